@@ -0,0 +1,89 @@
+// BCEncrypt XOR throughput per kernel
+//
+// Times each kernel this CPU can run against the original byte loop on
+// buffers from a small XML reply up to a large video message, and reports
+// GB/s. The offset changes every call as it does on a connection.
+//
+// Usage: bench_bc_crypto [--seconds S]
+
+#include "protocol/bc_crypto.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The byte loop BcCrypto used before the kernels
+void byte_loop(uint32_t offset, uint8_t* data, size_t len) {
+    uint8_t offset_byte = static_cast<uint8_t>(offset & 0xFF);
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = data[i] ^ BC_ENCRYPT_KEY[(offset + i) % 8] ^ offset_byte;
+    }
+}
+
+double measure(void (*apply)(uint32_t, uint8_t*, size_t), std::vector<uint8_t>& buffer,
+               double seconds) {
+    uint64_t bytes = 0;
+    uint32_t offset = 0;
+    auto start = Clock::now();
+    double elapsed = 0;
+    do {
+        for (int i = 0; i < 64; i++) {
+            apply(offset, buffer.data(), buffer.size());
+            offset += static_cast<uint32_t>(buffer.size());
+            bytes += buffer.size();
+        }
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < seconds);
+    return static_cast<double>(bytes) / elapsed / 1e9;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = 0.5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::stod(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--seconds S]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<BcXorKernel> kernels = bc_xor_kernels();
+    kernels.insert(kernels.begin(), BcXorKernel{"byte loop", true, byte_loop});
+
+    std::printf("BcCrypto uses: %s\n", bc_xor_kernel_name());
+    std::printf("%-10s", "GB/s");
+    for (size_t size : {256, 1500, 64 * 1024, 1024 * 1024}) {
+        std::printf(" %10zu B", size);
+    }
+    std::printf("\n");
+
+    std::mt19937 rng(1);
+    for (const BcXorKernel& kernel : kernels) {
+        if (!kernel.supported) {
+            std::printf("%-10s not supported by this CPU\n", kernel.name);
+            continue;
+        }
+        std::printf("%-10s", kernel.name);
+        for (size_t size : {256, 1500, 64 * 1024, 1024 * 1024}) {
+            std::vector<uint8_t> buffer(size);
+            for (uint8_t& b : buffer) {
+                b = static_cast<uint8_t>(rng());
+            }
+            std::printf(" %12.2f", measure(kernel.apply, buffer, seconds));
+            std::fflush(stdout);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
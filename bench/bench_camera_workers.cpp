@@ -0,0 +1,462 @@
+// Thread count against camera count, 1 to 64 cameras
+//
+// A fake camera server (one thread, epoll) speaks just enough Baichuan to
+// log in (unencrypted) and stream BcMedia frames at 25 fps, and serves an
+// MJPEG multipart stream at the same rate. For every camera count the
+// cameras are started through CameraContext - the same lifecycle the
+// dashboard and recorder run - and, once all are streaming, the process's
+// thread count is read from /proc/self/status. It should stay flat: camera
+// lifecycles run on the I/O reactor, not on a thread each. Also reported:
+// time until every camera streams, frames/s received and time to stop.
+//
+// Each Baichuan camera logs in with its own user name, so every camera has
+// its own connection rather than sharing one (as an NVR's channels would).
+//
+// Usage: bench_camera_workers [--cameras 1,2,4,...] [--seconds S]
+//                             [--type baichuan|mjpeg]
+
+#include "worker/camera_worker.h"
+#include "support/synthetic_stream.h"
+#include "utils/io_reactor.h"
+#include "utils/logger.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto FRAME_INTERVAL = std::chrono::milliseconds(40);
+constexpr auto READY_TIMEOUT = std::chrono::seconds(20);
+
+constexpr const char* ENCRYPTION_XML =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+    "<body>\n"
+    "<Encryption version=\"1.1\">\n"
+    "<type>none</type>\n"
+    "<nonce>0123456789abcdef</nonce>\n"
+    "</Encryption>\n"
+    "</body>\n";
+
+constexpr const char* MJPEG_BOUNDARY = "frame";
+
+struct Options {
+    std::vector<int> cameras = {1, 2, 4, 8, 16, 32, 64};
+    double seconds = 2.0;
+    std::string type;   // Empty = both
+};
+
+int read_thread_count() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) {
+            return std::atoi(line.c_str() + 8);
+        }
+    }
+    return -1;
+}
+
+void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+int listen_local(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+        std::perror("listen");
+        std::exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    set_nonblocking(fd);
+    return fd;
+}
+
+// The camera side of every connection, on one thread
+class FakeCameraServer {
+public:
+    FakeCameraServer() {
+        baichuan_listener_ = listen_local(baichuan_port_);
+        mjpeg_listener_ = listen_local(mjpeg_port_);
+
+        // A GOP of small frames, sent round and round
+        std::mt19937 rng(7);
+        for (const test::MediaFrame& frame : test::generate_media(rng, 50, 8 * 1024)) {
+            std::vector<uint8_t> bytes;
+            test::encode_frame(frame, bytes);
+            media_frames_.push_back(std::move(bytes));
+        }
+
+        // Not a picture; the cameras don't decode it
+        jpeg_.assign(4096, 0x55);
+        jpeg_[0] = 0xFF;
+        jpeg_[1] = 0xD8;
+        jpeg_[jpeg_.size() - 2] = 0xFF;
+        jpeg_[jpeg_.size() - 1] = 0xD9;
+
+        epoll_fd_ = epoll_create1(0);
+        watch(baichuan_listener_, EPOLLIN);
+        watch(mjpeg_listener_, EPOLLIN);
+        thread_ = std::thread(&FakeCameraServer::run, this);
+    }
+
+    ~FakeCameraServer() {
+        running_.store(false);
+        thread_.join();
+        for (auto& entry : clients_) {
+            close(entry.first);
+        }
+        close(baichuan_listener_);
+        close(mjpeg_listener_);
+        close(epoll_fd_);
+    }
+
+    uint16_t baichuan_port() const { return baichuan_port_; }
+    uint16_t mjpeg_port() const { return mjpeg_port_; }
+
+private:
+    struct Client {
+        bool mjpeg = false;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        bool streaming = false;
+        uint16_t stream_num = 0;
+        size_t next_frame = 0;
+        bool want_write = false;
+    };
+
+    int epoll_fd_ = -1;
+    int baichuan_listener_ = -1;
+    int mjpeg_listener_ = -1;
+    uint16_t baichuan_port_ = 0;
+    uint16_t mjpeg_port_ = 0;
+    std::vector<std::vector<uint8_t>> media_frames_;
+    std::vector<uint8_t> jpeg_;
+    std::map<int, Client> clients_;
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+
+    void watch(int fd, uint32_t events) {
+        struct epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void run() {
+        auto next_tick = Clock::now() + FRAME_INTERVAL;
+        struct epoll_event events[64];
+        while (running_.load()) {
+            int wait_ms = static_cast<int>(std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::milliseconds>(next_tick - Clock::now()).count()));
+            int n = epoll_wait(epoll_fd_, events, 64, std::min(wait_ms, 50));
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == baichuan_listener_ || fd == mjpeg_listener_) {
+                    accept_all(fd, fd == mjpeg_listener_);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    if (!read_client(fd)) {
+                        drop(fd);
+                        continue;
+                    }
+                }
+                if (events[i].events & EPOLLOUT) {
+                    flush(fd);
+                }
+            }
+
+            if (Clock::now() >= next_tick) {
+                next_tick += FRAME_INTERVAL;
+                send_frames();
+            }
+        }
+    }
+
+    void accept_all(int listener, bool mjpeg) {
+        while (true) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) return;
+            set_nonblocking(fd);
+            clients_[fd].mjpeg = mjpeg;
+            watch(fd, EPOLLIN);
+        }
+    }
+
+    void drop(int fd) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        clients_.erase(fd);
+    }
+
+    // False once the client has gone
+    bool read_client(int fd) {
+        Client& client = clients_[fd];
+        uint8_t buf[16384];
+        while (true) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                client.in.insert(client.in.end(), buf, buf + n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        return client.mjpeg ? handle_http(fd, client) : handle_messages(fd, client);
+    }
+
+    bool handle_http(int fd, Client& client) {
+        static const char END[] = "\r\n\r\n";
+        if (client.streaming ||
+            std::search(client.in.begin(), client.in.end(), END, END + 4) == client.in.end()) {
+            client.in.clear();
+            return true;
+        }
+        client.in.clear();
+        std::string response = std::string("HTTP/1.0 200 OK\r\n"
+                                           "Content-Type: multipart/x-mixed-replace; boundary=") +
+                               MJPEG_BOUNDARY + "\r\n\r\n";
+        queue(fd, client, reinterpret_cast<const uint8_t*>(response.data()), response.size());
+        client.streaming = true;
+        return true;
+    }
+
+    bool handle_messages(int fd, Client& client) {
+        size_t pos = 0;
+        while (client.in.size() - pos >= HEADER_SIZE_20) {
+            BcHeader header;
+            size_t header_len = BcHeader::deserialize(client.in.data() + pos, client.in.size() - pos, header);
+            if (header_len == 0) break;
+            if (client.in.size() - pos < header_len + header.body_len) break;
+            pos += header_len + header.body_len;
+            reply(fd, client, header);
+        }
+        client.in.erase(client.in.begin(), client.in.begin() + static_cast<std::ptrdiff_t>(pos));
+        return true;
+    }
+
+    void reply(int fd, Client& client, const BcHeader& request) {
+        BcMessage msg;
+        if (request.msg_id == MSG_ID_LOGIN && request.msg_class == MSG_CLASS_LEGACY) {
+            msg = BcMessage::create_with_payload(MSG_ID_LOGIN, request.msg_num, ENCRYPTION_XML);
+            msg.header.response_code = ENC_RESP_NONE;
+        } else if (request.msg_id == MSG_ID_VIDEO) {
+            msg = BcMessage::create_with_extension(MSG_ID_VIDEO, request.msg_num,
+                                                   test::VIDEO_EXTENSION_XML, {});
+            msg.header.response_code = RESPONSE_CODE_OK;
+            client.streaming = true;
+            client.stream_num = request.msg_num;
+        } else {
+            // Modern login, pings, motion requests, VIDEO_STOP
+            msg = BcMessage::create_header_only(request.msg_id, request.msg_num);
+            msg.header.response_code = RESPONSE_CODE_OK;
+            if (request.msg_id == MSG_ID_VIDEO_STOP) {
+                client.streaming = false;
+            }
+        }
+        std::vector<uint8_t> bytes = msg.serialize();
+        queue(fd, client, bytes.data(), bytes.size());
+    }
+
+    void send_frames() {
+        for (auto& entry : clients_) {
+            Client& client = entry.second;
+            if (!client.streaming || !client.out.empty()) continue;   // Slow reader: skip a frame
+            if (client.mjpeg) {
+                std::string part = std::string("--") + MJPEG_BOUNDARY + "\r\n"
+                                   "Content-Type: image/jpeg\r\n"
+                                   "Content-Length: " + std::to_string(jpeg_.size()) + "\r\n\r\n";
+                std::vector<uint8_t> bytes(part.begin(), part.end());
+                bytes.insert(bytes.end(), jpeg_.begin(), jpeg_.end());
+                bytes.push_back('\r');
+                bytes.push_back('\n');
+                queue(entry.first, client, bytes.data(), bytes.size());
+            } else {
+                const std::vector<uint8_t>& media = media_frames_[client.next_frame];
+                client.next_frame = (client.next_frame + 1) % media_frames_.size();
+                std::vector<uint8_t> bytes = test::wrap_in_messages(media, client.stream_num);
+                queue(entry.first, client, bytes.data(), bytes.size());
+            }
+        }
+    }
+
+    void queue(int fd, Client& client, const uint8_t* data, size_t len) {
+        client.out.insert(client.out.end(), data, data + len);
+        flush(fd);
+    }
+
+    void flush(int fd) {
+        Client& client = clients_[fd];
+        while (!client.out.empty()) {
+            ssize_t n = send(fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+            if (n <= 0) break;
+            client.out.erase(client.out.begin(), client.out.begin() + n);
+        }
+        bool want_write = !client.out.empty();
+        if (want_write != client.want_write) {
+            client.want_write = want_write;
+            struct epoll_event ev{};
+            ev.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+};
+
+struct Result {
+    int cameras = 0;
+    int threads = 0;           // Whole process, bench server thread excluded
+    double ready_ms = 0;       // Until every camera streams
+    double frames_per_sec = 0;
+    double stop_ms = 0;
+    bool all_ready = false;
+};
+
+Result run(const FakeCameraServer& server, CameraType type, int count, double seconds) {
+    std::atomic<uint64_t> frames{0};
+    std::vector<std::unique_ptr<CameraContext>> cameras;
+    for (int i = 0; i < count; i++) {
+        auto ctx = std::make_unique<CameraContext>();
+        ctx->index = static_cast<size_t>(i);
+        ctx->config.type = type;
+        ctx->config.name = "bench" + std::to_string(i);
+        ctx->config.host = "127.0.0.1";
+        ctx->config.port = server.baichuan_port();
+        ctx->config.username = "bench" + std::to_string(i);
+        ctx->config.password = "secret";
+        ctx->config.encryption = "none";
+        ctx->config.stream = "main";
+        ctx->config.url = "http://127.0.0.1:" + std::to_string(server.mjpeg_port()) + "/video";
+        ctx->handlers.on_packet = [&frames](const VideoPacket&) { frames++; };
+        ctx->handlers.on_mjpeg_poll = [](MjpegSource& source) {
+            source.set_decode_policy(DecodePolicy::Suspended);
+        };
+        cameras.push_back(std::move(ctx));
+    }
+
+    Result result;
+    result.cameras = count;
+
+    auto start = Clock::now();
+    for (auto& ctx : cameras) {
+        ctx->start();
+    }
+    auto all_streaming = [&cameras] {
+        return std::all_of(cameras.begin(), cameras.end(), [](const std::unique_ptr<CameraContext>& ctx) {
+            return ctx->state.load() == CameraState::Streaming;
+        });
+    };
+    while (!all_streaming() && Clock::now() - start < READY_TIMEOUT) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    result.all_ready = all_streaming();
+    result.ready_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    auto count_frames = [&] {
+        uint64_t total = frames.load();
+        for (auto& ctx : cameras) {
+            total += ctx->metrics.mjpeg.frames_received.load();
+        }
+        return total;
+    };
+    uint64_t frames_before = count_frames();
+    auto measure_start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    result.threads = read_thread_count() - 1;
+    double elapsed = std::chrono::duration<double>(Clock::now() - measure_start).count();
+    result.frames_per_sec = static_cast<double>(count_frames() - frames_before) / elapsed;
+
+    auto stop_start = Clock::now();
+    for (auto& ctx : cameras) {
+        ctx->stop();
+    }
+    result.stop_ms = std::chrono::duration<double, std::milli>(Clock::now() - stop_start).count();
+    return result;
+}
+
+std::vector<int> parse_list(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+void usage(const char* program) {
+    std::fprintf(stderr,
+                 "Usage: %s [--cameras 1,2,4,...] [--seconds S] [--type baichuan|mjpeg]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--cameras" && i + 1 < argc) {
+            options.cameras = parse_list(argv[++i]);
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            options.seconds = std::stod(argv[++i]);
+        } else if (arg == "--type" && i + 1 < argc) {
+            options.type = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Logger::instance().set_level(LogLevel::Error);
+
+    FakeCameraServer server;
+    IoReactor& reactor = IoReactor::instance();
+    std::printf("reactor threads: %zu, process threads with no camera: %d (bench server excluded)\n\n",
+                reactor.thread_count(), read_thread_count() - 1);
+
+    bool failed = false;
+    for (const char* type_name : {"baichuan", "mjpeg"}) {
+        if (!options.type.empty() && options.type != type_name) continue;
+        CameraType type = std::strcmp(type_name, "mjpeg") == 0 ? CameraType::Mjpeg : CameraType::Baichuan;
+
+        std::printf("%s\n", type_name);
+        std::printf("%8s %8s %10s %10s %9s\n", "cameras", "threads", "ready ms", "frames/s", "stop ms");
+        for (int count : options.cameras) {
+            Result result = run(server, type, count, options.seconds);
+            std::printf("%8d %8d %10.0f %10.0f %9.0f%s\n", result.cameras, result.threads,
+                        result.ready_ms, result.frames_per_sec, result.stop_ms,
+                        result.all_ready ? "" : "  (not all streaming)");
+            failed = failed || !result.all_ready;
+        }
+        std::printf("\n");
+    }
+    return failed ? 1 : 0;
+}
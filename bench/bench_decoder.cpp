@@ -0,0 +1,261 @@
+// Decoded frame conversion before and after direct BGRA output
+//
+//   rgb24+swizzle  the old path: sws_scale to RGB24, then a byte loop into
+//                  a BGRA vector allocated for every frame
+//   bgra           sws_scale straight to BGRA in a reused aligned buffer
+//   bgra 960x540   the same, scaled down to a dashboard pane on the way
+//
+// on a synthetic YUV420P frame at 1080p and 4K. With --h264 or --h265 FILE
+// (an Annex-B elementary stream, e.g. `ffmpeg -i clip.mp4 -c copy -f h264
+// clip.h264`) it also decodes the file through VideoDecoder, at native
+// size and scaled to 960x540, and reports frames/s.
+//
+// Usage: bench_decoder [--seconds S] [--h264 FILE | --h265 FILE]
+
+#include "video/decoder.h"
+#include "utils/logger.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libswscale/swscale.h>
+}
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int PANE_WIDTH = 960;
+constexpr int PANE_HEIGHT = 540;
+
+AVFrame* make_yuv_frame(int width, int height) {
+    AVFrame* frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 32) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+    // Gradients, so the scaler has real work to do
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            frame->data[0][y * frame->linesize[0] + x] = static_cast<uint8_t>(x + y);
+        }
+    }
+    for (int y = 0; y < height / 2; y++) {
+        for (int x = 0; x < width / 2; x++) {
+            frame->data[1][y * frame->linesize[1] + x] = static_cast<uint8_t>(x * 2);
+            frame->data[2][y * frame->linesize[2] + x] = static_cast<uint8_t>(y * 2);
+        }
+    }
+    return frame;
+}
+
+// Converts one frame per call; returns a byte of the output so the work
+// can't be optimized away
+class Converter {
+public:
+    Converter(const AVFrame* frame, AVPixelFormat format, int out_width, int out_height,
+              bool swizzle)
+        : frame_(frame), width_(out_width), height_(out_height), swizzle_(swizzle) {
+        sws_ = sws_getContext(frame->width, frame->height, AV_PIX_FMT_YUV420P, out_width,
+                              out_height, format, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        int bytes_per_pixel = format == AV_PIX_FMT_BGRA ? 4 : 3;
+        stride_ = (out_width * bytes_per_pixel + 31) & ~31;
+        buffer_ = static_cast<uint8_t*>(av_malloc(static_cast<size_t>(stride_) * out_height));
+    }
+
+    ~Converter() {
+        sws_freeContext(sws_);
+        av_free(buffer_);
+    }
+
+    bool ok() const { return sws_ && buffer_; }
+
+    uint8_t convert() {
+        uint8_t* dst_data[4] = {buffer_, nullptr, nullptr, nullptr};
+        int dst_linesize[4] = {stride_, 0, 0, 0};
+        sws_scale(sws_, frame_->data, frame_->linesize, 0, frame_->height, dst_data, dst_linesize);
+        if (!swizzle_) {
+            return buffer_[static_cast<size_t>(stride_) * (height_ / 2)];
+        }
+
+        // As the decoder did before: a fresh BGRA frame every time
+        std::vector<uint8_t> bgra(static_cast<size_t>(width_) * height_ * 4);
+        for (int y = 0; y < height_; y++) {
+            const uint8_t* src = buffer_ + static_cast<size_t>(y) * stride_;
+            uint8_t* dst = bgra.data() + static_cast<size_t>(y) * width_ * 4;
+            for (int x = 0; x < width_; x++) {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = 255;
+                src += 3;
+                dst += 4;
+            }
+        }
+        return bgra[bgra.size() / 2];
+    }
+
+private:
+    const AVFrame* frame_;
+    SwsContext* sws_ = nullptr;
+    uint8_t* buffer_ = nullptr;
+    int stride_ = 0;
+    int width_;
+    int height_;
+    bool swizzle_;
+};
+
+void bench_conversion(int width, int height, double seconds) {
+    AVFrame* frame = make_yuv_frame(width, height);
+    if (!frame) {
+        std::fprintf(stderr, "Cannot allocate a %dx%d frame\n", width, height);
+        return;
+    }
+
+    struct Mode {
+        const char* name;
+        AVPixelFormat format;
+        int out_width;
+        int out_height;
+        bool swizzle;
+    };
+    const Mode modes[] = {
+        {"rgb24+swizzle", AV_PIX_FMT_RGB24, width, height, true},
+        {"bgra", AV_PIX_FMT_BGRA, width, height, false},
+        {"bgra 960x540", AV_PIX_FMT_BGRA, PANE_WIDTH, PANE_HEIGHT, false},
+    };
+
+    std::printf("%dx%d YUV420P:\n", width, height);
+    for (const Mode& mode : modes) {
+        Converter converter(frame, mode.format, mode.out_width, mode.out_height, mode.swizzle);
+        if (!converter.ok()) {
+            std::printf("  %-14s unavailable\n", mode.name);
+            continue;
+        }
+        unsigned sink = 0;
+        uint64_t frames = 0;
+        auto start = Clock::now();
+        double elapsed = 0;
+        do {
+            sink += converter.convert();
+            frames++;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < seconds);
+        std::printf("  %-14s %8.2f ms/frame %8.1f frames/s   (%u)\n", mode.name,
+                    elapsed * 1000.0 / static_cast<double>(frames),
+                    static_cast<double>(frames) / elapsed, sink & 1);
+    }
+    av_frame_free(&frame);
+}
+
+// Split an Annex-B file into packets with the FFmpeg parser
+std::vector<std::vector<uint8_t>> split_packets(const std::vector<uint8_t>& file, VideoCodec codec) {
+    std::vector<std::vector<uint8_t>> packets;
+    AVCodecParserContext* parser =
+        av_parser_init(codec == VideoCodec::H265 ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264);
+    AVCodecContext* ctx = avcodec_alloc_context3(nullptr);
+    if (!parser || !ctx) {
+        return packets;
+    }
+
+    const uint8_t* data = file.data();
+    int remaining = static_cast<int>(file.size());
+    while (true) {
+        uint8_t* out = nullptr;
+        int out_size = 0;
+        int used = av_parser_parse2(parser, ctx, &out, &out_size, data, remaining, AV_NOPTS_VALUE,
+                                    AV_NOPTS_VALUE, 0);
+        if (used < 0) break;
+        data += used;
+        remaining -= used;
+        if (out_size > 0) {
+            packets.emplace_back(out, out + out_size);
+        }
+        if (remaining == 0 && out_size == 0) {
+            break;    // Flushed (parsing with no input drains the last packet)
+        }
+    }
+
+    av_parser_close(parser);
+    avcodec_free_context(&ctx);
+    return packets;
+}
+
+void bench_decode(const std::vector<std::vector<uint8_t>>& packets, VideoCodec codec, int max_width,
+                  int max_height) {
+    VideoDecoder decoder;
+    decoder.set_output_size(max_width, max_height);
+    if (!decoder.init(codec)) {
+        std::fprintf(stderr, "Cannot open the decoder\n");
+        return;
+    }
+
+    uint64_t frames = 0;
+    int width = 0;
+    int height = 0;
+    auto on_frame = [&](const DecodedFrame& frame) {
+        frames++;
+        width = frame.width;
+        height = frame.height;
+    };
+
+    auto start = Clock::now();
+    for (const auto& packet : packets) {
+        decoder.decode(packet.data(), packet.size(), on_frame);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("  decode -> %dx%d BGRA: %llu frames, %.1f frames/s\n", width, height,
+                static_cast<unsigned long long>(frames), static_cast<double>(frames) / elapsed);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = 1.0;
+    std::string file;
+    VideoCodec codec = VideoCodec::H264;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::stod(argv[++i]);
+        } else if ((arg == "--h264" || arg == "--h265") && i + 1 < argc) {
+            codec = arg == "--h265" ? VideoCodec::H265 : VideoCodec::H264;
+            file = argv[++i];
+        } else {
+            std::fprintf(stderr, "Usage: %s [--seconds S] [--h264 FILE | --h265 FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Logger::instance().set_level(LogLevel::Warning);
+
+    bench_conversion(1920, 1080, seconds);
+    bench_conversion(3840, 2160, seconds);
+
+    if (!file.empty()) {
+        std::ifstream in(file, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        auto packets = split_packets(bytes, codec);
+        if (packets.empty()) {
+            std::fprintf(stderr, "No packets in %s\n", file.c_str());
+            return 1;
+        }
+        std::printf("%s: %zu packets\n", file.c_str(), packets.size());
+        bench_decode(packets, codec, 0, 0);
+        bench_decode(packets, codec, PANE_WIDTH, PANE_HEIGHT);
+    }
+    return 0;
+}
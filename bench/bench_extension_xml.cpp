@@ -0,0 +1,82 @@
+// Extension XML parsing: the scanner against libxml2
+//
+// Times ExtensionXml::parse (the single-pass scanner, which every media
+// message goes through) and ExtensionXml::parse_dom (libxml2, what parse
+// did before and still does for anything outside the plain form) on the
+// Extensions a camera sends with video messages and a login reply.
+//
+// Usage: bench_extension_xml [--seconds S]
+
+#include "protocol/bc_xml.h"
+#include "support/synthetic_stream.h"
+#include <libxml/parser.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const LOGIN_EXTENSION_XML =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+    "<Extension version=\"1.1\">\n"
+    "<userName>admin</userName>\n"
+    "<token>0123456789abcdef0123456789abcdef</token>\n"
+    "<channelId>0</channelId>\n"
+    "</Extension>\n";
+
+template <typename Parse>
+void bench(const char* name, const std::string& xml, double seconds, Parse parse) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(xml.data());
+    uint64_t calls = 0;
+    unsigned sink = 0;
+    auto start = Clock::now();
+    double elapsed = 0;
+    do {
+        // Check the clock every 1024 calls so it doesn't dominate the scanner
+        for (int i = 0; i < 1024; i++) {
+            sink += parse(data, xml.size());
+        }
+        calls += 1024;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < seconds);
+    std::printf("  %-10s %9.1f ns/op %12.0f ops/s   (%u)\n", name,
+                elapsed * 1e9 / static_cast<double>(calls), static_cast<double>(calls) / elapsed,
+                sink & 1);
+}
+
+void bench_extension(const char* label, const std::string& xml, double seconds) {
+    std::printf("%s (%zu bytes):\n", label, xml.size());
+    bench("scanner", xml, seconds, [](const uint8_t* data, size_t len) {
+        auto ext = ExtensionXml::parse(data, len);
+        return ext ? ext->channel_id.value_or(1) + ext->binary_data.value_or(1) : 0u;
+    });
+    bench("libxml2", xml, seconds, [](const uint8_t* data, size_t len) {
+        auto ext = ExtensionXml::parse_dom(data, len);
+        return ext ? ext->channel_id.value_or(1) + ext->binary_data.value_or(1) : 0u;
+    });
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = 1.0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--seconds S]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    xmlInitParser();
+    bench_extension("video", test::VIDEO_EXTENSION_XML, seconds);
+    bench_extension("login", LOGIN_EXTENSION_XML, seconds);
+    return 0;
+}
@@ -0,0 +1,285 @@
+// Receive scaling from 1 to 64 cameras
+//
+// Each simulated camera writes BC video messages into its own socketpair;
+// the client end is read either
+//   reactor  by a MessageDemux on the shared IoReactor (how the dashboard
+//            and recorder receive), or
+//   threads  by a blocking receive thread per camera (the old model).
+// For every camera count it reports the receive threads used, throughput,
+// the CPU spent receiving (the camera threads' own CPU time is subtracted)
+// and the delay from write to callback.
+//
+// Unpaced (the default) every camera writes as fast as it can; with --kbps
+// each camera sends at that bitrate, which shows the CPU cost per camera.
+//
+// Usage: bench_io_reactor [--cameras 1,2,4,...] [--seconds S] [--kbps K]
+//                         [--message-bytes B] [--mode reactor|threads]
+
+#include "client/demux.h"
+#include "support/synthetic_stream.h"
+#include "utils/io_reactor.h"
+#include "utils/logger.h"
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t STREAM_NUM = 3;
+constexpr size_t MAX_SAMPLES = 100000;    // Latency samples kept per camera
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+double thread_cpu_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+double process_cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Options {
+    std::vector<int> cameras = {1, 2, 4, 8, 16, 32, 64};
+    double seconds = 2.0;
+    int kbps = 0;                 // 0 = unpaced
+    size_t message_bytes = 16 * 1024;
+    std::string mode;             // Empty = both
+};
+
+// One simulated camera and its client side
+struct Camera {
+    int camera_fd = -1;
+    Connection conn;
+    std::unique_ptr<MessageDemux> demux;
+    std::thread writer;
+    std::thread reader;
+    double writer_cpu = 0;
+
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::vector<int64_t> latency_ns;    // Only touched by the receiving thread
+
+    void on_message(const BcMessageView& msg) {
+        messages.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(msg.payload_len, std::memory_order_relaxed);
+        if (msg.payload_len >= sizeof(int64_t) && latency_ns.size() < MAX_SAMPLES) {
+            int64_t sent;
+            memcpy(&sent, msg.payload_data, sizeof(sent));
+            latency_ns.push_back(now_ns() - sent);
+        }
+    }
+};
+
+void write_loop(Camera& camera, const Options& options, const std::atomic<bool>& running) {
+    std::vector<uint8_t> payload(options.message_bytes);
+    BcMessage msg = BcMessage::create_with_extension(MSG_ID_VIDEO, STREAM_NUM,
+                                                     test::VIDEO_EXTENSION_XML, payload);
+    std::vector<uint8_t> bytes = msg.serialize();
+    size_t stamp_offset = bytes.size() - payload.size();
+
+    // Paced: messages/s for the bitrate, sent in per-frame bursts (25 fps)
+    double per_second = options.kbps > 0
+        ? options.kbps * 1000.0 / 8.0 / static_cast<double>(options.message_bytes) : 0;
+    auto start = Clock::now();
+    uint64_t sent = 0;
+
+    while (running.load(std::memory_order_relaxed)) {
+        if (per_second > 0) {
+            double due = static_cast<double>(sent) / per_second;
+            auto due_time = start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(due));
+            if (due_time > Clock::now()) {
+                std::this_thread::sleep_until(
+                    std::min(due_time, Clock::now() + std::chrono::milliseconds(40)));
+                continue;
+            }
+        }
+        int64_t stamp = now_ns();
+        memcpy(bytes.data() + stamp_offset, &stamp, sizeof(stamp));
+        size_t offset = 0;
+        while (offset < bytes.size()) {
+            ssize_t n = ::write(camera.camera_fd, bytes.data() + offset, bytes.size() - offset);
+            if (n <= 0) {
+                camera.writer_cpu = thread_cpu_seconds();
+                return;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        sent++;
+    }
+    camera.writer_cpu = thread_cpu_seconds();
+}
+
+double percentile(std::vector<int64_t>& samples, double p) {
+    if (samples.empty()) return 0;
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+    return static_cast<double>(samples[index]) / 1e6;
+}
+
+bool run(const std::string& mode, int count, const Options& options) {
+    std::vector<std::unique_ptr<Camera>> cameras;
+    for (int i = 0; i < count; i++) {
+        auto camera = std::make_unique<Camera>();
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            std::fprintf(stderr, "socketpair: %s\n", std::strerror(errno));
+            return false;
+        }
+        camera->camera_fd = fds[0];
+        camera->conn.attach(fds[1], "camera" + std::to_string(i));
+        camera->latency_ns.reserve(MAX_SAMPLES);
+        cameras.push_back(std::move(camera));
+    }
+
+    std::atomic<bool> writing{true};
+    std::atomic<bool> reading{true};
+    size_t receive_threads = 0;
+
+    if (mode == "reactor") {
+        for (auto& camera : cameras) {
+            Camera* c = camera.get();
+            c->demux = std::make_unique<MessageDemux>(c->conn);
+            c->demux->add_route(STREAM_NUM, [c](const BcMessageView& msg) { c->on_message(msg); });
+            if (!c->demux->start()) {
+                std::fprintf(stderr, "MessageDemux::start failed\n");
+                return false;
+            }
+        }
+        receive_threads = IoReactor::instance().thread_count();
+    } else {
+        for (auto& camera : cameras) {
+            Camera* c = camera.get();
+            c->reader = std::thread([c, &reading] {
+                auto on_message = [c](const BcMessageView& msg) { c->on_message(msg); };
+                while (reading.load(std::memory_order_relaxed)) {
+                    c->conn.receive_message_view(on_message, 100);
+                }
+            });
+        }
+        receive_threads = cameras.size();
+    }
+
+    uint64_t wakeups_before = IoReactor::instance().stats().wakeups;
+    double cpu_before = process_cpu_seconds();
+    auto start = Clock::now();
+    for (auto& camera : cameras) {
+        Camera* c = camera.get();
+        c->writer = std::thread([c, &options, &writing] { write_loop(*c, options, writing); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    for (auto& camera : cameras) {
+        messages += camera->messages.load();
+        bytes += camera->bytes.load();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = process_cpu_seconds() - cpu_before;
+    uint64_t wakeups = IoReactor::instance().stats().wakeups - wakeups_before;
+
+    // Writers may be blocked on a full socket: keep reading until they stop
+    writing.store(false);
+    for (auto& camera : cameras) {
+        camera->writer.join();
+        cpu -= camera->writer_cpu;
+    }
+    reading.store(false);
+    for (auto& camera : cameras) {
+        if (camera->demux) {
+            camera->demux->stop();
+        }
+        if (camera->reader.joinable()) {
+            camera->reader.join();
+        }
+        close(camera->camera_fd);
+    }
+
+    std::vector<int64_t> latency;
+    for (auto& camera : cameras) {
+        latency.insert(latency.end(), camera->latency_ns.begin(), camera->latency_ns.end());
+    }
+    double p50 = percentile(latency, 0.50);
+    double p99 = percentile(latency, 0.99);
+
+    std::printf("%7d  %-8s %7zu %10.1f %11.0f %9.1f%% %9.3f %9.3f %12s\n", count, mode.c_str(),
+                receive_threads, static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed,
+                static_cast<double>(messages) / elapsed, 100.0 * std::max(0.0, cpu) / elapsed, p50, p99,
+                mode == "reactor" ? std::to_string(wakeups).c_str() : "-");
+    return true;
+}
+
+std::vector<int> parse_list(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int value = std::atoi(item.c_str());
+        if (value > 0) values.push_back(value);
+    }
+    return values;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--cameras" && has_value) {
+            options.cameras = parse_list(argv[++i]);
+        } else if (arg == "--seconds" && has_value) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (arg == "--kbps" && has_value) {
+            options.kbps = std::atoi(argv[++i]);
+        } else if (arg == "--message-bytes" && has_value) {
+            options.message_bytes = std::max<size_t>(sizeof(int64_t), std::stoul(argv[++i]));
+        } else if (arg == "--mode" && has_value) {
+            options.mode = argv[++i];
+        } else {
+            std::fprintf(stderr,
+                         "Usage: %s [--cameras 1,2,4,...] [--seconds S] [--kbps K] "
+                         "[--message-bytes B] [--mode reactor|threads]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Logger::instance().set_level(LogLevel::Error);
+
+    std::printf("%s, %zu-byte messages, %.1f s per run\n",
+                options.kbps > 0 ? (std::to_string(options.kbps) + " kb/s per camera").c_str() : "unpaced",
+                options.message_bytes, options.seconds);
+    std::printf("%7s  %-8s %7s %10s %11s %10s %9s %9s %12s\n", "cameras", "mode", "threads", "MB/s",
+                "msgs/s", "recv CPU", "p50 ms", "p99 ms", "wakeups");
+    for (int count : options.cameras) {
+        for (const char* mode : {"reactor", "threads"}) {
+            if (!options.mode.empty() && options.mode != mode) continue;
+            if (!run(mode, count, options)) return 1;
+        }
+    }
+    return 0;
+}
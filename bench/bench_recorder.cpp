@@ -0,0 +1,311 @@
+// Recorder load: many cameras stream-copied to disk at once
+//
+// Drives one SegmentWriter per simulated camera with synthetic H.264 at the
+// camera's frame rate and bitrate (a keyframe with SPS/PPS every GOP, the
+// rest P-frames), the way the recorder's receive threads do, then reports
+// CPU use, memory, queue drops and bytes written.
+//
+// Usage: bench_recorder [--streams N] [--seconds S] [--fps F] [--kbps K]
+//                       [--segment-seconds S] [--format mp4|fmp4|mkv|ts]
+//                       [--dir DIR] [--keep]
+//
+// The files go to a fresh directory under /tmp unless --dir is given and
+// are removed afterwards unless --keep is given.
+
+#include "recorder/segment_writer.h"
+#include "utils/logger.h"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// RBSP bit writer for the parameter sets
+class BitWriter {
+public:
+    void bits(uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--) {
+            bit((value >> i) & 1);
+        }
+    }
+
+    void ue(uint32_t value) {
+        uint32_t coded = value + 1;
+        int length = 0;
+        while ((coded >> length) > 1) length++;
+        bits(0, length);
+        bits(coded, length + 1);
+    }
+
+    void se(int32_t value) {
+        ue(value > 0 ? static_cast<uint32_t>(2 * value - 1) : static_cast<uint32_t>(-2 * value));
+    }
+
+    // rbsp_trailing_bits, then emulation prevention
+    std::vector<uint8_t> finish() {
+        bit(1);
+        while (count_ != 0) bit(0);
+        std::vector<uint8_t> out;
+        int zeros = 0;
+        for (uint8_t b : bytes_) {
+            if (zeros == 2 && b <= 3) {
+                out.push_back(3);
+                zeros = 0;
+            }
+            out.push_back(b);
+            zeros = b == 0 ? zeros + 1 : 0;
+        }
+        return out;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+    uint8_t current_ = 0;
+    int count_ = 0;
+
+    void bit(uint32_t b) {
+        current_ = static_cast<uint8_t>((current_ << 1) | b);
+        if (++count_ == 8) {
+            bytes_.push_back(current_);
+            current_ = 0;
+            count_ = 0;
+        }
+    }
+};
+
+// Baseline-profile SPS and PPS for a 1920x1080 stream
+std::vector<uint8_t> parameter_sets() {
+    BitWriter sps;
+    sps.bits(66, 8);        // profile_idc: Baseline
+    sps.bits(0xC0, 8);      // constraint_set0/1
+    sps.bits(40, 8);        // level_idc 4.0
+    sps.ue(0);              // seq_parameter_set_id
+    sps.ue(0);              // log2_max_frame_num_minus4
+    sps.ue(2);              // pic_order_cnt_type
+    sps.ue(1);              // max_num_ref_frames
+    sps.bits(0, 1);         // gaps_in_frame_num_value_allowed_flag
+    sps.ue(1920 / 16 - 1);  // pic_width_in_mbs_minus1
+    sps.ue(1088 / 16 - 1);  // pic_height_in_map_units_minus1
+    sps.bits(1, 1);         // frame_mbs_only_flag
+    sps.bits(1, 1);         // direct_8x8_inference_flag
+    sps.bits(1, 1);         // frame_cropping_flag: 1088 -> 1080
+    sps.ue(0);
+    sps.ue(0);
+    sps.ue(0);
+    sps.ue(4);
+    sps.bits(0, 1);         // vui_parameters_present_flag
+
+    BitWriter pps;
+    pps.ue(0);              // pic_parameter_set_id
+    pps.ue(0);              // seq_parameter_set_id
+    pps.bits(0, 1);         // entropy_coding_mode_flag: CAVLC
+    pps.bits(0, 1);         // bottom_field_pic_order_in_frame_present_flag
+    pps.ue(0);              // num_slice_groups_minus1
+    pps.ue(0);              // num_ref_idx_l0_default_active_minus1
+    pps.ue(0);              // num_ref_idx_l1_default_active_minus1
+    pps.bits(0, 1);         // weighted_pred_flag
+    pps.bits(0, 2);         // weighted_bipred_idc
+    pps.se(0);              // pic_init_qp_minus26
+    pps.se(0);              // pic_init_qs_minus26
+    pps.se(0);              // chroma_qp_index_offset
+    pps.bits(1, 1);         // deblocking_filter_control_present_flag
+    pps.bits(0, 1);         // constrained_intra_pred_flag
+    pps.bits(0, 1);         // redundant_pic_cnt_present_flag
+
+    std::vector<uint8_t> out;
+    for (auto [header, rbsp] : {std::make_pair(uint8_t{0x67}, sps.finish()),
+                                std::make_pair(uint8_t{0x68}, pps.finish())}) {
+        out.insert(out.end(), {0, 0, 0, 1, header});
+        out.insert(out.end(), rbsp.begin(), rbsp.end());
+    }
+    return out;
+}
+
+// One access unit: [SPS PPS] slice NAL with a random body. Zero bytes are
+// left out of the body so it never contains a start code.
+FrameBuffer make_access_unit(std::mt19937& rng, bool keyframe, size_t size) {
+    std::vector<uint8_t> au;
+    if (keyframe) {
+        au = parameter_sets();
+    }
+    au.insert(au.end(), {0, 0, 0, 1, static_cast<uint8_t>(keyframe ? 0x65 : 0x41)});
+    while (au.size() < size) {
+        au.push_back(static_cast<uint8_t>(1 + rng() % 255));
+    }
+    return FrameBuffer::copy_of(au.data(), au.size());
+}
+
+double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+long rss_kb(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind(field, 0) == 0) {
+            return std::atol(line.c_str() + std::string(field).size());
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int streams = 50;
+    double seconds = 30;
+    int fps = 25;
+    int kbps = 2048;
+    bool keep = false;
+    std::string dir;
+    RecordingConfig config;
+    config.segment_seconds = 10;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--streams" && has_value) {
+            streams = std::atoi(argv[++i]);
+        } else if (arg == "--seconds" && has_value) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "--fps" && has_value) {
+            fps = std::atoi(argv[++i]);
+        } else if (arg == "--kbps" && has_value) {
+            kbps = std::atoi(argv[++i]);
+        } else if (arg == "--segment-seconds" && has_value) {
+            config.segment_seconds = std::atoi(argv[++i]);
+        } else if (arg == "--format" && has_value) {
+            config.format = argv[++i];
+        } else if (arg == "--dir" && has_value) {
+            dir = argv[++i];
+        } else if (arg == "--keep") {
+            keep = true;
+        } else {
+            std::fprintf(stderr,
+                         "Usage: %s [--streams N] [--seconds S] [--fps F] [--kbps K] "
+                         "[--segment-seconds S] [--format mp4|fmp4|mkv|ts] [--dir DIR] [--keep]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+    if (streams <= 0 || fps <= 0 || kbps <= 0) {
+        std::fprintf(stderr, "--streams, --fps and --kbps must be positive\n");
+        return 2;
+    }
+
+    Logger::instance().set_level(LogLevel::Warning);
+
+    if (dir.empty()) {
+        dir = (std::filesystem::temp_directory_path() /
+               ("bench_recorder_" + std::to_string(getpid()))).string();
+    }
+    config.directory = dir;
+
+    // 2 s GOPs; a keyframe is ten P-frames' worth of bytes
+    int gop = 2 * fps;
+    size_t gop_bytes = static_cast<size_t>(kbps) * 1000 / 8 * 2;
+    size_t p_size = gop_bytes / static_cast<size_t>(gop - 1 + 10);
+    size_t i_size = 10 * p_size;
+
+    // A few distinct access units per stream, reused (payloads are shared)
+    std::mt19937 rng(1);
+    std::vector<FrameBuffer> keyframes;
+    std::vector<FrameBuffer> pframes;
+    for (int i = 0; i < 4; i++) {
+        keyframes.push_back(make_access_unit(rng, true, i_size));
+        pframes.push_back(make_access_unit(rng, false, p_size));
+    }
+
+    std::printf("%d streams, %d fps, %d kb/s (I %zu B, P %zu B), %.0f s, %s segments of %d s in %s\n",
+                streams, fps, kbps, i_size, p_size, seconds, config.format.c_str(),
+                config.segment_seconds, dir.c_str());
+
+    long rss_before = rss_kb("VmRSS:");
+    double cpu_before = cpu_seconds();
+    auto start = Clock::now();
+
+    std::vector<std::unique_ptr<SegmentWriter>> writers;
+    for (int i = 0; i < streams; i++) {
+        writers.push_back(std::make_unique<SegmentWriter>(config, "cam" + std::to_string(i)));
+    }
+
+    // One tick per frame interval writes a frame to every stream; cameras
+    // are spread across the interval as they would be on the wire
+    auto interval = std::chrono::microseconds(1000000 / fps);
+    int64_t frames = static_cast<int64_t>(seconds * fps);
+    double late_ms_max = 0;
+    for (int64_t n = 0; n < frames; n++) {
+        auto tick = start + n * interval;
+        for (int i = 0; i < streams; i++) {
+            auto due = tick + interval * i / streams;
+            auto now = Clock::now();
+            if (due > now) {
+                std::this_thread::sleep_until(due);
+            } else {
+                late_ms_max = std::max(late_ms_max, std::chrono::duration<double, std::milli>(now - due).count());
+            }
+
+            VideoPacket packet;
+            packet.keyframe = (n + i) % gop == 0;    // Staggered GOPs
+            packet.data = packet.keyframe ? keyframes[(n / gop) % keyframes.size()]
+                                          : pframes[n % pframes.size()];
+            packet.timestamp_us = n * 1000000 / fps;
+            writers[i]->write(packet);
+        }
+    }
+
+    long rss_peak_running = rss_kb("VmHWM:");
+    auto stop_start = Clock::now();
+    for (auto& writer : writers) {
+        writer->stop();
+    }
+    double stop_ms = std::chrono::duration<double, std::milli>(Clock::now() - stop_start).count();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = cpu_seconds() - cpu_before;
+
+    uint64_t written = 0, bytes = 0, dropped = 0, skipped = 0, segments = 0;
+    for (auto& writer : writers) {
+        SegmentWriter::Stats stats = writer->stats();
+        written += stats.packets_written;
+        bytes += stats.bytes_written;
+        dropped += stats.packets_dropped;
+        skipped += stats.packets_skipped;
+        segments += stats.segments;
+    }
+    writers.clear();
+
+    uint64_t sent = static_cast<uint64_t>(frames) * static_cast<uint64_t>(streams);
+    std::printf("CPU:      %.2f s in %.1f s = %.1f%% of one core (%.2f%% per stream)\n", cpu, elapsed,
+                100.0 * cpu / elapsed, 100.0 * cpu / elapsed / streams);
+    std::printf("Memory:   %.1f MB RSS at start, %.1f MB peak\n", rss_before / 1024.0,
+                rss_peak_running / 1024.0);
+    std::printf("Packets:  %llu sent, %llu written, %llu dropped (queue full), %llu skipped\n",
+                static_cast<unsigned long long>(sent), static_cast<unsigned long long>(written),
+                static_cast<unsigned long long>(dropped), static_cast<unsigned long long>(skipped));
+    std::printf("Output:   %.1f MB in %llu segments, %.1f MB/s\n", bytes / (1024.0 * 1024.0),
+                static_cast<unsigned long long>(segments), bytes / (1024.0 * 1024.0) / elapsed);
+    std::printf("Feeder:   %.1f ms max lateness, stop() took %.0f ms\n", late_ms_max, stop_ms);
+
+    if (!keep) {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+    return dropped == 0 ? 0 : 1;
+}
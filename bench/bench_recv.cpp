@@ -0,0 +1,269 @@
+// Receive path throughput over a socketpair
+//
+// Streams a recorded capture or a synthetic video stream through a
+// socketpair and reads it back as BC messages with:
+//   legacy     the old receive loop (4 KB recv, vector append, body copy,
+//              front erase), reimplemented here as the baseline
+//   view       Connection::receive_message_view (blocking reads)
+//   available  Connection::receive_available driven by poll()
+//
+// A capture is the raw camera -> client byte stream after login, with no
+// encryption (e.g. the TCP payload of a session exported from Wireshark);
+// a trailing partial message is ignored.
+//
+// Usage: bench_recv [--capture FILE] [--mb N] [--mode legacy|view|available]
+
+#include "client/connection.h"
+#include "support/synthetic_stream.h"
+#include "utils/logger.h"
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <thread>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Counts {
+    uint64_t messages = 0;
+    uint64_t payload_bytes = 0;
+};
+
+std::vector<uint8_t> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return {};
+    }
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Number of complete messages in the stream; drops a trailing partial one
+size_t trim_to_messages(std::vector<uint8_t>& stream) {
+    size_t count = 0;
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        BcHeader header;
+        size_t header_size = BcHeader::deserialize(stream.data() + pos, stream.size() - pos, header);
+        if (header_size == 0 || header_size + header.body_len > stream.size() - pos) {
+            break;
+        }
+        pos += header_size + header.body_len;
+        count++;
+    }
+    stream.resize(pos);
+    return count;
+}
+
+void write_passes(int fd, const std::vector<uint8_t>& stream, size_t passes) {
+    for (size_t pass = 0; pass < passes; pass++) {
+        size_t offset = 0;
+        while (offset < stream.size()) {
+            ssize_t n = ::write(fd, stream.data() + offset, stream.size() - offset);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            offset += static_cast<size_t>(n);
+        }
+    }
+}
+
+bool wait_readable(int fd) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 5000) > 0;
+}
+
+// The receive loop as it was before RecvBuffer, unencrypted path only
+Counts read_legacy(int fd, uint64_t expected) {
+    Counts counts;
+    std::vector<uint8_t> buffer;
+    buffer.reserve(65536);
+    std::set<uint16_t> binary_nums;
+
+    auto fill = [&](size_t need) {
+        while (buffer.size() < need) {
+            if (!wait_readable(fd)) return false;
+            uint8_t temp[4096];
+            ssize_t n = recv(fd, temp, sizeof(temp), 0);
+            if (n <= 0) return false;
+            buffer.insert(buffer.end(), temp, temp + n);
+        }
+        return true;
+    };
+
+    while (counts.messages < expected) {
+        if (!fill(HEADER_SIZE_24)) break;
+        BcHeader header;
+        size_t header_size = BcHeader::deserialize(buffer.data(), buffer.size(), header);
+        if (header_size == 0) break;
+        size_t total_size = header_size + header.body_len;
+        if (!fill(total_size)) break;
+
+        BcMessage msg;
+        msg.header = header;
+        std::vector<uint8_t> body(buffer.begin() + static_cast<std::ptrdiff_t>(header_size),
+                                  buffer.begin() + static_cast<std::ptrdiff_t>(total_size));
+        uint32_t offset = header.payload_offset.value_or(0);
+        if (offset > 0 && offset <= body.size()) {
+            msg.extension_data.assign(body.begin(), body.begin() + offset);
+            msg.payload_data.assign(body.begin() + offset, body.end());
+            std::string ext_str(msg.extension_data.begin(), msg.extension_data.end());
+            if (ext_str.find("<binaryData>1</binaryData>") != std::string::npos) {
+                binary_nums.insert(header.msg_num);
+            }
+        } else {
+            msg.payload_data = std::move(body);
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(total_size));
+
+        counts.messages++;
+        counts.payload_bytes += msg.payload_data.size();
+    }
+    return counts;
+}
+
+Counts read_view(int fd, uint64_t expected) {
+    Counts counts;
+    Connection conn;
+    conn.attach(fd, "socketpair");
+    auto on_message = [&](const BcMessageView& view) {
+        counts.messages++;
+        counts.payload_bytes += view.payload_len;
+    };
+    while (counts.messages < expected && conn.receive_message_view(on_message, 5000)) {
+    }
+    return counts;
+}
+
+Counts read_available(int fd, uint64_t expected) {
+    Counts counts;
+    Connection conn;
+    conn.attach(fd, "socketpair");
+    auto on_message = [&](const BcMessageView& view) {
+        counts.messages++;
+        counts.payload_bytes += view.payload_len;
+    };
+    while (counts.messages < expected && wait_readable(fd)) {
+        if (!conn.receive_available(on_message)) break;
+    }
+    return counts;
+}
+
+void set_buffer_sizes(int fd) {
+    // Same receive buffer as Connection::connect
+    int size = 256 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+bool run(const std::string& mode, const std::vector<uint8_t>& stream, size_t messages_per_pass,
+         size_t passes) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        std::fprintf(stderr, "socketpair: %s\n", std::strerror(errno));
+        return false;
+    }
+    set_buffer_sizes(fds[0]);
+    set_buffer_sizes(fds[1]);
+
+    uint64_t expected = static_cast<uint64_t>(messages_per_pass) * passes;
+    auto start = Clock::now();
+    std::thread writer(write_passes, fds[0], std::cref(stream), passes);
+
+    Counts counts;
+    if (mode == "legacy") {
+        counts = read_legacy(fds[1], expected);
+        close(fds[1]);
+    } else if (mode == "view") {
+        counts = read_view(fds[1], expected);    // Connection closes fds[1]
+    } else {
+        counts = read_available(fds[1], expected);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    writer.join();
+    close(fds[0]);
+
+    double wire_mb = static_cast<double>(stream.size()) * static_cast<double>(passes) / (1024.0 * 1024.0);
+    std::printf("%-10s %9.1f MB/s %11.0f msg/s   %llu messages, %.1f MB payload in %.3f s\n",
+                mode.c_str(), wire_mb / seconds, static_cast<double>(counts.messages) / seconds,
+                static_cast<unsigned long long>(counts.messages),
+                static_cast<double>(counts.payload_bytes) / (1024.0 * 1024.0), seconds);
+
+    if (counts.messages != expected) {
+        std::fprintf(stderr, "%s: received %llu of %llu messages\n", mode.c_str(),
+                     static_cast<unsigned long long>(counts.messages),
+                     static_cast<unsigned long long>(expected));
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string capture;
+    std::string only_mode;
+    size_t total_mb = 1024;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--capture" && i + 1 < argc) {
+            capture = argv[++i];
+        } else if (arg == "--mb" && i + 1 < argc) {
+            total_mb = std::stoul(argv[++i]);
+        } else if (arg == "--mode" && i + 1 < argc) {
+            only_mode = argv[++i];
+        } else {
+            std::fprintf(stderr, "Usage: %s [--capture FILE] [--mb N] [--mode legacy|view|available]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Logger::instance().set_level(LogLevel::Warning);
+    // The writer stays open until the reader is done (so the reader never
+    // sees EOF); a reader that gives up early must not kill it with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<uint8_t> stream;
+    if (!capture.empty()) {
+        stream = read_file(capture);
+        if (stream.empty()) {
+            std::fprintf(stderr, "Cannot read capture %s\n", capture.c_str());
+            return 1;
+        }
+    } else {
+        std::mt19937 rng(1);
+        stream = test::wrap_in_messages(test::encode_media(test::generate_media(rng, 1000)), 3);
+    }
+
+    size_t messages_per_pass = trim_to_messages(stream);
+    if (messages_per_pass == 0) {
+        std::fprintf(stderr, "No complete BC messages in the input\n");
+        return 1;
+    }
+    size_t passes = std::max<size_t>(1, total_mb * 1024 * 1024 / stream.size());
+
+    std::printf("%s: %zu messages, %.1f MB per pass, %zu passes\n",
+                capture.empty() ? "synthetic stream" : capture.c_str(), messages_per_pass,
+                static_cast<double>(stream.size()) / (1024.0 * 1024.0), passes);
+
+    bool ok = true;
+    for (const char* mode : {"legacy", "view", "available"}) {
+        if (only_mode.empty() || only_mode == mode) {
+            ok = run(mode, stream, messages_per_pass, passes) && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
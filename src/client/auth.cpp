@@ -1,22 +1,46 @@
 #include "client/auth.h"
+#include "client/demux.h"
 #include "utils/md5.h"
 #include "utils/logger.h"
 
+#include <algorithm>
+#include <memory>
+
 namespace baichuan {
 
+namespace {
+
+// Each step of the login gets this long for its reply
+constexpr int LOGIN_STEP_TIMEOUT_MS = 10000;
+
+} // namespace
+
 Authenticator::Authenticator(Connection& conn) : conn_(conn) {}
 
-LoginResult Authenticator::login(const std::string& username, const std::string& password,
-                                  MaxEncryption max_encryption) {
-    LoginResult result;
+void Authenticator::begin(const std::string& username, MaxEncryption max_encryption,
+                          const LoginCache* cache) {
     max_encryption_ = max_encryption;
 
+    // Ask for what the camera settled on last time (never more than allowed)
+    if (cache) {
+        MaxEncryption cached = cache->encryption_type == EncryptionType::Unencrypted ? MaxEncryption::None :
+                               cache->encryption_type == EncryptionType::BCEncrypt ? MaxEncryption::BCEncrypt :
+                               MaxEncryption::Aes;
+        max_encryption_ = std::min(max_encryption, cached);
+    }
+
     LOG_INFO("Starting login for user: {} (max encryption: {})", username,
-             max_encryption == MaxEncryption::None ? "none" :
-             max_encryption == MaxEncryption::BCEncrypt ? "bc" : "aes");
+             max_encryption_ == MaxEncryption::None ? "none" :
+             max_encryption_ == MaxEncryption::BCEncrypt ? "bc" : "aes");
 
     // Get a message number to use for the entire login sequence
     login_msg_num_ = conn_.next_msg_num();
+}
+
+LoginResult Authenticator::login(const std::string& username, const std::string& password,
+                                  MaxEncryption max_encryption, const LoginCache* cache) {
+    LoginResult result;
+    begin(username, max_encryption, cache);
 
     // Step 1: Send legacy login request
     if (!send_legacy_login()) {
@@ -38,26 +62,131 @@ LoginResult Authenticator::login(const std::string& username, const std::string&
 
     result.encryption_type = negotiation->type;
 
+    // Same negotiation as last time: the device info won't have changed
+    bool reuse_info = cache && cache->device_info && cache->encryption_type == negotiation->type;
+
+    apply_login_encryption(*negotiation, password);
+
+    // Step 3: Send modern login with hashed credentials
+    if (!send_modern_login(username, password, negotiation->nonce)) {
+        result.error_message = "Failed to send modern login request";
+        LOG_ERROR("{}", result.error_message);
+        return result;
+    }
+
+    // Receive login response
+    auto device_info = receive_login_response(!reuse_info);
+    if (!device_info) {
+        result.error_message = "Login failed - invalid credentials or connection error";
+        LOG_ERROR("{}", result.error_message);
+        return result;
+    }
+
+    apply_session_encryption();
+
+    result.success = true;
+    result.device_info = reuse_info ? cache->device_info : device_info;
+    LOG_INFO("Login successful!");
+
+    return result;
+}
+
+void Authenticator::login_async(MessageDemux& demux, const std::string& username,
+                                const std::string& password, MaxEncryption max_encryption,
+                                const LoginCache* cache, LoginCallback done) {
+    // Carried from one reply to the next
+    struct Login {
+        explicit Login(Connection& conn) : auth(conn) {}
+        Authenticator auth;
+        std::string username;
+        std::string password;
+        std::optional<LoginCache> cache;
+        LoginCallback done;
+        LoginResult result;
+        bool reuse_info = false;
+
+        void fail(const char* message) {
+            result.error_message = message;
+            LOG_ERROR("{}", result.error_message);
+            done(result);
+        }
+    };
+    auto login = std::make_shared<Login>(demux.connection());
+    login->username = username;
+    login->password = password;
+    if (cache) login->cache = *cache;
+    login->done = std::move(done);
+    login->auth.begin(username, max_encryption, cache);
+
+    MessageDemux* demux_ptr = &demux;
+    auto on_response = [login](std::optional<BcMessage> reply) {
+        std::optional<DeviceInfoXml> device_info;
+        if (!reply) {
+            LOG_ERROR("No response to modern login");
+        } else {
+            device_info = login->auth.parse_login_response(*reply, !login->reuse_info);
+        }
+        if (!device_info) {
+            login->fail("Login failed - invalid credentials or connection error");
+            return;
+        }
+
+        login->auth.apply_session_encryption();
+        login->result.success = true;
+        login->result.device_info = login->reuse_info ? login->cache->device_info : device_info;
+        LOG_INFO("Login successful!");
+        login->done(login->result);
+    };
+
+    auto on_negotiation = [login, demux_ptr, on_response](std::optional<BcMessage> reply) {
+        if (!reply) {
+            LOG_ERROR("No response to legacy login");
+            login->fail("Failed to receive encryption negotiation");
+            return;
+        }
+        EncryptionNegotiation negotiation = parse_negotiation(*reply);
+        LOG_INFO("Encryption negotiated: type={}, nonce={}",
+                 static_cast<int>(negotiation.type), negotiation.nonce);
+        login->result.encryption_type = negotiation.type;
+        login->reuse_info = login->cache && login->cache->device_info &&
+                            login->cache->encryption_type == negotiation.type;
+
+        // Replies are decrypted just before their callback, so the crypto
+        // switched here already applies to the login response
+        login->auth.apply_login_encryption(negotiation, login->password);
+        BcMessage msg = login->auth.modern_login_message(login->username, login->password,
+                                                         negotiation.nonce);
+        if (!demux_ptr->request_async(msg, LOGIN_STEP_TIMEOUT_MS, on_response)) {
+            login->fail("Failed to send modern login request");
+        }
+    };
+
+    if (!demux.request_async(login->auth.legacy_login_message(), LOGIN_STEP_TIMEOUT_MS,
+                             on_negotiation)) {
+        login->fail("Failed to send legacy login request");
+    }
+}
+
+void Authenticator::apply_login_encryption(const EncryptionNegotiation& negotiation,
+                                           const std::string& password) {
     // IMPORTANT: During login (msg_id == 1), the protocol uses BCEncrypt even when AES is negotiated.
     // The AES key is derived here but only applied AFTER the login succeeds.
     // This matches the Rust neolink behavior in codex.rs lines 38-47.
+    use_aes_after_login_ = false;
+    use_full_aes_ = false;
 
-    std::array<uint8_t, 16> aes_key{};
-    bool use_aes_after_login = false;
-    bool use_full_aes = false;
-
-    if (negotiation->type == EncryptionType::BCEncrypt) {
+    if (negotiation.type == EncryptionType::BCEncrypt) {
         // BCEncrypt - use it for login and all subsequent messages
         BcCrypto crypto;
         crypto.set_bc_encrypt();
         conn_.set_encryption(std::move(crypto));
-    } else if (negotiation->type == EncryptionType::Aes ||
-               negotiation->type == EncryptionType::FullAes) {
+    } else if (negotiation.type == EncryptionType::Aes ||
+               negotiation.type == EncryptionType::FullAes) {
         // AES negotiated - but use BCEncrypt for the login message itself
         // Save the AES key to apply after login succeeds
-        aes_key = BcCrypto::derive_aes_key(password, negotiation->nonce);
-        use_aes_after_login = true;
-        use_full_aes = (negotiation->type == EncryptionType::FullAes);
+        aes_key_ = BcCrypto::derive_aes_key(password, negotiation.nonce);
+        use_aes_after_login_ = true;
+        use_full_aes_ = (negotiation.type == EncryptionType::FullAes);
 
         // Use BCEncrypt for the login message
         BcCrypto crypto;
@@ -68,44 +197,30 @@ LoginResult Authenticator::login(const std::string& username, const std::string&
 
     // Reset encryption offsets after setting up encryption
     conn_.reset_encryption_offsets();
+}
 
-    // Step 3: Send modern login with hashed credentials
-    if (!send_modern_login(username, password, negotiation->nonce)) {
-        result.error_message = "Failed to send modern login request";
-        LOG_ERROR("{}", result.error_message);
-        return result;
-    }
-
-    // Receive login response
-    auto device_info = receive_login_response();
-    if (!device_info) {
-        result.error_message = "Login failed - invalid credentials or connection error";
-        LOG_ERROR("{}", result.error_message);
-        return result;
-    }
-
+void Authenticator::apply_session_encryption() {
     // Now switch to AES if that's what was negotiated
-    if (use_aes_after_login) {
-        BcCrypto crypto;
-        if (use_full_aes) {
-            crypto.set_full_aes(aes_key);
-            LOG_INFO("Switched to Full AES encryption for subsequent messages");
-        } else {
-            crypto.set_aes(aes_key);
-            LOG_INFO("Switched to AES encryption for subsequent messages");
-        }
-        conn_.set_encryption(std::move(crypto));
-        conn_.reset_encryption_offsets();
+    if (!use_aes_after_login_) {
+        return;
     }
-
-    result.success = true;
-    result.device_info = device_info;
-    LOG_INFO("Login successful!");
-
-    return result;
+    BcCrypto crypto;
+    if (use_full_aes_) {
+        crypto.set_full_aes(aes_key_);
+        LOG_INFO("Switched to Full AES encryption for subsequent messages");
+    } else {
+        crypto.set_aes(aes_key_);
+        LOG_INFO("Switched to AES encryption for subsequent messages");
+    }
+    conn_.set_encryption(std::move(crypto));
+    conn_.reset_encryption_offsets();
 }
 
 bool Authenticator::send_legacy_login() {
+    return conn_.send_message(legacy_login_message());
+}
+
+BcMessage Authenticator::legacy_login_message() const {
     // Create legacy login message to negotiate encryption
     // This is a minimal message with class 0x6514 (legacy)
     BcMessage msg;
@@ -129,7 +244,7 @@ bool Authenticator::send_legacy_login() {
 
     msg.header.body_len = 0;
 
-    return conn_.send_message(msg);
+    return msg;
 }
 
 std::optional<Authenticator::EncryptionNegotiation> Authenticator::receive_encryption_negotiation() {
@@ -153,11 +268,14 @@ std::optional<Authenticator::EncryptionNegotiation> Authenticator::receive_encry
         LOG_ERROR("Did not receive negotiation response after retries");
         return std::nullopt;
     }
+    return parse_negotiation(*msg);
+}
 
+Authenticator::EncryptionNegotiation Authenticator::parse_negotiation(const BcMessage& msg) {
     EncryptionNegotiation result;
 
     // Determine encryption type from response code
-    uint16_t resp = msg->header.response_code;
+    uint16_t resp = msg.header.response_code;
     uint8_t resp_high = (resp >> 8) & 0xFF;
     uint8_t resp_low = resp & 0xFF;
 
@@ -191,7 +309,7 @@ std::optional<Authenticator::EncryptionNegotiation> Authenticator::receive_encry
     // (BCEncrypt uses a fixed key, so no key exchange needed)
     // Even when AES is negotiated, the nonce payload is BCEncrypt encrypted
     // because we need the nonce to derive the AES key
-    std::vector<uint8_t> payload_data = msg->payload_data;
+    std::vector<uint8_t> payload_data = msg.payload_data;
 
     // Always decrypt with BCEncrypt (except for truly unencrypted mode)
     if (result.type != EncryptionType::Unencrypted && !payload_data.empty()) {
@@ -218,8 +336,8 @@ std::optional<Authenticator::EncryptionNegotiation> Authenticator::receive_encry
     }
 
     // Also check extension data
-    if (!msg->extension_data.empty()) {
-        std::string ext(msg->extension_data.begin(), msg->extension_data.end());
+    if (!msg.extension_data.empty()) {
+        std::string ext(msg.extension_data.begin(), msg.extension_data.end());
         LOG_DEBUG("Extension data: {}", ext);
     }
 
@@ -229,6 +347,12 @@ std::optional<Authenticator::EncryptionNegotiation> Authenticator::receive_encry
 bool Authenticator::send_modern_login(const std::string& username,
                                       const std::string& password,
                                       const std::string& nonce) {
+    return conn_.send_message(modern_login_message(username, password, nonce));
+}
+
+BcMessage Authenticator::modern_login_message(const std::string& username,
+                                              const std::string& password,
+                                              const std::string& nonce) const {
     // Hash credentials with nonce (uppercase hex, truncated to 31 chars)
     std::string hashed_username = MD5::to_hex_upper_truncated(MD5::hash(username + nonce));
     std::string hashed_password = MD5::to_hex_upper_truncated(MD5::hash(password + nonce));
@@ -250,10 +374,10 @@ bool Authenticator::send_modern_login(const std::string& username,
         MSG_CLASS_MODERN_24
     );
 
-    return conn_.send_message(msg);
+    return msg;
 }
 
-std::optional<DeviceInfoXml> Authenticator::receive_login_response() {
+std::optional<DeviceInfoXml> Authenticator::receive_login_response(bool parse_info) {
     // Some cameras send unsolicited messages during login; skip them
     std::optional<BcMessage> msg;
     for (int attempts = 0; attempts < 5; attempts++) {
@@ -274,14 +398,18 @@ std::optional<DeviceInfoXml> Authenticator::receive_login_response() {
         LOG_ERROR("Did not receive login response after retries");
         return std::nullopt;
     }
+    return parse_login_response(*msg, parse_info);
+}
 
+std::optional<DeviceInfoXml> Authenticator::parse_login_response(const BcMessage& msg,
+                                                                 bool parse_info) {
     LOG_INFO("Login response: msg_id={}, response_code={}, class={}",
-             msg->header.msg_id, msg->header.response_code, msg->header.msg_class);
+             msg.header.msg_id, msg.header.response_code, msg.header.msg_class);
 
     // Log payload for debugging
-    if (!msg->payload_data.empty()) {
+    if (!msg.payload_data.empty()) {
         // Try to decrypt if we're using BCEncrypt
-        std::vector<uint8_t> decrypted = msg->payload_data;
+        std::vector<uint8_t> decrypted = msg.payload_data;
         if (conn_.encryption().type() == EncryptionType::BCEncrypt) {
             decrypted = conn_.encryption().decrypt(0, decrypted);
         }
@@ -289,14 +417,14 @@ std::optional<DeviceInfoXml> Authenticator::receive_login_response() {
         LOG_INFO("Login response payload: {}", payload);
     }
 
-    if (msg->header.response_code != RESPONSE_CODE_OK) {
-        LOG_ERROR("Login rejected with code: {}", msg->header.response_code);
+    if (msg.header.response_code != RESPONSE_CODE_OK) {
+        LOG_ERROR("Login rejected with code: {}", msg.header.response_code);
         return std::nullopt;
     }
 
     // Parse device info from response
-    if (!msg->payload_data.empty()) {
-        std::string xml(msg->payload_data.begin(), msg->payload_data.end());
+    if (parse_info && !msg.payload_data.empty()) {
+        std::string xml(msg.payload_data.begin(), msg.payload_data.end());
         LOG_DEBUG("Login response XML: {}", xml);
         return BcXmlBuilder::parse_device_info(xml);
     }
@@ -2,11 +2,15 @@
 
 #include "client/connection.h"
 #include "protocol/bc_xml.h"
+#include <array>
+#include <functional>
 #include <string>
 #include <optional>
 
 namespace baichuan {
 
+class MessageDemux;
+
 // Requested encryption level for login
 enum class MaxEncryption {
     None,       // Request no encryption
@@ -22,6 +26,15 @@ struct LoginResult {
     EncryptionType encryption_type = EncryptionType::Unencrypted;
 };
 
+// What an earlier login to the same camera learned, passed back on
+// reconnect. The nonce is new on every connection, so the negotiation round
+// trip stays; the request names the encryption the camera chose last time
+// and the DeviceInfo reply is not parsed again while that still holds.
+struct LoginCache {
+    EncryptionType encryption_type = EncryptionType::Unencrypted;
+    std::optional<DeviceInfoXml> device_info;
+};
+
 class Authenticator {
 public:
     explicit Authenticator(Connection& conn);
@@ -30,30 +43,59 @@ public:
     // max_encryption specifies the maximum encryption level to request
     // Returns LoginResult with success status and device info
     LoginResult login(const std::string& username, const std::string& password,
-                      MaxEncryption max_encryption = MaxEncryption::Aes);
+                      MaxEncryption max_encryption = MaxEncryption::Aes,
+                      const LoginCache* cache = nullptr);
+
+    // The same exchange without blocking a thread: each step is sent as a
+    // request on the demux (started, and reading the connection) and the
+    // next one follows from its reply. done runs exactly once - on an I/O
+    // thread, or before login_async() returns if the first send fails.
+    using LoginCallback = std::function<void(const LoginResult&)>;
+    static void login_async(MessageDemux& demux, const std::string& username,
+                            const std::string& password, MaxEncryption max_encryption,
+                            const LoginCache* cache, LoginCallback done);
 
 private:
     Connection& conn_;
     uint16_t login_msg_num_ = 0;
     MaxEncryption max_encryption_ = MaxEncryption::Aes;
 
-    // Step 1: Send legacy login request to negotiate encryption
-    bool send_legacy_login();
+    // AES key derived during the login, applied once it succeeds
+    std::array<uint8_t, 16> aes_key_{};
+    bool use_aes_after_login_ = false;
+    bool use_full_aes_ = false;
 
-    // Step 2: Receive encryption negotiation and extract nonce
     struct EncryptionNegotiation {
         EncryptionType type = EncryptionType::Unencrypted;
         std::string nonce;
     };
+
+    // Pick the encryption to ask for and the login's msg_num
+    void begin(const std::string& username, MaxEncryption max_encryption, const LoginCache* cache);
+
+    // Step 1: Legacy login request to negotiate encryption
+    BcMessage legacy_login_message() const;
+    bool send_legacy_login();
+
+    // Step 2: Receive encryption negotiation and extract nonce
     std::optional<EncryptionNegotiation> receive_encryption_negotiation();
+    static EncryptionNegotiation parse_negotiation(const BcMessage& msg);
+
+    // Encryption for the modern login message (BCEncrypt even when AES was
+    // negotiated), and the negotiated one once it succeeded
+    void apply_login_encryption(const EncryptionNegotiation& negotiation, const std::string& password);
+    void apply_session_encryption();
 
-    // Step 3: Send modern login with hashed credentials
+    // Step 3: Modern login with hashed credentials
+    BcMessage modern_login_message(const std::string& username, const std::string& password,
+                                   const std::string& nonce) const;
     bool send_modern_login(const std::string& username,
                           const std::string& password,
                           const std::string& nonce);
 
-    // Receive and parse login response
-    std::optional<DeviceInfoXml> receive_login_response();
+    // Receive the login response; its DeviceInfo is parsed when parse_info is set
+    std::optional<DeviceInfoXml> receive_login_response(bool parse_info);
+    std::optional<DeviceInfoXml> parse_login_response(const BcMessage& msg, bool parse_info);
 };
 
 } // namespace baichuan
@@ -1,7 +1,9 @@
 #include "client/connection.h"
+#include "protocol/bc_xml.h"
 #include "utils/logger.h"
 
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -10,25 +12,52 @@
 #include <poll.h>
 #include <cerrno>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
 
 namespace baichuan {
 
-Connection::Connection() {
-    recv_buffer_.reserve(65536);
-}
+Connection::Connection() = default;
 
 Connection::~Connection() {
     disconnect();
 }
 
-bool Connection::connect(const std::string& host, uint16_t port) {
+bool Connection::connect(const std::string& host, uint16_t port, int timeout_ms) {
+    if (!begin_connect(host, port)) {
+        return false;
+    }
+
+    // Wait for connection with timeout
+    struct pollfd pfd;
+    pfd.fd = socket_fd_;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+
+    int result = poll(&pfd, 1, timeout_ms);
+    if (result <= 0 || cancelled_.load()) {
+        LOG_ERROR("Connection timeout or error");
+        close_socket();
+        return false;
+    }
+    return finish_connect();
+}
+
+bool Connection::begin_connect(const std::string& host, uint16_t port) {
     if (socket_fd_ >= 0) {
         disconnect();
     }
 
     LOG_INFO("Connecting to {}:{}", host, port);
 
-    socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    {
+        std::lock_guard<std::mutex> lock(fd_mutex_);
+        if (cancelled_.load()) {
+            LOG_ERROR("Connect to {}:{} cancelled", host, port);
+            return false;
+        }
+        socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    }
     if (socket_fd_ < 0) {
         LOG_ERROR("Failed to create socket: {}", strerror(errno));
         return false;
@@ -46,6 +75,12 @@ bool Connection::connect(const std::string& host, uint16_t port) {
         LOG_WARN("Failed to set SO_RCVBUF: {}", strerror(errno));
     }
 
+    // A peer that stops reading fails sends instead of blocking them forever
+    struct timeval send_timeout = {5, 0};
+    if (setsockopt(socket_fd_, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout)) < 0) {
+        LOG_WARN("Failed to set SO_SNDTIMEO: {}", strerror(errno));
+    }
+
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -53,34 +88,34 @@ bool Connection::connect(const std::string& host, uint16_t port) {
 
     if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0) {
         LOG_ERROR("Invalid address: {}", host);
-        close(socket_fd_);
-        socket_fd_ = -1;
+        close_socket();
         return false;
     }
 
-    // Set non-blocking for connect with timeout
+    // Non-blocking until finish_connect(), so the handshake can be waited
+    // for with a timeout
     int flags = fcntl(socket_fd_, F_GETFL, 0);
     fcntl(socket_fd_, F_SETFL, flags | O_NONBLOCK);
 
     int result = ::connect(socket_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
     if (result < 0 && errno != EINPROGRESS) {
         LOG_ERROR("Failed to connect: {}", strerror(errno));
-        close(socket_fd_);
-        socket_fd_ = -1;
+        close_socket();
         return false;
     }
 
-    // Wait for connection with timeout
-    struct pollfd pfd;
-    pfd.fd = socket_fd_;
-    pfd.events = POLLOUT;
-    pfd.revents = 0;
+    host_ = host;
+    port_ = port;
+    return true;
+}
 
-    result = poll(&pfd, 1, 10000); // 10 second timeout
-    if (result <= 0) {
-        LOG_ERROR("Connection timeout or error");
-        close(socket_fd_);
-        socket_fd_ = -1;
+bool Connection::finish_connect() {
+    if (socket_fd_ < 0) {
+        return false;
+    }
+    if (cancelled_.load()) {
+        LOG_ERROR("Connect to {}:{} cancelled", host_, port_);
+        close_socket();
         return false;
     }
 
@@ -89,32 +124,60 @@ bool Connection::connect(const std::string& host, uint16_t port) {
     socklen_t len = sizeof(error);
     if (getsockopt(socket_fd_, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
         LOG_ERROR("Connection failed: {}", error != 0 ? strerror(error) : "getsockopt error");
-        close(socket_fd_);
-        socket_fd_ = -1;
+        close_socket();
         return false;
     }
 
     // Set back to blocking mode
-    fcntl(socket_fd_, F_SETFL, flags);
+    int flags = fcntl(socket_fd_, F_GETFL, 0);
+    fcntl(socket_fd_, F_SETFL, flags & ~O_NONBLOCK);
 
-    host_ = host;
-    port_ = port;
+    peer_closed_.store(false);
 
-    LOG_INFO("Connected to {}:{}", host, port);
+    LOG_INFO("Connected to {}:{}", host_, port_);
     return true;
 }
 
+void Connection::attach(int fd, const std::string& peer) {
+    if (socket_fd_ >= 0) {
+        disconnect();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fd_mutex_);
+        socket_fd_ = fd;
+    }
+    host_ = peer;
+    port_ = 0;
+    peer_closed_.store(false);
+}
+
 void Connection::disconnect() {
     if (socket_fd_ >= 0) {
         LOG_INFO("Disconnecting from {}:{}", host_, port_);
-        close(socket_fd_);
-        socket_fd_ = -1;
+        close_socket();
     }
     recv_buffer_.clear();
     send_offset_ = 0;
     recv_offset_ = 0;
 }
 
+void Connection::cancel() {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    cancelled_.store(true);
+    if (socket_fd_ >= 0) {
+        // Wakes a poll() or blocking call on the socket; the fd stays valid
+        // until the owning thread closes it
+        ::shutdown(socket_fd_, SHUT_RDWR);
+    }
+}
+
+void Connection::close_socket() {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    close(socket_fd_);
+    socket_fd_ = -1;
+}
+
 bool Connection::send_message(const BcMessage& msg) {
     std::lock_guard<std::mutex> lock(send_mutex_);
 
@@ -129,15 +192,15 @@ bool Connection::send_message(const BcMessage& msg) {
     // Encrypt the body portion if needed (header is never encrypted)
     size_t header_size = msg.header.header_size();
     if (data.size() > header_size && crypto_.type() != EncryptionType::Unencrypted) {
-        std::vector<uint8_t> body(data.begin() + header_size, data.end());
+        uint8_t* body = data.data() + header_size;
+        size_t body_len = data.size() - header_size;
         LOG_DEBUG("Encrypting {} bytes with offset {}, encryption type {}",
-                  body.size(), send_offset_, static_cast<int>(crypto_.type()));
+                  body_len, send_offset_, static_cast<int>(crypto_.type()));
         LOG_DEBUG("First 32 bytes of plaintext: {}",
-                  Logger::bytes_to_hex(body.data(), std::min(body.size(), size_t(32))));
-        std::vector<uint8_t> encrypted = crypto_.encrypt(msg.header.channel_id, body);
+                  Logger::bytes_to_hex(body, std::min(body_len, size_t(32))));
+        crypto_.encrypt_inplace(msg.header.channel_id, body, body_len);
         LOG_DEBUG("First 32 bytes of ciphertext: {}",
-                  Logger::bytes_to_hex(encrypted.data(), std::min(encrypted.size(), size_t(32))));
-        std::copy(encrypted.begin(), encrypted.end(), data.begin() + header_size);
+                  Logger::bytes_to_hex(body, std::min(body_len, size_t(32))));
     } else if (data.size() > header_size) {
         LOG_DEBUG("Sending {} bytes unencrypted", data.size() - header_size);
     }
@@ -153,30 +216,24 @@ bool Connection::send_message(const BcMessage& msg) {
 }
 
 std::optional<BcMessage> Connection::receive_message(int timeout_ms) {
+    std::optional<BcMessage> msg;
+    receive_message_view([&msg](const BcMessageView& view) {
+        msg = view.to_owned();
+    }, timeout_ms);
+    return msg;
+}
+
+bool Connection::receive_message_view(const MessageViewCallback& callback, int timeout_ms) {
     std::lock_guard<std::mutex> lock(recv_mutex_);
 
     if (socket_fd_ < 0) {
         LOG_ERROR("Not connected");
-        return std::nullopt;
+        return false;
     }
 
     // First, ensure we have at least 24 bytes for the largest possible header
-    while (recv_buffer_.size() < HEADER_SIZE_24) {
-        if (!wait_for_data(timeout_ms)) {
-            return std::nullopt;
-        }
-
-        uint8_t temp[1024];
-        ssize_t n = recv(socket_fd_, temp, sizeof(temp), 0);
-        if (n <= 0) {
-            if (n == 0) {
-                LOG_ERROR("Connection closed by peer");
-            } else {
-                LOG_ERROR("Receive error: {}", strerror(errno));
-            }
-            return std::nullopt;
-        }
-        recv_buffer_.insert(recv_buffer_.end(), temp, temp + n);
+    if (!fill_recv_buffer(HEADER_SIZE_24, timeout_ms)) {
+        return false;
     }
 
     // Parse header
@@ -184,51 +241,121 @@ std::optional<BcMessage> Connection::receive_message(int timeout_ms) {
     size_t header_size = BcHeader::deserialize(recv_buffer_.data(), recv_buffer_.size(), header);
     if (header_size == 0) {
         LOG_ERROR("Failed to parse header");
-        return std::nullopt;
+        return false;
+    }
+
+    if (header.body_len > MAX_BODY_SIZE) {
+        LOG_ERROR("Message body too large: {} bytes", header.body_len);
+        return false;
     }
 
     // Wait for complete message
     size_t total_size = header_size + header.body_len;
-    while (recv_buffer_.size() < total_size) {
-        if (!wait_for_data(timeout_ms)) {
-            LOG_ERROR("Timeout waiting for message body ({} of {} bytes)",
-                      recv_buffer_.size(), total_size);
-            return std::nullopt;
+    if (!fill_recv_buffer(total_size, timeout_ms)) {
+        LOG_ERROR("Timeout waiting for message body ({} of {} bytes)",
+                  recv_buffer_.size(), total_size);
+        return false;
+    }
+
+    deliver_message(header, header_size, callback);
+    return true;
+}
+
+bool Connection::receive_available(const MessageViewCallback& callback) {
+    std::lock_guard<std::mutex> lock(recv_mutex_);
+
+    if (socket_fd_ < 0) {
+        return false;
+    }
+
+    while (true) {
+        // Hand out what is already buffered before reading more
+        if (!deliver_buffered(callback)) {
+            peer_closed_.store(true);
+            return false;
         }
 
-        uint8_t temp[4096];
-        ssize_t n = recv(socket_fd_, temp, sizeof(temp), 0);
-        if (n <= 0) {
-            if (n == 0) {
-                LOG_ERROR("Connection closed by peer");
-            } else {
-                LOG_ERROR("Receive error: {}", strerror(errno));
-            }
-            return std::nullopt;
+        ssize_t n = read_socket(MSG_DONTWAIT);
+        if (n > 0) {
+            continue;
+        }
+        if (n == 0) {
+            LOG_ERROR("Connection closed by peer");
+            peer_closed_.store(true);
+            return false;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;  // Drained
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        LOG_ERROR("Receive error: {}", strerror(errno));
+        peer_closed_.store(true);
+        return false;
+    }
+}
+
+bool Connection::deliver_buffered(const MessageViewCallback& callback) {
+    while (recv_buffer_.size() >= HEADER_SIZE_20) {
+        // The message class decides whether the header is 20 or 24 bytes
+        const uint8_t* data = recv_buffer_.data();
+        BcHeader peek;
+        peek.msg_class = static_cast<uint16_t>(data[18] | (data[19] << 8));
+        if (recv_buffer_.size() < peek.header_size()) {
+            break;
+        }
+
+        BcHeader header;
+        size_t header_size = BcHeader::deserialize(data, recv_buffer_.size(), header);
+        if (header_size == 0) {
+            LOG_ERROR("Failed to parse header");
+            return false;
+        }
+        if (header.body_len > MAX_BODY_SIZE) {
+            LOG_ERROR("Message body too large: {} bytes", header.body_len);
+            return false;
+        }
+
+        size_t total_size = header_size + header.body_len;
+        if (recv_buffer_.size() < total_size) {
+            recv_buffer_.reserve(total_size);  // The rest lands contiguously
+            break;
         }
-        recv_buffer_.insert(recv_buffer_.end(), temp, temp + n);
+
+        deliver_message(header, header_size, callback);
     }
+    return true;
+}
+
+void Connection::deliver_message(const BcHeader& header, size_t header_size,
+                                 const MessageViewCallback& callback) {
+    size_t total_size = header_size + header.body_len;
 
-    // Extract message body
-    BcMessage msg;
-    msg.header = header;
+    // The body is split and decrypted in place - the view points straight
+    // into recv_buffer_, which is not touched again until the callback returns
+    BcMessageView view;
+    view.header = header;
 
     if (header.body_len > 0) {
-        std::vector<uint8_t> body(recv_buffer_.begin() + header_size,
-                                   recv_buffer_.begin() + total_size);
+        StageTimer decrypt_timer(pipeline_stats_, PipelineStage::Decrypt);
+        uint8_t* body = recv_buffer_.data() + header_size;
+        size_t body_len = header.body_len;
 
         // Split into extension and payload based on payload_offset FIRST
         // Then decrypt selectively - extension is always XML (encrypted),
         // but payload may be binary (not encrypted in BCEncrypt mode)
         if (header.payload_offset && *header.payload_offset > 0) {
             uint32_t offset = *header.payload_offset;
-            if (offset <= body.size()) {
-                msg.extension_data.assign(body.begin(), body.begin() + offset);
-                msg.payload_data.assign(body.begin() + offset, body.end());
+            if (offset <= body_len) {
+                uint8_t* extension = body;
+                size_t extension_len = offset;
+                uint8_t* payload = body + offset;
+                size_t payload_len = body_len - offset;
 
                 // Decrypt extension (always XML)
-                if (crypto_.type() != EncryptionType::Unencrypted && !msg.extension_data.empty()) {
-                    msg.extension_data = crypto_.decrypt(header.channel_id, msg.extension_data);
+                if (crypto_.type() != EncryptionType::Unencrypted && extension_len > 0) {
+                    crypto_.decrypt_inplace(header.channel_id, extension, extension_len);
                 }
 
                 // Check if payload is binary (video/audio)
@@ -238,30 +365,25 @@ std::optional<BcMessage> Connection::receive_message(int timeout_ms) {
                 bool is_binary = false;
                 bool in_binary_from_extension = false;
                 std::optional<uint32_t> encrypt_len;
-                if (!msg.extension_data.empty()) {
-                    std::string ext_str(msg.extension_data.begin(), msg.extension_data.end());
-                    in_binary_from_extension = ext_str.find("<binaryData>1</binaryData>") != std::string::npos;
+                if (extension_len > 0) {
+                    // Scanned in place (no copy, no DOM) - this runs for every frame
+                    auto ext = ExtensionXml::parse(extension, extension_len);
+                    if (ext) {
+                        in_binary_from_extension = ext->binary_data && *ext->binary_data == 1;
+                        encrypt_len = ext->encrypt_len;
+                    }
 
                     // Track binary mode per msg_num
                     if (in_binary_from_extension) {
                         binary_mode_nums_.insert(header.msg_num);
                     }
 
-                    // Parse encryptLen for FullAes mode
-                    size_t enc_start = ext_str.find("<encryptLen>");
-                    size_t enc_end = ext_str.find("</encryptLen>");
-                    if (enc_start != std::string::npos && enc_end != std::string::npos) {
-                        enc_start += 12; // length of "<encryptLen>"
-                        std::string enc_val = ext_str.substr(enc_start, enc_end - enc_start);
-                        encrypt_len = static_cast<uint32_t>(std::stoul(enc_val));
-                    }
-
                     // Debug: log extension for video messages
-                    if (header.msg_id == MSG_ID_VIDEO) {
+                    if (header.msg_id == MSG_ID_VIDEO && Logger::instance().level() <= LogLevel::Debug) {
                         LOG_DEBUG("Video extension: binary={}, encryptLen={}, ext={}",
                                   in_binary_from_extension ? "yes" : "no",
                                   encrypt_len ? std::to_string(*encrypt_len) : "none",
-                                  ext_str.substr(0, std::min(ext_str.size(), size_t(200))));
+                                  std::string(extension, extension + std::min(extension_len, size_t(200))));
                     }
                 }
 
@@ -273,55 +395,42 @@ std::optional<BcMessage> Connection::receive_message(int timeout_ms) {
                 // - FullAes without encryptLen: all encrypted
                 // - BCEncrypt/Aes: decrypt only XML, not binary
                 if (crypto_.type() == EncryptionType::FullAes && is_binary && encrypt_len && *encrypt_len > 0) {
-                    // FullAes binary mode: decrypt ALL bytes, but only first encryptLen bytes
-                    // are actual encrypted data. The rest should already be cleartext that
-                    // was included after the encrypted portion.
-                    //
-                    // However, AES-CFB is a stream cipher - decrypting raw cleartext
-                    // would produce garbage. So we need to:
-                    // 1. Decrypt only first encryptLen bytes
-                    // 2. Keep rest as-is (it's cleartext continuation data)
-                    if (*encrypt_len < msg.payload_data.size()) {
-                        // Split: encrypted part + cleartext part
-                        std::vector<uint8_t> encrypted_part(msg.payload_data.begin(),
-                                                            msg.payload_data.begin() + *encrypt_len);
-                        std::vector<uint8_t> clear_part(msg.payload_data.begin() + *encrypt_len,
-                                                        msg.payload_data.end());
-                        // Decrypt only the encrypted portion
-                        auto decrypted = crypto_.decrypt(header.channel_id, encrypted_part);
-
-                        // Debug: show what we got
-                        if (decrypted.size() >= 8) {
-                            char hex[64];
-                            snprintf(hex, sizeof(hex), "%02x %02x %02x %02x %02x %02x %02x %02x",
-                                     decrypted[0], decrypted[1], decrypted[2], decrypted[3],
-                                     decrypted[4], decrypted[5], decrypted[6], decrypted[7]);
-                            LOG_DEBUG("Decrypted first 8 bytes: {}", hex);
-                        }
-
-                        // Combine: decrypted + cleartext
-                        msg.payload_data = std::move(decrypted);
-                        msg.payload_data.insert(msg.payload_data.end(), clear_part.begin(), clear_part.end());
-                    } else {
-                        // All data is encrypted (encryptLen >= payload size)
-                        msg.payload_data = crypto_.decrypt(header.channel_id, msg.payload_data);
+                    // FullAes binary mode: only the first encryptLen bytes are encrypted,
+                    // the rest is cleartext continuation data. AES-CFB is a stream
+                    // cipher, so decrypting the cleartext would produce garbage -
+                    // decrypt the encrypted prefix and leave the rest as-is
+                    size_t encrypted_len = std::min<size_t>(*encrypt_len, payload_len);
+                    crypto_.decrypt_inplace(header.channel_id, payload, encrypted_len);
+
+                    // Debug: show what we got
+                    if (encrypted_len >= 8) {
+                        char hex[64];
+                        snprintf(hex, sizeof(hex), "%02x %02x %02x %02x %02x %02x %02x %02x",
+                                 payload[0], payload[1], payload[2], payload[3],
+                                 payload[4], payload[5], payload[6], payload[7]);
+                        LOG_DEBUG("Decrypted first 8 bytes: {}", hex);
                     }
                 } else if (crypto_.type() == EncryptionType::FullAes && !is_binary) {
                     // Non-binary XML payload - decrypt all
-                    msg.payload_data = crypto_.decrypt(header.channel_id, msg.payload_data);
+                    crypto_.decrypt_inplace(header.channel_id, payload, payload_len);
                 } else if (crypto_.type() != EncryptionType::Unencrypted && !is_binary) {
                     // BCEncrypt/Aes: decrypt only XML, not binary
-                    msg.payload_data = crypto_.decrypt(header.channel_id, msg.payload_data);
+                    crypto_.decrypt_inplace(header.channel_id, payload, payload_len);
                 }
                 // Binary without encryptLen: leave as raw
+
+                view.extension_data = extension;
+                view.extension_len = extension_len;
+                view.payload_data = payload;
+                view.payload_len = payload_len;
             } else {
-                msg.payload_data = std::move(body);
                 if (crypto_.type() != EncryptionType::Unencrypted) {
-                    msg.payload_data = crypto_.decrypt(header.channel_id, msg.payload_data);
+                    crypto_.decrypt_inplace(header.channel_id, body, body_len);
                 }
+                view.payload_data = body;
+                view.payload_len = body_len;
             }
         } else {
-            msg.payload_data = std::move(body);
             // No extension - could be XML or binary
             // Check if this msg_num is in binary mode (from a previous message with binaryData=1)
             bool is_binary = binary_mode_nums_.count(header.msg_num) > 0;
@@ -330,22 +439,25 @@ std::optional<BcMessage> Connection::receive_message(int timeout_ms) {
             // For binary mode (tracked by msg_num) or video messages: data is raw, don't decrypt
             // Only decrypt non-binary payloads (XML responses)
             if (crypto_.type() != EncryptionType::Unencrypted && !is_binary && !is_video_msg) {
-                msg.payload_data = crypto_.decrypt(header.channel_id, msg.payload_data);
+                crypto_.decrypt_inplace(header.channel_id, body, body_len);
             }
             // Binary data without extension is always raw (even for FullAes)
+            view.payload_data = body;
+            view.payload_len = body_len;
         }
     }
 
-    // Update receive offset and remove processed data from buffer
     recv_offset_ += header.body_len;
-    recv_buffer_.erase(recv_buffer_.begin(), recv_buffer_.begin() + total_size);
 
     LOG_DEBUG("Received {} message, {} bytes, response={}, msg_num={}, payload_offset={}",
-              BcHeader::msg_id_name(msg.header.msg_id),
-              total_size, msg.header.response_code, msg.header.msg_num,
-              msg.header.payload_offset ? static_cast<int>(*msg.header.payload_offset) : -1);
+              BcHeader::msg_id_name(header.msg_id),
+              total_size, header.response_code, header.msg_num,
+              header.payload_offset ? static_cast<int>(*header.payload_offset) : -1);
 
-    return msg;
+    callback(view);
+
+    // Release the message only after the callback is done with the view
+    recv_buffer_.consume(total_size);
 }
 
 bool Connection::send_raw(const uint8_t* data, size_t len) {
@@ -372,8 +484,12 @@ bool Connection::recv_raw(uint8_t* data, size_t len, int timeout_ms) {
         if (n <= 0) {
             if (n == 0) {
                 LOG_ERROR("Connection closed by peer");
+                peer_closed_.store(true);
             } else {
                 LOG_ERROR("Receive error: {}", strerror(errno));
+                if (errno != EINTR && errno != EAGAIN) {
+                    peer_closed_.store(true);
+                }
             }
             return false;
         }
@@ -382,6 +498,47 @@ bool Connection::recv_raw(uint8_t* data, size_t len, int timeout_ms) {
     return true;
 }
 
+bool Connection::fill_recv_buffer(size_t need, int timeout_ms) {
+    // Make room up front so the whole message lands contiguously
+    recv_buffer_.reserve(need);
+
+    while (recv_buffer_.size() < need) {
+        if (!wait_for_data(timeout_ms)) {
+            return false;
+        }
+
+        ssize_t n = read_socket(0);
+        if (n <= 0) {
+            if (n == 0) {
+                LOG_ERROR("Connection closed by peer");
+                peer_closed_.store(true);
+            } else {
+                LOG_ERROR("Receive error: {}", strerror(errno));
+                if (errno != EINTR && errno != EAGAIN) {
+                    peer_closed_.store(true);
+                }
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+ssize_t Connection::read_socket(int flags) {
+    if (!pipeline_stats_) {
+        return recv_buffer_.read_from(socket_fd_, flags);
+    }
+
+    // Only reads that returned data count; an empty non-blocking read just
+    // ends a drain
+    auto start = std::chrono::steady_clock::now();
+    ssize_t n = recv_buffer_.read_from(socket_fd_, flags);
+    if (n > 0) {
+        pipeline_stats_->record(PipelineStage::Recv, std::chrono::steady_clock::now() - start);
+    }
+    return n;
+}
+
 bool Connection::wait_for_data(int timeout_ms) {
     if (timeout_ms == 0) {
         return true; // No timeout, assume data will arrive
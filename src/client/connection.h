@@ -2,6 +2,8 @@
 
 #include "protocol/bc_header.h"
 #include "protocol/bc_crypto.h"
+#include "client/recv_buffer.h"
+#include "utils/pipeline_stats.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -19,14 +21,28 @@ public:
     Connection();
     ~Connection();
 
-    // Connect to camera
-    bool connect(const std::string& host, uint16_t port = 9000);
+    // Connect to camera (timeout_ms bounds the TCP handshake)
+    bool connect(const std::string& host, uint16_t port = 9000, int timeout_ms = 10000);
+
+    // The same in two steps for an event loop: begin_connect() starts the
+    // handshake without waiting; once socket_fd() is writable,
+    // finish_connect() reports whether it succeeded
+    bool begin_connect(const std::string& host, uint16_t port = 9000);
+    bool finish_connect();
+
+    // Take over an already connected stream socket (e.g. one end of a
+    // socketpair); it is closed on disconnect like a connected one
+    void attach(int fd, const std::string& peer = "attached");
 
     // Disconnect
     void disconnect();
 
-    // Check if connected
-    bool is_connected() const { return socket_fd_ >= 0; }
+    // Abort from another thread: a connect() or receive in progress fails
+    // promptly (the socket is shut down), and so does any later connect()
+    void cancel();
+
+    // Check if connected (false once the peer has closed the socket)
+    bool is_connected() const { return socket_fd_ >= 0 && !peer_closed_.load(); }
 
     // Send a message (handles encryption if needed)
     bool send_message(const BcMessage& msg);
@@ -35,6 +51,23 @@ public:
     // timeout_ms: 0 = no timeout, otherwise wait up to timeout_ms milliseconds
     std::optional<BcMessage> receive_message(int timeout_ms = 5000);
 
+    // Receive a message without copying it: the callback gets a view whose
+    // spans point into the receive buffer and are only valid during the call.
+    // The receive lock is held while the callback runs, so it must not call
+    // back into receive_message/receive_message_view.
+    // Returns false on timeout/error (callback not invoked)
+    using MessageViewCallback = std::function<void(const BcMessageView&)>;
+    bool receive_message_view(const MessageViewCallback& callback, int timeout_ms = 5000);
+
+    // Non-blocking receive for an event loop: read until the socket has
+    // nothing more (EAGAIN) and hand every complete message to the callback
+    // as a view. A partial message stays buffered for the next call.
+    // Returns false once the connection is closed or out of sync.
+    bool receive_available(const MessageViewCallback& callback);
+
+    // Socket to watch for readability (-1 when not connected)
+    int socket_fd() const { return socket_fd_; }
+
     // Get next message number for sequencing
     uint16_t next_msg_num() { return ++msg_num_counter_; }
 
@@ -52,12 +85,19 @@ public:
         recv_offset_ = 0;
     }
 
+    // Record socket read and decrypt times here (null = off). Set before
+    // receiving starts; the stats must outlive the connection's use.
+    void set_pipeline_stats(PipelineStats* stats) { pipeline_stats_ = stats; }
+
     // Callback for received video frames (set by stream handler)
     using MessageCallback = std::function<void(const BcMessage&)>;
     void set_message_callback(MessageCallback cb) { message_callback_ = std::move(cb); }
 
 private:
     int socket_fd_ = -1;
+    std::atomic<bool> peer_closed_{false};
+    std::mutex fd_mutex_;                  // Guards socket_fd_ changes against cancel()
+    std::atomic<bool> cancelled_{false};
     std::string host_;
     uint16_t port_ = 9000;
 
@@ -68,8 +108,8 @@ private:
     uint32_t send_offset_ = 0;
     uint32_t recv_offset_ = 0;
 
-    // Receive buffer
-    std::vector<uint8_t> recv_buffer_;
+    // Receive buffer (socket data is read straight into it and parsed in place)
+    RecvBuffer recv_buffer_;
 
     // Thread safety
     mutable std::mutex send_mutex_;
@@ -78,14 +118,34 @@ private:
     // Callback for messages
     MessageCallback message_callback_;
 
+    PipelineStats* pipeline_stats_ = nullptr;
+
     // Binary mode tracking per msg_num (for FullAes)
     // Once a msg_num has binaryData=1, all subsequent messages with that msg_num are binary
     std::set<uint16_t> binary_mode_nums_;
 
+    // Close the socket (under fd_mutex_)
+    void close_socket();
+
     // Low-level socket operations
     bool send_raw(const uint8_t* data, size_t len);
     bool recv_raw(uint8_t* data, size_t len, int timeout_ms);
     bool wait_for_data(int timeout_ms);
+
+    // Read from the socket until recv_buffer_ holds at least `need` bytes
+    bool fill_recv_buffer(size_t need, int timeout_ms);
+
+    // One read into recv_buffer_, timed when pipeline stats are on
+    ssize_t read_socket(int flags);
+
+    // Hand every complete message in recv_buffer_ to the callback
+    // (false if the stream can't be parsed)
+    bool deliver_buffered(const MessageViewCallback& callback);
+
+    // Decrypt the complete message at the front of recv_buffer_ in place,
+    // run the callback on it and release it
+    void deliver_message(const BcHeader& header, size_t header_size,
+                         const MessageViewCallback& callback);
 };
 
 } // namespace baichuan
@@ -0,0 +1,332 @@
+#include "client/demux.h"
+#include "utils/io_reactor.h"
+#include "utils/logger.h"
+
+#include <chrono>
+#include <vector>
+
+namespace baichuan {
+
+namespace {
+
+// Demux whose messages the current I/O thread is dispatching
+thread_local const MessageDemux* t_dispatching = nullptr;
+
+} // namespace
+
+MessageDemux::MessageDemux(Connection& conn)
+    : conn_(conn) {}
+
+MessageDemux::~MessageDemux() {
+    stop();
+}
+
+bool MessageDemux::start() {
+    if (running_.load()) {
+        return true;
+    }
+    running_.store(true);
+    touch();
+
+    // Messages read along with the login replies are already buffered;
+    // the reactor only reports data arriving from now on
+    if (!on_readable()) {
+        return false;
+    }
+
+    reactor_id_ = IoReactor::instance().add(conn_.socket_fd(), [this]() {
+        return on_readable();
+    });
+    if (reactor_id_ == 0) {
+        running_.store(false);
+        return false;
+    }
+    return true;
+}
+
+void MessageDemux::stop() {
+    if (reactor_id_ != 0) {
+        IoReactor::instance().remove(reactor_id_);
+        reactor_id_ = 0;
+    }
+    running_.store(false);
+
+    // Nothing will answer now
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        reply_cv_.notify_all();
+    }
+    fail_requests();
+
+    // Timeouts still pending would outlive the demux
+    std::set<uint64_t> timers;
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        timers.swap(request_timers_);
+    }
+    for (uint64_t id : timers) {
+        IoReactor::instance().cancel_timer(id);
+    }
+}
+
+void MessageDemux::add_route(uint16_t msg_num, Connection::MessageViewCallback cb) {
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    routes_[msg_num] = std::move(cb);
+}
+
+void MessageDemux::remove_route(uint16_t msg_num) {
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        routes_.erase(msg_num);
+    }
+    wait_for_dispatch();
+}
+
+int MessageDemux::add_listener(Connection::MessageViewCallback cb) {
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    int id = next_listener_id_++;
+    listeners_[id] = std::move(cb);
+    return id;
+}
+
+void MessageDemux::remove_listener(int id) {
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        listeners_.erase(id);
+    }
+    wait_for_dispatch();
+}
+
+std::optional<BcMessage> MessageDemux::request(const BcMessage& msg, int timeout_ms) {
+    uint16_t msg_num = msg.header.msg_num;
+    auto waiter = std::make_shared<Waiter>();
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        waiters_[msg_num] = waiter;
+    }
+
+    if (!conn_.send_message(msg)) {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        waiters_.erase(msg_num);
+        return std::nullopt;
+    }
+
+    std::unique_lock<std::mutex> lock(routes_mutex_);
+    reply_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, &waiter] {
+        return waiter->done || !running_.load();
+    });
+    waiters_.erase(msg_num);
+
+    if (!waiter->done) {
+        return std::nullopt;
+    }
+    return std::move(waiter->reply);
+}
+
+bool MessageDemux::request_async(const BcMessage& msg, int timeout_ms, ReplyCallback on_reply) {
+    if (!running_.load()) {
+        return false;
+    }
+
+    uint16_t msg_num = msg.header.msg_num;
+    auto waiter = std::make_shared<Waiter>();
+    waiter->msg_id = msg.header.msg_id;
+    waiter->on_reply = std::move(on_reply);
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        waiters_[msg_num] = waiter;
+    }
+
+    if (!conn_.send_message(msg)) {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        auto it = waiters_.find(msg_num);
+        if (it != waiters_.end() && it->second == waiter) {
+            waiters_.erase(it);
+        }
+        return false;
+    }
+
+    // Armed after the send, so a failed send leaves no timer behind. A reply
+    // that beat it here leaves the timer nothing to expire.
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    waiter->timer = IoReactor::instance().add_timer(
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms),
+        [this, msg_num, waiter]() { expire_request(msg_num, waiter); });
+    if (waiter->timer != 0) {
+        request_timers_.insert(waiter->timer);
+    }
+    return true;
+}
+
+bool MessageDemux::cancel_request(uint16_t msg_num) {
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        auto it = waiters_.find(msg_num);
+        if (it != waiters_.end() && it->second->on_reply) {
+            waiters_.erase(it);
+            return true;
+        }
+    }
+
+    // Already taken: wait for its callback
+    wait_for_dispatch();
+    return false;
+}
+
+void MessageDemux::expire_request(uint16_t msg_num, const std::shared_ptr<Waiter>& waiter) {
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        request_timers_.erase(waiter->timer);
+        auto it = waiters_.find(msg_num);
+        if (it == waiters_.end() || it->second != waiter) {
+            return;  // Answered, failed or cancelled already
+        }
+        waiters_.erase(it);
+    }
+
+    LOG_WARN("No reply to {} (msg_num {})", BcHeader::msg_id_name(waiter->msg_id), msg_num);
+
+    // Serialised with dispatch like every other callback
+    std::lock_guard<std::mutex> dispatch_lock(dispatch_mutex_);
+    const MessageDemux* previous = t_dispatching;
+    t_dispatching = this;
+    waiter->on_reply(std::nullopt);
+    t_dispatching = previous;
+}
+
+void MessageDemux::fail_requests() {
+    std::vector<std::shared_ptr<Waiter>> failed;
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        for (auto it = waiters_.begin(); it != waiters_.end();) {
+            if (it->second->on_reply) {
+                failed.push_back(it->second);
+                it = waiters_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (failed.empty()) {
+        return;
+    }
+
+    // Already holding the dispatch lock when a callback stops the demux
+    std::unique_lock<std::mutex> dispatch_lock(dispatch_mutex_, std::defer_lock);
+    if (t_dispatching != this) {
+        dispatch_lock.lock();
+    }
+    const MessageDemux* previous = t_dispatching;
+    t_dispatching = this;
+    for (const auto& waiter : failed) {
+        waiter->on_reply(std::nullopt);
+    }
+    t_dispatching = previous;
+}
+
+MessageDemux::Stats MessageDemux::stats() const {
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    return stats_;
+}
+
+bool MessageDemux::on_readable() {
+    touch();
+    t_dispatching = this;
+    bool ok = conn_.receive_available([this](const BcMessageView& msg) {
+        dispatch(msg);
+    });
+    t_dispatching = nullptr;
+
+    if (!ok) {
+        LOG_WARN("Shared connection lost");
+
+        // Let requests still waiting give up now rather than at their timeout
+        running_.store(false);
+        {
+            std::lock_guard<std::mutex> lock(routes_mutex_);
+            reply_cv_.notify_all();
+        }
+        fail_requests();
+        if (closed_callback_) {
+            closed_callback_();
+        }
+    }
+    return ok;
+}
+
+void MessageDemux::dispatch(const BcMessageView& msg) {
+    uint16_t msg_num = msg.header.msg_num;
+
+    // Held from the lookup until the callbacks return: a remove_route() or
+    // remove_listener() erasing the entry meanwhile then waits for them, and
+    // one that got in first leaves nothing to look up
+    std::lock_guard<std::mutex> dispatch_lock(dispatch_mutex_);
+
+    Connection::MessageViewCallback route;
+    std::vector<Connection::MessageViewCallback> listeners;
+    ReplyCallback on_reply;
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+
+        auto waiter = waiters_.find(msg_num);
+        if (waiter != waiters_.end() && waiter->second->on_reply) {
+            if (waiter->second->msg_id == msg.header.msg_id) {
+                // Whoever erases the waiter delivers it; its timer finds
+                // nothing left to expire
+                on_reply = std::move(waiter->second->on_reply);
+                waiters_.erase(waiter);
+                stats_.replies++;
+            }
+        } else if (waiter != waiters_.end() && !waiter->second->done) {
+            waiter->second->reply = msg.to_owned();
+            waiter->second->done = true;
+            stats_.replies++;
+            reply_cv_.notify_all();
+            return;
+        }
+
+        auto it = routes_.find(msg_num);
+        if (on_reply) {
+            // Delivered below
+        } else if (it != routes_.end()) {
+            route = it->second;
+            stats_.routed++;
+        } else {
+            for (const auto& entry : listeners_) {
+                listeners.push_back(entry.second);
+            }
+            stats_.unrouted++;
+        }
+    }
+
+    if (on_reply) {
+        on_reply(msg.to_owned());
+        return;
+    }
+    if (route) {
+        route(msg);
+        return;
+    }
+    if (listeners.empty()) {
+        LOG_DEBUG("Ignoring message: {} (msg_num {})",
+                  BcHeader::msg_id_name(msg.header.msg_id), msg_num);
+    }
+    for (const auto& listener : listeners) {
+        listener(msg);
+    }
+}
+
+void MessageDemux::touch() {
+    last_received_.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                         std::memory_order_relaxed);
+}
+
+void MessageDemux::wait_for_dispatch() {
+    // A callback removing itself must not wait for itself
+    if (t_dispatching == this) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(dispatch_mutex_);
+}
+
+} // namespace baichuan
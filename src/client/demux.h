@@ -0,0 +1,129 @@
+#pragma once
+
+#include "client/connection.h"
+#include <functional>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <set>
+#include <cstdint>
+
+namespace baichuan {
+
+// Shares one authenticated connection between several consumers
+//
+// The connection's socket is watched by the shared IoReactor; when data
+// arrives an I/O thread drains it and dispatches each complete message:
+//   1. to a request() or request_async() waiting for the reply with that
+//      msg_num,
+//   2. else to the route registered for the msg_num (a VideoStream's frames
+//      carry the msg_num of its start request),
+//   3. else to every listener (alarm pushes, replies nobody waits for).
+// Callbacks run on an I/O thread with views into the receive buffer. They
+// may send, call add/remove_route and request_async(), but must not call
+// request() or stop(), or block (other cameras share the I/O threads).
+class MessageDemux {
+public:
+    explicit MessageDemux(Connection& conn);
+    ~MessageDemux();
+
+    MessageDemux(const MessageDemux&) = delete;
+    MessageDemux& operator=(const MessageDemux&) = delete;
+
+    Connection& connection() { return conn_; }
+
+    // Start/stop receiving: after a blocking login (which reads the
+    // connection directly), or before Authenticator::login_async()
+    bool start();
+    void stop();
+
+    // Receiving and the socket still open
+    bool is_running() const { return running_.load() && conn_.is_connected(); }
+
+    // When data last arrived (or start()); a quiet connection may be dead
+    std::chrono::steady_clock::time_point last_received() const {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(last_received_.load(std::memory_order_relaxed)));
+    }
+
+    // Route all messages with msg_num to cb. Once remove_route() returns the
+    // callback is not running and will not be called again.
+    void add_route(uint16_t msg_num, Connection::MessageViewCallback cb);
+    void remove_route(uint16_t msg_num);
+
+    // Called once when the connection is lost, on an I/O thread (or in
+    // start(), if it already is); not after stop(). Set before start().
+    void on_closed(std::function<void()> cb) { closed_callback_ = std::move(cb); }
+
+    // Messages with no waiter or route; returns an id for remove_listener()
+    int add_listener(Connection::MessageViewCallback cb);
+    void remove_listener(int id);
+
+    // Send msg and wait for the reply with its msg_num
+    std::optional<BcMessage> request(const BcMessage& msg, int timeout_ms = 5000);
+
+    // Send msg without waiting: on_reply gets the reply with its msg_num and
+    // msg_id, or nullopt after timeout_ms or once the connection is lost or
+    // stopped. It runs exactly once, on an I/O thread under the same rules
+    // as the other callbacks. Returns false (on_reply not called) if the
+    // demux isn't running or the send fails.
+    using ReplyCallback = std::function<void(std::optional<BcMessage>)>;
+    bool request_async(const BcMessage& msg, int timeout_ms, ReplyCallback on_reply);
+
+    // Drop a request_async() still waiting for msg_num; once it returns
+    // on_reply is not running and will not be called. True if it was still
+    // waiting.
+    bool cancel_request(uint16_t msg_num);
+
+    struct Stats {
+        uint64_t replies = 0;    // Delivered to request() and request_async()
+        uint64_t routed = 0;     // Delivered to a route
+        uint64_t unrouted = 0;   // Delivered to the listeners
+    };
+    Stats stats() const;
+
+private:
+    struct Waiter {
+        bool done = false;
+        BcMessage reply;
+        uint16_t msg_id = 0;        // request_async(): the reply must carry it
+        ReplyCallback on_reply;     // Set for request_async()
+        uint64_t timer = 0;
+    };
+
+    Connection& conn_;
+
+    std::atomic<bool> running_{false};
+    uint64_t reactor_id_ = 0;
+    std::atomic<std::chrono::steady_clock::rep> last_received_{0};
+
+    // Routing tables (short critical sections, never held across a callback)
+    mutable std::mutex routes_mutex_;
+    std::condition_variable reply_cv_;
+    std::map<uint16_t, std::shared_ptr<Waiter>> waiters_;
+    std::set<uint64_t> request_timers_;   // request_async() timeouts
+    std::map<uint16_t, Connection::MessageViewCallback> routes_;
+    std::map<int, Connection::MessageViewCallback> listeners_;
+    int next_listener_id_ = 0;
+    Stats stats_;
+    std::function<void()> closed_callback_;
+
+    // Held by dispatch() across the lookup and the callbacks, so removal can
+    // wait for a callback it just unregistered (taken before routes_mutex_)
+    std::mutex dispatch_mutex_;
+
+    bool on_readable();
+    void touch();
+    void dispatch(const BcMessageView& msg);
+    void wait_for_dispatch();
+
+    // Take every request_async() waiter and tell it no reply is coming
+    void fail_requests();
+    void expire_request(uint16_t msg_num, const std::shared_ptr<Waiter>& waiter);
+};
+
+} // namespace baichuan
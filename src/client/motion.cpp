@@ -0,0 +1,107 @@
+#include "client/motion.h"
+#include "protocol/bc_xml.h"
+#include "utils/logger.h"
+
+namespace baichuan {
+
+MotionMonitor::MotionMonitor(Connection& conn, uint8_t channel_id)
+    : conn_(conn), channel_id_(channel_id) {}
+
+MotionMonitor::~MotionMonitor() {
+    stop();
+}
+
+bool MotionMonitor::subscribe() {
+    request_num_ = conn_.next_msg_num();
+
+    BcMessage msg = BcMessage::create_header_only(MSG_ID_MOTION_REQUEST, request_num_,
+                                                  MSG_CLASS_MODERN_24);
+    msg.header.channel_id = channel_id_;
+
+    if (!conn_.send_message(msg)) {
+        LOG_ERROR("Failed to send motion alarm request");
+        return false;
+    }
+
+    LOG_DEBUG("Motion alarm request sent (msg_num {})", request_num_);
+    return true;
+}
+
+bool MotionMonitor::handle_message(const BcMessageView& msg) {
+    if (msg.header.msg_id == MSG_ID_MOTION_REQUEST) {
+        if (msg.header.response_code == RESPONSE_CODE_OK) {
+            subscribed_.store(true);
+            LOG_INFO("Motion alarms enabled (channel {})", channel_id_);
+        } else {
+            LOG_WARN("Motion alarm request rejected with code: {}", msg.header.response_code);
+        }
+        return true;
+    }
+
+    if (msg.header.msg_id != MSG_ID_MOTION) {
+        return false;
+    }
+
+    stats_.alarm_messages++;
+    if (msg.payload_len == 0) {
+        return true;
+    }
+
+    std::string xml(reinterpret_cast<const char*>(msg.payload_data), msg.payload_len);
+    for (const AlarmEventXml& alarm : AlarmEventXml::parse_list(xml)) {
+        if (alarm.channel_id != channel_id_) {
+            continue;
+        }
+
+        // Cameras repeat the current state; report changes only
+        bool motion = alarm.is_motion();
+        if (motion == active_.exchange(motion)) {
+            continue;
+        }
+
+        if (motion) {
+            stats_.motion_starts++;
+        }
+        LOG_INFO("Motion {} on channel {} (status: {})", motion ? "started" : "stopped",
+                 channel_id_, alarm.status);
+
+        if (callback_) {
+            MotionEvent event;
+            event.channel_id = alarm.channel_id;
+            event.motion = motion;
+            event.status = alarm.status;
+            event.ai_type = alarm.ai_type;
+            callback_(event);
+        }
+    }
+    return true;
+}
+
+bool MotionMonitor::start() {
+    if (running_.load()) {
+        return true;
+    }
+
+    running_.store(true);
+    receive_thread_ = std::thread([this]() {
+        auto handler = [this](const BcMessageView& msg) {
+            if (!handle_message(msg)) {
+                LOG_DEBUG("Ignoring message: {}", BcHeader::msg_id_name(msg.header.msg_id));
+            }
+        };
+        while (running_.load()) {
+            conn_.receive_message_view(handler, 1000);
+        }
+    });
+
+    return subscribe();
+}
+
+void MotionMonitor::stop() {
+    running_.store(false);
+    if (receive_thread_.joinable()) {
+        receive_thread_.join();
+    }
+}
+
+} // namespace baichuan
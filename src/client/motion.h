@@ -0,0 +1,71 @@
+#pragma once
+
+#include "client/connection.h"
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstdint>
+
+namespace baichuan {
+
+// Motion state change reported by the camera
+struct MotionEvent {
+    uint8_t channel_id = 0;
+    bool motion = false;       // Start (true) or end (false) of motion
+    std::string status;        // Raw AlarmEvent status ("MD", "none", ...)
+    std::string ai_type;       // AI detection type, if the camera reports one
+};
+
+using MotionCallback = std::function<void(const MotionEvent&)>;
+
+// Camera motion alarms (MSG_ID_MOTION_REQUEST / MSG_ID_MOTION)
+//
+// subscribe() asks the camera to push AlarmEventList messages; they are
+// then fed to handle_message() by whoever owns the connection's receive
+// loop - VideoStream::on_message() while streaming, or the monitor's own
+// loop (start()) when no video is requested. Only changes of the motion
+// state for the configured channel reach the callback.
+class MotionMonitor {
+public:
+    explicit MotionMonitor(Connection& conn, uint8_t channel_id = 0);
+    ~MotionMonitor();
+
+    // Set before subscribing
+    void on_event(MotionCallback cb) { callback_ = std::move(cb); }
+
+    // Send the alarm subscription; the reply arrives on the receive loop
+    bool subscribe();
+
+    // Handle a received message; returns true if it was a motion message
+    bool handle_message(const BcMessageView& msg);
+
+    // Run a receive loop of its own (connection not used by a VideoStream)
+    bool start();
+    void stop();
+
+    bool motion_active() const { return active_.load(); }
+    bool subscribed() const { return subscribed_.load(); }
+
+    struct Stats {
+        uint64_t alarm_messages = 0;  // MSG_ID_MOTION received
+        uint64_t motion_starts = 0;
+    };
+    Stats stats() const { return stats_; }
+
+private:
+    Connection& conn_;
+    uint8_t channel_id_;
+    uint16_t request_num_ = 0;
+
+    MotionCallback callback_;
+    std::atomic<bool> active_{false};
+    std::atomic<bool> subscribed_{false};
+
+    std::atomic<bool> running_{false};
+    std::thread receive_thread_;
+
+    Stats stats_;
+};
+
+} // namespace baichuan
@@ -0,0 +1,66 @@
+#include "client/recv_buffer.h"
+
+#include <sys/socket.h>
+#include <cstring>
+
+namespace baichuan {
+
+RecvBuffer::RecvBuffer(size_t initial_capacity)
+    : buf_(new uint8_t[initial_capacity]), capacity_(initial_capacity) {}
+
+void RecvBuffer::reserve(size_t total) {
+    size_t used = size();
+
+    // Enough room left at the tail already
+    if (total <= used || capacity_ - read_pos_ >= total) {
+        return;
+    }
+
+    // Room exists if the consumed front is reclaimed - move only the
+    // unconsumed remainder (a partial message) back to the start
+    if (total <= capacity_) {
+        if (used > 0) {
+            memmove(buf_.get(), buf_.get() + read_pos_, used);
+        }
+        read_pos_ = 0;
+        write_pos_ = used;
+        return;
+    }
+
+    // Grow (doubling) and carry the unconsumed bytes over
+    size_t new_capacity = capacity_;
+    while (new_capacity < total) {
+        new_capacity *= 2;
+    }
+
+    std::unique_ptr<uint8_t[]> new_buf(new uint8_t[new_capacity]);
+    if (used > 0) {
+        memcpy(new_buf.get(), buf_.get() + read_pos_, used);
+    }
+    buf_ = std::move(new_buf);
+    capacity_ = new_capacity;
+    read_pos_ = 0;
+    write_pos_ = used;
+}
+
+void RecvBuffer::consume(size_t n) {
+    read_pos_ += n;
+    if (read_pos_ >= write_pos_) {
+        // Fully drained - rewind without moving anything
+        read_pos_ = write_pos_ = 0;
+    }
+}
+
+ssize_t RecvBuffer::read_from(int fd, int flags) {
+    if (writable() < MIN_READ_SIZE) {
+        reserve(size() + MIN_READ_SIZE);
+    }
+
+    ssize_t n = recv(fd, write_ptr(), writable(), flags);
+    if (n > 0) {
+        commit(static_cast<size_t>(n));
+    }
+    return n;
+}
+
+} // namespace baichuan
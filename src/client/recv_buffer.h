@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <sys/types.h>
+
+namespace baichuan {
+
+// Contiguous receive buffer for socket reads
+//
+// Data is read from the socket straight into the free tail of the buffer and
+// handed out as a pointer to the unconsumed region, so a complete message can
+// be parsed in place. Consumed space is reclaimed by advancing a read cursor;
+// when the buffer drains the cursors rewind, and only a partial trailing
+// message is ever moved forward (when the tail runs out of room).
+class RecvBuffer {
+public:
+    explicit RecvBuffer(size_t initial_capacity = 256 * 1024);
+
+    // Unconsumed bytes
+    uint8_t* data() { return buf_.get() + read_pos_; }
+    const uint8_t* data() const { return buf_.get() + read_pos_; }
+    size_t size() const { return write_pos_ - read_pos_; }
+    bool empty() const { return read_pos_ == write_pos_; }
+
+    // Free space at the tail
+    uint8_t* write_ptr() { return buf_.get() + write_pos_; }
+    size_t writable() const { return capacity_ - write_pos_; }
+    size_t capacity() const { return capacity_; }
+
+    // Make sure `total` unconsumed bytes fit contiguously in the buffer
+    // (compacts or grows as needed; never discards unconsumed data)
+    void reserve(size_t total);
+
+    // Mark n bytes at write_ptr() as filled
+    void commit(size_t n) { write_pos_ += n; }
+
+    // Release n bytes from the front
+    void consume(size_t n);
+
+    // Drop all buffered data
+    void clear() { read_pos_ = write_pos_ = 0; }
+
+    // Read from a socket into the free tail (flags as for recv(), e.g.
+    // MSG_DONTWAIT). Returns the recv() result (bytes read, 0 on EOF, -1 on error)
+    ssize_t read_from(int fd, int flags = 0);
+
+private:
+    std::unique_ptr<uint8_t[]> buf_;
+    size_t capacity_ = 0;
+    size_t read_pos_ = 0;
+    size_t write_pos_ = 0;
+
+    // Minimum free space offered to each recv() call
+    static constexpr size_t MIN_READ_SIZE = 16 * 1024;
+};
+
+} // namespace baichuan
@@ -0,0 +1,168 @@
+#include "client/snap.h"
+#include "protocol/bc_xml.h"
+#include "utils/logger.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace baichuan {
+
+namespace {
+
+// Larger than any JPEG a camera sends; guards against a corrupt size
+constexpr uint32_t MAX_PICTURE_SIZE = 16 * 1024 * 1024;
+
+// One fetch's progress, fed every message carrying the request's msg_num:
+// first the XML reply, then the JPEG in binary chunks
+struct Transfer {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool replied = false;
+    bool done = false;
+    uint32_t expected = 0;
+    SnapResult result;
+
+    void on_message(const BcMessageView& msg);
+    void finish();
+};
+
+void Transfer::on_message(const BcMessageView& msg) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (done) {
+        return;
+    }
+
+    if (!replied) {
+        replied = true;
+        if (msg.header.response_code != RESPONSE_CODE_OK) {
+            result.error = "snapshot refused with code " + std::to_string(msg.header.response_code);
+            finish();
+            return;
+        }
+
+        std::string xml(reinterpret_cast<const char*>(msg.payload_data), msg.payload_len);
+        auto snap = SnapXml::parse(xml);
+        if (!snap || !snap->picture_size || *snap->picture_size == 0 ||
+            *snap->picture_size > MAX_PICTURE_SIZE) {
+            result.error = "snapshot reply without a valid picture size";
+            finish();
+            return;
+        }
+        expected = *snap->picture_size;
+        result.file_name = snap->file_name.value_or("");
+        result.jpeg.reserve(expected);
+        return;
+    }
+
+    result.jpeg.insert(result.jpeg.end(), msg.payload_data, msg.payload_data + msg.payload_len);
+    if (result.jpeg.size() >= expected) {
+        result.jpeg.resize(expected);
+        result.ok = true;
+        finish();
+    }
+}
+
+void Transfer::finish() {
+    done = true;
+    cv.notify_all();
+}
+
+SnapResult failed(const std::string& error) {
+    LOG_WARN("Snapshot failed: {}", error);
+    SnapResult result;
+    result.error = error;
+    return result;
+}
+
+} // namespace
+
+SnapClient::SnapClient(Connection& conn)
+    : conn_(conn) {}
+
+SnapClient::SnapClient(MessageDemux& demux)
+    : conn_(demux.connection()), demux_(&demux) {}
+
+SnapResult SnapClient::fetch(const SnapConfig& config) {
+    uint16_t msg_num = conn_.next_msg_num();
+    BcMessage request = create_request(msg_num, config);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.timeout_ms);
+
+    Transfer transfer;
+
+    if (demux_) {
+        if (!demux_->is_running()) {
+            return failed("not connected");
+        }
+
+        // The reply and the picture carry our msg_num; route them before asking
+        demux_->add_route(msg_num, [&transfer](const BcMessageView& msg) {
+            transfer.on_message(msg);
+        });
+        if (!conn_.send_message(request)) {
+            demux_->remove_route(msg_num);
+            return failed("failed to send snapshot request");
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(transfer.mutex);
+            transfer.cv.wait_until(lock, deadline, [&transfer] { return transfer.done; });
+        }
+        demux_->remove_route(msg_num);
+    } else {
+        if (!conn_.send_message(request)) {
+            return failed("failed to send snapshot request");
+        }
+
+        auto handler = [&transfer, msg_num](const BcMessageView& msg) {
+            if (msg.header.msg_num != msg_num) {
+                LOG_DEBUG("Ignoring message: {}", BcHeader::msg_id_name(msg.header.msg_id));
+                return;
+            }
+            transfer.on_message(msg);
+        };
+
+        while (conn_.is_connected()) {
+            {
+                std::lock_guard<std::mutex> lock(transfer.mutex);
+                if (transfer.done) break;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) break;
+            conn_.receive_message_view(handler, static_cast<int>(remaining));
+        }
+    }
+
+    // The route is gone (or we were the receiver): nothing touches transfer now
+    if (!transfer.done) {
+        if (!transfer.replied) {
+            return failed("no reply to snapshot request");
+        }
+        return failed("snapshot incomplete: " + std::to_string(transfer.result.jpeg.size()) +
+                      " of " + std::to_string(transfer.expected) + " bytes");
+    }
+    if (!transfer.result.ok) {
+        return failed(transfer.result.error);
+    }
+
+    LOG_DEBUG("Snapshot received: {} bytes ({})", transfer.result.jpeg.size(),
+              transfer.result.file_name);
+    return std::move(transfer.result);
+}
+
+BcMessage SnapClient::create_request(uint16_t msg_num, const SnapConfig& config) const {
+    std::string xml = BcXmlBuilder::create_snap_request(config.channel_id, config.stream_type);
+
+    BcMessage msg = BcMessage::create_with_extension(
+        MSG_ID_SNAP,
+        msg_num,
+        BcXmlBuilder::create_channel_extension(config.channel_id),
+        std::vector<uint8_t>(xml.begin(), xml.end()),
+        MSG_CLASS_MODERN_24
+    );
+    msg.header.channel_id = config.channel_id;  // NVR channel
+    return msg;
+}
+
+} // namespace baichuan
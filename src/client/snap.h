@@ -0,0 +1,52 @@
+#pragma once
+
+#include "client/connection.h"
+#include "client/demux.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace baichuan {
+
+// Snapshot request configuration
+struct SnapConfig {
+    uint8_t channel_id = 0;
+    std::string stream_type = "main";  // "main" or "sub" (picture resolution)
+    int timeout_ms = 5000;             // For the reply and the whole picture
+};
+
+struct SnapResult {
+    bool ok = false;
+    std::string error;
+    std::vector<uint8_t> jpeg;
+    std::string file_name;             // Name the camera gave the picture
+};
+
+// Camera-side JPEG snapshots (MSG_ID_SNAP)
+//
+// The camera encodes the picture itself: fetch() sends a Snap request, the
+// reply gives the picture size and the JPEG follows as binary messages with
+// the request's msg_num. Nothing is decoded on our side, so periodic
+// thumbnails cost a few kilobytes of network and no CPU.
+//
+// On a MessageDemux the messages are routed to the fetch by msg_num, so it
+// runs alongside VideoStreams and other requests on the same connection.
+// On a bare Connection fetch() reads the socket itself; nothing else may be
+// receiving on it (no VideoStream with its own receive thread).
+class SnapClient {
+public:
+    explicit SnapClient(Connection& conn);
+    explicit SnapClient(MessageDemux& demux);
+
+    // Blocks until the picture is complete, the camera refuses or the
+    // timeout passes. Safe to call from several threads at once.
+    SnapResult fetch(const SnapConfig& config = SnapConfig{});
+
+private:
+    Connection& conn_;
+    MessageDemux* demux_ = nullptr;
+
+    BcMessage create_request(uint16_t msg_num, const SnapConfig& config) const;
+};
+
+} // namespace baichuan
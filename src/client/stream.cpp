@@ -4,46 +4,114 @@
 
 namespace baichuan {
 
-VideoStream::VideoStream(Connection& conn) : conn_(conn) {}
+VideoStream::VideoStream(Connection& conn)
+    : conn_(conn),
+      media_parser_([this](const BcMediaFrame& frame, size_t frame_size) {
+          handle_media_frame(frame, frame_size);
+      }) {}
+
+VideoStream::VideoStream(MessageDemux& demux)
+    : VideoStream(demux.connection()) {
+    demux_ = &demux;
+}
 
 VideoStream::~VideoStream() {
     stop();
 }
 
 bool VideoStream::start(const StreamConfig& config) {
-    if (streaming_.load()) {
+    if (streaming_.load() || starting_.load()) {
         LOG_WARN("Stream already running");
         return false;
     }
 
-    config_ = config;
-    stats_ = Stats{};
-    stream_info_received_ = false;
+    BcMessage request = begin_start(config);
+
+    std::optional<BcMessage> response;
+    if (demux_) {
+        // Frames follow the reply with the same msg_num; route them before asking
+        demux_->add_route(stream_msg_num_, [this](const BcMessageView& msg) {
+            process_message(msg);
+        });
+        response = demux_->request(request, 5000);
+    } else {
+        if (!conn_.send_message(request)) {
+            LOG_ERROR("Failed to send stream start request");
+            return false;
+        }
 
-    LOG_INFO("Starting video stream: channel={}, handle={}, type={}",
-             config_.channel_id, config_.handle, config_.stream_type);
+        // Wait for initial response
+        response = conn_.receive_message(5000);
+    }
 
-    if (!send_start_request()) {
-        LOG_ERROR("Failed to send stream start request");
+    if (!finish_start(response)) {
+        return false;
+    }
+
+    // Start receive thread (a shared connection already has one)
+    if (!demux_) {
+        receive_thread_ = std::thread([this]() {
+            receive_loop();
+        });
+    }
+    return true;
+}
+
+bool VideoStream::start_async(const StreamConfig& config, std::function<void(bool)> done) {
+    if (!demux_ || streaming_.load() || starting_.load()) {
+        LOG_WARN("Stream already running");
         return false;
     }
 
-    // Wait for initial response
-    auto response = conn_.receive_message(5000);
-    if (!response) {
-        LOG_ERROR("No response to stream start request");
+    BcMessage request = begin_start(config);
+    demux_->add_route(stream_msg_num_, [this](const BcMessageView& msg) {
+        process_message(msg);
+    });
+
+    starting_.store(true);
+    bool sent = demux_->request_async(request, 5000, [this, done](std::optional<BcMessage> response) {
+        bool ok = finish_start(response);
+        starting_.store(false);
+        done(ok);
+    });
+    if (!sent) {
+        LOG_ERROR("Failed to send stream start request");
+        starting_.store(false);
+        demux_->remove_route(stream_msg_num_);
         return false;
     }
+    return true;
+}
+
+BcMessage VideoStream::begin_start(const StreamConfig& config) {
+    config_ = config;
+    stream_info_received_ = false;
+    media_parser_.reset();
+
+    LOG_INFO("Starting video stream: channel={}, handle={}, type={}",
+             config_.channel_id, config_.handle, config_.stream_type);
 
-    if (response->header.response_code != RESPONSE_CODE_OK) {
-        LOG_ERROR("Stream start rejected with code: {}", response->header.response_code);
+    stream_msg_num_ = conn_.next_msg_num();
+    return create_start_request(stream_msg_num_);
+}
+
+bool VideoStream::finish_start(const std::optional<BcMessage>& response) {
+    if (!response || response->header.response_code != RESPONSE_CODE_OK) {
+        if (!response) {
+            LOG_ERROR("No response to stream start request");
+        } else {
+            LOG_ERROR("Stream start rejected with code: {}", response->header.response_code);
+        }
+        if (demux_) {
+            demux_->remove_route(stream_msg_num_);
+        }
         return false;
     }
 
     // Check if extension indicates binary data mode
     if (!response->extension_data.empty()) {
-        std::string ext_xml(response->extension_data.begin(), response->extension_data.end());
-        auto ext = BcXmlBuilder::parse_extension(ext_xml);
+        auto ext = BcXmlBuilder::parse_extension(response->extension_data.data(),
+                                                 response->extension_data.size());
         if (ext && ext->binary_data && *ext->binary_data == 1) {
             std::lock_guard<std::mutex> lock(binary_mode_mutex_);
             binary_mode_nums_.insert(response->header.msg_num);
@@ -52,17 +120,19 @@ bool VideoStream::start(const StreamConfig& config) {
     }
 
     streaming_.store(true);
-
-    // Start receive thread
-    receive_thread_ = std::thread([this]() {
-        receive_loop();
-    });
-
     LOG_INFO("Video stream started");
     return true;
 }
 
-void VideoStream::stop() {
+void VideoStream::stop(bool send_request) {
+    // A start_async() still waiting: drop the request (or wait for its
+    // reply's callback, which may have just started the stream)
+    if (starting_.load() && demux_->cancel_request(stream_msg_num_)) {
+        starting_.store(false);
+        demux_->remove_route(stream_msg_num_);
+        LOG_INFO("Video stream start abandoned");
+        return;
+    }
     if (!streaming_.load()) {
         return;
     }
@@ -71,10 +141,14 @@ void VideoStream::stop() {
     streaming_.store(false);
 
     // Send stop request (best effort)
-    send_stop_request();
+    if (send_request) {
+        send_stop_request();
+    }
 
     // Wait for receive thread to finish
-    if (receive_thread_.joinable()) {
+    if (demux_) {
+        demux_->remove_route(stream_msg_num_);
+    } else if (receive_thread_.joinable()) {
         receive_thread_.join();
     }
 
@@ -86,7 +160,7 @@ void VideoStream::stop() {
     LOG_INFO("Video stream stopped");
 }
 
-bool VideoStream::send_start_request() {
+BcMessage VideoStream::create_start_request(uint16_t msg_num) const {
     std::string xml = BcXmlBuilder::create_preview_request(
         config_.channel_id,
         config_.handle,
@@ -95,12 +169,12 @@ bool VideoStream::send_start_request() {
 
     BcMessage msg = BcMessage::create_with_payload(
         MSG_ID_VIDEO,
-        conn_.next_msg_num(),
+        msg_num,
         xml,
         MSG_CLASS_MODERN_24
     );
-
-    return conn_.send_message(msg);
+    msg.header.channel_id = config_.channel_id;  // NVR channel
+    return msg;
 }
 
 bool VideoStream::send_stop_request() {
@@ -116,6 +190,7 @@ bool VideoStream::send_stop_request() {
         xml,
         MSG_CLASS_MODERN_24
     );
+    msg.header.channel_id = config_.channel_id;
 
     return conn_.send_message(msg);
 }
@@ -123,29 +198,33 @@ bool VideoStream::send_stop_request() {
 void VideoStream::receive_loop() {
     LOG_DEBUG("Receive loop started");
 
-    while (streaming_.load()) {
-        auto msg = conn_.receive_message(1000);
-        if (!msg) {
-            // Timeout is OK, just continue
-            continue;
-        }
+    // Messages are handled as views into the connection's receive buffer;
+    // video payloads are parsed without an intermediate copy
+    auto handler = [this](const BcMessageView& msg) {
+        process_message(msg);
+    };
 
-        process_message(*msg);
+    while (streaming_.load()) {
+        // Timeout is OK, just continue
+        conn_.receive_message_view(handler, 1000);
     }
 
     LOG_DEBUG("Receive loop ended");
 }
 
-void VideoStream::process_message(const BcMessage& msg) {
+void VideoStream::process_message(const BcMessageView& msg) {
     if (msg.header.msg_id != MSG_ID_VIDEO) {
-        LOG_DEBUG("Ignoring non-video message: {}", BcHeader::msg_id_name(msg.header.msg_id));
+        if (message_callback_) {
+            message_callback_(msg);
+        } else {
+            LOG_DEBUG("Ignoring non-video message: {}", BcHeader::msg_id_name(msg.header.msg_id));
+        }
         return;
     }
 
     // Check if this message indicates binary mode
-    if (!msg.extension_data.empty()) {
-        std::string ext_xml(msg.extension_data.begin(), msg.extension_data.end());
-        auto ext = BcXmlBuilder::parse_extension(ext_xml);
+    if (msg.extension_len > 0) {
+        auto ext = BcXmlBuilder::parse_extension(msg.extension_data, msg.extension_len);
         if (ext && ext->binary_data && *ext->binary_data == 1) {
             std::lock_guard<std::mutex> lock(binary_mode_mutex_);
             binary_mode_nums_.insert(msg.header.msg_num);
@@ -153,110 +232,78 @@ void VideoStream::process_message(const BcMessage& msg) {
     }
 
     // Process payload data as BcMedia
-    if (!msg.payload_data.empty()) {
-        process_media_data(msg.payload_data);
+    if (msg.payload_len > 0) {
+        process_media_data(msg.payload_data, msg.payload_len);
     }
 }
 
-void VideoStream::process_media_data(const std::vector<uint8_t>& data) {
-    // Append new data to buffer
-    media_buffer_.insert(media_buffer_.end(), data.begin(), data.end());
-
-    // Debug: print first bytes of incoming data (only once when buffer is small)
-    if (media_buffer_.size() == data.size() && data.size() >= 32) {
-        std::string hex;
-        for (size_t i = 0; i < 32 && i < data.size(); i++) {
-            char buf[4];
-            snprintf(buf, sizeof(buf), "%02x ", data[i]);
-            hex += buf;
-        }
-        LOG_DEBUG("First 32 bytes of video data: {}", hex);
+void VideoStream::process_media_data(const uint8_t* data, size_t len) {
+    // Debug: print first bytes of incoming data (only when starting on a frame boundary)
+    if (media_parser_.pending_bytes() == 0 && len >= 32) {
+        LOG_DEBUG("First 32 bytes of video data: {}", Logger::bytes_to_hex(data, 32));
     }
 
-    // Try to parse complete frames from buffer
-    size_t offset = 0;
+    // Frames spanning several BC messages are assembled by the parser as the
+    // chunks arrive; complete frames come back through handle_media_frame()
+    if (!pipeline_stats_) {
+        media_parser_.feed(data, len);
+        return;
+    }
 
-    while (offset < media_buffer_.size()) {
-        // Check if remaining data starts with a valid magic
-        if (media_buffer_.size() - offset < 4) {
-            break;  // Need more data
-        }
+    auto start = std::chrono::steady_clock::now();
+    callback_time_ = {};
+    media_parser_.feed(data, len);
+    pipeline_stats_->record(PipelineStage::Parse,
+                            std::chrono::steady_clock::now() - start - callback_time_);
+}
 
-        uint32_t magic = static_cast<uint32_t>(media_buffer_[offset]) |
-                        (static_cast<uint32_t>(media_buffer_[offset + 1]) << 8) |
-                        (static_cast<uint32_t>(media_buffer_[offset + 2]) << 16) |
-                        (static_cast<uint32_t>(media_buffer_[offset + 3]) << 24);
-
-        if (!BcMediaParser::is_bcmedia_magic(magic)) {
-            // Unknown magic - skip one byte and try to resync
-            char magic_str[64];
-            snprintf(magic_str, sizeof(magic_str), "0x%08x bytes: %02x %02x %02x %02x",
-                     magic,
-                     media_buffer_[offset], media_buffer_[offset + 1],
-                     media_buffer_[offset + 2], media_buffer_[offset + 3]);
-            LOG_WARN("Unknown magic {} at offset {}", magic_str, offset);
-            offset++;
-            continue;
+void VideoStream::handle_media_frame(const BcMediaFrame& frame, size_t frame_size) {
+    stats_->frames_received++;
+    stats_->bytes_received += frame_size;
+
+    // Process frame based on type
+    std::visit([this](auto&& arg) {
+        using T = std::decay_t<decltype(arg)>;
+
+        if constexpr (std::is_same_v<T, BcMediaInfo>) {
+            LOG_INFO("Stream info: {}x{} @ {} fps",
+                    arg.video_width, arg.video_height, arg.fps);
+            stream_info_ = arg;
+            stream_info_received_ = true;
+            if (stream_info_callback_) {
+                stream_info_callback_(arg);
+            }
         }
-
-        auto result = BcMediaParser::parse(media_buffer_.data() + offset, media_buffer_.size() - offset);
-        if (!result) {
-            // Not enough data for complete frame - wait for more
-            char magic_str[32];
-            snprintf(magic_str, sizeof(magic_str), "0x%08x", magic);
-            LOG_DEBUG("Incomplete frame at offset {}, waiting for more data (buffer size: {}, magic: {})",
-                     offset, media_buffer_.size() - offset, magic_str);
-            break;
+        else if constexpr (std::is_same_v<T, BcMediaIFrame>) {
+            stats_->i_frames++;
+            LOG_INFO("IFrame received: {} bytes, {} codec",
+                     arg.data.size(),
+                     arg.codec == VideoCodec::H264 ? "H264" : "H265");
         }
-
-        const auto& [frame, consumed] = *result;
-        offset += consumed;
-        stats_.frames_received++;
-        stats_.bytes_received += consumed;
-
-        // Process frame based on type
-        std::visit([this](auto&& arg) {
-            using T = std::decay_t<decltype(arg)>;
-
-            if constexpr (std::is_same_v<T, BcMediaInfo>) {
-                LOG_INFO("Stream info: {}x{} @ {} fps",
-                        arg.video_width, arg.video_height, arg.fps);
-                stream_info_ = arg;
-                stream_info_received_ = true;
-                if (stream_info_callback_) {
-                    stream_info_callback_(arg);
-                }
-            }
-            else if constexpr (std::is_same_v<T, BcMediaIFrame>) {
-                stats_.i_frames++;
-                LOG_INFO("IFrame received: {} bytes, {} codec",
-                         arg.data.size(),
-                         arg.codec == VideoCodec::H264 ? "H264" : "H265");
-            }
-            else if constexpr (std::is_same_v<T, BcMediaPFrame>) {
-                stats_.p_frames++;
-                if (stats_.p_frames <= 3) {
-                    LOG_DEBUG("PFrame received: {} bytes", arg.data.size());
-                }
-            }
-            else if constexpr (std::is_same_v<T, BcMediaAac>) {
-                // Audio frames are frequent, only log at trace level
+        else if constexpr (std::is_same_v<T, BcMediaPFrame>) {
+            stats_->p_frames++;
+            if (stats_->p_frames.load() <= 3) {
+                LOG_DEBUG("PFrame received: {} bytes", arg.data.size());
             }
-            else if constexpr (std::is_same_v<T, BcMediaAdpcm>) {
-                // Audio frames are frequent, only log at trace level
-            }
-        }, frame);
+        }
+        else if constexpr (std::is_same_v<T, BcMediaAac>) {
+            // Audio frames are frequent, only log at trace level
+        }
+        else if constexpr (std::is_same_v<T, BcMediaAdpcm>) {
+            // Audio frames are frequent, only log at trace level
+        }
+    }, frame);
 
-        // Call frame callback
-        if (frame_callback_) {
+    // Call frame callback (timed so parsing can leave it out)
+    if (frame_callback_) {
+        if (pipeline_stats_) {
+            auto start = std::chrono::steady_clock::now();
+            frame_callback_(frame);
+            callback_time_ += std::chrono::steady_clock::now() - start;
+        } else {
             frame_callback_(frame);
         }
     }
-
-    // Remove consumed data from buffer
-    if (offset > 0) {
-        media_buffer_.erase(media_buffer_.begin(), media_buffer_.begin() + offset);
-    }
 }
 
 } // namespace baichuan
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "client/connection.h"
+#include "client/demux.h"
 #include "protocol/bc_media.h"
+#include "utils/pipeline_stats.h"
+#include "utils/metrics.h"
 #include <functional>
 #include <atomic>
 #include <thread>
@@ -20,6 +23,8 @@ struct StreamConfig {
 };
 
 // Callback types for stream events
+// Video payloads are pooled FrameBuffers: copying the frame (or its data
+// handle) keeps the payload alive without copying the bytes
 using FrameCallback = std::function<void(const BcMediaFrame&)>;
 using StreamInfoCallback = std::function<void(const BcMediaInfo&)>;
 using ErrorCallback = std::function<void(const std::string&)>;
@@ -27,13 +32,25 @@ using ErrorCallback = std::function<void(const std::string&)>;
 class VideoStream {
 public:
     explicit VideoStream(Connection& conn);
+
+    // Share a connection with other streams: frames arrive through the
+    // demux's receive thread (routed by msg_num) instead of a thread of our own
+    explicit VideoStream(MessageDemux& demux);
     ~VideoStream();
 
     // Start video stream
     bool start(const StreamConfig& config = StreamConfig{});
 
-    // Stop video stream
-    void stop();
+    // Start on a shared connection without waiting for the camera's reply:
+    // done(ok) follows on an I/O thread (demux callback rules apply). False
+    // if the request could not be sent (done not called). A stop() before
+    // the reply abandons the start; done is then not called.
+    bool start_async(const StreamConfig& config, std::function<void(bool)> done);
+
+    // Stop video stream. send_request = false skips the VIDEO_STOP message,
+    // for a connection that is lost or being abandoned (the send could block
+    // for the socket's send timeout)
+    void stop(bool send_request = true);
 
     // Check if streaming
     bool is_streaming() const { return streaming_.load(); }
@@ -43,25 +60,42 @@ public:
     void on_stream_info(StreamInfoCallback cb) { stream_info_callback_ = std::move(cb); }
     void on_error(ErrorCallback cb) { error_callback_ = std::move(cb); }
 
+    // Non-video messages arriving on the stream's connection (alarm pushes,
+    // replies to other requests) are handed here on the receive thread.
+    // Set before start(). Not used on a shared connection - register a
+    // listener with the MessageDemux instead.
+    void on_message(Connection::MessageViewCallback cb) { message_callback_ = std::move(cb); }
+
+    // Record BcMedia parse times here (null = off; set before start()).
+    // Time spent in the frame callback is not counted.
+    void set_pipeline_stats(PipelineStats* stats) { pipeline_stats_ = stats; }
+
     // Get stream info (available after first info frame is received)
     const BcMediaInfo* stream_info() const {
         return stream_info_received_ ? &stream_info_ : nullptr;
     }
 
-    // Get statistics
+    // Statistics (atomic: readable from any thread while streaming)
     struct Stats {
-        uint64_t frames_received = 0;
-        uint64_t bytes_received = 0;
-        uint64_t i_frames = 0;
-        uint64_t p_frames = 0;
+        MetricCounter frames_received;
+        MetricCounter bytes_received;
+        MetricCounter i_frames;
+        MetricCounter p_frames;
     };
-    Stats stats() const { return stats_; }
+    const Stats& stats() const { return *stats_; }
+
+    // Count into an external block instead (e.g. one that outlives the
+    // stream, for totals across reconnects); set before start()
+    void set_stats(Stats* stats) { stats_ = stats ? stats : &own_stats_; }
 
 private:
     Connection& conn_;
+    MessageDemux* demux_ = nullptr;
+    uint16_t stream_msg_num_ = 0;  // msg_num of the start request (shared connection route)
     StreamConfig config_;
 
     std::atomic<bool> streaming_{false};
+    std::atomic<bool> starting_{false};   // start_async() waiting for its reply
     std::thread receive_thread_;
 
     // Stream info
@@ -72,23 +106,31 @@ private:
     FrameCallback frame_callback_;
     StreamInfoCallback stream_info_callback_;
     ErrorCallback error_callback_;
+    Connection::MessageViewCallback message_callback_;
 
     // Statistics
-    Stats stats_;
+    Stats own_stats_;
+    Stats* stats_ = &own_stats_;
+    PipelineStats* pipeline_stats_ = nullptr;
+    std::chrono::steady_clock::duration callback_time_{};  // In frame callbacks during one parse
 
     // Binary mode tracking (msg_num for which we're in binary mode)
     std::set<uint16_t> binary_mode_nums_;
     std::mutex binary_mode_mutex_;
 
-    // Media data buffer - accumulates data across BC messages
-    std::vector<uint8_t> media_buffer_;
+    // Incremental BcMedia parser - frames may span BC messages
+    BcMediaStreamParser media_parser_;
 
     // Internal methods
-    bool send_start_request();
+    BcMessage begin_start(const StreamConfig& config);
+    bool finish_start(const std::optional<BcMessage>& response);
+    BcMessage create_start_request(uint16_t msg_num) const;
     bool send_stop_request();
     void receive_loop();
-    void process_message(const BcMessage& msg);
-    void process_media_data(const std::vector<uint8_t>& data);
+    void process_message(const BcMessageView& msg);
+    void process_media_data(const uint8_t* data, size_t len);
+
+    void handle_media_frame(const BcMediaFrame& frame, size_t frame_size);
 };
 
 } // namespace baichuan
@@ -1,5 +1,6 @@
 #include "control/command_server.h"
 #include "utils/logger.h"
+#include "utils/metrics.h"
 
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -13,6 +14,24 @@
 
 namespace baichuan {
 
+namespace {
+
+// Replies can exceed one socket buffer (metrics pages, snapshots); a client
+// that stops reading is given up on after the send timeout
+void send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+} // namespace
+
 CommandServer::CommandServer(const std::string& unix_path, int tcp_port)
     : unix_path_(unix_path), tcp_port_(tcp_port) {
 }
@@ -25,6 +44,33 @@ void CommandServer::set_handler(CommandHandler handler) {
     handler_ = std::move(handler);
 }
 
+void CommandServer::add_http_route(const std::string& path, HttpHandler handler) {
+    http_routes_[path] = std::move(handler);
+}
+
+void CommandServer::set_metrics_handler(MetricsHandler handler) {
+    add_http_route("/metrics", [handler](const std::string&) {
+        HttpResponse response;
+        response.content_type = OpenMetricsWriter::CONTENT_TYPE;
+        response.body = handler();
+        return response;
+    });
+}
+
+std::string CommandServer::query_param(const std::string& query, const std::string& name) {
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+        if (query.compare(pos, name.size(), name) == 0 && pos + name.size() < end &&
+            query[pos + name.size()] == '=') {
+            return query.substr(pos + name.size() + 1, end - pos - name.size() - 1);
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
 int CommandServer::create_unix_socket(const std::string& path) {
     // Remove stale socket file
     unlink(path.c_str());
@@ -175,14 +221,14 @@ void CommandServer::listener_loop() {
         fds.push_back({tcp_fd_, POLLIN, 0});
     }
 
+    // No timeout: stop() wakes the loop through the quit pipe
     while (running_.load()) {
-        int ret = poll(fds.data(), fds.size(), 1000);  // 1s timeout
+        int ret = poll(fds.data(), fds.size(), -1);
         if (ret < 0) {
             if (errno == EINTR) continue;
             LOG_ERROR("CommandServer: poll error: {}", strerror(errno));
             break;
         }
-        if (ret == 0) continue;  // timeout
 
         // Check quit pipe
         if (fds[0].revents & POLLIN) {
@@ -210,30 +256,27 @@ void CommandServer::listener_loop() {
 }
 
 void CommandServer::handle_connection(int client_fd) {
-    // Set a read timeout so we don't block forever
+    // Set read and write timeouts so we don't block forever
     struct timeval tv;
     tv.tv_sec = 5;
     tv.tv_usec = 0;
     setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
     // Read until newline or EOF (max 4KB)
-    std::string request;
+    std::string received;
     char buf[1024];
-    bool got_newline = false;
+    size_t newline = std::string::npos;
 
-    while (request.size() < 4096) {
+    while (received.size() < 4096) {
         ssize_t n = read(client_fd, buf, sizeof(buf));
         if (n <= 0) break;
 
-        for (ssize_t i = 0; i < n; i++) {
-            if (buf[i] == '\n') {
-                got_newline = true;
-                break;
-            }
-            request += buf[i];
-        }
-        if (got_newline) break;
+        received.append(buf, static_cast<size_t>(n));
+        newline = received.find('\n');
+        if (newline != std::string::npos) break;
     }
+    std::string request = received.substr(0, newline);
 
     // Trim whitespace
     while (!request.empty() && (request.back() == '\r' || request.back() == ' ')) {
@@ -245,6 +288,14 @@ void CommandServer::handle_connection(int client_fd) {
         return;
     }
 
+    // HTTP clients (metrics scrapers)
+    if (request.compare(0, 4, "GET ") == 0) {
+        std::string pending = newline != std::string::npos ? received.substr(newline + 1) : "";
+        handle_http(client_fd, request, pending);
+        close(client_fd);
+        return;
+    }
+
     LOG_DEBUG("CommandServer: Received command: {}", request);
 
     std::string response;
@@ -255,10 +306,51 @@ void CommandServer::handle_connection(int client_fd) {
     }
 
     response += "\n";
-    ssize_t ret = write(client_fd, response.c_str(), response.size());
-    (void)ret;
+    send_all(client_fd, response);
 
     close(client_fd);
 }
 
+void CommandServer::handle_http(int client_fd, const std::string& request_line, std::string& pending) {
+    // Drain the request headers; closing with unread data would reset the
+    // connection and could cut the response short
+    char buf[1024];
+    while (pending.find("\r\n\r\n") == std::string::npos &&
+           pending.find("\n\n") == std::string::npos &&
+           pending != "\r\n" && pending != "\n" && pending.size() < 8192) {
+        ssize_t n = read(client_fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        pending.append(buf, static_cast<size_t>(n));
+    }
+
+    // "GET <path> HTTP/1.x"
+    size_t path_end = request_line.find(' ', 4);
+    std::string path = request_line.substr(4, path_end == std::string::npos ? std::string::npos : path_end - 4);
+    std::string query;
+    size_t query_start = path.find('?');
+    if (query_start != std::string::npos) {
+        query = path.substr(query_start + 1);
+        path.resize(query_start);
+    }
+
+    HttpResponse reply;
+    auto route = http_routes_.find(path);
+    if (route != http_routes_.end()) {
+        reply = route->second(query);
+    } else {
+        reply.status = "404 Not Found";
+        reply.content_type = "text/plain; charset=utf-8";
+        reply.body = "not found\n";
+    }
+
+    LOG_DEBUG("CommandServer: HTTP GET {} -> {}", path, reply.status);
+
+    std::string response = "HTTP/1.0 " + reply.status + "\r\n"
+                           "Content-Type: " + reply.content_type + "\r\n"
+                           "Content-Length: " + std::to_string(reply.body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + reply.body;
+
+    send_all(client_fd, response);
+}
+
 } // namespace baichuan
@@ -5,12 +5,24 @@
 #include <thread>
 #include <atomic>
 #include <vector>
+#include <map>
 
 namespace baichuan {
 
 // Callback: receives raw JSON command string, returns response JSON string
 using CommandHandler = std::function<std::string(const std::string&)>;
 
+// Callback: returns the metrics page (OpenMetrics text) for GET /metrics
+using MetricsHandler = std::function<std::string()>;
+
+// HTTP GET route: receives the query string (after '?'), returns the reply
+struct HttpResponse {
+    std::string status = "200 OK";
+    std::string content_type;
+    std::string body;
+};
+using HttpHandler = std::function<HttpResponse(const std::string& query)>;
+
 class CommandServer {
 public:
     CommandServer(const std::string& unix_path = "", int tcp_port = 0);
@@ -19,6 +31,16 @@ public:
     // Set the handler called for each received command
     void set_handler(CommandHandler handler);
 
+    // Serve GET <path> on the same sockets (connections whose first line
+    // is an HTTP request are answered over HTTP/1.0 and closed)
+    void add_http_route(const std::string& path, HttpHandler handler);
+
+    // GET /metrics
+    void set_metrics_handler(MetricsHandler handler);
+
+    // Value of name in a query string ("camera=2&quality=80"), or ""
+    static std::string query_param(const std::string& query, const std::string& name);
+
     // Start listener thread(s)
     bool start();
 
@@ -39,9 +61,11 @@ private:
     std::atomic<bool> running_{false};
 
     CommandHandler handler_;
+    std::map<std::string, HttpHandler> http_routes_;
 
     void listener_loop();
     void handle_connection(int client_fd);
+    void handle_http(int client_fd, const std::string& request_line, std::string& pending);
     int create_unix_socket(const std::string& path);
     int create_tcp_socket(int port);
 };
@@ -1,20 +1,24 @@
-#include "client/connection.h"
-#include "client/auth.h"
-#include "client/stream.h"
+#include "worker/camera_worker.h"
 #include "video/decoder.h"
+#include "video/decode_gate.h"
+#include "video/decode_pool.h"
 #include "video/dashboard_display.h"
-#include "rtsp/rtsp_source.h"
-#include "mjpeg/mjpeg_source.h"
+#include "video/camera_snapshot.h"
 #include "control/command_server.h"
 #include "utils/logger.h"
 #include "utils/json_config.h"
+#include "utils/latency.h"
+#include "utils/metrics.h"
 
 #include <iostream>
+#include <cstdlib>
+#include <cmath>
 #include <string>
 #include <atomic>
 #include <memory>
 #include <vector>
 #include <thread>
+#include <algorithm>
 #include <csignal>
 #include <getopt.h>
 
@@ -36,6 +40,8 @@ void print_usage(const char* program) {
               << "  -c, --config <file>   JSON configuration file (required)\n"
               << "  -d, --debug           Enable debug logging\n"
               << "  -H, --hidden          Start with window hidden (headless mode)\n"
+              << "  --decoder <profile>   Default decoder profile: low-latency, throughput\n"
+              << "                        (default: low-latency; per camera: \"decoder\")\n"
               << "  --help                Show this help message\n"
               << "\n"
               << "Configuration file format (Baichuan camera):\n"
@@ -83,333 +89,272 @@ void print_usage(const char* program) {
               << "  " << program << " -c cameras.json\n";
 }
 
-// Per-camera context
-struct CameraContext {
-    size_t index;
-    CameraConfig config;
-    // Baichuan-specific
-    std::unique_ptr<Connection> connection;
-    std::unique_ptr<VideoStream> stream;
-    // RTSP-specific
-    std::unique_ptr<RtspSource> rtsp_source;
-    // MJPEG-specific
-    std::unique_ptr<MjpegSource> mjpeg_source;
-    // Shared
+// Dashboard camera: the shared camera context plus its pane's decoder
+struct DashboardCamera : CameraContext {
+    // Created on the first keyframe, dropped when the connection ends
     std::unique_ptr<VideoDecoder> decoder;
-    std::thread worker_thread;
-    std::atomic<bool> running{false};
-    std::atomic<bool> paused{false};   // When true, worker disconnects and waits
-};
-
-MaxEncryption string_to_encryption(const std::string& enc) {
-    if (enc == "none") return MaxEncryption::None;
-    if (enc == "bc") return MaxEncryption::BCEncrypt;
-    return MaxEncryption::Aes;
-}
+    std::unique_ptr<DecodeGate> decode_gate;
 
-// RTSP camera worker
-void rtsp_camera_worker(CameraContext* ctx, DashboardDisplay* display) {
-    LOG_INFO("Camera {} (RTSP: {}) starting...", ctx->index, ctx->config.name);
+    // FFmpeg threads per decoder; the pool already runs cameras in parallel
+    int decoder_threads = 1;
+    DecoderProfile decoder_profile = DecoderProfile::LowLatency;
 
-    display->set_status(ctx->index, "Connecting RTSP...");
+    // Decoder counters kept across decoder instances (for the metrics page)
+    VideoDecoder::Stats decoder_stats;
 
-    // Create RTSP source
-    ctx->rtsp_source = std::make_unique<RtspSource>();
-    ctx->rtsp_source->set_url(ctx->config.url);
-    ctx->rtsp_source->set_transport(ctx->config.transport);
-
-    if (!ctx->rtsp_source->connect()) {
-        LOG_ERROR("Camera {}: RTSP connection failed", ctx->index);
-        display->set_status(ctx->index, "RTSP failed");
-        return;
-    }
+    // Camera capture to decoded picture (Baichuan cameras with a wall clock)
+    LatencyStats latency;
 
-    display->set_status(ctx->index, "Starting stream...");
+    // Decode policy set by the "decode" command; while decode_auto is true
+    // the policy follows pane visibility instead
+    std::atomic<bool> decode_auto{true};
+    std::atomic<DecodePolicy> decode_policy{DecodePolicy::Full};
 
-    // Create decoder
-    ctx->decoder = std::make_unique<VideoDecoder>();
-
-    // Handle stream info
-    ctx->rtsp_source->on_info([ctx](int width, int height, int fps) {
-        LOG_INFO("Camera {} (RTSP): Stream {}x{} @ {} fps", ctx->index, width, height, fps);
-    });
+    // Set when the decode backlog was full; packets are dropped until the
+    // next keyframe so the decoder never sees a broken reference chain
+    std::atomic<bool> decode_resync{false};
+    std::atomic<uint64_t> packets_dropped{0};
+};
 
-    // Handle video frames
-    ctx->rtsp_source->on_frame([ctx, display](const uint8_t* data, size_t len, VideoCodec codec) {
-        if (!ctx->running.load()) return;
+// Decode policy currently in effect for a camera: the command override, or
+// full decode for a visible pane and none for a hidden one
+DecodePolicy effective_decode_policy(const DashboardCamera* ctx, const DashboardDisplay* display) {
+    if (!ctx->decode_auto.load()) {
+        return ctx->decode_policy.load();
+    }
+    return display->is_pane_visible(ctx->index) ? DecodePolicy::Full : DecodePolicy::Suspended;
+}
 
-        // Initialize decoder on first frame
-        if (!ctx->decoder->is_initialized()) {
-            if (!ctx->decoder->init(codec)) {
-                LOG_ERROR("Camera {}: Failed to initialize decoder", ctx->index);
-                return;
-            }
+// Decode one packet at pane size, subject to the decode policy
+// (runs on the camera's decode pool thread)
+void decode_packet(DashboardCamera* ctx, DashboardDisplay* display, const VideoPacket& packet) {
+    // Initialize decoder on first keyframe
+    if (!ctx->decoder) {
+        if (!packet.keyframe) return;
+        ctx->decoder = std::make_unique<VideoDecoder>();
+        ctx->decode_gate = std::make_unique<DecodeGate>(*ctx->decoder);
+        ctx->decoder->set_thread_count(ctx->decoder_threads);
+        ctx->decoder->set_profile(ctx->decoder_profile);
+        ctx->decoder->set_pipeline_stats(&ctx->pipeline);
+        ctx->decoder->set_stats(&ctx->decoder_stats);
+        if (!ctx->decoder->init(packet.codec)) {
+            LOG_ERROR("Camera {}: Failed to initialize decoder", ctx->index);
+            ctx->decode_gate.reset();
+            ctx->decoder.reset();
+            return;
         }
+    }
 
-        // Decode and display
-        ctx->decoder->decode(data, len, [ctx, display](const DecodedFrame& decoded) {
-            display->update_frame(ctx->index, decoded);
-        });
-    });
-
-    // Handle errors
-    ctx->rtsp_source->on_error([ctx, display](const std::string& error) {
-        LOG_ERROR("Camera {} (RTSP): Error: {}", ctx->index, error);
-        display->set_status(ctx->index, "Error: " + error);
-    });
+    // Decode and display, converting straight to the pane's size
+    int pane_width, pane_height;
+    display->get_target_size(ctx->index, pane_width, pane_height);
+    ctx->decoder->set_output_size(pane_width, pane_height);
+
+    // Hidden panes skip decoding; the gate keeps the GOP for resume
+    ctx->decode_gate->submit(packet.data, packet.keyframe,
+                             effective_decode_policy(ctx, display),
+                             [ctx, display](const DecodedFrame& decoded) {
+        if (decoded.pts != INT64_MIN) {
+            ctx->latency.record(wall_clock_us() - decoded.pts);
+        }
+        display->update_frame(ctx->index, decoded);
+    }, packet.capture_time_us);
+}
 
-    // Start streaming
-    ctx->running.store(true);
-    if (!ctx->rtsp_source->start()) {
-        LOG_ERROR("Camera {}: Failed to start RTSP stream", ctx->index);
-        display->set_status(ctx->index, "Stream failed");
-        ctx->running.store(false);
-        return;
+// Decoder profile from the camera's "decoder" setting, else the default
+DecoderProfile decoder_profile_for(const CameraConfig& config, DecoderProfile fallback) {
+    if (config.decoder.empty()) {
+        return fallback;
     }
-
-    // Wait until quit or pause requested
-    while (ctx->running.load() && !g_quit.load() && !ctx->paused.load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    DecoderProfile profile;
+    if (!parse_decoder_profile(config.decoder, profile)) {
+        LOG_WARN("Camera '{}': unknown decoder profile '{}', using {}",
+                 config.name, config.decoder, decoder_profile_to_string(fallback));
+        return fallback;
     }
-
-    // Cleanup
-    ctx->running.store(false);
-    ctx->rtsp_source->stop();
-    ctx->rtsp_source.reset();
-    ctx->decoder.reset();
-    LOG_INFO("Camera {} (RTSP): Stopped", ctx->index);
+    return profile;
 }
 
-// MJPEG camera worker
-void mjpeg_camera_worker(CameraContext* ctx, DashboardDisplay* display) {
-    LOG_INFO("Camera {} (MJPEG: {}) starting...", ctx->index, ctx->config.name);
-
-    display->set_status(ctx->index, "Connecting MJPEG...");
-
-    // Create MJPEG source
-    ctx->mjpeg_source = std::make_unique<MjpegSource>();
-    ctx->mjpeg_source->set_url(ctx->config.url);
+// FFmpeg threads for each decoder: split the cores between the cameras so
+// the pool's threads aren't each fanning out into a full set of their own
+int decoder_threads_for(size_t camera_count) {
+    size_t hw = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    return static_cast<int>(std::max<size_t>(hw / std::max<size_t>(camera_count, 1), 1));
+}
 
-    if (!ctx->mjpeg_source->connect()) {
-        LOG_ERROR("Camera {}: MJPEG connection failed", ctx->index);
-        display->set_status(ctx->index, "MJPEG failed");
-        return;
-    }
+// Route a camera's output to its pane
+void attach_to_display(DashboardCamera* ctx, DashboardDisplay* display, DecodePool* decode_pool) {
+    display->set_pipeline_stats(ctx->index, &ctx->pipeline);
 
-    display->set_status(ctx->index, "Starting stream...");
+    ctx->handlers.on_status = [ctx, display](const std::string& status) {
+        display->set_status(ctx->index, status);
+    };
 
-    // Handle stream info
-    ctx->mjpeg_source->on_info([ctx](int width, int height, int fps) {
-        (void)fps;
-        LOG_INFO("Camera {} (MJPEG): Stream {}x{}", ctx->index, width, height);
-    });
+    // Compressed video: hand to the decode pool (packets arrive on a shared
+    // I/O thread, which must not decode)
+    ctx->handlers.on_packet = [ctx, display, decode_pool](const VideoPacket& packet) {
+        if (ctx->decode_resync.load() && !packet.keyframe) {
+            ctx->packets_dropped++;
+            return;
+        }
+        auto submitted = std::chrono::steady_clock::now();
+        bool queued = decode_pool->submit(ctx->index, [ctx, display, packet, submitted]() {
+            ctx->pipeline.record(PipelineStage::DecodeQueue, std::chrono::steady_clock::now() - submitted);
+            decode_packet(ctx, display, packet);
+        });
+        if (!queued) {
+            ctx->packets_dropped++;
+        }
+        ctx->decode_resync.store(!queued);
+    };
 
-    // Handle decoded frames directly (MJPEG decodes internally)
-    ctx->mjpeg_source->on_frame([ctx, display](const DecodedFrame& decoded) {
-        if (!ctx->running.load()) return;
+    // MJPEG frames arrive decoded
+    ctx->handlers.on_mjpeg_frame = [ctx, display](const DecodedFrame& decoded) {
         display->update_frame(ctx->index, decoded);
-    });
 
-    // Handle errors
-    ctx->mjpeg_source->on_error([ctx, display](const std::string& error) {
-        LOG_ERROR("Camera {} (MJPEG): Error: {}", ctx->index, error);
-        display->set_status(ctx->index, "Error: " + error);
-    });
+        // Track the pane size for the next JPEG
+        int pane_width, pane_height;
+        display->get_target_size(ctx->index, pane_width, pane_height);
+        ctx->mjpeg_source->set_output_size(pane_width, pane_height);
+    };
 
-    // Start streaming
-    ctx->running.store(true);
-    if (!ctx->mjpeg_source->start()) {
-        LOG_ERROR("Camera {}: Failed to start MJPEG stream", ctx->index);
-        display->set_status(ctx->index, "Stream failed");
-        ctx->running.store(false);
-        return;
-    }
+    // JPEGs decode on the pool too, in the camera's lane
+    ctx->handlers.mjpeg_decode_executor = [ctx, decode_pool](std::function<void()> task) {
+        return decode_pool->submit(ctx->index, std::move(task));
+    };
 
-    // Wait until quit or pause requested
-    while (ctx->running.load() && !g_quit.load() && !ctx->paused.load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
+    ctx->handlers.on_mjpeg_poll = [ctx, display](MjpegSource& source) {
+        source.set_decode_policy(effective_decode_policy(ctx, display));
+    };
 
-    // Cleanup
-    ctx->running.store(false);
-    ctx->mjpeg_source->stop();
-    ctx->mjpeg_source.reset();
-    LOG_INFO("Camera {} (MJPEG): Stopped", ctx->index);
+    // Free the decoder between connections, once queued packets are done with it
+    ctx->handlers.on_stopped = [ctx, decode_pool]() {
+        decode_pool->drain(ctx->index);
+        ctx->decode_resync.store(false);
+        ctx->decode_gate.reset();
+        ctx->decoder.reset();
+    };
 }
 
-// Baichuan camera worker
-void baichuan_camera_worker(CameraContext* ctx, DashboardDisplay* display) {
-    LOG_INFO("Camera {} ({}) starting...", ctx->index, ctx->config.host);
-
-    display->set_status(ctx->index, "Connecting...");
-
-    // Create connection
-    ctx->connection = std::make_unique<Connection>();
-    if (!ctx->connection->connect(ctx->config.host, ctx->config.port)) {
-        LOG_ERROR("Camera {}: Failed to connect", ctx->index);
-        display->set_status(ctx->index, "Connection failed");
-        return;
+// Pane visibility changed: MJPEG cameras re-push the automatic decode policy
+void wake_cameras(const std::vector<std::unique_ptr<DashboardCamera>>& cameras) {
+    for (auto& ctx : cameras) {
+        ctx->wake();
     }
+}
 
-    display->set_status(ctx->index, "Authenticating...");
+// OpenMetrics page for GET /metrics: per-camera counters and gauges, then
+// the frame buffer pool. Everything read here is atomic or copied under a
+// short lock (decode lanes, buffer pool), so scraping never blocks the
+// receive or decode threads for long.
+std::string render_metrics(const std::vector<std::unique_ptr<DashboardCamera>>& cameras,
+                           DashboardDisplay& display, DecodePool& decode_pool) {
+    auto panes = display.get_pane_info();
+    OpenMetricsWriter writer;
+
+    auto labels = [](const DashboardCamera& ctx) {
+        return OpenMetricsWriter::Labels{{"camera", ctx.config.name},
+                                         {"index", std::to_string(ctx.index)}};
+    };
 
-    // Authenticate
-    Authenticator auth(*ctx->connection);
-    auto login_result = auth.login(ctx->config.username, ctx->config.password,
-                                   string_to_encryption(ctx->config.encryption));
-    if (!login_result.success) {
-        LOG_ERROR("Camera {}: Login failed: {}", ctx->index, login_result.error_message);
-        display->set_status(ctx->index, "Login failed");
-        return;
+    writer.family("baichuan_frames_received", "counter", "Video frames received from the camera");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_frames_received_total", labels(*ctx),
+                      ctx->metrics.received.frames_received.load() + ctx->metrics.mjpeg.frames_received.load());
     }
 
-    LOG_INFO("Camera {}: Login successful", ctx->index);
-    display->set_status(ctx->index, "Starting stream...");
-
-    // Create decoder
-    ctx->decoder = std::make_unique<VideoDecoder>();
-
-    // Configure stream
-    StreamConfig stream_config;
-    stream_config.channel_id = ctx->config.channel;
-
-    if (ctx->config.stream == "sub") {
-        stream_config.handle = STREAM_HANDLE_SUB;
-        stream_config.stream_type = "subStream";
-    } else if (ctx->config.stream == "extern") {
-        stream_config.handle = STREAM_HANDLE_EXTERN;
-        stream_config.stream_type = "externStream";
-    } else {
-        stream_config.handle = STREAM_HANDLE_MAIN;
-        stream_config.stream_type = "mainStream";
+    writer.family("baichuan_keyframes_received", "counter", "Keyframes received (Baichuan and RTSP)");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_keyframes_received_total", labels(*ctx), ctx->metrics.received.i_frames.load());
     }
 
-    // Create video stream
-    ctx->stream = std::make_unique<VideoStream>(*ctx->connection);
-
-    // Handle stream info
-    ctx->stream->on_stream_info([ctx](const BcMediaInfo& info) {
-        LOG_INFO("Camera {}: Stream {}x{} @ {} fps",
-                 ctx->index, info.video_width, info.video_height, info.fps);
-    });
-
-    // Handle video frames
-    ctx->stream->on_frame([ctx, display](const BcMediaFrame& frame) {
-        if (!ctx->running.load()) return;
-
-        const BcMediaIFrame* iframe = std::get_if<BcMediaIFrame>(&frame);
-        const BcMediaPFrame* pframe = std::get_if<BcMediaPFrame>(&frame);
-
-        if (!iframe && !pframe) return;
-
-        // Initialize decoder on first IFrame
-        if (iframe && !ctx->decoder->is_initialized()) {
-            if (!ctx->decoder->init(iframe->codec)) {
-                LOG_ERROR("Camera {}: Failed to initialize decoder", ctx->index);
-                return;
-            }
-        }
-
-        if (!ctx->decoder->is_initialized()) return;
-
-        // Decode and display
-        auto decode_callback = [ctx, display](const DecodedFrame& decoded) {
-            display->update_frame(ctx->index, decoded);
-        };
-
-        if (iframe) {
-            ctx->decoder->decode(*iframe, decode_callback);
-        } else if (pframe) {
-            ctx->decoder->decode(*pframe, decode_callback);
-        }
-    });
-
-    // Handle errors
-    ctx->stream->on_error([ctx, display](const std::string& error) {
-        LOG_ERROR("Camera {}: Stream error: {}", ctx->index, error);
-        display->set_status(ctx->index, "Error: " + error);
-    });
-
-    // Start stream
-    ctx->running.store(true);
-    if (!ctx->stream->start(stream_config)) {
-        LOG_ERROR("Camera {}: Failed to start stream", ctx->index);
-        display->set_status(ctx->index, "Stream failed");
-        ctx->running.store(false);
-        return;
+    writer.family("baichuan_received_bytes", "counter", "Compressed video bytes received");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_received_bytes_total", labels(*ctx),
+                      ctx->metrics.received.bytes_received.load() + ctx->metrics.mjpeg.bytes_received.load());
     }
 
-    // Wait until quit or pause requested
-    while (ctx->running.load() && !g_quit.load() && !ctx->paused.load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Rates are measured here, over the time since the previous read
+    std::vector<RateMeter::Rates> rates;
+    for (auto& ctx : cameras) {
+        rates.push_back(ctx->rates());
     }
 
-    // Cleanup
-    ctx->running.store(false);
-    ctx->stream->stop();
-    ctx->connection->disconnect();
-    ctx->stream.reset();
-    ctx->connection.reset();
-    ctx->decoder.reset();
-    LOG_INFO("Camera {}: Stopped", ctx->index);
-}
+    writer.family("baichuan_receive_fps", "gauge", "Frames received per second since the previous read");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_receive_fps", labels(*cameras[i]), rates[i].fps);
+    }
 
-// Run one connection cycle for the appropriate camera type
-void camera_worker_once(CameraContext* ctx, DashboardDisplay* display) {
-    if (ctx->config.type == CameraType::Rtsp) {
-        rtsp_camera_worker(ctx, display);
-    } else if (ctx->config.type == CameraType::Mjpeg) {
-        mjpeg_camera_worker(ctx, display);
-    } else {
-        baichuan_camera_worker(ctx, display);
+    writer.family("baichuan_receive_bitrate_bits_per_second", "gauge", "Received bitrate since the previous read");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_receive_bitrate_bits_per_second", labels(*cameras[i]), rates[i].bitrate);
     }
-}
 
-// Top-level camera worker with pause/resume support
-void camera_worker(CameraContext* ctx, DashboardDisplay* display) {
-    while (!g_quit.load()) {
-        // Wait while paused
-        if (ctx->paused.load()) {
-            display->set_status(ctx->index, "Disconnected");
-            while (ctx->paused.load() && !g_quit.load()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            }
-            if (g_quit.load()) break;
-        }
+    writer.family("baichuan_frames_decoded", "counter", "Pictures decoded");
+    for (auto& ctx : cameras) {
+        const MjpegSource::Stats& mjpeg = ctx->metrics.mjpeg;
+        // Skipped and failed frames were counted as received first
+        uint64_t not_decoded = mjpeg.frames_skipped.load() + mjpeg.decode_errors.load();
+        uint64_t mjpeg_decoded = mjpeg.frames_received.load() - not_decoded;
+        writer.sample("baichuan_frames_decoded_total", labels(*ctx),
+                      ctx->decoder_stats.frames_decoded.load() + mjpeg_decoded);
+    }
 
-        // Run one connection cycle
-        camera_worker_once(ctx, display);
+    writer.family("baichuan_decode_errors", "counter", "Packets or pictures the decoder rejected");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_decode_errors_total", labels(*ctx),
+                      ctx->decoder_stats.decode_errors.load() + ctx->metrics.mjpeg.decode_errors.load());
+    }
 
-        // If quitting, exit
-        if (g_quit.load()) break;
+    writer.family("baichuan_reconnects", "counter", "Connections that dropped and were retried");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_reconnects_total", labels(*ctx), ctx->metrics.reconnects.load());
+    }
 
-        // If paused, loop back to wait for unpause
-        if (ctx->paused.load()) continue;
+    writer.family("baichuan_decode_queue_depth", "gauge", "Packets queued or decoding in the decode pool");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_decode_queue_depth", labels(*ctx),
+                      static_cast<uint64_t>(decode_pool.lane_stats(ctx->index).pending));
+    }
 
-        // Stream dropped — reconnect after a delay
-        display->set_status(ctx->index, "Reconnecting...");
-        for (int i = 0; i < 50 && !g_quit.load() && !ctx->paused.load(); i++) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+    // decode_backlog: dropped until the next keyframe because the decode
+    // queue was full; display: overwritten before being painted;
+    // decode_policy: MJPEG frames not decoded for a hidden pane
+    writer.family("baichuan_frames_dropped", "counter", "Frames dropped, by reason");
+    for (auto& ctx : cameras) {
+        auto with_reason = [&](const char* reason) {
+            auto l = labels(*ctx);
+            l.emplace_back("reason", reason);
+            return l;
+        };
+        uint64_t display_dropped = ctx->index < panes.size() ? panes[ctx->index].frames_dropped : 0;
+        writer.sample("baichuan_frames_dropped_total", with_reason("decode_backlog"), ctx->packets_dropped.load());
+        writer.sample("baichuan_frames_dropped_total", with_reason("display"), display_dropped);
+        writer.sample("baichuan_frames_dropped_total", with_reason("decode_policy"), ctx->metrics.mjpeg.frames_skipped.load());
     }
+
+    write_buffer_pool_metrics(writer);
+    return writer.str();
 }
 
 int main(int argc, char* argv[]) {
     std::string config_file;
     bool debug = false;
     bool start_hidden = false;
+    DecoderProfile default_profile = DecoderProfile::LowLatency;
 
     // Parse command line arguments
     static struct option long_options[] = {
         {"config",  required_argument, nullptr, 'c'},
         {"debug",   no_argument,       nullptr, 'd'},
         {"hidden",  no_argument,       nullptr, 'H'},
+        {"decoder", required_argument, nullptr, 'D'},
         {"help",    no_argument,       nullptr, '?'},
         {nullptr,   0,                 nullptr, 0}
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "c:dH", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "c:dHD:", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'c':
                 config_file = optarg;
@@ -420,6 +365,13 @@ int main(int argc, char* argv[]) {
             case 'H':
                 start_hidden = true;
                 break;
+            case 'D':
+                if (!parse_decoder_profile(optarg, default_profile)) {
+                    std::cerr << "Unknown decoder profile: " << optarg << "\n";
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
             case '?':
             default:
                 print_usage(argv[0]);
@@ -477,73 +429,40 @@ int main(int argc, char* argv[]) {
         display.hide_window();
     }
 
-    // Create camera contexts and start workers
-    std::vector<std::unique_ptr<CameraContext>> cameras;
+    // Create camera contexts
+    std::vector<std::unique_ptr<DashboardCamera>> cameras;
+
+    // Decoding for every camera runs on one work-stealing pool (declared
+    // after the cameras, so it is stopped before they go away)
+    DecodePool decode_pool;
     for (size_t i = 0; i < config.cameras.size(); i++) {
-        auto ctx = std::make_unique<CameraContext>();
+        auto ctx = std::make_unique<DashboardCamera>();
         ctx->index = i;
         ctx->config = config.cameras[i];
+        ctx->decoder_threads = decoder_threads_for(config.cameras.size());
+        ctx->decoder_profile = decoder_profile_for(ctx->config, default_profile);
+        attach_to_display(ctx.get(), &display, &decode_pool);
         cameras.push_back(std::move(ctx));
     }
 
-    // Start camera worker threads
+    // Start the cameras (their lifecycles run on the I/O reactor)
     for (auto& ctx : cameras) {
-        ctx->worker_thread = std::thread(camera_worker, ctx.get(), &display);
+        ctx->start();
     }
 
     // Set up command server if control config is present
+    SnapshotService snapshots;
     std::unique_ptr<CommandServer> cmd_server;
     if (!config.control.unix_path.empty() || config.control.tcp_port > 0) {
         cmd_server = std::make_unique<CommandServer>(config.control.unix_path,
                                                       config.control.tcp_port);
 
-        // Helper: parse an int or array of ints from JSON value after a key
-        auto parse_indices = [](const std::string& json, const std::string& key) -> std::vector<size_t> {
-            std::vector<size_t> indices;
-            std::string search = "\"" + key + "\"";
-            size_t pos = json.find(search);
-            if (pos == std::string::npos) return indices;
-
-            size_t colon = json.find(':', pos);
-            if (colon == std::string::npos) return indices;
-
-            size_t val_start = colon + 1;
-            while (val_start < json.size() && json[val_start] == ' ') val_start++;
-
-            if (json[val_start] == '[') {
-                size_t arr_end = JsonConfigParser::find_matching_bracket_pub(json, val_start);
-                if (arr_end == std::string::npos) return indices;
-                std::string arr_str = json.substr(val_start + 1, arr_end - val_start - 1);
-                std::string num;
-                for (char c : arr_str) {
-                    if (c >= '0' && c <= '9') {
-                        num += c;
-                    } else if (c == ',' || c == ' ') {
-                        if (!num.empty()) {
-                            indices.push_back(static_cast<size_t>(std::stoi(num)));
-                            num.clear();
-                        }
-                    }
-                }
-                if (!num.empty()) {
-                    indices.push_back(static_cast<size_t>(std::stoi(num)));
-                }
-            } else if (json[val_start] >= '0' && json[val_start] <= '9') {
-                std::string num;
-                for (size_t i = val_start; i < json.size() && json[i] >= '0' && json[i] <= '9'; i++) {
-                    num += json[i];
-                }
-                indices.push_back(static_cast<size_t>(std::stoi(num)));
-            }
-            return indices;
-        };
-
-        cmd_server->set_handler([&display, &cameras, parse_indices](const std::string& cmd_json) -> std::string {
+        cmd_server->set_handler([&display, &cameras, &decode_pool, &snapshots, default_profile](const std::string& cmd_json) -> std::string {
             size_t pane_total = display.pane_count();
 
             // --- show: show specific panes, optionally disconnect hidden ones ---
             if (cmd_json.find("\"show\"") != std::string::npos) {
-                auto indices = parse_indices(cmd_json, "show");
+                auto indices = JsonConfigParser::get_indices(cmd_json, "show");
                 if (indices.empty()) return "{\"error\": \"invalid show value\"}";
 
                 for (size_t idx : indices) {
@@ -553,6 +472,7 @@ int main(int argc, char* argv[]) {
                 }
 
                 display.show_only(indices);
+                wake_cameras(cameras);
 
                 // If "disconnect": true, pause hidden cameras and unpause shown ones
                 bool disconnect = JsonConfigParser::get_bool(cmd_json, "disconnect");
@@ -563,9 +483,9 @@ int main(int argc, char* argv[]) {
                             if (ctx->index == idx) { is_shown = true; break; }
                         }
                         if (is_shown) {
-                            ctx->paused.store(false);
+                            ctx->set_paused(false);
                         } else {
-                            ctx->paused.store(true);
+                            ctx->set_paused(true);
                         }
                     }
                 }
@@ -576,21 +496,22 @@ int main(int argc, char* argv[]) {
             // --- show_all: show all panes, reconnect any disconnected ---
             if (cmd_json.find("\"show_all\"") != std::string::npos) {
                 display.show_all_panes();
+                wake_cameras(cameras);
                 // Unpause all cameras so they reconnect
                 for (auto& ctx : cameras) {
-                    ctx->paused.store(false);
+                    ctx->set_paused(false);
                 }
                 return "{\"ok\": true}";
             }
 
             // --- disconnect: pause specific cameras (panes stay visible) ---
             if (cmd_json.find("\"disconnect\"") != std::string::npos) {
-                auto indices = parse_indices(cmd_json, "disconnect");
+                auto indices = JsonConfigParser::get_indices(cmd_json, "disconnect");
                 if (indices.empty()) {
                     // disconnect all if value is true
                     if (JsonConfigParser::get_bool(cmd_json, "disconnect")) {
                         for (auto& ctx : cameras) {
-                            ctx->paused.store(true);
+                            ctx->set_paused(true);
                         }
                         return "{\"ok\": true}";
                     }
@@ -604,7 +525,7 @@ int main(int argc, char* argv[]) {
                 for (auto& ctx : cameras) {
                     for (size_t idx : indices) {
                         if (ctx->index == idx) {
-                            ctx->paused.store(true);
+                            ctx->set_paused(true);
                             display.set_status(ctx->index, "Disconnected");
                             break;
                         }
@@ -615,12 +536,12 @@ int main(int argc, char* argv[]) {
 
             // --- connect: resume specific cameras ---
             if (cmd_json.find("\"connect\"") != std::string::npos) {
-                auto indices = parse_indices(cmd_json, "connect");
+                auto indices = JsonConfigParser::get_indices(cmd_json, "connect");
                 if (indices.empty()) {
                     // connect all if value is true
                     if (JsonConfigParser::get_bool(cmd_json, "connect")) {
                         for (auto& ctx : cameras) {
-                            ctx->paused.store(false);
+                            ctx->set_paused(false);
                         }
                         return "{\"ok\": true}";
                     }
@@ -634,7 +555,7 @@ int main(int argc, char* argv[]) {
                 for (auto& ctx : cameras) {
                     for (size_t idx : indices) {
                         if (ctx->index == idx) {
-                            ctx->paused.store(false);
+                            ctx->set_paused(false);
                             break;
                         }
                     }
@@ -642,15 +563,46 @@ int main(int argc, char* argv[]) {
                 return "{\"ok\": true}";
             }
 
+            // --- decode: set the decode policy ("full", "keyframes", "off" or
+            //     "auto" to follow pane visibility) for "cameras" or all ---
+            if (cmd_json.find("\"decode\"") != std::string::npos) {
+                std::string value = JsonConfigParser::get_string(cmd_json, "decode", "");
+                DecodePolicy policy = DecodePolicy::Full;
+                bool automatic = (value == "auto");
+                if (!automatic && !parse_decode_policy(value, policy)) {
+                    return "{\"error\": \"invalid decode value\"}";
+                }
+
+                auto indices = JsonConfigParser::get_indices(cmd_json, "cameras");
+                for (size_t idx : indices) {
+                    if (idx >= pane_total) {
+                        return "{\"error\": \"index " + std::to_string(idx) + " out of range\"}";
+                    }
+                }
+                for (auto& ctx : cameras) {
+                    bool selected = indices.empty();
+                    for (size_t idx : indices) {
+                        if (ctx->index == idx) { selected = true; break; }
+                    }
+                    if (!selected) continue;
+                    ctx->decode_policy.store(policy);
+                    ctx->decode_auto.store(automatic);
+                    ctx->wake();  // MJPEG cameras push it to their source
+                }
+                return "{\"ok\": true}";
+            }
+
             // --- hide_ui: hide the window ---
             if (cmd_json.find("\"hide_ui\"") != std::string::npos) {
                 display.hide_window();
+                wake_cameras(cameras);
                 return "{\"ok\": true}";
             }
 
             // --- show_ui: show the window ---
             if (cmd_json.find("\"show_ui\"") != std::string::npos) {
                 display.show_window();
+                wake_cameras(cameras);
                 return "{\"ok\": true}";
             }
 
@@ -685,17 +637,71 @@ int main(int argc, char* argv[]) {
                 bool replace = JsonConfigParser::get_bool(cam_json, "replace");
                 size_t new_index = display.add_pane(cam_config, replace);
 
-                auto ctx = std::make_unique<CameraContext>();
+                auto ctx = std::make_unique<DashboardCamera>();
                 ctx->index = new_index;
                 ctx->config = cam_config;
+                ctx->decoder_threads = decoder_threads_for(cameras.size() + 1);
+                ctx->decoder_profile = decoder_profile_for(cam_config, default_profile);
+                attach_to_display(ctx.get(), &display, &decode_pool);
 
-                CameraContext* ctx_ptr = ctx.get();
-                ctx->worker_thread = std::thread(camera_worker, ctx_ptr, &display);
+                ctx->start();
                 cameras.push_back(std::move(ctx));
 
                 return "{\"ok\": true, \"index\": " + std::to_string(new_index) + "}";
             }
 
+            // --- stats: per-stage timings (p50/p99/max), optionally reset ---
+            if (cmd_json.find("\"stats\"") != std::string::npos) {
+                std::string result = "{\"ok\": true, \"cameras\": [";
+                for (size_t i = 0; i < cameras.size(); i++) {
+                    auto& ctx = cameras[i];
+                    if (i > 0) result += ", ";
+                    result += "{\"index\": " + std::to_string(ctx->index) +
+                              ", \"name\": \"" + ctx->config.name + "\"" +
+                              ", \"stages\": " + ctx->pipeline.to_json() + "}";
+                }
+
+                // Socket reads and decryption are per connection (shared by
+                // the cameras on one host)
+                result += "], \"connections\": [";
+                auto connections = BaichuanSession::connection_stats();
+                for (size_t i = 0; i < connections.size(); i++) {
+                    if (i > 0) result += ", ";
+                    result += "{\"name\": \"" + connections[i].name + "\"" +
+                              ", \"stages\": " + connections[i].stats->to_json() + "}";
+                }
+                result += "], \"buffer_pool\": " + BufferPool::instance().stats().to_json() + "}";
+
+                if (JsonConfigParser::get_bool(cmd_json, "reset")) {
+                    for (auto& ctx : cameras) {
+                        ctx->pipeline.reset();
+                    }
+                    for (auto& connection : connections) {
+                        connection.stats->reset();
+                    }
+                }
+                return result;
+            }
+
+            // --- snapshot: JPEG of a camera's latest keyframe, returned as
+            //     base64 or written to "path" ---
+            if (cmd_json.find("\"snapshot\"") != std::string::npos) {
+                auto indices = JsonConfigParser::get_indices(cmd_json, "snapshot");
+                if (indices.size() != 1) return "{\"error\": \"invalid snapshot value\"}";
+
+                for (auto& ctx : cameras) {
+                    if (ctx->index != indices[0]) continue;
+                    auto options = SnapshotOptions::from(JsonConfigParser::get_int(cmd_json, "quality"),
+                                                         JsonConfigParser::get_int(cmd_json, "width"),
+                                                         JsonConfigParser::get_int(cmd_json, "height"));
+                    std::string native = JsonConfigParser::get_bool(cmd_json, "native")
+                        ? "main" : JsonConfigParser::get_string(cmd_json, "native", "");
+                    auto shot = take_camera_snapshot(ctx.get(), snapshots, options, native);
+                    return shot->to_json(JsonConfigParser::get_string(cmd_json, "path", ""));
+                }
+                return "{\"error\": \"index " + std::to_string(indices[0]) + " out of range\"}";
+            }
+
             // --- list: return feed info ---
             if (cmd_json.find("\"list\"") != std::string::npos) {
                 // Build connected flags from camera contexts
@@ -709,18 +715,72 @@ int main(int argc, char* argv[]) {
                 std::string result = "{\"ok\": true, \"feeds\": [";
                 for (size_t i = 0; i < panes.size(); i++) {
                     if (i > 0) result += ", ";
+                    std::string decode = "full";
+                    std::string state = camera_state_to_string(CameraState::Stopped);
+                    uint64_t backlog_dropped = 0;
+                    DecodePool::LaneStats queue;
+                    std::string profile = decoder_profile_to_string(default_profile);
+                    LatencyStats::Summary latency;
+                    RateMeter::Rates rates;
+                    for (auto& ctx : cameras) {
+                        if (ctx->index == i) {
+                            backlog_dropped = ctx->packets_dropped.load();
+                            rates = ctx->rates();
+                            state = camera_state_to_string(ctx->state.load());
+                            queue = decode_pool.lane_stats(ctx->index);
+                            profile = decoder_profile_to_string(ctx->decoder_profile);
+                            latency = ctx->latency.summary();
+                            decode = ctx->decode_auto.load()
+                                ? std::string("auto (") + decode_policy_to_string(effective_decode_policy(ctx.get(), &display)) + ")"
+                                : decode_policy_to_string(ctx->decode_policy.load());
+                            break;
+                        }
+                    }
                     result += "{\"index\": " + std::to_string(i) +
                               ", \"name\": \"" + panes[i].name + "\"" +
                               ", \"visible\": " + (panes[i].visible ? "true" : "false") +
-                              ", \"connected\": " + (panes[i].connected ? "true" : "false") + "}";
+                              ", \"connected\": " + (panes[i].connected ? "true" : "false") +
+                              ", \"state\": \"" + state + "\"" +
+                              ", \"decode\": \"" + decode + "\"" +
+                              ", \"decoder\": \"" + profile + "\"" +
+                              ", \"fps\": " + std::to_string(std::lround(rates.fps)) +
+                              ", \"kbps\": " + std::to_string(std::lround(rates.bitrate / 1000)) +
+                              ", \"frames\": {\"published\": " + std::to_string(panes[i].frames_published) +
+                              ", \"displayed\": " + std::to_string(panes[i].frames_displayed) +
+                              ", \"dropped\": " + std::to_string(panes[i].frames_dropped) +
+                              ", \"decode_backlog_dropped\": " + std::to_string(backlog_dropped) + "}" +
+                              ", \"decode_queue\": {\"pending\": " + std::to_string(queue.pending) +
+                              ", \"decoded\": " + std::to_string(queue.tasks_run) +
+                              ", \"wait_avg_ms\": " + std::to_string(queue.tasks_run > 0 ? queue.wait_us_total / queue.tasks_run / 1000 : 0) +
+                              ", \"wait_max_ms\": " + std::to_string(queue.wait_us_max / 1000) +
+                              ", \"busy_ms\": " + std::to_string(queue.busy_us / 1000) + "}" +
+                              ", \"latency_ms\": {\"samples\": " + std::to_string(latency.count) +
+                              ", \"last\": " + std::to_string(latency.last_us / 1000) +
+                              ", \"avg\": " + std::to_string(latency.avg_us / 1000) +
+                              ", \"min\": " + std::to_string(latency.min_us / 1000) +
+                              ", \"max\": " + std::to_string(latency.max_us / 1000) + "}}";
                 }
-                result += "]}";
+                auto pool = decode_pool.stats();
+                result += "], \"decode_pool\": {\"threads\": " + std::to_string(decode_pool.thread_count()) +
+                          ", \"tasks\": " + std::to_string(pool.tasks_run) +
+                          ", \"rejected\": " + std::to_string(pool.rejected) +
+                          ", \"steals\": " + std::to_string(pool.steals) + "}}";
                 return result;
             }
 
             return "{\"error\": \"unknown command\"}";
         });
 
+        // Prometheus / OpenMetrics scrapes (GET /metrics, usually on the TCP port)
+        cmd_server->set_metrics_handler([&display, &cameras, &decode_pool]() {
+            return render_metrics(cameras, display, decode_pool);
+        });
+
+        // GET /snapshot?camera=N[&quality=Q&width=W&height=H] -> image/jpeg
+        cmd_server->add_http_route("/snapshot", [&cameras, &snapshots](const std::string& query) {
+            return snapshot_response(cameras, snapshots, query);
+        });
+
         if (!cmd_server->start()) {
             LOG_ERROR("Failed to start command server");
         } else {
@@ -728,12 +788,10 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // Handle quit
-    display.on_quit([&cameras, &cmd_server]() {
+    // Handle quit (the cameras are stopped once the main loop has returned:
+    // stopping one waits for its teardown, which may need the display)
+    display.on_quit([&cmd_server]() {
         g_quit.store(true);
-        for (auto& ctx : cameras) {
-            ctx->running.store(false);
-        }
         if (cmd_server) cmd_server->stop();
     });
 
@@ -745,17 +803,10 @@ int main(int argc, char* argv[]) {
         cmd_server->stop();
     }
 
-    // Signal all cameras to stop
+    // Stop all cameras (each returns once its teardown is done)
     g_quit.store(true);
     for (auto& ctx : cameras) {
-        ctx->running.store(false);
-    }
-
-    // Wait for all threads to finish
-    for (auto& ctx : cameras) {
-        if (ctx->worker_thread.joinable()) {
-            ctx->worker_thread.join();
-        }
+        ctx->stop();
     }
 
     LOG_INFO("Dashboard shutdown complete");
@@ -1,14 +1,18 @@
 #include "client/connection.h"
 #include "client/auth.h"
 #include "client/stream.h"
+#include "client/snap.h"
 #include "video/decoder.h"
 #include "video/display.h"
 #include "video/writer.h"
 #include "rtsp/rtsp_source.h"
 #include "mjpeg/mjpeg_source.h"
 #include "utils/logger.h"
+#include "utils/buffer_pool.h"
+#include "utils/latency.h"
 
 #include <iostream>
+#include <cstdio>
 #include <string>
 #include <atomic>
 #include <memory>
@@ -56,19 +60,26 @@ void print_usage(const char* program) {
               << "\n"
               << "Common Options:\n"
               << "  -i, --img <file>      Capture single snapshot to JPEG file and exit\n"
-              << "  -v, --video <file>    Record video to file (mp4/mpg/avi)\n"
+              << "  --snap <file>         Baichuan: fetch a JPEG encoded by the camera and exit\n"
+              << "                        (no decoding; -s main or sub picks the resolution)\n"
+              << "  -v, --video <file>    Record video to file (mp4/mkv; stream copy, no decoding)\n"
+              << "  --transcode           With --video: decode and re-encode instead of stream copy\n"
               << "  -t, --time <seconds>  Recording duration in seconds (default: 10, 0=until Ctrl+C)\n"
+              << "  --decoder <profile>   Decoder profile: low-latency, throughput\n"
+              << "                        (default: throughput with --transcode, else low-latency)\n"
               << "  -d, --debug           Enable debug logging\n"
               << "  --help                Show this help message\n"
               << "\n"
               << "Modes:\n"
               << "  Default:  Display live video in GTK window\n"
               << "  --img:    Capture one frame, save as JPEG, exit\n"
+              << "  --snap:   Ask the camera for a JPEG, save it, exit\n"
               << "  --video:  Record video for specified duration\n"
               << "\n"
               << "Baichuan Examples:\n"
               << "  " << program << " -h 10.0.1.29 -u admin -P mypassword\n"
               << "  " << program << " -h 10.0.1.29 -P mypassword --img snapshot.jpg\n"
+              << "  " << program << " -h 10.0.1.29 -P mypassword --snap thumb.jpg -s sub\n"
               << "  " << program << " -h 10.0.1.29 -P mypassword --video recording.mp4 -t 30\n"
               << "\n"
               << "RTSP Examples:\n"
@@ -84,6 +95,7 @@ void print_usage(const char* program) {
 enum class CaptureMode {
     Display,    // Live display in GTK window
     Image,      // Single snapshot to JPEG
+    CameraSnap, // JPEG encoded by the camera (MSG_ID_SNAP)
     Video       // Record video to file
 };
 
@@ -107,8 +119,11 @@ int main(int argc, char* argv[]) {
     // Capture options
     CaptureMode mode = CaptureMode::Display;
     std::string image_file;
+    std::string snap_file;
     std::string video_file;
     int record_seconds = 10;
+    bool transcode = false;
+    std::string decoder_profile;
 
     // Parse command line arguments
     static struct option long_options[] = {
@@ -123,15 +138,18 @@ int main(int argc, char* argv[]) {
         {"transport",  required_argument, nullptr, 'T'},
         {"mjpeg",      required_argument, nullptr, 'm'},
         {"img",        required_argument, nullptr, 'i'},
+        {"snap",       required_argument, nullptr, 'S'},
         {"video",      required_argument, nullptr, 'v'},
         {"time",       required_argument, nullptr, 't'},
+        {"transcode",  no_argument,       nullptr, 'X'},
+        {"decoder",    required_argument, nullptr, 'D'},
         {"debug",      no_argument,       nullptr, 'd'},
         {"help",       no_argument,       nullptr, '?'},
         {nullptr,      0,                 nullptr, 0}
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "h:p:u:P:c:s:e:r:T:m:i:v:t:d", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "h:p:u:P:c:s:e:r:T:m:i:S:v:t:XD:d", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'h':
                 host = optarg;
@@ -169,6 +187,10 @@ int main(int argc, char* argv[]) {
                 image_file = optarg;
                 mode = CaptureMode::Image;
                 break;
+            case 'S':
+                snap_file = optarg;
+                mode = CaptureMode::CameraSnap;
+                break;
             case 'v':
                 video_file = optarg;
                 mode = CaptureMode::Video;
@@ -176,6 +198,12 @@ int main(int argc, char* argv[]) {
             case 't':
                 record_seconds = std::stoi(optarg);
                 break;
+            case 'X':
+                transcode = true;
+                break;
+            case 'D':
+                decoder_profile = optarg;
+                break;
             case 'd':
                 debug = true;
                 break;
@@ -203,6 +231,11 @@ int main(int argc, char* argv[]) {
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
 
+    if (mode == CaptureMode::CameraSnap && source_type != SourceType::Baichuan) {
+        std::cerr << "--snap needs a Baichuan camera (use --img for RTSP/MJPEG)\n";
+        return 1;
+    }
+
     // Convert encryption string to enum (Baichuan only)
     MaxEncryption max_encryption = MaxEncryption::Aes;
     if (source_type == SourceType::Baichuan) {
@@ -221,7 +254,8 @@ int main(int argc, char* argv[]) {
 
     LOG_INFO("Baichuan Camera Client");
     const char* mode_str = (mode == CaptureMode::Display) ? "display" :
-                           (mode == CaptureMode::Image) ? "snapshot" : "recording";
+                           (mode == CaptureMode::Image) ? "snapshot" :
+                           (mode == CaptureMode::CameraSnap) ? "camera snapshot" : "recording";
     LOG_INFO("Mode: {}", mode_str);
 
     // Get display name based on source type
@@ -282,6 +316,9 @@ int main(int argc, char* argv[]) {
     } else if (mode == CaptureMode::Video) {
         // Video writer will be initialized on first frame (we need dimensions)
         video_writer = std::make_unique<VideoWriter>();
+        if (source_type == SourceType::Mjpeg && !transcode) {
+            LOG_INFO("MJPEG source delivers decoded frames only, recording will transcode");
+        }
         if (record_seconds > 0) {
             LOG_INFO("Recording {} seconds of video to: {}", record_seconds, video_file);
         } else {
@@ -289,10 +326,61 @@ int main(int argc, char* argv[]) {
         }
     } else if (mode == CaptureMode::Image) {
         LOG_INFO("Capturing snapshot to: {}", image_file);
+    } else if (mode == CaptureMode::CameraSnap) {
+        LOG_INFO("Fetching camera snapshot to: {}", snap_file);
     }
 
-    // Create video decoder (shared between both protocols)
+    // Recording without a display muxes the compressed stream directly, so
+    // the decoder never runs (MJPEG frames arrive decoded, so it transcodes)
+    bool passthrough = (mode == CaptureMode::Video && !transcode &&
+                        source_type != SourceType::Mjpeg);
+
+    // Create video decoder (shared between both protocols); transcoding
+    // favours throughput, live viewing latency
     VideoDecoder decoder;
+    DecoderProfile profile = (mode == CaptureMode::Video) ? DecoderProfile::Throughput
+                                                          : DecoderProfile::LowLatency;
+    if (!decoder_profile.empty() && !parse_decoder_profile(decoder_profile, profile)) {
+        std::cerr << "Unknown decoder profile: " << decoder_profile << "\n";
+        print_usage(argv[0]);
+        return 1;
+    }
+    decoder.set_profile(profile);
+
+    // Camera capture to decoded picture (Baichuan only: frames carry the
+    // camera's wall clock)
+    LatencyStats latency;
+
+    // Stop recording once the requested duration has passed
+    auto check_record_time = [&]() {
+        if (record_seconds > 0) {
+            auto elapsed = std::chrono::steady_clock::now() - start_time;
+            auto elapsed_sec = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
+            if (elapsed_sec >= record_seconds) {
+                LOG_INFO("Recording time reached ({} seconds)", record_seconds);
+                capture_done.store(true);
+            }
+        }
+    };
+
+    // Stream-copy recording of a compressed access unit
+    auto write_passthrough = [&](const uint8_t* data, size_t len, VideoCodec codec,
+                                 bool keyframe, int64_t timestamp_us) {
+        if (g_quit.load() || capture_done.load()) {
+            return;
+        }
+
+        if (!video_writer->is_open() && !video_writer->open_passthrough(video_file, codec)) {
+            LOG_ERROR("Failed to open video file: {}", video_file);
+            capture_done.store(true);
+            return;
+        }
+
+        video_writer->write_packet(data, len, keyframe, timestamp_us);
+        if (video_writer->frames_written() > 0) {
+            check_record_time();
+        }
+    };
 
     // Shared decode callback for processed frames
     auto decoded_frame_callback = [&](const DecodedFrame& decoded) {
@@ -300,6 +388,10 @@ int main(int argc, char* argv[]) {
             return;
         }
 
+        if (decoded.pts != INT64_MIN) {
+            latency.record(wall_clock_us() - decoded.pts);
+        }
+
         switch (mode) {
             case CaptureMode::Display:
                 if (display) {
@@ -332,16 +424,13 @@ int main(int argc, char* argv[]) {
                     video_writer->write_frame(decoded);
 
                     // Check if recording time elapsed
-                    if (record_seconds > 0) {
-                        auto elapsed = std::chrono::steady_clock::now() - start_time;
-                        auto elapsed_sec = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
-                        if (elapsed_sec >= record_seconds) {
-                            LOG_INFO("Recording time reached ({} seconds)", record_seconds);
-                            capture_done.store(true);
-                        }
-                    }
+                    check_record_time();
                 }
                 break;
+
+            case CaptureMode::CameraSnap:
+                // Fetched before any stream starts
+                break;
         }
     };
 
@@ -374,22 +463,26 @@ int main(int argc, char* argv[]) {
         });
 
         // Handle video frames
-        rtsp_source.on_frame([&](const uint8_t* data, size_t len, VideoCodec codec) {
-            if (g_quit.load() || capture_done.load()) {
-                return;
-            }
-
-            // Initialize decoder on first frame
-            if (!decoder.is_initialized()) {
-                if (!decoder.init(codec)) {
-                    LOG_ERROR("Failed to initialize decoder");
+        if (passthrough) {
+            rtsp_source.on_packet(write_passthrough);
+        } else {
+            rtsp_source.on_frame([&](const uint8_t* data, size_t len, VideoCodec codec) {
+                if (g_quit.load() || capture_done.load()) {
                     return;
                 }
-            }
 
-            // Decode frame
-            decoder.decode(data, len, decoded_frame_callback);
-        });
+                // Initialize decoder on first frame
+                if (!decoder.is_initialized()) {
+                    if (!decoder.init(codec)) {
+                        LOG_ERROR("Failed to initialize decoder");
+                        return;
+                    }
+                }
+
+                // Decode frame
+                decoder.decode(data, len, decoded_frame_callback);
+            });
+        }
 
         // Handle errors
         rtsp_source.on_error([](const std::string& error) {
@@ -427,10 +520,10 @@ int main(int argc, char* argv[]) {
         }
 
         // Print RTSP statistics
-        auto decoder_stats = decoder.stats();
+        const auto& decoder_stats = decoder.stats();
         LOG_INFO("RTSP statistics:");
-        LOG_INFO("  Frames decoded: {}", decoder_stats.frames_decoded);
-        LOG_INFO("  Decode errors: {}", decoder_stats.decode_errors);
+        LOG_INFO("  Frames decoded: {}", decoder_stats.frames_decoded.load());
+        LOG_INFO("  Decode errors: {}", decoder_stats.decode_errors.load());
 
         if (video_writer) {
             LOG_INFO("  Video frames written: {}", video_writer->frames_written());
@@ -497,17 +590,12 @@ int main(int argc, char* argv[]) {
 
                     if (video_writer && video_writer->is_open()) {
                         video_writer->write_frame(decoded);
-
-                        if (record_seconds > 0) {
-                            auto elapsed = std::chrono::steady_clock::now() - start_time;
-                            auto elapsed_sec = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
-                            if (elapsed_sec >= record_seconds) {
-                                LOG_INFO("Recording time reached ({} seconds)", record_seconds);
-                                capture_done.store(true);
-                            }
-                        }
+                        check_record_time();
                     }
                     break;
+
+                case CaptureMode::CameraSnap:
+                    break;
             }
         });
 
@@ -547,11 +635,11 @@ int main(int argc, char* argv[]) {
         }
 
         // Print MJPEG statistics
-        auto mjpeg_stats = mjpeg_source.stats();
+        const auto& mjpeg_stats = mjpeg_source.stats();
         LOG_INFO("MJPEG statistics:");
-        LOG_INFO("  Frames received: {}", mjpeg_stats.frames_received);
-        LOG_INFO("  Bytes received: {}", mjpeg_stats.bytes_received);
-        LOG_INFO("  Decode errors: {}", mjpeg_stats.decode_errors);
+        LOG_INFO("  Frames received: {}", mjpeg_stats.frames_received.load());
+        LOG_INFO("  Bytes received: {}", mjpeg_stats.bytes_received.load());
+        LOG_INFO("  Decode errors: {}", mjpeg_stats.decode_errors.load());
 
         if (video_writer) {
             LOG_INFO("  Video frames written: {}", video_writer->frames_written());
@@ -590,6 +678,30 @@ int main(int argc, char* argv[]) {
 
         LOG_INFO("Login successful, encryption type: {}", static_cast<int>(login_result.encryption_type));
 
+        // The camera encodes the picture: no stream, no decoder
+        if (mode == CaptureMode::CameraSnap) {
+            SnapConfig snap_config;
+            snap_config.channel_id = channel_id;
+            snap_config.stream_type = (stream_type == "sub") ? "sub" : "main";
+
+            SnapClient snap(conn);
+            SnapResult result = snap.fetch(snap_config);
+            if (!result.ok) {
+                LOG_ERROR("Camera snapshot failed: {}", result.error);
+                return 1;
+            }
+
+            FILE* f = fopen(snap_file.c_str(), "wb");
+            if (!f) {
+                LOG_ERROR("Failed to open output file: {}", snap_file);
+                return 1;
+            }
+            fwrite(result.jpeg.data(), 1, result.jpeg.size(), f);
+            fclose(f);
+            LOG_INFO("Camera snapshot saved: {} bytes", result.jpeg.size());
+            return 0;
+        }
+
         // Update status before starting stream
         if (display) {
             display->set_status("Logged in as " + username + "\nStarting video stream...");
@@ -623,6 +735,7 @@ int main(int argc, char* argv[]) {
         });
 
         // Handle video frames
+        CaptureClock capture_clock;
         stream.on_frame([&](const BcMediaFrame& frame) {
             if (g_quit.load() || capture_done.load()) {
                 return;
@@ -635,6 +748,15 @@ int main(int argc, char* argv[]) {
                 return;
             }
 
+            // Stream copy: no decoding
+            if (passthrough) {
+                const FrameBuffer& data = iframe ? iframe->data : pframe->data;
+                write_passthrough(data.data(), data.size(),
+                                  iframe ? iframe->codec : pframe->codec, iframe != nullptr,
+                                  iframe ? iframe->microseconds : pframe->microseconds);
+                return;
+            }
+
             // Initialize decoder on first IFrame
             if (iframe && !decoder.is_initialized()) {
                 if (!decoder.init(iframe->codec)) {
@@ -647,10 +769,16 @@ int main(int argc, char* argv[]) {
                 return;
             }
 
+            // Capture time rides through the decoder as the pts
             if (iframe) {
-                decoder.decode(*iframe, decoded_frame_callback);
+                if (iframe->posix_time) {
+                    capture_clock.on_keyframe(*iframe->posix_time, iframe->microseconds);
+                }
+                decoder.decode(iframe->data.data(), iframe->data.size(), decoded_frame_callback,
+                               capture_clock.to_wall_us(iframe->microseconds));
             } else if (pframe) {
-                decoder.decode(*pframe, decoded_frame_callback);
+                decoder.decode(pframe->data.data(), pframe->data.size(), decoded_frame_callback,
+                               capture_clock.to_wall_us(pframe->microseconds));
             }
         });
 
@@ -692,15 +820,26 @@ int main(int argc, char* argv[]) {
         conn.disconnect();
 
         // Print Baichuan statistics
-        auto stats = stream.stats();
-        auto decoder_stats = decoder.stats();
+        const auto& stats = stream.stats();
+        const auto& decoder_stats = decoder.stats();
         LOG_INFO("Stream statistics:");
-        LOG_INFO("  Frames received: {}", stats.frames_received);
-        LOG_INFO("  Bytes received: {}", stats.bytes_received);
-        LOG_INFO("  I-Frames: {}", stats.i_frames);
-        LOG_INFO("  P-Frames: {}", stats.p_frames);
-        LOG_INFO("  Frames decoded: {}", decoder_stats.frames_decoded);
-        LOG_INFO("  Decode errors: {}", decoder_stats.decode_errors);
+        LOG_INFO("  Frames received: {}", stats.frames_received.load());
+        LOG_INFO("  Bytes received: {}", stats.bytes_received.load());
+        LOG_INFO("  I-Frames: {}", stats.i_frames.load());
+        LOG_INFO("  P-Frames: {}", stats.p_frames.load());
+        LOG_INFO("  Frames decoded: {}", decoder_stats.frames_decoded.load());
+        LOG_INFO("  Decode errors: {}", decoder_stats.decode_errors.load());
+
+        auto latency_stats = latency.summary();
+        if (latency_stats.count > 0) {
+            LOG_INFO("  Capture to decode latency ({}): avg {} ms, min {} ms, max {} ms ({} frames)",
+                     decoder_profile_to_string(profile), latency_stats.avg_us / 1000,
+                     latency_stats.min_us / 1000, latency_stats.max_us / 1000, latency_stats.count);
+        }
+
+        auto pool_stats = BufferPool::instance().stats();
+        LOG_INFO("  Frame buffer pool: {} hits, {} misses, peak {} KB resident",
+                 pool_stats.hits, pool_stats.misses, pool_stats.peak_resident_bytes / 1024);
 
         if (video_writer) {
             LOG_INFO("  Video frames written: {}", video_writer->frames_written());
@@ -1,4 +1,5 @@
 #include "mjpeg/mjpeg_source.h"
+#include "utils/io_reactor.h"
 #include "utils/logger.h"
 
 #include <sys/socket.h>
@@ -8,6 +9,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <sstream>
@@ -16,6 +19,24 @@
 
 namespace baichuan {
 
+namespace {
+
+// Header lines longer than this are not HTTP
+constexpr size_t MAX_LINE = 8192;
+
+// Safety limit for one JPEG
+constexpr size_t MAX_JPEG = 10 * 1024 * 1024;
+
+// Room made in the receive buffer before each read
+constexpr size_t READ_CHUNK = 64 * 1024;
+
+void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+} // namespace
+
 MjpegSource::MjpegSource() = default;
 
 MjpegSource::~MjpegSource() {
@@ -31,6 +52,24 @@ void MjpegSource::set_timeout(int seconds) {
     timeout_seconds_ = seconds;
 }
 
+bool MjpegSource::resolve(struct sockaddr_in& addr) {
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    if (inet_pton(AF_INET, host_.c_str(), &addr.sin_addr) == 1) {
+        return true;
+    }
+
+    // Resolve hostname
+    struct hostent* server = gethostbyname(host_.c_str());
+    if (!server) {
+        LOG_ERROR("Failed to resolve hostname: {}", host_);
+        return false;
+    }
+    std::memcpy(&addr.sin_addr.s_addr, server->h_addr, server->h_length);
+    return true;
+}
+
 bool MjpegSource::connect() {
     if (url_.empty()) {
         LOG_ERROR("MJPEG URL not set");
@@ -47,10 +86,8 @@ bool MjpegSource::connect() {
 
     LOG_INFO("Connecting to MJPEG: {}:{}{}", host_, port_, path_);
 
-    // Resolve hostname
-    struct hostent* server = gethostbyname(host_.c_str());
-    if (!server) {
-        LOG_ERROR("Failed to resolve hostname: {}", host_);
+    struct sockaddr_in server_addr;
+    if (!resolve(server_addr)) {
         return false;
     }
 
@@ -69,11 +106,6 @@ bool MjpegSource::connect() {
     setsockopt(socket_fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
     // Connect
-    struct sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port_);
-    std::memcpy(&server_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-
     if (::connect(socket_fd_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         LOG_ERROR("Failed to connect to {}:{}", host_, port_);
         cleanup();
@@ -111,23 +143,104 @@ bool MjpegSource::start() {
         return true;
     }
 
-    running_.store(true);
-    receive_thread_ = std::thread(&MjpegSource::receive_loop, this);
+    // The response headers were read a byte at a time, so nothing of the
+    // stream is buffered yet
+    set_nonblocking(socket_fd_);
+    reset_parser(Phase::Boundary);
+    if (!watch(IoReactor::Interest::Read)) {
+        return false;
+    }
 
     LOG_INFO("MJPEG streaming started");
     return true;
 }
 
+bool MjpegSource::start_async() {
+    if (running_.load()) {
+        LOG_WARN("MJPEG already streaming");
+        return true;
+    }
+    if (url_.empty()) {
+        LOG_ERROR("MJPEG URL not set");
+        return false;
+    }
+
+    cleanup();
+
+    if (!parse_url()) {
+        LOG_ERROR("Failed to parse MJPEG URL: {}", url_);
+        return false;
+    }
+
+    LOG_INFO("Connecting to MJPEG: {}:{}{}", host_, port_, path_);
+
+    // A host name (not an address) still resolves on this thread
+    struct sockaddr_in server_addr;
+    if (!resolve(server_addr)) {
+        return false;
+    }
+
+    socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd_ < 0) {
+        LOG_ERROR("Failed to create socket");
+        return false;
+    }
+    set_nonblocking(socket_fd_);
+
+    if (::connect(socket_fd_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 &&
+        errno != EINPROGRESS) {
+        LOG_ERROR("Failed to connect to {}:{}", host_, port_);
+        cleanup();
+        return false;
+    }
+
+    // The handshake completes when the socket turns writable
+    reset_parser(Phase::Connecting);
+    return watch(IoReactor::Interest::Write);
+}
+
+bool MjpegSource::watch(IoReactor::Interest interest) {
+    running_.store(true);
+    last_data_.store(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::lock_guard<std::mutex> lock(reactor_mutex_);
+        stopped_ = false;
+        reactor_id_ = IoReactor::instance().add(socket_fd_, [this, interest]() {
+            return interest == IoReactor::Interest::Write ? on_writable() : on_readable();
+        }, interest);
+        if (reactor_id_ == 0) {
+            running_.store(false);
+            return false;
+        }
+    }
+    schedule_deadline(std::chrono::steady_clock::now() + std::chrono::seconds(timeout_seconds_));
+    return true;
+}
+
 void MjpegSource::stop() {
     running_.store(false);
 
-    // Close socket to unblock any reads
-    if (socket_fd_ >= 0) {
-        shutdown(socket_fd_, SHUT_RDWR);
+    uint64_t id;
+    uint64_t timer;
+    {
+        std::lock_guard<std::mutex> lock(reactor_mutex_);
+        stopped_ = true;
+        id = reactor_id_;
+        timer = deadline_timer_;
+        reactor_id_ = 0;
+        deadline_timer_ = 0;
+    }
+    if (id != 0) {
+        IoReactor::instance().remove(id);
+    }
+    if (timer != 0) {
+        IoReactor::instance().cancel_timer(timer);
     }
 
-    if (receive_thread_.joinable()) {
-        receive_thread_.join();
+    // Decodes still queued point at this source
+    {
+        std::unique_lock<std::mutex> lock(decode_mutex_);
+        decode_cv_.wait(lock, [this] { return decodes_pending_ == 0; });
     }
 
     LOG_INFO("MJPEG streaming stopped");
@@ -156,6 +269,16 @@ void MjpegSource::on_info(InfoCallback cb) {
     info_callback_ = std::move(cb);
 }
 
+void MjpegSource::on_end(EndCallback cb) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    end_callback_ = std::move(cb);
+}
+
+void MjpegSource::on_jpeg(JpegCallback cb) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    jpeg_callback_ = std::move(cb);
+}
+
 bool MjpegSource::parse_url() {
     // Format: http://[user:pass@]host[:port]/path
     std::string url = url_;
@@ -234,7 +357,7 @@ bool MjpegSource::send_http_request() {
             << "\r\n";
 
     std::string req_str = request.str();
-    ssize_t sent = send(socket_fd_, req_str.c_str(), req_str.length(), 0);
+    ssize_t sent = send(socket_fd_, req_str.c_str(), req_str.length(), MSG_NOSIGNAL);
 
     return sent == static_cast<ssize_t>(req_str.length());
 }
@@ -271,31 +394,7 @@ bool MjpegSource::read_http_headers() {
         if (header.empty()) {
             break;
         }
-
-        // Look for Content-Type header with boundary
-        if (header.find("Content-Type:") != std::string::npos ||
-            header.find("content-type:") != std::string::npos) {
-
-            size_t boundary_pos = header.find("boundary=");
-            if (boundary_pos != std::string::npos) {
-                boundary_ = header.substr(boundary_pos + 9);
-                // Remove quotes if present
-                if (!boundary_.empty() && boundary_[0] == '"') {
-                    boundary_ = boundary_.substr(1);
-                    size_t end_quote = boundary_.find('"');
-                    if (end_quote != std::string::npos) {
-                        boundary_ = boundary_.substr(0, end_quote);
-                    }
-                }
-                // Remove any trailing whitespace or semicolon
-                size_t end = boundary_.find_first_of(" \t;");
-                if (end != std::string::npos) {
-                    boundary_ = boundary_.substr(0, end);
-                }
-            }
-        }
-
-        LOG_DEBUG("MJPEG header: {}", header);
+        parse_http_header(header);
     }
 
     if (boundary_.empty()) {
@@ -306,127 +405,375 @@ bool MjpegSource::read_http_headers() {
     return true;
 }
 
-bool MjpegSource::read_bytes(std::vector<uint8_t>& buffer, size_t count) {
-    buffer.resize(count);
-    size_t total_read = 0;
-
-    while (total_read < count && running_.load()) {
-        ssize_t n = recv(socket_fd_, buffer.data() + total_read, count - total_read, 0);
-        if (n <= 0) {
-            return false;
+void MjpegSource::parse_http_header(const std::string& header) {
+    // Look for Content-Type header with boundary
+    if (header.find("Content-Type:") != std::string::npos ||
+        header.find("content-type:") != std::string::npos) {
+
+        size_t boundary_pos = header.find("boundary=");
+        if (boundary_pos != std::string::npos) {
+            boundary_ = header.substr(boundary_pos + 9);
+            // Remove quotes if present
+            if (!boundary_.empty() && boundary_[0] == '"') {
+                boundary_ = boundary_.substr(1);
+                size_t end_quote = boundary_.find('"');
+                if (end_quote != std::string::npos) {
+                    boundary_ = boundary_.substr(0, end_quote);
+                }
+            }
+            // Remove any trailing whitespace or semicolon
+            size_t end = boundary_.find_first_of(" \t;");
+            if (end != std::string::npos) {
+                boundary_ = boundary_.substr(0, end);
+            }
         }
-        total_read += n;
     }
 
-    return total_read == count;
+    LOG_DEBUG("MJPEG header: {}", header);
 }
 
-bool MjpegSource::find_boundary() {
-    // Look for --boundary
-    std::string search = "--" + boundary_;
-    std::string buffer;
-    char c;
+void MjpegSource::schedule_deadline(std::chrono::steady_clock::time_point when) {
+    std::lock_guard<std::mutex> lock(reactor_mutex_);
+    if (stopped_) {
+        return;
+    }
+    deadline_timer_ = IoReactor::instance().add_timer(when, [this]() {
+        on_deadline();
+    });
+}
 
-    while (running_.load()) {
-        if (recv(socket_fd_, &c, 1, 0) != 1) {
-            return false;
-        }
+void MjpegSource::on_deadline() {
+    if (!running_.load()) {
+        return;
+    }
 
-        buffer += c;
+    // Data arrived since the deadline was set: move it on
+    auto timeout = std::chrono::seconds(timeout_seconds_);
+    auto last = std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(last_data_.load()));
+    if (std::chrono::steady_clock::now() < last + timeout) {
+        schedule_deadline(last + timeout);
+        return;
+    }
 
-        // Keep buffer size manageable
-        if (buffer.length() > search.length() * 2) {
-            buffer = buffer.substr(buffer.length() - search.length());
-        }
+    // The socket handler sees the connection end and reports it (only it
+    // unregisters the socket, so neither waits for the other)
+    LOG_ERROR("No MJPEG data from {}:{} for {} s", host_, port_, timeout_seconds_);
+    ::shutdown(socket_fd_, SHUT_RDWR);
+}
 
-        if (buffer.find(search) != std::string::npos) {
-            // Read the newline after boundary
-            read_line();
-            return true;
+bool MjpegSource::on_writable() {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(socket_fd_, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+        error = errno;
+    }
+
+    {
+        // Swapped under the lock, so stop() removes whichever is registered
+        std::lock_guard<std::mutex> lock(reactor_mutex_);
+        if (!running_.load()) {
+            return false;
+        }
+        IoReactor::instance().remove(reactor_id_);
+        reactor_id_ = 0;
+
+        if (error == 0 && send_http_request()) {
+            phase_ = Phase::Status;
+            reactor_id_ = IoReactor::instance().add(socket_fd_, [this]() {
+                return on_readable();
+            });
+            if (reactor_id_ != 0) {
+                return false;
+            }
         }
     }
 
+    LOG_ERROR("Failed to connect to {}:{}{}", host_, port_,
+              error != 0 ? std::string(": ") + strerror(error) : "");
+    fail("Connection failed");
     return false;
 }
 
-bool MjpegSource::read_part_headers(size_t& content_length) {
-    content_length = 0;
-
-    while (true) {
-        std::string header = read_line();
-        if (header.empty()) {
-            break;
+bool MjpegSource::on_readable() {
+    while (running_.load()) {
+        // Keep the unparsed bytes at the front, with room for a read behind
+        if (buffer_start_ > 0 && (buffer_start_ == buffer_end_ || buffer_.size() - buffer_end_ < READ_CHUNK)) {
+            std::memmove(buffer_.data(), buffer_.data() + buffer_start_, buffer_end_ - buffer_start_);
+            buffer_end_ -= buffer_start_;
+            buffer_start_ = 0;
+        }
+        if (buffer_.size() - buffer_end_ < READ_CHUNK) {
+            buffer_.resize(buffer_end_ + READ_CHUNK);
         }
 
-        // Look for Content-Length
-        if (header.find("Content-Length:") != std::string::npos ||
-            header.find("content-length:") != std::string::npos) {
-            size_t colon = header.find(':');
-            if (colon != std::string::npos) {
-                std::string len_str = header.substr(colon + 1);
-                // Trim whitespace
-                size_t start = len_str.find_first_not_of(" \t");
-                if (start != std::string::npos) {
-                    content_length = std::stoul(len_str.substr(start));
-                }
+        ssize_t n = recv(socket_fd_, buffer_.data() + buffer_end_, buffer_.size() - buffer_end_, 0);
+        if (n > 0) {
+            buffer_end_ += static_cast<size_t>(n);
+            last_data_.store(std::chrono::steady_clock::now().time_since_epoch().count());
+            if (!parse()) {
+                fail("Lost MJPEG stream");
+                return false;
             }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
         }
-    }
 
-    return true;
+        // Closed by the camera, or shut down by the deadline
+        LOG_ERROR("MJPEG connection to {}:{} closed", host_, port_);
+        fail(phase_ < Phase::Boundary ? "Connection failed" : "Lost MJPEG stream");
+        return false;
+    }
+    return false;
 }
 
-bool MjpegSource::read_jpeg_frame(std::vector<uint8_t>& jpeg_data, size_t content_length) {
-    if (content_length > 0) {
-        // Content-Length specified, read exact bytes
-        return read_bytes(jpeg_data, content_length);
+void MjpegSource::fail(const std::string& message) {
+    if (!running_.exchange(false)) {
+        return;  // Stopped meanwhile
+    }
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    if (error_callback_) {
+        error_callback_(message);
+    }
+    if (end_callback_) {
+        end_callback_();
     }
+}
 
-    // No Content-Length, read until boundary
-    // Look for JPEG SOI (0xFFD8) and EOI (0xFFD9) markers
-    jpeg_data.clear();
-    jpeg_data.reserve(100000);  // Typical JPEG size
+void MjpegSource::reset_parser(Phase phase) {
+    phase_ = phase;
+    buffer_start_ = 0;
+    buffer_end_ = 0;
+    content_length_ = 0;
+    soi_found_ = false;
+    scan_pos_ = 0;
+}
 
-    uint8_t prev_byte = 0;
-    uint8_t curr_byte = 0;
-    bool found_soi = false;
+std::optional<std::string> MjpegSource::take_line() {
+    const uint8_t* data = buffer_.data() + buffer_start_;
+    size_t len = buffer_end_ - buffer_start_;
+    const void* newline = std::memchr(data, '\n', len);
+    if (!newline) {
+        return std::nullopt;
+    }
+
+    size_t line_len = static_cast<const uint8_t*>(newline) - data;
+    buffer_start_ += line_len + 1;
+    // Remove trailing \r if present
+    if (line_len > 0 && data[line_len - 1] == '\r') {
+        line_len--;
+    }
+    return std::string(reinterpret_cast<const char*>(data), line_len);
+}
 
+bool MjpegSource::parse() {
     while (running_.load()) {
-        if (recv(socket_fd_, &curr_byte, 1, 0) != 1) {
-            return false;
-        }
+        const uint8_t* data = buffer_.data() + buffer_start_;
+        size_t len = buffer_end_ - buffer_start_;
+
+        switch (phase_) {
+            case Phase::Connecting:
+                return false;
+
+            case Phase::Status:
+            case Phase::Headers:
+            case Phase::BoundaryLine:
+            case Phase::PartHeaders: {
+                std::optional<std::string> line = take_line();
+                if (!line) {
+                    return len <= MAX_LINE;  // Wait for the rest of the line
+                }
+                if (phase_ == Phase::Status) {
+                    if (line->find("200") == std::string::npos) {
+                        LOG_ERROR("HTTP error: {}", *line);
+                        return false;
+                    }
+                    phase_ = Phase::Headers;
+                } else if (phase_ == Phase::Headers) {
+                    if (!line->empty()) {
+                        parse_http_header(*line);
+                        break;
+                    }
+                    if (boundary_.empty()) {
+                        LOG_ERROR("No boundary found in Content-Type header");
+                        return false;
+                    }
+                    connected_.store(true);
+                    LOG_INFO("MJPEG connected, boundary: {}", boundary_);
+                    phase_ = Phase::Boundary;
+                } else if (phase_ == Phase::BoundaryLine) {
+                    // Rest of the boundary line
+                    content_length_ = 0;
+                    phase_ = Phase::PartHeaders;
+                } else if (!line->empty()) {
+                    // Look for Content-Length
+                    if (line->find("Content-Length:") != std::string::npos ||
+                        line->find("content-length:") != std::string::npos) {
+                        size_t colon = line->find(':');
+                        content_length_ = std::strtoul(line->c_str() + colon + 1, nullptr, 10);
+                    }
+                } else {
+                    soi_found_ = false;
+                    scan_pos_ = 0;
+                    phase_ = Phase::Body;
+                }
+                break;
+            }
 
-        // Check for SOI marker (start of JPEG)
-        if (!found_soi) {
-            if (prev_byte == 0xFF && curr_byte == 0xD8) {
-                jpeg_data.push_back(0xFF);
-                jpeg_data.push_back(0xD8);
-                found_soi = true;
+            case Phase::Boundary: {
+                // Look for --boundary
+                std::string search = "--" + boundary_;
+                auto it = std::search(data, data + len, search.begin(), search.end());
+                if (it == data + len) {
+                    // Keep what could be the start of a split boundary
+                    if (len >= search.size()) {
+                        buffer_start_ += len - (search.size() - 1);
+                    }
+                    return true;
+                }
+                buffer_start_ += static_cast<size_t>(it - data) + search.size();
+                phase_ = Phase::BoundaryLine;
+                break;
+            }
+
+            case Phase::Body: {
+                if (content_length_ > 0) {
+                    // Content-Length specified, wait for exactly that much
+                    if (content_length_ > MAX_JPEG) {
+                        LOG_ERROR("JPEG frame too large, aborting");
+                        return false;
+                    }
+                    if (len < content_length_) {
+                        return true;
+                    }
+                    buffer_start_ += content_length_;
+                    phase_ = Phase::Boundary;
+                    deliver_jpeg(data, content_length_);
+                    break;
+                }
+
+                // No Content-Length: the JPEG runs from its SOI (0xFFD8) to
+                // its EOI (0xFFD9) marker
+                static const uint8_t SOI[] = {0xFF, 0xD8};
+                static const uint8_t EOI[] = {0xFF, 0xD9};
+                if (!soi_found_) {
+                    const uint8_t* soi = std::search(data, data + len, SOI, SOI + 2);
+                    if (soi == data + len) {
+                        buffer_start_ += len > 0 ? len - 1 : 0;  // 0xFF may start a marker
+                        return true;
+                    }
+                    buffer_start_ += static_cast<size_t>(soi - data);
+                    soi_found_ = true;
+                    scan_pos_ = 2;
+                    break;
+                }
+
+                size_t from = std::max<size_t>(scan_pos_, 3) - 1;
+                const uint8_t* eoi = std::search(data + std::min(from, len), data + len, EOI, EOI + 2);
+                if (eoi == data + len) {
+                    scan_pos_ = len;
+                    if (len > MAX_JPEG) {
+                        LOG_ERROR("JPEG frame too large, aborting");
+                        return false;
+                    }
+                    return true;
+                }
+                size_t frame_len = static_cast<size_t>(eoi - data) + 2;
+                buffer_start_ += frame_len;
+                phase_ = Phase::Boundary;
+                deliver_jpeg(data, frame_len);
+                break;
             }
-            prev_byte = curr_byte;
-            continue;
         }
+    }
+    return true;
+}
 
-        jpeg_data.push_back(curr_byte);
+void MjpegSource::deliver_jpeg(const uint8_t* data, size_t len) {
+    stats_->frames_received++;
+    stats_->bytes_received += len;
 
-        // Check for EOI marker (end of JPEG)
-        if (prev_byte == 0xFF && curr_byte == 0xD9) {
-            return true;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        if (jpeg_callback_) {
+            jpeg_callback_(data, len);
         }
+    }
+
+    // Apply the decode policy
+    DecodePolicy policy = decode_policy_.load();
+    auto now = std::chrono::steady_clock::now();
+    if (policy == DecodePolicy::Suspended ||
+        (policy == DecodePolicy::KeyframesOnly && now - last_decode_ < std::chrono::seconds(1))) {
+        stats_->frames_skipped++;
+        return;
+    }
+    last_decode_ = now;
 
-        prev_byte = curr_byte;
+    if (!decode_executor_) {
+        decode_and_deliver(data, len);
+        return;
+    }
 
-        // Safety limit
-        if (jpeg_data.size() > 10 * 1024 * 1024) {
-            LOG_ERROR("JPEG frame too large, aborting");
-            return false;
+    // Off the I/O thread: the JPEG is copied out of the receive buffer
+    auto jpeg = std::make_shared<std::vector<uint8_t>>(data, data + len);
+    {
+        std::lock_guard<std::mutex> lock(decode_mutex_);
+        decodes_pending_++;
+    }
+    bool queued = decode_executor_([this, jpeg]() {
+        decode_and_deliver(jpeg->data(), jpeg->size());
+        finish_decode();
+    });
+    if (!queued) {
+        stats_->frames_skipped++;
+        finish_decode();
+    }
+}
+
+void MjpegSource::finish_decode() {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    if (--decodes_pending_ == 0) {
+        decode_cv_.notify_all();
+    }
+}
+
+void MjpegSource::decode_and_deliver(const uint8_t* data, size_t len) {
+    DecodedFrame frame;
+    if (!decode_jpeg(data, len, frame)) {
+        LOG_WARN("Failed to decode JPEG frame");
+        stats_->decode_errors++;
+        return;
+    }
+
+    // Send info callback on first successful decode
+    if (!info_sent_) {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        if (info_callback_) {
+            info_callback_(frame.width, frame.height, 0);  // FPS unknown for MJPEG
         }
+        info_sent_ = true;
+        LOG_INFO("MJPEG stream: {}x{}", frame.width, frame.height);
     }
 
-    return false;
+    // Deliver decoded frame
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    if (frame_callback_) {
+        frame_callback_(frame);
+    }
 }
 
-bool MjpegSource::decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFrame& frame) {
+void MjpegSource::set_output_size(int max_width, int max_height) {
+    max_width_.store(max_width > 0 ? max_width : 0);
+    max_height_.store(max_height > 0 ? max_height : 0);
+}
+
+bool MjpegSource::decode_jpeg(const uint8_t* jpeg_data, size_t jpeg_len, DecodedFrame& frame) {
     struct jpeg_decompress_struct cinfo;
     struct jpeg_error_mgr jerr;
 
@@ -434,7 +781,7 @@ bool MjpegSource::decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFram
     jpeg_create_decompress(&cinfo);
 
     // Set source to memory buffer
-    jpeg_mem_src(&cinfo, jpeg_data.data(), jpeg_data.size());
+    jpeg_mem_src(&cinfo, jpeg_data, jpeg_len);
 
     // Read header
     if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
@@ -442,8 +789,28 @@ bool MjpegSource::decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFram
         return false;
     }
 
+    // DCT-domain downscale towards the requested bound (much cheaper than
+    // decoding at full size and scaling afterwards)
+    int max_width = max_width_.load();
+    int max_height = max_height_.load();
+    if (max_width > 0 && max_height > 0) {
+        unsigned int denom = 1;
+        while (denom < 8 &&
+               cinfo.image_width / (denom * 2) >= static_cast<unsigned int>(max_width) &&
+               cinfo.image_height / (denom * 2) >= static_cast<unsigned int>(max_height)) {
+            denom *= 2;
+        }
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = denom;
+    }
+
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo can write BGRX rows directly (Cairo's native layout)
+    cinfo.out_color_space = JCS_EXT_BGRX;
+#else
     // Request RGB output (libjpeg decodes to RGB)
     cinfo.out_color_space = JCS_RGB;
+#endif
 
     // Start decompression
     if (!jpeg_start_decompress(&cinfo)) {
@@ -453,18 +820,28 @@ bool MjpegSource::decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFram
 
     frame.width = cinfo.output_width;
     frame.height = cinfo.output_height;
-    int rgb_stride = cinfo.output_width * cinfo.output_components;
+    frame.stride = frame.width * 4;
+
+    // Output buffer is reused; it only grows when the resolution does
+    pixels_.resize(static_cast<size_t>(frame.stride) * frame.height);
+    frame.data = pixels_.data();
 
+#ifdef JCS_EXTENSIONS
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint8_t* row_ptr = pixels_.data() + static_cast<size_t>(cinfo.output_scanline) * frame.stride;
+        jpeg_read_scanlines(&cinfo, &row_ptr, 1);
+    }
+#else
     // Decode row by row, converting RGB -> BGRA to match decoder output format
+    int rgb_stride = cinfo.output_width * cinfo.output_components;
     std::vector<uint8_t> rgb_row(rgb_stride);
-    frame.rgb_data.resize(frame.width * frame.height * 4);
 
     while (cinfo.output_scanline < cinfo.output_height) {
         uint8_t* row_ptr = rgb_row.data();
         jpeg_read_scanlines(&cinfo, &row_ptr, 1);
 
         int y = cinfo.output_scanline - 1;
-        uint8_t* dst = frame.rgb_data.data() + y * frame.width * 4;
+        uint8_t* dst = pixels_.data() + static_cast<size_t>(y) * frame.stride;
         const uint8_t* src = rgb_row.data();
         for (int x = 0; x < frame.width; x++) {
             dst[0] = src[2];  // B
@@ -475,6 +852,7 @@ bool MjpegSource::decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFram
             dst += 4;
         }
     }
+#endif
 
     jpeg_finish_decompress(&cinfo);
     jpeg_destroy_decompress(&cinfo);
@@ -482,67 +860,6 @@ bool MjpegSource::decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFram
     return true;
 }
 
-void MjpegSource::receive_loop() {
-    std::vector<uint8_t> jpeg_data;
-    DecodedFrame frame;
-
-    while (running_.load()) {
-        // Find next boundary
-        if (!find_boundary()) {
-            if (running_.load()) {
-                LOG_ERROR("Failed to find MJPEG boundary");
-                std::lock_guard<std::mutex> lock(callback_mutex_);
-                if (error_callback_) {
-                    error_callback_("Lost MJPEG stream");
-                }
-            }
-            break;
-        }
-
-        // Read part headers
-        size_t content_length = 0;
-        if (!read_part_headers(content_length)) {
-            continue;
-        }
-
-        // Read JPEG frame
-        if (!read_jpeg_frame(jpeg_data, content_length)) {
-            if (running_.load()) {
-                LOG_ERROR("Failed to read JPEG frame");
-            }
-            continue;
-        }
-
-        stats_.frames_received++;
-        stats_.bytes_received += jpeg_data.size();
-
-        // Decode JPEG
-        if (!decode_jpeg(jpeg_data, frame)) {
-            LOG_WARN("Failed to decode JPEG frame");
-            stats_.decode_errors++;
-            continue;
-        }
-
-        // Send info callback on first successful decode
-        if (!info_sent_) {
-            std::lock_guard<std::mutex> lock(callback_mutex_);
-            if (info_callback_) {
-                info_callback_(frame.width, frame.height, 0);  // FPS unknown for MJPEG
-            }
-            info_sent_ = true;
-            LOG_INFO("MJPEG stream: {}x{}", frame.width, frame.height);
-        }
-
-        // Deliver decoded frame
-        std::lock_guard<std::mutex> lock(callback_mutex_);
-        if (frame_callback_) {
-            frame_callback_(frame);
-        }
-    }
-
-    running_.store(false);
-}
-
 void MjpegSource::cleanup() {
     if (socket_fd_ >= 0) {
         close(socket_fd_);
@@ -552,6 +869,7 @@ void MjpegSource::cleanup() {
     auth_header_.clear();
     info_sent_ = false;
     connected_.store(false);
+    reset_parser(Phase::Boundary);
 }
 
 } // namespace baichuan
@@ -1,17 +1,26 @@
 #pragma once
 
 #include "video/decoder.h"  // For DecodedFrame
+#include "video/decode_gate.h"  // For DecodePolicy
+#include "utils/io_reactor.h"
+#include "utils/metrics.h"
 #include <string>
 #include <vector>
-#include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <functional>
+#include <optional>
+#include <chrono>
+
+struct sockaddr_in;
 
 namespace baichuan {
 
 // MJPEG over HTTP video source
-// Connects to HTTP MJPEG streams and decodes JPEG frames using libjpeg
+// Connects to HTTP MJPEG streams and decodes JPEG frames using libjpeg.
+// While streaming, the socket is read on the shared IoReactor and parsed as
+// data arrives, so a stream has no thread of its own.
 class MjpegSource {
 public:
     MjpegSource();
@@ -24,12 +33,36 @@ public:
     // Set connection timeout in seconds (default: 10)
     void set_timeout(int seconds);
 
-    // Connect to the MJPEG stream
+    // Bound the decoded size (0 x 0 = native). libjpeg can only scale by
+    // 1/2, 1/4 or 1/8 during decode, so the largest reduction that still
+    // covers the bound is used. Safe to call from any thread.
+    void set_output_size(int max_width, int max_height);
+
+    // Decode every JPEG (Full), at most one per second (KeyframesOnly - every
+    // JPEG is a keyframe) or none (Suspended). Frames are still read off the
+    // socket, so decoding picks up again with the next JPEG. Safe to call
+    // from any thread.
+    void set_decode_policy(DecodePolicy policy) { decode_policy_.store(policy); }
+
+    // Connect to the MJPEG stream (blocking, up to the timeout)
     bool connect();
 
     // Start receiving and decoding frames
     bool start();
 
+    // Connect and start without blocking: the connect, the request and the
+    // response headers all run on the reactor. False if the URL is bad or
+    // the host name doesn't resolve (a name, unlike an address, resolves on
+    // the caller's thread); later failures go to on_error and on_end.
+    bool start_async();
+
+    // Decode (and call on_info/on_frame) through executor instead of on the
+    // reactor thread. It must run one source's tasks in order, one at a
+    // time, and returns false to drop the frame (counted as skipped). Set
+    // before starting; stop() waits for the decodes already queued.
+    using DecodeExecutor = std::function<bool(std::function<void()>)>;
+    void set_decode_executor(DecodeExecutor executor) { decode_executor_ = std::move(executor); }
+
     // Stop streaming
     void stop();
 
@@ -41,18 +74,31 @@ public:
     using DecodedFrameCallback = std::function<void(const DecodedFrame&)>;
     using ErrorCallback = std::function<void(const std::string&)>;
     using InfoCallback = std::function<void(int width, int height, int fps)>;
+    // Each JPEG as received, before the decode policy (valid during the call)
+    using JpegCallback = std::function<void(const uint8_t* data, size_t len)>;
 
     void on_frame(DecodedFrameCallback cb);
     void on_error(ErrorCallback cb);
     void on_info(InfoCallback cb);
+    void on_jpeg(JpegCallback cb);
+
+    // The stream ended by itself (connection lost or timed out); called on
+    // the reactor thread once is_streaming() reads false, not after stop()
+    using EndCallback = std::function<void()>;
+    void on_end(EndCallback cb);
 
-    // Statistics
+    // Statistics (atomic: readable from any thread while streaming)
     struct Stats {
-        uint64_t frames_received = 0;
-        uint64_t bytes_received = 0;
-        uint64_t decode_errors = 0;
+        MetricCounter frames_received;
+        MetricCounter bytes_received;
+        MetricCounter decode_errors;
+        MetricCounter frames_skipped;  // Not decoded (decode policy, or a full decode backlog)
     };
-    Stats stats() const { return stats_; }
+    const Stats& stats() const { return *stats_; }
+
+    // Count into an external block instead (e.g. one that outlives the
+    // source, for totals across reconnects); set before start()
+    void set_stats(Stats* stats) { stats_ = stats ? stats : &own_stats_; }
 
 private:
     std::string url_;
@@ -65,38 +111,91 @@ private:
     int socket_fd_ = -1;
     int timeout_seconds_ = 10;
 
-    std::thread receive_thread_;
     std::atomic<bool> running_{false};
     std::atomic<bool> connected_{false};
 
+    // Incremental parse of what the reactor has read
+    enum class Phase {
+        Connecting,    // Waiting for the TCP handshake
+        Status,        // HTTP status line
+        Headers,       // HTTP response headers
+        Boundary,      // Looking for --boundary
+        BoundaryLine,  // Rest of the boundary line
+        PartHeaders,   // Part headers up to the blank line
+        Body           // The JPEG itself
+    };
+    Phase phase_ = Phase::Boundary;
+    std::vector<uint8_t> buffer_;
+    size_t buffer_start_ = 0;     // Unparsed bytes are [start, end)
+    size_t buffer_end_ = 0;
+    size_t content_length_ = 0;   // 0 = scan for the JPEG markers
+    bool soi_found_ = false;
+    size_t scan_pos_ = 0;         // Marker scan resumes here
+
+    // Reactor registration and the stall deadline
+    std::mutex reactor_mutex_;
+    uint64_t reactor_id_ = 0;
+    uint64_t deadline_timer_ = 0;
+    bool stopped_ = false;                 // No more deadline timers
+    std::atomic<int64_t> last_data_{0};    // steady_clock ticks
+
+    DecodeExecutor decode_executor_;
+    std::mutex decode_mutex_;
+    std::condition_variable decode_cv_;
+    size_t decodes_pending_ = 0;
+
     DecodedFrameCallback frame_callback_;
     ErrorCallback error_callback_;
     InfoCallback info_callback_;
+    JpegCallback jpeg_callback_;
+    EndCallback end_callback_;
     std::mutex callback_mutex_;
 
-    Stats stats_;
+    Stats own_stats_;
+    Stats* stats_ = &own_stats_;
     bool info_sent_ = false;
 
+    std::atomic<DecodePolicy> decode_policy_{DecodePolicy::Full};
+    std::chrono::steady_clock::time_point last_decode_{};
+
+    std::atomic<int> max_width_{0};
+    std::atomic<int> max_height_{0};
+
+    // Decoded BGRA pixels, reused across frames (DecodedFrame points into it)
+    std::vector<uint8_t> pixels_;
+
     // URL parsing
     bool parse_url();
     std::string base64_encode(const std::string& input);
 
-    // HTTP handling
+    bool resolve(struct sockaddr_in& addr);
+
+    // HTTP handling (read_line is the blocking connect()'s)
     bool send_http_request();
     bool read_http_headers();
     std::string read_line();
-    bool read_bytes(std::vector<uint8_t>& buffer, size_t count);
-
-    // Multipart parsing
-    bool find_boundary();
-    bool read_part_headers(size_t& content_length);
-    bool read_jpeg_frame(std::vector<uint8_t>& jpeg_data, size_t content_length);
+    void parse_http_header(const std::string& header);
+
+    // Reactor handlers
+    bool watch(IoReactor::Interest interest);
+    bool on_writable();
+    bool on_readable();
+    void schedule_deadline(std::chrono::steady_clock::time_point when);
+    void on_deadline();
+    void fail(const std::string& message);
+
+    // Multipart parsing; false on a protocol error
+    void reset_parser(Phase phase);
+    std::optional<std::string> take_line();
+    bool parse();
+
+    // One complete JPEG: stats, on_jpeg, then the decode (maybe queued)
+    void deliver_jpeg(const uint8_t* data, size_t len);
+    void decode_and_deliver(const uint8_t* data, size_t len);
+    void finish_decode();
 
     // JPEG decoding (using libjpeg)
-    bool decode_jpeg(const std::vector<uint8_t>& jpeg_data, DecodedFrame& frame);
-
-    // Main loop
-    void receive_loop();
+    bool decode_jpeg(const uint8_t* jpeg_data, size_t jpeg_len, DecodedFrame& frame);
 
     // Cleanup
     void cleanup();
@@ -9,8 +9,142 @@
 #include <sstream>
 #include <iomanip>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define BC_CRYPTO_X86_SIMD 1
+#endif
+
 namespace baichuan {
 
+namespace {
+
+// BCEncrypt XOR kernels
+//
+// The BCEncrypt keystream has a period of 8 bytes, so a 32-byte key schedule
+// (four repetitions starting at the right key phase) can be applied to any
+// 8/16/32-byte aligned-in-phase block of the data. All kernels XOR `data` in
+// place with schedule[i % 32] and produce identical output.
+using XorKernel = void (*)(uint8_t* data, size_t len, const uint8_t* schedule);
+
+void xor_kernel_scalar(uint8_t* data, size_t len, const uint8_t* schedule) {
+    // 8 bytes at a time through a 64-bit word, then the tail byte by byte
+    uint64_t key_word;
+    memcpy(&key_word, schedule, sizeof(key_word));
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        word ^= key_word;
+        memcpy(data + i, &word, sizeof(word));
+    }
+    for (; i < len; ++i) {
+        data[i] ^= schedule[i & 7];
+    }
+}
+
+#ifdef BC_CRYPTO_X86_SIMD
+__attribute__((target("sse2")))
+void xor_kernel_sse2(uint8_t* data, size_t len, const uint8_t* schedule) {
+    const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(schedule));
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i* p = reinterpret_cast<__m128i*>(data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key));
+    }
+    xor_kernel_scalar(data + i, len - i, schedule);
+}
+
+__attribute__((target("avx2")))
+void xor_kernel_avx2(uint8_t* data, size_t len, const uint8_t* schedule) {
+    const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(schedule));
+
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i* p0 = reinterpret_cast<__m256i*>(data + i);
+        __m256i* p1 = reinterpret_cast<__m256i*>(data + i + 32);
+        _mm256_storeu_si256(p0, _mm256_xor_si256(_mm256_loadu_si256(p0), key));
+        _mm256_storeu_si256(p1, _mm256_xor_si256(_mm256_loadu_si256(p1), key));
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i* p = reinterpret_cast<__m256i*>(data + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), key));
+    }
+    xor_kernel_scalar(data + i, len - i, schedule);
+}
+#endif
+
+bool cpu_supports(const char* feature) {
+    if (feature == nullptr) {
+        return true;
+    }
+#ifdef BC_CRYPTO_X86_SIMD
+    __builtin_cpu_init();
+    if (strcmp(feature, "avx2") == 0) return __builtin_cpu_supports("avx2");
+    if (strcmp(feature, "sse2") == 0) return __builtin_cpu_supports("sse2");
+#endif
+    return false;
+}
+
+// The keystream repeats every 8 bytes, so one 32-byte schedule starting at
+// the key phase for byte 0 covers any block a kernel applies
+void build_schedule(uint32_t offset, uint8_t* schedule) {
+    uint8_t offset_byte = static_cast<uint8_t>(offset & 0xFF);
+    for (size_t i = 0; i < 32; ++i) {
+        schedule[i] = BC_ENCRYPT_KEY[(offset + i) % 8] ^ offset_byte;
+    }
+}
+
+template <XorKernel Kernel>
+void apply_kernel(uint32_t offset, uint8_t* data, size_t len) {
+    alignas(32) uint8_t schedule[32];
+    build_schedule(offset, schedule);
+    Kernel(data, len, schedule);
+}
+
+struct KernelEntry {
+    const char* name;
+    const char* feature;    // CPU feature it needs (nullptr = none)
+    XorKernel kernel;
+    void (*apply)(uint32_t offset, uint8_t* data, size_t len);
+};
+
+// Fastest first; the scalar kernel always runs
+const KernelEntry KERNELS[] = {
+#ifdef BC_CRYPTO_X86_SIMD
+    {"avx2", "avx2", xor_kernel_avx2, apply_kernel<xor_kernel_avx2>},
+    {"sse2", "sse2", xor_kernel_sse2, apply_kernel<xor_kernel_sse2>},
+#endif
+    {"scalar", nullptr, xor_kernel_scalar, apply_kernel<xor_kernel_scalar>},
+};
+
+const KernelEntry& select_xor_kernel() {
+    for (const KernelEntry& entry : KERNELS) {
+        if (cpu_supports(entry.feature)) {
+            return entry;
+        }
+    }
+    return KERNELS[sizeof(KERNELS) / sizeof(KERNELS[0]) - 1];
+}
+
+// Chosen once from cpuid at startup
+const KernelEntry& g_xor_kernel = select_xor_kernel();
+
+} // namespace
+
+std::vector<BcXorKernel> bc_xor_kernels() {
+    std::vector<BcXorKernel> kernels;
+    for (const KernelEntry& entry : KERNELS) {
+        kernels.push_back({entry.name, cpu_supports(entry.feature), entry.apply});
+    }
+    return kernels;
+}
+
+const char* bc_xor_kernel_name() {
+    return g_xor_kernel.name;
+}
+
 struct BcCrypto::AesContext {
     std::array<uint8_t, 16> key;
     EVP_CIPHER_CTX* enc_ctx = nullptr;
@@ -152,52 +286,59 @@ std::array<uint8_t, 16> BcCrypto::derive_aes_key(const std::string& password,
 }
 
 std::vector<uint8_t> BcCrypto::encrypt(uint32_t offset, const uint8_t* data, size_t len) {
+    std::vector<uint8_t> result(data, data + len);
+    encrypt_inplace(offset, result.data(), result.size());
+    return result;
+}
+
+std::vector<uint8_t> BcCrypto::decrypt(uint32_t offset, const uint8_t* data, size_t len) {
+    std::vector<uint8_t> result(data, data + len);
+    decrypt_inplace(offset, result.data(), result.size());
+    return result;
+}
+
+void BcCrypto::encrypt_inplace(uint32_t offset, uint8_t* data, size_t len) {
     switch (type_) {
         case EncryptionType::Unencrypted:
-            return std::vector<uint8_t>(data, data + len);
+            return;
 
         case EncryptionType::BCEncrypt:
-            return bc_encrypt_decrypt(offset, data, len);
+            bc_encrypt_decrypt(offset, data, len);
+            return;
 
         case EncryptionType::Aes:
         case EncryptionType::FullAes:
-            return aes_encrypt(data, len);
+            aes_encrypt(data, len);
+            return;
     }
-    return std::vector<uint8_t>(data, data + len);
 }
 
-std::vector<uint8_t> BcCrypto::decrypt(uint32_t offset, const uint8_t* data, size_t len) {
+void BcCrypto::decrypt_inplace(uint32_t offset, uint8_t* data, size_t len) {
     switch (type_) {
         case EncryptionType::Unencrypted:
-            return std::vector<uint8_t>(data, data + len);
+            return;
 
         case EncryptionType::BCEncrypt:
-            return bc_encrypt_decrypt(offset, data, len);
+            bc_encrypt_decrypt(offset, data, len);
+            return;
 
         case EncryptionType::Aes:
         case EncryptionType::FullAes:
-            return aes_decrypt(data, len);
+            aes_decrypt(data, len);
+            return;
     }
-    return std::vector<uint8_t>(data, data + len);
 }
 
-std::vector<uint8_t> BcCrypto::bc_encrypt_decrypt(uint32_t offset, const uint8_t* data, size_t len) {
+void BcCrypto::bc_encrypt_decrypt(uint32_t offset, uint8_t* data, size_t len) {
     // BCEncrypt: XOR each byte with key[(offset+i) % 8] ^ (offset as u8)
     // Note: offset is XORed as-is (not offset+i), only key index advances
     // This is symmetric - encrypt and decrypt are the same operation
-    std::vector<uint8_t> result(len);
-
-    uint8_t offset_byte = static_cast<uint8_t>(offset & 0xFF);
-    for (size_t i = 0; i < len; ++i) {
-        size_t key_idx = (offset + i) % 8;
-        uint8_t key_byte = BC_ENCRYPT_KEY[key_idx];
-        result[i] = data[i] ^ key_byte ^ offset_byte;
-    }
-
-    return result;
+    alignas(32) uint8_t schedule[32];
+    build_schedule(offset, schedule);
+    g_xor_kernel.kernel(data, len, schedule);
 }
 
-std::vector<uint8_t> BcCrypto::aes_encrypt(const uint8_t* data, size_t len) {
+void BcCrypto::aes_encrypt(uint8_t* data, size_t len) {
     if (!aes_ctx_) {
         throw std::runtime_error("AES context not initialized");
     }
@@ -206,24 +347,23 @@ std::vector<uint8_t> BcCrypto::aes_encrypt(const uint8_t* data, size_t len) {
     // for each operation, which effectively resets to IV state
     aes_ctx_->reset_enc();
 
-    std::vector<uint8_t> result(len + EVP_MAX_BLOCK_LENGTH);
+    // CFB is a stream mode: output length equals input length and OpenSSL
+    // allows out == in, so the data is transformed where it lies
     int out_len = 0;
-
-    if (EVP_EncryptUpdate(aes_ctx_->enc_ctx, result.data(), &out_len,
+    if (EVP_EncryptUpdate(aes_ctx_->enc_ctx, data, &out_len,
                           data, static_cast<int>(len)) != 1) {
         throw std::runtime_error("AES encryption failed");
     }
 
+    // No padding in CFB mode, so finalization never produces output
+    uint8_t tail[EVP_MAX_BLOCK_LENGTH];
     int final_len = 0;
-    if (EVP_EncryptFinal_ex(aes_ctx_->enc_ctx, result.data() + out_len, &final_len) != 1) {
+    if (EVP_EncryptFinal_ex(aes_ctx_->enc_ctx, tail, &final_len) != 1) {
         throw std::runtime_error("AES encryption finalization failed");
     }
-
-    result.resize(out_len + final_len);
-    return result;
 }
 
-std::vector<uint8_t> BcCrypto::aes_decrypt(const uint8_t* data, size_t len) {
+void BcCrypto::aes_decrypt(uint8_t* data, size_t len) {
     if (!aes_ctx_) {
         throw std::runtime_error("AES context not initialized");
     }
@@ -232,21 +372,17 @@ std::vector<uint8_t> BcCrypto::aes_decrypt(const uint8_t* data, size_t len) {
     // for each operation, which effectively resets to IV state
     aes_ctx_->reset_dec();
 
-    std::vector<uint8_t> result(len + EVP_MAX_BLOCK_LENGTH);
     int out_len = 0;
-
-    if (EVP_DecryptUpdate(aes_ctx_->dec_ctx, result.data(), &out_len,
+    if (EVP_DecryptUpdate(aes_ctx_->dec_ctx, data, &out_len,
                           data, static_cast<int>(len)) != 1) {
         throw std::runtime_error("AES decryption failed");
     }
 
+    uint8_t tail[EVP_MAX_BLOCK_LENGTH];
     int final_len = 0;
-    if (EVP_DecryptFinal_ex(aes_ctx_->dec_ctx, result.data() + out_len, &final_len) != 1) {
+    if (EVP_DecryptFinal_ex(aes_ctx_->dec_ctx, tail, &final_len) != 1) {
         throw std::runtime_error("AES decryption finalization failed");
     }
-
-    result.resize(out_len + final_len);
-    return result;
 }
 
 } // namespace baichuan
@@ -14,6 +14,20 @@ constexpr uint8_t BC_ENCRYPT_KEY[8] = {0x1F, 0x2D, 0x3C, 0x4B, 0x5A, 0x69, 0x78,
 // Fixed IV for AES-128-CFB
 constexpr char AES_IV[17] = "0123456789abcdef";
 
+// BCEncrypt XOR kernel compiled into this build (BcCrypto picks the fastest
+// one the CPU supports); listed so tests and benchmarks can run each of them
+struct BcXorKernel {
+    const char* name;
+    bool supported;     // The CPU can run it
+    // XOR data in place with the BCEncrypt keystream for this offset
+    void (*apply)(uint32_t offset, uint8_t* data, size_t len);
+};
+
+std::vector<BcXorKernel> bc_xor_kernels();
+
+// Name of the kernel BcCrypto uses
+const char* bc_xor_kernel_name();
+
 enum class EncryptionType {
     Unencrypted,
     BCEncrypt,
@@ -59,6 +73,10 @@ public:
         return decrypt(offset, data.data(), data.size());
     }
 
+    // Encrypt/decrypt in place (all modes are length-preserving)
+    void encrypt_inplace(uint32_t offset, uint8_t* data, size_t len);
+    void decrypt_inplace(uint32_t offset, uint8_t* data, size_t len);
+
     EncryptionType type() const { return type_; }
 
     // Check if video stream should be encrypted (only FullAes)
@@ -71,9 +89,9 @@ private:
     struct AesContext;
     std::unique_ptr<AesContext> aes_ctx_;
 
-    std::vector<uint8_t> bc_encrypt_decrypt(uint32_t offset, const uint8_t* data, size_t len);
-    std::vector<uint8_t> aes_encrypt(const uint8_t* data, size_t len);
-    std::vector<uint8_t> aes_decrypt(const uint8_t* data, size_t len);
+    void bc_encrypt_decrypt(uint32_t offset, uint8_t* data, size_t len);
+    void aes_encrypt(uint8_t* data, size_t len);
+    void aes_decrypt(uint8_t* data, size_t len);
 };
 
 } // namespace baichuan
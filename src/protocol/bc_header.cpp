@@ -180,4 +180,16 @@ std::vector<uint8_t> BcMessage::serialize() const {
     return buf;
 }
 
+BcMessage BcMessageView::to_owned() const {
+    BcMessage msg;
+    msg.header = header;
+    if (extension_len > 0) {
+        msg.extension_data.assign(extension_data, extension_data + extension_len);
+    }
+    if (payload_len > 0) {
+        msg.payload_data.assign(payload_data, payload_data + payload_len);
+    }
+    return msg;
+}
+
 } // namespace baichuan
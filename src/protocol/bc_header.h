@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 #include <optional>
 #include <string>
@@ -41,6 +42,9 @@ constexpr uint16_t MSG_CLASS_MODERN_24_ALT = 0x0000; // Modern 24-byte header (a
 constexpr size_t HEADER_SIZE_20 = 20;
 constexpr size_t HEADER_SIZE_24 = 24;
 
+// Upper bound on body_len accepted from the wire (guards against corrupt headers)
+constexpr uint32_t MAX_BODY_SIZE = 16 * 1024 * 1024;
+
 // Response codes
 constexpr uint16_t RESPONSE_CODE_OK = 200;
 constexpr uint16_t RESPONSE_CODE_BAD_REQUEST = 400;
@@ -127,4 +131,18 @@ struct BcMessage {
     std::vector<uint8_t> serialize() const;
 };
 
+// Non-owning view of a received message
+// extension_data/payload_data point into the connection's receive buffer and
+// are only valid while the receive callback runs; use to_owned() to keep them
+struct BcMessageView {
+    BcHeader header;
+    const uint8_t* extension_data = nullptr;
+    size_t extension_len = 0;
+    const uint8_t* payload_data = nullptr;
+    size_t payload_len = 0;
+
+    // Copy the spans into a self-contained message
+    BcMessage to_owned() const;
+};
+
 } // namespace baichuan
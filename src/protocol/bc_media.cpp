@@ -1,6 +1,7 @@
 #include "protocol/bc_media.h"
 #include "utils/logger.h"
 #include <cstring>
+#include <algorithm>
 
 namespace baichuan {
 
@@ -182,7 +183,7 @@ std::optional<std::pair<BcMediaIFrame, size_t>> BcMediaParser::parse_iframe(cons
     if (len < total_size) return std::nullopt;
 
     // Copy frame data
-    frame.data.assign(data + header_consumed, data + header_consumed + payload_size);
+    frame.data = FrameBuffer::copy_of(data + header_consumed, payload_size);
 
     LOG_DEBUG("Parsed IFrame: {} bytes, codec={}", payload_size,
               frame.codec == VideoCodec::H264 ? "H264" : "H265");
@@ -213,7 +214,7 @@ std::optional<std::pair<BcMediaPFrame, size_t>> BcMediaParser::parse_pframe(cons
     if (len < total_size) return std::nullopt;
 
     // Copy frame data
-    frame.data.assign(data + header_consumed, data + header_consumed + payload_size);
+    frame.data = FrameBuffer::copy_of(data + header_consumed, payload_size);
 
     return std::make_pair(std::move(frame), total_size);
 }
@@ -248,7 +249,7 @@ std::optional<std::pair<BcMediaAdpcm, size_t>> BcMediaParser::parse_adpcm(const
     uint16_t payload_size = read_u16_le(data);
     // payload_size includes the 4 bytes of more_magic and block_size
 
-    if (len < 4 + payload_size) return std::nullopt;
+    if (len < 4 + static_cast<size_t>(payload_size)) return std::nullopt;
 
     BcMediaAdpcm frame;
     // Skip the inner header (more_magic + block_size = 4 bytes)
@@ -286,7 +287,7 @@ bool BcMediaParser::is_video_frame(const BcMediaFrame& frame) {
            std::holds_alternative<BcMediaPFrame>(frame);
 }
 
-const std::vector<uint8_t>* BcMediaParser::get_video_data(const BcMediaFrame& frame) {
+const FrameBuffer* BcMediaParser::get_video_data(const BcMediaFrame& frame) {
     if (auto* iframe = std::get_if<BcMediaIFrame>(&frame)) {
         return &iframe->data;
     }
@@ -306,4 +307,270 @@ std::optional<VideoCodec> BcMediaParser::get_video_codec(const BcMediaFrame& fra
     return std::nullopt;
 }
 
+// BcMediaStreamParser methods
+BcMediaStreamParser::BcMediaStreamParser(FrameHandler handler)
+    : handler_(std::move(handler)) {}
+
+void BcMediaStreamParser::reset() {
+    state_ = State::Magic;
+    header_len_ = 0;
+    header_need_ = 0;
+    extra_remaining_ = 0;
+    extra_pos_ = 0;
+    frame_ = BcMediaInfo{};
+    payload_ = nullptr;
+    payload_size_ = 0;
+    payload_pos_ = 0;
+    padding_remaining_ = 0;
+    frame_size_ = 0;
+    pending_ = 0;
+    skipped_run_ = 0;
+}
+
+void BcMediaStreamParser::feed(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+
+    while (pos < len) {
+        size_t avail = len - pos;
+
+        switch (state_) {
+            case State::Magic: {
+                size_t n = std::min(4 - header_len_, avail);
+                memcpy(header_ + header_len_, data + pos, n);
+                header_len_ += n;
+                pos += n;
+                if (header_len_ < 4) {
+                    break;
+                }
+
+                uint32_t magic = read_u32_le(header_);
+                if (!BcMediaParser::is_bcmedia_magic(magic)) {
+                    // Unknown magic - skip one byte and try to resync
+                    memmove(header_, header_ + 1, 3);
+                    header_len_ = 3;
+                    skipped_run_++;
+                    skipped_total_++;
+                    break;
+                }
+
+                if (skipped_run_ > 0) {
+                    LOG_WARN("Skipped {} bytes of unknown media data to resync", skipped_run_);
+                    skipped_run_ = 0;
+                }
+
+                // Fixed header size (after the magic) for each frame type
+                if (magic == MAGIC_BCMEDIA_INFO_V1 || magic == MAGIC_BCMEDIA_INFO_V2) {
+                    type_ = BcMediaType::Info;
+                    header_need_ = 4 + 32;
+                } else if (magic >= MAGIC_BCMEDIA_IFRAME && magic <= MAGIC_BCMEDIA_IFRAME_LAST) {
+                    type_ = BcMediaType::IFrame;
+                    header_need_ = 4 + 20;
+                } else if (magic >= MAGIC_BCMEDIA_PFRAME && magic <= MAGIC_BCMEDIA_PFRAME_LAST) {
+                    type_ = BcMediaType::PFrame;
+                    header_need_ = 4 + 20;
+                } else if (magic == MAGIC_BCMEDIA_AAC) {
+                    type_ = BcMediaType::Aac;
+                    header_need_ = 4 + 4;
+                } else {
+                    type_ = BcMediaType::Adpcm;
+                    header_need_ = 4 + 8;
+                }
+                pending_ = header_len_;
+                state_ = State::Header;
+                break;
+            }
+
+            case State::Header: {
+                size_t n = std::min(header_need_ - header_len_, avail);
+                memcpy(header_ + header_len_, data + pos, n);
+                header_len_ += n;
+                pending_ += n;
+                pos += n;
+                if (header_len_ == header_need_) {
+                    on_header();
+                }
+                break;
+            }
+
+            case State::Extra: {
+                size_t n = std::min(extra_remaining_, avail);
+                if (extra_pos_ < sizeof(extra_)) {
+                    size_t keep = std::min(sizeof(extra_) - extra_pos_, n);
+                    memcpy(extra_ + extra_pos_, data + pos, keep);
+                }
+                extra_pos_ += n;
+                extra_remaining_ -= n;
+                pending_ += n;
+                pos += n;
+                if (extra_remaining_ == 0) {
+                    on_extra();
+                }
+                break;
+            }
+
+            case State::Payload: {
+                size_t n = std::min(payload_size_ - payload_pos_, avail);
+                memcpy(payload_ + payload_pos_, data + pos, n);
+                payload_pos_ += n;
+                pending_ += n;
+                pos += n;
+                if (payload_pos_ == payload_size_) {
+                    emit();
+                }
+                break;
+            }
+
+            case State::Padding: {
+                size_t n = std::min(padding_remaining_, avail);
+                padding_remaining_ -= n;
+                pos += n;
+                if (padding_remaining_ == 0) {
+                    reset();
+                }
+                break;
+            }
+        }
+    }
+}
+
+void BcMediaStreamParser::on_header() {
+    const uint8_t* h = header_ + 4;
+    frame_size_ = header_need_;
+
+    switch (type_) {
+        case BcMediaType::Info: {
+            auto result = BcMediaParser::parse(header_, header_len_);
+            if (result) {
+                frame_ = std::move(result->first);
+            }
+            begin_payload(0, 0);
+            return;
+        }
+
+        case BcMediaType::IFrame:
+        case BcMediaType::PFrame: {
+            uint32_t payload_size = read_u32_le(h + 4);
+            uint32_t additional_header = read_u32_le(h + 8);
+            if (payload_size > BCMEDIA_MAX_PAYLOAD_SIZE || additional_header > BCMEDIA_MAX_PAYLOAD_SIZE) {
+                LOG_WARN("Implausible {} sizes (payload={}, additional={}), resyncing",
+                         BcMediaParser::type_name(type_), payload_size, additional_header);
+                resync();
+                return;
+            }
+
+            if (type_ == BcMediaType::IFrame) {
+                BcMediaIFrame frame;
+                frame.codec = parse_video_type(h);
+                frame.microseconds = read_u32_le(h + 12);
+                frame_ = std::move(frame);
+                // Only an additional header of 4+ bytes (POSIX time) is skipped
+                extra_remaining_ = additional_header >= 4 ? additional_header : 0;
+            } else {
+                BcMediaPFrame frame;
+                frame.codec = parse_video_type(h);
+                frame.microseconds = read_u32_le(h + 12);
+                frame_ = std::move(frame);
+                extra_remaining_ = additional_header;
+            }
+
+            // Payload size is kept in header_ until the additional header is skipped
+            if (extra_remaining_ > 0) {
+                extra_pos_ = 0;
+                frame_size_ += extra_remaining_;
+                state_ = State::Extra;
+                return;
+            }
+            on_extra();
+            return;
+        }
+
+        case BcMediaType::Aac: {
+            uint16_t payload_size = read_u16_le(h);
+            frame_ = BcMediaAac{};
+            begin_payload(payload_size, calculate_padding(payload_size));
+            return;
+        }
+
+        case BcMediaType::Adpcm: {
+            // payload_size includes the 4 bytes of more_magic and block_size
+            uint16_t payload_size = read_u16_le(h);
+            frame_ = BcMediaAdpcm{};
+            begin_payload(payload_size >= 4 ? payload_size - 4 : 0, 0);
+            return;
+        }
+    }
+}
+
+void BcMediaStreamParser::on_extra() {
+    if (type_ == BcMediaType::IFrame && extra_pos_ >= 4) {
+        std::get<BcMediaIFrame>(frame_).posix_time = read_u32_le(extra_);
+    }
+
+    uint32_t payload_size = read_u32_le(header_ + 4 + 4);
+    begin_payload(payload_size, calculate_padding(payload_size));
+}
+
+void BcMediaStreamParser::begin_payload(size_t payload_size, size_t padding) {
+    frame_size_ += payload_size + padding;
+    padding_remaining_ = padding;
+    payload_size_ = payload_size;
+    payload_pos_ = 0;
+
+    // Allocate the payload once; chunks are copied straight into it.
+    // Video payloads come from the buffer pool
+    payload_ = std::visit([payload_size](auto& arg) -> uint8_t* {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, BcMediaInfo>) {
+            return nullptr;
+        } else if constexpr (std::is_same_v<T, BcMediaIFrame> || std::is_same_v<T, BcMediaPFrame>) {
+            arg.data = FrameBuffer::allocate(payload_size);
+            return arg.data.data();
+        } else {
+            arg.data.resize(payload_size);
+            return arg.data.data();
+        }
+    }, frame_);
+
+    if (payload_size == 0 || !payload_) {
+        emit();
+        return;
+    }
+
+    state_ = State::Payload;
+}
+
+void BcMediaStreamParser::emit() {
+    if (type_ == BcMediaType::IFrame) {
+        const auto& frame = std::get<BcMediaIFrame>(frame_);
+        LOG_DEBUG("Parsed IFrame: {} bytes, codec={}", frame.data.size(),
+                  frame.codec == VideoCodec::H264 ? "H264" : "H265");
+    }
+
+    if (handler_) {
+        handler_(frame_, frame_size_);
+    }
+
+    if (padding_remaining_ > 0) {
+        // Release the payload now; the padding carries no data
+        frame_ = BcMediaInfo{};
+        payload_ = nullptr;
+        state_ = State::Padding;
+    } else {
+        reset();
+    }
+}
+
+void BcMediaStreamParser::resync() {
+    // Drop the first byte of the bogus magic and re-scan the rest of the header
+    uint8_t replay[sizeof(header_)];
+    size_t replay_len = header_len_ - 1;
+    memcpy(replay, header_ + 1, replay_len);
+
+    size_t skipped = skipped_run_ + 1;
+    reset();
+    skipped_run_ = skipped;
+    skipped_total_++;
+    feed(replay, replay_len);
+}
+
 } // namespace baichuan
@@ -5,6 +5,8 @@
 #include <variant>
 #include <optional>
 #include <string>
+#include <functional>
+#include "utils/buffer_pool.h"
 
 namespace baichuan {
 
@@ -21,6 +23,10 @@ constexpr uint32_t MAGIC_BCMEDIA_ADPCM = 0x62773130;      // "bw10"
 // Padding size for media packets
 constexpr uint32_t BCMEDIA_PAD_SIZE = 8;
 
+// Largest frame payload accepted by the stream parser (larger sizes are
+// treated as a corrupt header)
+constexpr uint32_t BCMEDIA_MAX_PAYLOAD_SIZE = 16 * 1024 * 1024;
+
 enum class VideoCodec {
     H264,
     H265
@@ -50,14 +56,14 @@ struct BcMediaIFrame {
     VideoCodec codec = VideoCodec::H264;
     uint32_t microseconds = 0;
     std::optional<uint32_t> posix_time;  // Seconds since epoch
-    std::vector<uint8_t> data;
+    FrameBuffer data;                    // Pooled; copies share the payload
 };
 
 // Video P-Frame (delta frame)
 struct BcMediaPFrame {
     VideoCodec codec = VideoCodec::H264;
     uint32_t microseconds = 0;
-    std::vector<uint8_t> data;
+    FrameBuffer data;                    // Pooled; copies share the payload
 };
 
 // AAC audio frame
@@ -117,7 +123,7 @@ public:
     static bool is_video_frame(const BcMediaFrame& frame);
 
     // Get video data from frame (returns nullptr for non-video frames)
-    static const std::vector<uint8_t>* get_video_data(const BcMediaFrame& frame);
+    static const FrameBuffer* get_video_data(const BcMediaFrame& frame);
 
     // Get video codec from frame (returns nullopt for non-video frames)
     static std::optional<VideoCodec> get_video_codec(const BcMediaFrame& frame);
@@ -130,4 +136,75 @@ private:
     static std::optional<std::pair<BcMediaAdpcm, size_t>> parse_adpcm(const uint8_t* data, size_t len);
 };
 
+// Incremental BcMedia parser for a stream that arrives in arbitrary chunks
+//
+// feed() takes every byte it is given: frame headers are collected in a small
+// fixed buffer, payloads are copied once straight into the frame being built,
+// and each frame is handed to the callback exactly once when its payload is
+// complete. Nothing is re-scanned when a large frame spans many BC messages.
+// Bytes that do not start with a known magic are skipped to resync.
+class BcMediaStreamParser {
+public:
+    // frame_size is the number of stream bytes the frame occupies
+    // (magic + headers + payload + padding)
+    using FrameHandler = std::function<void(const BcMediaFrame& frame, size_t frame_size)>;
+
+    explicit BcMediaStreamParser(FrameHandler handler);
+
+    // Consume a chunk of stream data
+    void feed(const uint8_t* data, size_t len);
+
+    // Drop any partially parsed frame
+    void reset();
+
+    // Bytes held for the frame currently being assembled
+    size_t pending_bytes() const { return pending_; }
+
+    // Total bytes skipped while looking for a valid magic
+    uint64_t skipped_bytes() const { return skipped_total_; }
+
+private:
+    enum class State {
+        Magic,      // Collecting the 4-byte magic
+        Header,     // Collecting the fixed-size header for this frame type
+        Extra,      // Skipping the IFrame/PFrame additional header
+        Payload,    // Copying payload bytes into the frame
+        Padding     // Skipping alignment padding after the payload
+    };
+
+    FrameHandler handler_;
+
+    State state_ = State::Magic;
+    BcMediaType type_ = BcMediaType::Info;
+
+    // Magic + largest fixed header (Info: 4 + 32)
+    uint8_t header_[36];
+    size_t header_len_ = 0;
+    size_t header_need_ = 0;
+
+    size_t extra_remaining_ = 0;
+    size_t extra_pos_ = 0;
+    uint8_t extra_[4];
+
+    BcMediaFrame frame_;
+    uint8_t* payload_ = nullptr;
+    size_t payload_size_ = 0;
+    size_t payload_pos_ = 0;
+    size_t padding_remaining_ = 0;
+
+    size_t frame_size_ = 0;
+    size_t pending_ = 0;
+    size_t skipped_run_ = 0;
+    uint64_t skipped_total_ = 0;
+
+    // Header complete: set up the frame and work out what follows
+    void on_header();
+    // Additional header complete (IFrame POSIX time)
+    void on_extra();
+    // Start the payload (or emit straight away when it is empty)
+    void begin_payload(size_t payload_size, size_t padding);
+    void emit();
+    void resync();
+};
+
 } // namespace baichuan
@@ -5,7 +5,10 @@
 #include <libxml/tree.h>
 #include <libxml/xmlwriter.h>
 #include <sstream>
+#include <string_view>
+#include <cerrno>
 #include <cstring>
+#include <cstdlib>
 #include <memory>
 
 namespace baichuan {
@@ -58,6 +61,262 @@ std::string get_attr(xmlNode* node, const char* name) {
     return result;
 }
 
+// Unsigned number the way std::stoul reads it (leading space, digits up to
+// the first non-digit); nullopt instead of throwing on malformed values
+std::optional<unsigned long> parse_number(const std::string& text) {
+    const char* start = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(start, &end, 10);
+    if (end == start || errno == ERANGE) return std::nullopt;
+    return value;
+}
+
+// Single-pass scanner for the fixed <Extension> schema
+//
+// Every media message carries an Extension; building a libxml2 DOM for it
+// costs several allocations per message. This handles the plain subset the
+// cameras send - optional XML declaration, <Extension version="..."> and
+// flat children with simple text - reading straight from the bytes. The
+// only allocations are for userName/token, and for version strings longer
+// than the small-string buffer. Anything else (comments, entities, CDATA,
+// nested or non-ASCII content, odd numbers) makes scan() return false, and
+// the caller hands the bytes to libxml2 instead. That gives the same result
+// for the input, or rejects it.
+class ExtensionScanner {
+public:
+    ExtensionScanner(const char* data, size_t len)
+        : begin_(data), p_(data), end_(data + len) {}
+
+    bool scan(ExtensionXml& out) {
+        if (starts_with("<?xml") && !skip_declaration()) return false;
+        skip_space();
+        if (!starts_with("<Extension")) return false;
+        p_ += 10;
+        if (!scan_attributes(out)) return false;
+
+        while (true) {
+            skip_space();
+            if (starts_with("</")) {
+                p_ += 2;
+                std::string_view name;
+                if (!read_name(name) || name != "Extension") return false;
+                skip_space();
+                if (!consume('>')) return false;
+                skip_space();
+                return p_ == end_;
+            }
+            if (!scan_child(out)) return false;
+        }
+    }
+
+private:
+    const char* begin_;
+    const char* p_;
+    const char* end_;
+
+    static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    bool starts_with(std::string_view literal) const {
+        return static_cast<size_t>(end_ - p_) >= literal.size() &&
+               std::memcmp(p_, literal.data(), literal.size()) == 0;
+    }
+
+    bool consume(char c) {
+        if (p_ == end_ || *p_ != c) return false;
+        p_++;
+        return true;
+    }
+
+    bool skip_space() {
+        const char* start = p_;
+        while (p_ != end_ && is_space(*p_)) p_++;
+        return p_ != start;
+    }
+
+    static bool name_start(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    static bool name_char(char c) { return name_start(c) || (c >= '0' && c <= '9') || c == '-' || c == '.'; }
+
+    // Plain ASCII names only (no namespace prefixes)
+    bool read_name(std::string_view& name) {
+        const char* start = p_;
+        if (p_ == end_ || !name_start(*p_)) return false;
+        while (p_ != end_ && name_char(*p_)) {
+            p_++;
+        }
+        name = std::string_view(start, static_cast<size_t>(p_ - start));
+        return true;
+    }
+
+    // Printable ASCII that libxml2 would return unchanged: no entities, no
+    // CR (line ends are normalised), no "]]>"
+    static bool plain_char(const char* pos, const char* begin) {
+        unsigned char c = static_cast<unsigned char>(*pos);
+        if (c >= 0x80 || c == '&' || c == '<' || c == '\r') return false;
+        if (c < 0x20 && c != '\t' && c != '\n') return false;
+        if (c == '>' && pos - begin >= 2 && pos[-1] == ']' && pos[-2] == ']') return false;
+        return true;
+    }
+
+    bool read_quoted(std::string_view& value) {
+        if (p_ == end_ || (*p_ != '"' && *p_ != '\'')) return false;
+        char quote = *p_++;
+        const char* start = p_;
+        while (p_ != end_ && *p_ != quote) {
+            // Attribute values also normalise tabs and newlines to spaces
+            if (!plain_char(p_, start) || *p_ == '\t' || *p_ == '\n') return false;
+            p_++;
+        }
+        if (p_ == end_) return false;
+        value = std::string_view(start, static_cast<size_t>(p_ - start));
+        p_++;
+        return true;
+    }
+
+    // name ws* = ws* "value"
+    bool read_attribute(std::string_view& name, std::string_view& value) {
+        if (!read_name(name)) return false;
+        skip_space();
+        if (!consume('=')) return false;
+        skip_space();
+        return read_quoted(value);
+    }
+
+    // <?xml version="1.0" [encoding="UTF-8"] ?> at the very start
+    bool skip_declaration() {
+        if (p_ != begin_) return false;
+        p_ += 5;
+        std::string_view name, value;
+        if (!skip_space() || !read_attribute(name, value) || name != "version" || value != "1.0") {
+            return false;
+        }
+        bool spaced = skip_space();
+        if (spaced && !starts_with("?>")) {
+            if (!read_attribute(name, value) || name != "encoding" ||
+                (value != "UTF-8" && value != "utf-8")) {
+                return false;
+            }
+            skip_space();
+        }
+        if (!starts_with("?>")) return false;
+        p_ += 2;
+        return true;
+    }
+
+    // Attributes of <Extension ...>, through the closing '>'
+    bool scan_attributes(ExtensionXml& out) {
+        bool have_version = false;
+        while (true) {
+            bool spaced = skip_space();
+            if (consume('>')) return true;
+            std::string_view name, value;
+            if (!spaced || !read_attribute(name, value) || name != "version" || have_version) {
+                return false;
+            }
+            have_version = true;
+            if (!value.empty()) {
+                out.version.assign(value.data(), value.size());
+            }
+        }
+    }
+
+    // Digits, optionally space-padded; longer numbers go to libxml2 so
+    // overflow behaves exactly as before
+    static bool read_number(std::string_view text, uint32_t& value) {
+        size_t i = 0;
+        while (i < text.size() && is_space(text[i])) i++;
+        size_t digits_start = i;
+        value = 0;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+            value = value * 10 + static_cast<uint32_t>(text[i] - '0');
+            i++;
+        }
+        size_t digits = i - digits_start;
+        while (i < text.size() && is_space(text[i])) i++;
+        return digits > 0 && digits <= 9 && i == text.size();
+    }
+
+    // <name>text</name>; the first occurrence of each field wins, as with
+    // find_child(); unknown elements are skipped
+    bool scan_child(ExtensionXml& out) {
+        std::string_view name, close;
+        if (!consume('<') || !read_name(name)) return false;
+        skip_space();
+        if (!consume('>')) return false;
+
+        const char* start = p_;
+        while (p_ != end_ && *p_ != '<') {
+            if (!plain_char(p_, start)) return false;
+            p_++;
+        }
+        std::string_view text(start, static_cast<size_t>(p_ - start));
+
+        if (!starts_with("</")) return false;
+        p_ += 2;
+        if (!read_name(close) || close != name) return false;
+        skip_space();
+        if (!consume('>')) return false;
+
+        uint32_t number;
+        if (name == "binaryData") {
+            if (!read_number(text, number)) return false;
+            if (!out.binary_data) out.binary_data = number;
+        } else if (name == "channelId") {
+            if (!read_number(text, number)) return false;
+            if (!out.channel_id) out.channel_id = static_cast<uint8_t>(number);
+        } else if (name == "encryptLen") {
+            if (!read_number(text, number)) return false;
+            if (!out.encrypt_len) out.encrypt_len = number;
+        } else if (name == "userName") {
+            if (!out.user_name) out.user_name = std::string(text);
+        } else if (name == "token") {
+            if (!out.token) out.token = std::string(text);
+        }
+        return true;
+    }
+};
+
+// libxml2 path for Extension XML the scanner doesn't handle
+std::optional<ExtensionXml> parse_extension_dom(const char* data, size_t len) {
+    XmlDocPtr doc(xmlReadMemory(data, static_cast<int>(len),
+                                nullptr, nullptr, XML_PARSE_NOERROR | XML_PARSE_NOWARNING));
+    if (!doc) return std::nullopt;
+
+    xmlNode* root = xmlDocGetRootElement(doc.get());
+    if (!root) return std::nullopt;
+
+    xmlNode* ext_node = nullptr;
+    if (xmlStrcmp(root->name, BAD_CAST "Extension") == 0) {
+        ext_node = root;
+    } else {
+        ext_node = find_child(root, "Extension");
+    }
+
+    if (!ext_node) return std::nullopt;
+
+    ExtensionXml result;
+    result.version = get_attr(ext_node, "version");
+    if (result.version.empty()) result.version = XML_VERSION;
+
+    if (xmlNode* n = find_child(ext_node, "binaryData")) {
+        if (auto value = parse_number(get_content(n))) result.binary_data = *value;
+    }
+    if (xmlNode* n = find_child(ext_node, "userName")) {
+        result.user_name = get_content(n);
+    }
+    if (xmlNode* n = find_child(ext_node, "token")) {
+        result.token = get_content(n);
+    }
+    if (xmlNode* n = find_child(ext_node, "channelId")) {
+        if (auto value = parse_number(get_content(n))) result.channel_id = static_cast<uint8_t>(*value);
+    }
+    if (xmlNode* n = find_child(ext_node, "encryptLen")) {
+        if (auto value = parse_number(get_content(n))) result.encrypt_len = *value;
+    }
+
+    return result;
+}
+
 } // anonymous namespace
 
 // EncryptionXml implementation
@@ -136,6 +395,62 @@ std::string PreviewXml::serialize() const {
     return oss.str();
 }
 
+// SnapXml implementation
+std::string SnapXml::serialize() const {
+    std::ostringstream oss;
+    oss << "<Snap version=\"" << version << "\">"
+        << "<channelId>" << static_cast<int>(channel_id) << "</channelId>"
+        << "<logicChannel>" << static_cast<int>(channel_id) << "</logicChannel>"
+        << "<time>" << time << "</time>"
+        << "<fullFrame>" << full_frame << "</fullFrame>"
+        << "<streamType>" << stream_type << "</streamType>"
+        << "</Snap>";
+    return oss.str();
+}
+
+std::optional<SnapXml> SnapXml::parse(const std::string& xml) {
+    XmlDocPtr doc(xmlReadMemory(xml.c_str(), static_cast<int>(xml.size()),
+                                nullptr, nullptr, XML_PARSE_NOERROR | XML_PARSE_NOWARNING));
+    if (!doc) return std::nullopt;
+
+    xmlNode* root = xmlDocGetRootElement(doc.get());
+    if (!root) return std::nullopt;
+
+    xmlNode* snap_node = nullptr;
+    if (xmlStrcmp(root->name, BAD_CAST "Snap") == 0) {
+        snap_node = root;
+    } else {
+        snap_node = find_child(root, "Snap");
+    }
+
+    if (!snap_node) return std::nullopt;
+
+    SnapXml result;
+    std::string ver = get_attr(snap_node, "version");
+    if (!ver.empty()) result.version = ver;
+
+    if (xmlNode* n = find_child(snap_node, "channelId")) {
+        if (auto value = parse_number(get_content(n))) result.channel_id = static_cast<uint8_t>(*value);
+    }
+    if (xmlNode* n = find_child(snap_node, "time")) {
+        if (auto value = parse_number(get_content(n))) result.time = static_cast<uint32_t>(*value);
+    }
+    if (xmlNode* n = find_child(snap_node, "fullFrame")) {
+        if (auto value = parse_number(get_content(n))) result.full_frame = static_cast<uint32_t>(*value);
+    }
+    if (xmlNode* n = find_child(snap_node, "streamType")) {
+        result.stream_type = get_content(n);
+    }
+    if (xmlNode* n = find_child(snap_node, "fileName")) {
+        result.file_name = get_content(n);
+    }
+    if (xmlNode* n = find_child(snap_node, "pictureSize")) {
+        if (auto value = parse_number(get_content(n))) result.picture_size = static_cast<uint32_t>(*value);
+    }
+
+    return result;
+}
+
 // ExtensionXml implementation
 std::string ExtensionXml::serialize() const {
     std::ostringstream oss;
@@ -163,43 +478,24 @@ std::string ExtensionXml::serialize() const {
 }
 
 std::optional<ExtensionXml> ExtensionXml::parse(const std::string& xml) {
-    XmlDocPtr doc(xmlReadMemory(xml.c_str(), static_cast<int>(xml.size()),
-                                nullptr, nullptr, XML_PARSE_NOERROR | XML_PARSE_NOWARNING));
-    if (!doc) return std::nullopt;
-
-    xmlNode* root = xmlDocGetRootElement(doc.get());
-    if (!root) return std::nullopt;
-
-    xmlNode* ext_node = nullptr;
-    if (xmlStrcmp(root->name, BAD_CAST "Extension") == 0) {
-        ext_node = root;
-    } else {
-        ext_node = find_child(root, "Extension");
-    }
-
-    if (!ext_node) return std::nullopt;
+    return parse(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+}
 
+std::optional<ExtensionXml> ExtensionXml::parse(const uint8_t* data, size_t len) {
     ExtensionXml result;
-    result.version = get_attr(ext_node, "version");
-    if (result.version.empty()) result.version = XML_VERSION;
-
-    if (xmlNode* n = find_child(ext_node, "binaryData")) {
-        result.binary_data = std::stoul(get_content(n));
-    }
-    if (xmlNode* n = find_child(ext_node, "userName")) {
-        result.user_name = get_content(n);
-    }
-    if (xmlNode* n = find_child(ext_node, "token")) {
-        result.token = get_content(n);
-    }
-    if (xmlNode* n = find_child(ext_node, "channelId")) {
-        result.channel_id = static_cast<uint8_t>(std::stoul(get_content(n)));
-    }
-    if (xmlNode* n = find_child(ext_node, "encryptLen")) {
-        result.encrypt_len = std::stoul(get_content(n));
+    if (scan(data, len, result)) {
+        return result;
     }
+    return parse_dom(data, len);
+}
 
-    return result;
+bool ExtensionXml::scan(const uint8_t* data, size_t len, ExtensionXml& out) {
+    out = ExtensionXml();
+    return ExtensionScanner(reinterpret_cast<const char*>(data), len).scan(out);
+}
+
+std::optional<ExtensionXml> ExtensionXml::parse_dom(const uint8_t* data, size_t len) {
+    return parse_extension_dom(reinterpret_cast<const char*>(data), len);
 }
 
 // DeviceInfoXml implementation
@@ -236,6 +532,57 @@ std::optional<DeviceInfoXml> DeviceInfoXml::parse(const std::string& xml) {
     return result;
 }
 
+// AlarmEventXml implementation
+std::vector<AlarmEventXml> AlarmEventXml::parse_list(const std::string& xml) {
+    std::vector<AlarmEventXml> events;
+
+    XmlDocPtr doc(xmlReadMemory(xml.c_str(), static_cast<int>(xml.size()),
+                                nullptr, nullptr, XML_PARSE_NOERROR | XML_PARSE_NOWARNING));
+    if (!doc) return events;
+
+    xmlNode* root = xmlDocGetRootElement(doc.get());
+    if (!root) return events;
+
+    xmlNode* list_node = nullptr;
+    if (xmlStrcmp(root->name, BAD_CAST "AlarmEventList") == 0) {
+        list_node = root;
+    } else {
+        list_node = find_child(root, "AlarmEventList");
+    }
+
+    if (!list_node) return events;
+
+    // Numeric fields are optional and vary by firmware; bad values read as 0
+    auto get_number = [](xmlNode* parent, const char* name) -> uint32_t {
+        xmlNode* n = find_child(parent, name);
+        if (!n) return 0;
+        std::string text = get_content(n);
+        char* end = nullptr;
+        unsigned long value = std::strtoul(text.c_str(), &end, 10);
+        return end == text.c_str() ? 0 : static_cast<uint32_t>(value);
+    };
+
+    for (xmlNode* cur = list_node->children; cur; cur = cur->next) {
+        if (cur->type != XML_ELEMENT_NODE || xmlStrcmp(cur->name, BAD_CAST "AlarmEvent") != 0) {
+            continue;
+        }
+
+        AlarmEventXml event;
+        event.channel_id = static_cast<uint8_t>(get_number(cur, "channelId"));
+        if (xmlNode* n = find_child(cur, "status")) {
+            event.status = get_content(n);
+        }
+        if (xmlNode* n = find_child(cur, "AItype")) {
+            event.ai_type = get_content(n);
+        }
+        event.recording = get_number(cur, "recording");
+        event.timestamp = get_number(cur, "timeStamp");
+        events.push_back(std::move(event));
+    }
+
+    return events;
+}
+
 // LoginRequestXml implementation
 std::string LoginRequestXml::serialize() const {
     std::ostringstream oss;
@@ -281,6 +628,26 @@ std::string BcXmlBuilder::create_binary_extension(uint8_t channel_id) {
     return ext.serialize();
 }
 
+std::string BcXmlBuilder::create_snap_request(uint8_t channel_id, const std::string& stream_type) {
+    std::ostringstream oss;
+    oss << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"
+        << "<body>";
+
+    SnapXml snap;
+    snap.channel_id = channel_id;
+    snap.stream_type = stream_type;
+    oss << snap.serialize();
+
+    oss << "</body>";
+    return oss.str();
+}
+
+std::string BcXmlBuilder::create_channel_extension(uint8_t channel_id) {
+    ExtensionXml ext;
+    ext.channel_id = channel_id;
+    return ext.serialize();
+}
+
 std::optional<EncryptionXml> BcXmlBuilder::parse_encryption(const std::string& xml) {
     return EncryptionXml::parse(xml);
 }
@@ -293,6 +660,10 @@ std::optional<ExtensionXml> BcXmlBuilder::parse_extension(const std::string& xml
     return ExtensionXml::parse(xml);
 }
 
+std::optional<ExtensionXml> BcXmlBuilder::parse_extension(const uint8_t* data, size_t len) {
+    return ExtensionXml::parse(data, len);
+}
+
 std::optional<std::string> BcXmlBuilder::extract_tag(const std::string& xml, const std::string& tag) {
     // Simple regex-free extraction for basic cases
     std::string open_tag = "<" + tag;
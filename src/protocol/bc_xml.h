@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cstdint>
+#include <cstddef>
 #include <optional>
 #include <vector>
 
@@ -57,6 +58,22 @@ struct PreviewXml {
     std::string serialize() const;
 };
 
+// XML structure for Snap (MSG_ID_SNAP request and reply)
+// The camera replies with the picture's name and size, then sends the JPEG
+// as binary messages carrying the request's msg_num
+struct SnapXml {
+    std::string version = XML_VERSION;
+    uint8_t channel_id = 0;
+    uint32_t time = 0;                  // 0 = now
+    uint32_t full_frame = 0;
+    std::string stream_type = "main";   // "main" or "sub" (resolution of the picture)
+    std::optional<std::string> file_name;   // Reply only
+    std::optional<uint32_t> picture_size;   // Reply only: JPEG bytes to follow
+
+    std::string serialize() const;
+    static std::optional<SnapXml> parse(const std::string& xml);
+};
+
 // XML structure for Extension (metadata for payload)
 struct ExtensionXml {
     std::string version = XML_VERSION;
@@ -68,6 +85,32 @@ struct ExtensionXml {
 
     std::string serialize() const;
     static std::optional<ExtensionXml> parse(const std::string& xml);
+
+    // Same, straight from a message's bytes (no copy); the plain form the
+    // cameras send is scanned without libxml2 or allocations, anything
+    // else goes through libxml2
+    static std::optional<ExtensionXml> parse(const uint8_t* data, size_t len);
+
+    // The two paths of parse(), for tests and benchmarks: scan() returns
+    // false for anything but the plain form, parse_dom() always uses libxml2
+    static bool scan(const uint8_t* data, size_t len, ExtensionXml& out);
+    static std::optional<ExtensionXml> parse_dom(const uint8_t* data, size_t len);
+};
+
+// XML structure for AlarmEvent (pushed by the camera as MSG_ID_MOTION)
+// <AlarmEventList><AlarmEvent><channelId/><status/><AItype/><recording/><timeStamp/></AlarmEvent>...
+struct AlarmEventXml {
+    uint8_t channel_id = 0;
+    std::string status;     // "MD" (motion), "none", or a detection type on some firmware
+    std::string ai_type;    // "people", "vehicle", ... or "none" (AI-capable cameras only)
+    uint32_t recording = 0;
+    uint32_t timestamp = 0;
+
+    // Anything other than "none" counts as motion
+    bool is_motion() const { return !status.empty() && status != "none"; }
+
+    // Parse every AlarmEvent in an AlarmEventList (empty on malformed input)
+    static std::vector<AlarmEventXml> parse_list(const std::string& xml);
 };
 
 // Combined login request body
@@ -93,6 +136,12 @@ public:
     // Create extension XML for binary data
     static std::string create_binary_extension(uint8_t channel_id);
 
+    // Create snapshot request XML ("main" or "sub")
+    static std::string create_snap_request(uint8_t channel_id, const std::string& stream_type);
+
+    // Create extension XML naming the channel a request is for
+    static std::string create_channel_extension(uint8_t channel_id);
+
     // Parse encryption response to get nonce
     static std::optional<EncryptionXml> parse_encryption(const std::string& xml);
 
@@ -101,6 +150,7 @@ public:
 
     // Parse extension from response
     static std::optional<ExtensionXml> parse_extension(const std::string& xml);
+    static std::optional<ExtensionXml> parse_extension(const uint8_t* data, size_t len);
 
     // Generic XML parsing helper - extract text content of a tag
     static std::optional<std::string> extract_tag(const std::string& xml, const std::string& tag);
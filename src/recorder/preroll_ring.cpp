@@ -0,0 +1,63 @@
+#include "recorder/preroll_ring.h"
+#include "utils/logger.h"
+
+namespace baichuan {
+
+PrerollRing::PrerollRing(size_t max_bytes, std::chrono::milliseconds duration)
+    : max_bytes_(max_bytes), duration_(duration) {}
+
+void PrerollRing::push(const VideoPacket& packet) {
+    if (!enabled()) {
+        return;
+    }
+
+    if (packet.keyframe) {
+        overflow_ = false;
+        Gop gop;
+        gop.start = std::chrono::steady_clock::now();
+        gops_.push_back(std::move(gop));
+    } else if (gops_.empty() || overflow_) {
+        return;
+    }
+
+    Gop& current = gops_.back();
+    current.packets.push_back(packet);
+    current.bytes += packet.data.size();
+    bytes_ += packet.data.size();
+
+    trim();
+}
+
+void PrerollRing::trim() {
+    auto window_start = std::chrono::steady_clock::now() - duration_;
+
+    // The oldest GOP is only needed while the next one starts inside the window
+    while (gops_.size() > 1 &&
+           (bytes_ > max_bytes_ || gops_[1].start <= window_start)) {
+        bytes_ -= gops_.front().bytes;
+        gops_.pop_front();
+    }
+
+    if (gops_.size() == 1 && bytes_ > max_bytes_) {
+        LOG_DEBUG("Pre-roll GOP over {} bytes, dropping it until the next keyframe", max_bytes_);
+        gops_.clear();
+        bytes_ = 0;
+        overflow_ = true;
+    }
+}
+
+std::vector<VideoPacket> PrerollRing::contents() const {
+    std::vector<VideoPacket> packets;
+    for (const Gop& gop : gops_) {
+        packets.insert(packets.end(), gop.packets.begin(), gop.packets.end());
+    }
+    return packets;
+}
+
+void PrerollRing::clear() {
+    gops_.clear();
+    bytes_ = 0;
+    overflow_ = false;
+}
+
+} // namespace baichuan
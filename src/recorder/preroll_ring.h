@@ -0,0 +1,55 @@
+#pragma once
+
+#include "worker/camera_worker.h"
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+namespace baichuan {
+
+// In-memory ring of the most recent compressed GOPs of one camera
+//
+// Holds whole GOPs (keyframe plus the packets after it) covering at least
+// `duration` of stream, so an event clip can start that far back without
+// re-encoding. Older GOPs are dropped once the next one alone covers the
+// window, or when the ring exceeds max_bytes. A single GOP larger than
+// max_bytes is discarded and collection restarts at the next keyframe.
+// Payloads are shared FrameBuffers, so buffering costs no copies.
+//
+// Not thread-safe: owned by the SegmentWriter thread.
+class PrerollRing {
+public:
+    PrerollRing(size_t max_bytes, std::chrono::milliseconds duration);
+
+    // Add a packet; packets before the first keyframe are dropped
+    void push(const VideoPacket& packet);
+
+    // Buffered packets, oldest first, starting at a keyframe
+    std::vector<VideoPacket> contents() const;
+
+    // Drop everything (stream restarted)
+    void clear();
+
+    bool enabled() const { return max_bytes_ > 0 && duration_.count() > 0; }
+    size_t bytes() const { return bytes_; }
+    size_t gop_count() const { return gops_.size(); }
+
+private:
+    struct Gop {
+        std::chrono::steady_clock::time_point start;
+        std::vector<VideoPacket> packets;
+        size_t bytes = 0;
+    };
+
+    size_t max_bytes_;
+    std::chrono::milliseconds duration_;
+
+    std::deque<Gop> gops_;
+    size_t bytes_ = 0;
+    bool overflow_ = false;  // Current GOP was dropped; wait for a keyframe
+
+    void trim();
+};
+
+} // namespace baichuan
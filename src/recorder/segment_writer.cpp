@@ -0,0 +1,452 @@
+#include "recorder/segment_writer.h"
+#include "utils/logger.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <ctime>
+
+namespace baichuan {
+
+namespace {
+
+// Camera names become directory names
+std::string sanitize_name(const std::string& name) {
+    std::string out;
+    for (char c : name) {
+        bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+        out += safe ? c : '_';
+    }
+    if (out.empty() || out == "." || out == "..") {
+        out = "camera";
+    }
+    return out;
+}
+
+} // namespace
+
+SegmentWriter::SegmentWriter(const RecordingConfig& config, const std::string& camera_name)
+    : directory_(config.directory + "/" + sanitize_name(camera_name)),
+      extension_(config.format == "fmp4" || config.format.empty() ? "mp4" : config.format),
+      fragmented_(config.format == "fmp4"),
+      continuous_(config.mode != "events" && config.mode != "motion"),
+      segment_length_(config.segment_seconds > 0 ? config.segment_seconds : 300),
+      event_length_(config.event_seconds > 0 ? config.event_seconds : 30),
+      retention_age_(config.retention_hours > 0 ? config.retention_hours : 0),
+      retention_bytes_(config.retention_mb > 0 ? static_cast<uint64_t>(config.retention_mb) * 1024 * 1024 : 0),
+      preroll_(config.pre_roll_mb > 0 ? static_cast<size_t>(config.pre_roll_mb) * 1024 * 1024 : 0,
+               std::chrono::seconds(config.pre_roll_seconds > 0 ? config.pre_roll_seconds : 0)) {
+    segment_.set_fragmented(fragmented_);
+    event_.set_fragmented(fragmented_);
+    thread_ = std::thread(&SegmentWriter::run, this);
+}
+
+SegmentWriter::~SegmentWriter() {
+    stop();
+}
+
+bool SegmentWriter::write(const VideoPacket& packet) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (stopping_) {
+            return false;
+        }
+
+        // After a drop the next packets can't be decoded until a keyframe
+        if (resync_ && !packet.keyframe) {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            stats_.packets_dropped++;
+            return false;
+        }
+        if (queued_bytes_ + packet.data.size() > max_queue_bytes_) {
+            if (!resync_) {
+                LOG_WARN("Recording queue for {} over {} bytes, dropping until next keyframe",
+                         directory_, max_queue_bytes_);
+            }
+            resync_ = true;
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            stats_.packets_dropped++;
+            return false;
+        }
+        resync_ = false;
+
+        Item item;
+        item.kind = Item::Kind::Packet;
+        item.packet = packet;
+        queued_bytes_ += packet.data.size();
+        queue_.push_back(std::move(item));
+    }
+    queue_cv_.notify_one();
+    return true;
+}
+
+void SegmentWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        Item item;
+        item.kind = Item::Kind::Close;
+        queue_.push_back(std::move(item));
+    }
+    queue_cv_.notify_one();
+}
+
+void SegmentWriter::trigger_event(int seconds) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        Item item;
+        item.kind = Item::Kind::Event;
+        item.seconds = seconds;
+        queue_.push_back(std::move(item));
+    }
+    queue_cv_.notify_one();
+}
+
+void SegmentWriter::set_motion(bool active) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        Item item;
+        item.kind = Item::Kind::Motion;
+        item.active = active;
+        queue_.push_back(std::move(item));
+    }
+    queue_cv_.notify_one();
+}
+
+void SegmentWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+SegmentWriter::Stats SegmentWriter::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void SegmentWriter::run() {
+    apply_retention();
+
+    while (true) {
+        Item item;
+        size_t queued_bytes;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                break;  // Stopping and drained
+            }
+            item = std::move(queue_.front());
+            queue_.pop_front();
+            if (item.kind == Item::Kind::Packet) {
+                queued_bytes_ -= item.packet.data.size();
+            }
+            queued_bytes = queued_bytes_;
+        }
+
+        switch (item.kind) {
+            case Item::Kind::Packet:
+                handle_packet(item.packet);
+                break;
+            case Item::Kind::Close:
+                close_segment();
+                close_event();
+                preroll_.clear();
+                apply_retention();
+                break;
+            case Item::Kind::Event:
+                start_event(item.seconds);
+                break;
+            case Item::Kind::Motion:
+                set_event_motion(item.active);
+                break;
+        }
+
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.queued_bytes = queued_bytes;
+        stats_.preroll_bytes = preroll_.bytes();
+        stats_.preroll_gops = preroll_.gop_count();
+    }
+
+    close_segment();
+    close_event();
+}
+
+void SegmentWriter::handle_packet(const VideoPacket& packet) {
+    // An event triggered with nothing buffered starts at the next keyframe
+    if (event_pending_) {
+        if (event_expired()) {
+            event_pending_ = false;
+        } else if (packet.keyframe) {
+            event_pending_ = false;
+            open_event(packet.codec);
+        }
+    }
+
+    preroll_.push(packet);
+
+    if (continuous_) {
+        write_segment(packet);
+    }
+    if (event_.is_open()) {
+        write_event(packet);
+    }
+}
+
+void SegmentWriter::write_segment(const VideoPacket& packet) {
+    if (segment_.is_open() && packet.keyframe) {
+        // Cut at the first keyframe past the segment length (or on a codec change)
+        auto elapsed = std::chrono::steady_clock::now() - segment_start_;
+        if (elapsed >= segment_length_ || packet.codec != segment_codec_) {
+            close_segment();
+            apply_retention();
+        }
+    }
+
+    if (!segment_.is_open()) {
+        std::string filename;
+        if (!packet.keyframe || !open_file(segment_, directory_, packet.codec, filename)) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.packets_skipped++;
+            return;
+        }
+        segment_codec_ = packet.codec;
+        segment_start_ = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.segments++;
+        stats_.current_file = filename;
+    }
+
+    bool written = segment_.write_packet(packet.data.data(), packet.data.size(),
+                                         packet.keyframe, packet.timestamp_us);
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    if (written) {
+        stats_.packets_written++;
+        stats_.bytes_written += packet.data.size();
+    } else {
+        // A segment that failed to start has closed itself; retry at the next keyframe
+        if (!segment_.is_open()) {
+            stats_.current_file.clear();
+        }
+        stats_.packets_skipped++;
+    }
+}
+
+void SegmentWriter::write_event(const VideoPacket& packet) {
+    if (event_expired()) {
+        close_event();
+        apply_retention();
+        return;
+    }
+
+    // Long motion continues in a new clip; the old one already has the pre-roll
+    if (packet.keyframe &&
+        std::chrono::steady_clock::now() - event_start_ >= segment_length_) {
+        bool hold = event_hold_;
+        auto end = event_end_;
+        close_event();
+        apply_retention();
+
+        std::string filename;
+        if (!open_file(event_, directory_ + "/events", packet.codec, filename)) {
+            return;
+        }
+        event_start_ = std::chrono::steady_clock::now();
+        event_hold_ = hold;
+        event_end_ = end;
+
+        LOG_INFO("Event recording continues in {}", filename);
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.events++;
+        stats_.event_file = filename;
+    }
+
+    event_.write_packet(packet.data.data(), packet.data.size(),
+                        packet.keyframe, packet.timestamp_us);
+}
+
+void SegmentWriter::start_event(int seconds) {
+    auto length = seconds > 0 ? std::chrono::seconds(seconds) : event_length_;
+    auto end = std::chrono::steady_clock::now() + length;
+
+    if (event_.is_open() || event_pending_) {
+        event_end_ = std::max(event_end_, end);
+        return;
+    }
+
+    event_end_ = end;
+    if (preroll_.gop_count() == 0) {
+        event_pending_ = true;
+        return;
+    }
+    open_event(VideoCodec::H264);
+}
+
+void SegmentWriter::set_event_motion(bool active) {
+    if (active) {
+        start_event(0);
+        event_hold_ = true;
+        return;
+    }
+
+    // Post-roll: keep recording event_seconds after the motion ends
+    if (event_hold_) {
+        event_hold_ = false;
+        event_end_ = std::chrono::steady_clock::now() + event_length_;
+    }
+}
+
+bool SegmentWriter::event_expired() const {
+    return !event_hold_ && std::chrono::steady_clock::now() >= event_end_;
+}
+
+void SegmentWriter::open_event(VideoCodec codec) {
+    // The pre-roll starts with a keyframe and decides the clip's codec
+    std::vector<VideoPacket> preroll = preroll_.contents();
+    if (!preroll.empty()) {
+        codec = preroll.front().codec;
+    }
+
+    std::string filename;
+    if (!open_file(event_, directory_ + "/events", codec, filename)) {
+        return;
+    }
+
+    for (const VideoPacket& packet : preroll) {
+        event_.write_packet(packet.data.data(), packet.data.size(),
+                            packet.keyframe, packet.timestamp_us);
+    }
+
+    event_start_ = std::chrono::steady_clock::now();
+    LOG_INFO("Event recording to {} ({} pre-roll packets)", filename, preroll.size());
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.events++;
+    stats_.event_file = filename;
+}
+
+bool SegmentWriter::open_file(VideoWriter& writer, const std::string& directory, VideoCodec codec,
+                              std::string& filename) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        LOG_ERROR("Cannot create recording directory {}: {}", directory, ec.message());
+        return false;
+    }
+
+    filename = next_filename(directory);
+    if (!writer.open_passthrough(filename, codec)) {
+        LOG_ERROR("Failed to open recording: {}", filename);
+        return false;
+    }
+    return true;
+}
+
+void SegmentWriter::close_segment() {
+    if (segment_.is_open()) {
+        segment_.close();
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.current_file.clear();
+}
+
+void SegmentWriter::close_event() {
+    event_pending_ = false;
+    event_hold_ = false;
+    if (event_.is_open()) {
+        event_.close();
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.event_file.clear();
+}
+
+void SegmentWriter::apply_retention() {
+    if (retention_age_.count() == 0 && retention_bytes_ == 0) {
+        return;
+    }
+
+    namespace fs = std::filesystem;
+
+    struct Entry {
+        fs::path path;
+        fs::file_time_type mtime;
+        uintmax_t size;
+    };
+
+    std::string open_segment, open_event;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        open_segment = stats_.current_file;
+        open_event = stats_.event_file;
+    }
+
+    // Closed files of this camera (segments and events)
+    std::vector<Entry> files;
+    uintmax_t total = 0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        std::string path = it->path().string();
+        if (path == open_segment || path == open_event) continue;
+
+        Entry entry{it->path(), it->last_write_time(ec), it->file_size(ec)};
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        total += entry.size;
+        files.push_back(std::move(entry));
+    }
+
+    std::sort(files.begin(), files.end(), [](const Entry& a, const Entry& b) {
+        return a.mtime < b.mtime;
+    });
+
+    auto now = fs::file_time_type::clock::now();
+    uint64_t deleted = 0;
+    for (const Entry& file : files) {
+        bool too_old = retention_age_.count() > 0 && now - file.mtime > retention_age_;
+        bool too_big = retention_bytes_ > 0 && total > retention_bytes_;
+        if (!too_old && !too_big) {
+            break;  // Everything after this is newer
+        }
+        if (fs::remove(file.path, ec)) {
+            LOG_DEBUG("Retention: deleted {}", file.path.string());
+            total -= file.size;
+            deleted++;
+        } else if (ec) {
+            LOG_WARN("Retention: cannot delete {}: {}", file.path.string(), ec.message());
+            ec.clear();
+        }
+    }
+
+    if (deleted > 0) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.files_deleted += deleted;
+    }
+}
+
+std::string SegmentWriter::next_filename(const std::string& directory) const {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    localtime_r(&now, &local);
+
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    // A reconnect within the same second must not overwrite the last file
+    std::string base = directory + "/" + stamp;
+    std::string filename = base + "." + extension_;
+    for (int n = 1; std::filesystem::exists(filename); n++) {
+        filename = base + "-" + std::to_string(n) + "." + extension_;
+    }
+    return filename;
+}
+
+} // namespace baichuan
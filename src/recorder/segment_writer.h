@@ -0,0 +1,140 @@
+#pragma once
+
+#include "worker/camera_worker.h"
+#include "recorder/preroll_ring.h"
+#include "video/writer.h"
+#include "utils/json_config.h"
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+namespace baichuan {
+
+// Stream-copy recording of one camera: continuous segments and event clips
+//
+// Segments: <directory>/<camera>/<YYYYmmdd-HHMMSS>.<ext>, named after the
+// local time they start. Every segment begins at a keyframe; once
+// segment_seconds have passed the file is closed at the next keyframe, so
+// each one plays on its own.
+//
+// Events: trigger_event() writes <directory>/<camera>/events/<stamp>.<ext>
+// containing the pre-roll ring (the last pre_roll_seconds of GOPs) followed
+// by event_seconds of live stream. Triggering again while a clip is open
+// extends it.
+//
+// Motion: set_motion() holds an event clip open for as long as the camera
+// reports motion and closes it event_seconds after the motion ends. In
+// "motion" mode nothing else is written, so an idle camera costs only the
+// pre-roll ring in memory. Clips longer than segment_seconds continue in a
+// new file at the next keyframe.
+//
+// Retention: after each file is closed, the oldest closed files of the
+// camera are deleted until they fit retention_mb and retention_hours.
+//
+// write() only queues the packet (payloads are shared, not copied); muxing,
+// file rollover and deletion run on the writer's own thread, so a slow disk
+// never stalls the camera's receive thread. If the queue exceeds its byte
+// bound packets are dropped until the next keyframe.
+class SegmentWriter {
+public:
+    SegmentWriter(const RecordingConfig& config, const std::string& camera_name);
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    // Queue one packet; returns false if it was dropped (queue full)
+    bool write(const VideoPacket& packet);
+
+    // Finish the open files (e.g. when the stream drops); the next keyframe
+    // starts new ones. The pre-roll ring is cleared as timestamps restart.
+    void close();
+
+    // Save an event clip: pre-roll plus `seconds` (0 = event_seconds) of live stream
+    void trigger_event(int seconds = 0);
+
+    // Motion started (clip held open) or ended (clip closes after event_seconds)
+    void set_motion(bool active);
+
+    // Drain the queue, close all files and stop the writer thread
+    void stop();
+
+    struct Stats {
+        uint64_t segments = 0;          // Segment files started
+        uint64_t events = 0;            // Event clips started
+        uint64_t packets_written = 0;   // Packets muxed into segments
+        uint64_t bytes_written = 0;     // Segment payload bytes (excluding container overhead)
+        uint64_t packets_skipped = 0;   // Waiting for a keyframe
+        uint64_t packets_dropped = 0;   // Queue full
+        uint64_t files_deleted = 0;     // Removed by retention
+        size_t queued_bytes = 0;
+        size_t preroll_bytes = 0;
+        size_t preroll_gops = 0;
+        std::string current_file;       // Empty between segments
+        std::string event_file;         // Empty when no event is being written
+    };
+    Stats stats() const;
+
+private:
+    struct Item {
+        enum class Kind { Packet, Close, Event, Motion };
+        Kind kind = Kind::Packet;
+        VideoPacket packet;
+        int seconds = 0;
+        bool active = false;
+    };
+
+    std::string directory_;
+    std::string extension_;
+    bool fragmented_ = false;
+    bool continuous_ = true;
+    std::chrono::seconds segment_length_;
+    std::chrono::seconds event_length_;
+    std::chrono::hours retention_age_;
+    uint64_t retention_bytes_ = 0;
+    size_t max_queue_bytes_ = 16 * 1024 * 1024;
+
+    // Queue between the receive thread and the writer thread
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Item> queue_;
+    size_t queued_bytes_ = 0;
+    bool resync_ = false;     // Dropped a packet; wait for the next keyframe
+    bool stopping_ = false;
+    std::thread thread_;
+
+    // Writer thread state
+    VideoWriter segment_;
+    VideoCodec segment_codec_ = VideoCodec::H264;
+    std::chrono::steady_clock::time_point segment_start_;
+    VideoWriter event_;
+    std::chrono::steady_clock::time_point event_start_;
+    std::chrono::steady_clock::time_point event_end_;
+    bool event_pending_ = false;  // Triggered before any keyframe was buffered
+    bool event_hold_ = false;     // Motion in progress; event_end_ not yet set
+    PrerollRing preroll_;
+
+    mutable std::mutex stats_mutex_;
+    Stats stats_;
+
+    void run();
+    void handle_packet(const VideoPacket& packet);
+    void write_segment(const VideoPacket& packet);
+    void write_event(const VideoPacket& packet);
+    void start_event(int seconds);
+    void set_event_motion(bool active);
+    void open_event(VideoCodec codec);
+    bool event_expired() const;
+    bool open_file(VideoWriter& writer, const std::string& directory, VideoCodec codec,
+                   std::string& filename);
+    void close_segment();
+    void close_event();
+    void apply_retention();
+    std::string next_filename(const std::string& directory) const;
+};
+
+} // namespace baichuan
@@ -0,0 +1,490 @@
+#include "worker/camera_worker.h"
+#include "recorder/segment_writer.h"
+#include "video/camera_snapshot.h"
+#include "control/command_server.h"
+#include "utils/logger.h"
+#include "utils/json_config.h"
+#include "utils/metrics.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <getopt.h>
+#include <unistd.h>
+
+using namespace baichuan;
+
+// Global flag for signal handling, and a self-pipe that wakes main()
+static std::atomic<bool> g_quit{false};
+static int g_quit_pipe[2] = {-1, -1};
+
+void signal_handler(int signum) {
+    (void)signum;
+    LOG_INFO("Received signal, shutting down...");
+    g_quit.store(true);
+    if (g_quit_pipe[1] >= 0) {
+        char c = 'q';
+        ssize_t ret = write(g_quit_pipe[1], &c, 1);
+        (void)ret;
+    }
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " -c <config.json> [options]\n"
+              << "\n"
+              << "Headless multi-camera recorder: stream-copies every camera into\n"
+              << "fixed-length segment files and event clips. No display, no decoding.\n"
+              << "\n"
+              << "Options:\n"
+              << "  -c, --config <file>   JSON configuration file (required, same format as dashboard)\n"
+              << "  -o, --output <dir>    Recording directory (overrides recording.directory)\n"
+              << "  -d, --debug           Enable debug logging\n"
+              << "  --help                Show this help message\n"
+              << "\n"
+              << "Recording section (optional):\n"
+              << "  \"recording\": {\n"
+              << "    \"directory\": \"/var/lib/baichuan\",\n"
+              << "    \"mode\": \"continuous\",          (\"events\": event clips only,\n"
+              << "                                      \"motion\": clips on camera motion alarms)\n"
+              << "    \"segment_seconds\": 300,\n"
+              << "    \"format\": \"mp4\",               (mp4, fmp4, mkv, ts)\n"
+              << "    \"retention_hours\": 168,          (0 = keep forever)\n"
+              << "    \"retention_mb\": 50000,           (per camera, 0 = unlimited)\n"
+              << "    \"pre_roll_seconds\": 15,\n"
+              << "    \"pre_roll_mb\": 32,\n"
+              << "    \"event_seconds\": 30\n"
+              << "  }\n"
+              << "\n"
+              << "Example:\n"
+              << "  " << program << " -c cameras.json -o /srv/recordings\n";
+}
+
+// Recorder camera: the shared camera context plus its segment writer
+struct RecorderCamera : CameraContext {
+    std::unique_ptr<SegmentWriter> segments;
+    std::atomic<bool> motion{false};
+
+    mutable std::mutex status_mutex;
+    std::string status = "Connecting...";
+
+    std::string get_status() const {
+        std::lock_guard<std::mutex> lock(status_mutex);
+        return status;
+    }
+};
+
+// Route a camera's packets (and, in motion mode, its alarms) into its segment files
+void attach_to_recorder(RecorderCamera* ctx, bool motion_triggered) {
+    ctx->handlers.on_status = [ctx](const std::string& status) {
+        std::lock_guard<std::mutex> lock(ctx->status_mutex);
+        ctx->status = status;
+    };
+
+    ctx->handlers.on_packet = [ctx](const VideoPacket& packet) {
+        ctx->segments->write(packet);
+    };
+
+    if (motion_triggered) {
+        ctx->handlers.on_motion = [ctx](const MotionEvent& event) {
+            ctx->motion.store(event.motion);
+            ctx->segments->set_motion(event.motion);
+        };
+    }
+
+    // Timestamps restart with the next connection
+    ctx->handlers.on_stopped = [ctx]() {
+        ctx->segments->close();
+    };
+}
+
+// OpenMetrics page for GET /metrics: per-camera receive and recording
+// counters, then the frame buffer pool (pre-roll rings hold its buffers)
+std::string render_metrics(const std::vector<std::unique_ptr<RecorderCamera>>& cameras) {
+    OpenMetricsWriter writer;
+
+    auto labels = [](const RecorderCamera& ctx) {
+        return OpenMetricsWriter::Labels{{"camera", ctx.config.name},
+                                         {"index", std::to_string(ctx.index)}};
+    };
+
+    std::vector<SegmentWriter::Stats> stats;
+    for (auto& ctx : cameras) {
+        stats.push_back(ctx->segments->stats());
+    }
+
+    writer.family("baichuan_frames_received", "counter", "Video frames received from the camera");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_frames_received_total", labels(*ctx), ctx->metrics.received.frames_received.load());
+    }
+
+    writer.family("baichuan_received_bytes", "counter", "Compressed video bytes received");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_received_bytes_total", labels(*ctx), ctx->metrics.received.bytes_received.load());
+    }
+
+    // Rates are measured here, over the time since the previous read
+    std::vector<RateMeter::Rates> rates;
+    for (auto& ctx : cameras) {
+        rates.push_back(ctx->rates());
+    }
+
+    writer.family("baichuan_receive_fps", "gauge", "Frames received per second since the previous read");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_receive_fps", labels(*cameras[i]), rates[i].fps);
+    }
+
+    writer.family("baichuan_receive_bitrate_bits_per_second", "gauge", "Received bitrate since the previous read");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_receive_bitrate_bits_per_second", labels(*cameras[i]), rates[i].bitrate);
+    }
+
+    writer.family("baichuan_reconnects", "counter", "Connections that dropped and were retried");
+    for (auto& ctx : cameras) {
+        writer.sample("baichuan_reconnects_total", labels(*ctx), ctx->metrics.reconnects.load());
+    }
+
+    writer.family("baichuan_recorded_packets", "counter", "Packets written to segment files");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_recorded_packets_total", labels(*cameras[i]), stats[i].packets_written);
+    }
+
+    writer.family("baichuan_recorded_bytes", "counter", "Payload bytes written to segment files");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_recorded_bytes_total", labels(*cameras[i]), stats[i].bytes_written);
+    }
+
+    writer.family("baichuan_recorder_packets_dropped", "counter", "Packets dropped because the write queue was full");
+    for (size_t i = 0; i < cameras.size(); i++) {
+        writer.sample("baichuan_recorder_packets_dropped_total", labels(*cameras[i]), stats[i].packets_dropped);
+    }
+
+    write_buffer_pool_metrics(writer);
+    return writer.str();
+}
+
+int main(int argc, char* argv[]) {
+    std::string config_file;
+    std::string output_dir;
+    bool debug = false;
+
+    // Parse command line arguments
+    static struct option long_options[] = {
+        {"config",  required_argument, nullptr, 'c'},
+        {"output",  required_argument, nullptr, 'o'},
+        {"debug",   no_argument,       nullptr, 'd'},
+        {"help",    no_argument,       nullptr, '?'},
+        {nullptr,   0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:o:d", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'c':
+                config_file = optarg;
+                break;
+            case 'o':
+                output_dir = optarg;
+                break;
+            case 'd':
+                debug = true;
+                break;
+            case '?':
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (config_file.empty()) {
+        std::cerr << "Error: Configuration file required\n\n";
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Configure logging
+    if (debug) {
+        Logger::instance().set_level(LogLevel::Debug);
+    }
+
+    LOG_INFO("Baichuan Recorder");
+
+    // Parse configuration
+    DashboardConfig config;
+    try {
+        config = JsonConfigParser::parse(config_file);
+        LOG_INFO("Loaded {} cameras from config", config.cameras.size());
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to parse config: {}", e.what());
+        return 1;
+    }
+
+    if (!output_dir.empty()) {
+        config.recording.directory = output_dir;
+    }
+
+    // Install signal handler
+    if (pipe(g_quit_pipe) < 0) {
+        LOG_ERROR("Failed to create quit pipe: {}", strerror(errno));
+        return 1;
+    }
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    // Create camera contexts (MJPEG carries no compressed video to copy)
+    std::vector<std::unique_ptr<RecorderCamera>> cameras;
+    for (size_t i = 0; i < config.cameras.size(); i++) {
+        if (config.cameras[i].type == CameraType::Mjpeg) {
+            LOG_WARN("Camera {} ({}): MJPEG cameras cannot be stream-copied, skipping",
+                     i, config.cameras[i].name);
+            continue;
+        }
+
+        // Only Baichuan cameras push motion alarms; record the others continuously
+        RecordingConfig recording = config.recording;
+        bool motion_triggered = recording.mode == "motion";
+        if (motion_triggered && config.cameras[i].type != CameraType::Baichuan) {
+            LOG_WARN("Camera {} ({}): no motion alarms over RTSP, recording continuously",
+                     i, config.cameras[i].name);
+            recording.mode = "continuous";
+            motion_triggered = false;
+        }
+
+        auto ctx = std::make_unique<RecorderCamera>();
+        ctx->index = i;
+        ctx->config = config.cameras[i];
+        ctx->segments = std::make_unique<SegmentWriter>(recording, ctx->config.name);
+        attach_to_recorder(ctx.get(), motion_triggered);
+        cameras.push_back(std::move(ctx));
+    }
+
+    if (cameras.empty()) {
+        LOG_ERROR("No recordable cameras defined in config");
+        return 1;
+    }
+
+    if (config.recording.mode == "motion") {
+        LOG_INFO("Recording {} cameras to {} (motion clips, {} s pre-roll, {} s post-roll)",
+                 cameras.size(), config.recording.directory,
+                 config.recording.pre_roll_seconds, config.recording.event_seconds);
+    } else if (config.recording.mode == "events") {
+        LOG_INFO("Recording {} cameras to {} (event clips only, {} s pre-roll)", cameras.size(),
+                 config.recording.directory, config.recording.pre_roll_seconds);
+    } else {
+        LOG_INFO("Recording {} cameras to {} ({} s {} segments)", cameras.size(),
+                 config.recording.directory, config.recording.segment_seconds,
+                 config.recording.format);
+    }
+
+    // Start the cameras (their lifecycles run on the I/O reactor)
+    for (auto& ctx : cameras) {
+        ctx->start();
+    }
+
+    // Set up command server if control config is present
+    SnapshotService snapshots;
+    std::unique_ptr<CommandServer> cmd_server;
+    if (!config.control.unix_path.empty() || config.control.tcp_port > 0) {
+        cmd_server = std::make_unique<CommandServer>(config.control.unix_path,
+                                                      config.control.tcp_port);
+
+        // Apply paused = value to the cameras selected by "key"
+        // (an index, an array of indices, or true for all)
+        auto set_paused = [&cameras](const std::string& cmd_json, const std::string& key,
+                                     bool paused) -> std::string {
+            auto indices = JsonConfigParser::get_indices(cmd_json, key);
+            if (indices.empty()) {
+                if (!JsonConfigParser::get_bool(cmd_json, key)) {
+                    return "{\"error\": \"invalid " + key + " value\"}";
+                }
+                for (auto& ctx : cameras) {
+                    ctx->set_paused(paused);
+                }
+                return "{\"ok\": true}";
+            }
+
+            std::vector<RecorderCamera*> selected;
+            for (size_t idx : indices) {
+                RecorderCamera* match = nullptr;
+                for (auto& ctx : cameras) {
+                    if (ctx->index == idx) { match = ctx.get(); break; }
+                }
+                if (!match) {
+                    return "{\"error\": \"index " + std::to_string(idx) + " not recording\"}";
+                }
+                selected.push_back(match);
+            }
+            for (RecorderCamera* ctx : selected) {
+                ctx->set_paused(paused);
+            }
+            return "{\"ok\": true}";
+        };
+
+        cmd_server->set_handler([&cameras, &snapshots, set_paused](const std::string& cmd_json) -> std::string {
+            // --- disconnect: stop recording specific cameras ---
+            if (cmd_json.find("\"disconnect\"") != std::string::npos) {
+                return set_paused(cmd_json, "disconnect", true);
+            }
+
+            // --- connect: resume recording specific cameras ---
+            if (cmd_json.find("\"connect\"") != std::string::npos) {
+                return set_paused(cmd_json, "connect", false);
+            }
+
+            // --- event: save pre-roll plus "seconds" of live stream for
+            //     "cameras" (an index or array; all if absent) ---
+            if (cmd_json.find("\"event\"") != std::string::npos) {
+                int seconds = JsonConfigParser::get_int(cmd_json, "seconds");
+                auto indices = JsonConfigParser::get_indices(cmd_json, "cameras");
+                size_t triggered = 0;
+                for (auto& ctx : cameras) {
+                    bool selected = indices.empty();
+                    for (size_t idx : indices) {
+                        if (ctx->index == idx) { selected = true; break; }
+                    }
+                    if (!selected) continue;
+                    ctx->segments->trigger_event(seconds > 0 ? seconds : 0);
+                    triggered++;
+                }
+                if (triggered == 0) {
+                    return "{\"error\": \"no matching cameras\"}";
+                }
+                return "{\"ok\": true}";
+            }
+
+            // --- snapshot: JPEG of a camera's latest keyframe, returned as
+            //     base64 or written to "path" ---
+            if (cmd_json.find("\"snapshot\"") != std::string::npos) {
+                auto indices = JsonConfigParser::get_indices(cmd_json, "snapshot");
+                if (indices.size() != 1) return "{\"error\": \"invalid snapshot value\"}";
+
+                for (auto& ctx : cameras) {
+                    if (ctx->index != indices[0]) continue;
+                    auto options = SnapshotOptions::from(JsonConfigParser::get_int(cmd_json, "quality"),
+                                                         JsonConfigParser::get_int(cmd_json, "width"),
+                                                         JsonConfigParser::get_int(cmd_json, "height"));
+                    std::string native = JsonConfigParser::get_bool(cmd_json, "native")
+                        ? "main" : JsonConfigParser::get_string(cmd_json, "native", "");
+                    auto shot = take_camera_snapshot(ctx.get(), snapshots, options, native);
+                    return shot->to_json(JsonConfigParser::get_string(cmd_json, "path", ""));
+                }
+                return "{\"error\": \"index " + std::to_string(indices[0]) + " not recording\"}";
+            }
+
+            // --- stats: per-stage timings (p50/p99/max) and the frame
+            //     buffer pool, optionally reset ---
+            if (cmd_json.find("\"stats\"") != std::string::npos) {
+                std::string result = "{\"ok\": true, \"cameras\": [";
+                for (size_t i = 0; i < cameras.size(); i++) {
+                    auto& ctx = cameras[i];
+                    if (i > 0) result += ", ";
+                    result += "{\"index\": " + std::to_string(ctx->index) +
+                              ", \"name\": \"" + ctx->config.name + "\"" +
+                              ", \"stages\": " + ctx->pipeline.to_json() + "}";
+                }
+
+                result += "], \"connections\": [";
+                auto connections = BaichuanSession::connection_stats();
+                for (size_t i = 0; i < connections.size(); i++) {
+                    if (i > 0) result += ", ";
+                    result += "{\"name\": \"" + connections[i].name + "\"" +
+                              ", \"stages\": " + connections[i].stats->to_json() + "}";
+                }
+                result += "], \"buffer_pool\": " + BufferPool::instance().stats().to_json() + "}";
+
+                if (JsonConfigParser::get_bool(cmd_json, "reset")) {
+                    for (auto& ctx : cameras) {
+                        ctx->pipeline.reset();
+                    }
+                    for (auto& connection : connections) {
+                        connection.stats->reset();
+                    }
+                }
+                return result;
+            }
+
+            // --- list: return per-camera recording state ---
+            if (cmd_json.find("\"list\"") != std::string::npos) {
+                std::string result = "{\"ok\": true, \"cameras\": [";
+                for (size_t i = 0; i < cameras.size(); i++) {
+                    const auto& ctx = cameras[i];
+                    auto stats = ctx->segments->stats();
+                    auto rates = ctx->rates();
+                    if (i > 0) result += ", ";
+                    result += "{\"index\": " + std::to_string(ctx->index) +
+                              ", \"name\": \"" + ctx->config.name + "\"" +
+                              ", \"connected\": " + (ctx->paused.load() ? "false" : "true") +
+                              ", \"state\": \"" + camera_state_to_string(ctx->state.load()) + "\"" +
+                              ", \"status\": \"" + (ctx->running.load() ? std::string("Streaming") : ctx->get_status()) + "\"" +
+                              ", \"motion\": " + (ctx->motion.load() ? "true" : "false") +
+                              ", \"fps\": " + std::to_string(std::lround(rates.fps)) +
+                              ", \"kbps\": " + std::to_string(std::lround(rates.bitrate / 1000)) +
+                              ", \"file\": \"" + stats.current_file + "\"" +
+                              ", \"event_file\": \"" + stats.event_file + "\"" +
+                              ", \"segments\": " + std::to_string(stats.segments) +
+                              ", \"events\": " + std::to_string(stats.events) +
+                              ", \"packets\": " + std::to_string(stats.packets_written) +
+                              ", \"bytes\": " + std::to_string(stats.bytes_written) +
+                              ", \"skipped\": " + std::to_string(stats.packets_skipped) +
+                              ", \"dropped\": " + std::to_string(stats.packets_dropped) +
+                              ", \"deleted\": " + std::to_string(stats.files_deleted) +
+                              ", \"queued_bytes\": " + std::to_string(stats.queued_bytes) +
+                              ", \"preroll\": {\"bytes\": " + std::to_string(stats.preroll_bytes) +
+                              ", \"gops\": " + std::to_string(stats.preroll_gops) + "}}";
+                }
+                result += "]}";
+                return result;
+            }
+
+            return "{\"error\": \"unknown command\"}";
+        });
+
+        // Prometheus / OpenMetrics scrapes (GET /metrics, usually on the TCP port)
+        cmd_server->set_metrics_handler([&cameras]() {
+            return render_metrics(cameras);
+        });
+
+        // GET /snapshot?camera=N[&quality=Q&width=W&height=H] -> image/jpeg
+        cmd_server->add_http_route("/snapshot", [&cameras, &snapshots](const std::string& query) {
+            return snapshot_response(cameras, snapshots, query);
+        });
+
+        if (!cmd_server->start()) {
+            LOG_ERROR("Failed to start command server");
+        } else {
+            LOG_INFO("Command server started");
+        }
+    }
+
+    // Run until signalled (blocks on the quit pipe; no polling)
+    while (!g_quit.load()) {
+        char c;
+        if (read(g_quit_pipe[0], &c, 1) < 0 && errno != EINTR) {
+            LOG_ERROR("Quit pipe read failed: {}", strerror(errno));
+            break;
+        }
+    }
+
+    // Stop command server
+    if (cmd_server) {
+        cmd_server->stop();
+    }
+
+    // Stop all cameras (each returns once its teardown is done), then
+    // flush and close the last files
+    for (auto& ctx : cameras) {
+        ctx->stop();
+        ctx->segments->stop();
+    }
+
+    LOG_INFO("Recorder shutdown complete");
+    return 0;
+}
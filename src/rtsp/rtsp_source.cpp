@@ -5,10 +5,20 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/dict.h>
+#include <libavutil/mathematics.h>
 }
 
 namespace baichuan {
 
+namespace {
+
+// FFmpeg polls this while it blocks on the network; non-zero aborts the call
+int interrupt_requested(void* opaque) {
+    return static_cast<std::atomic<bool>*>(opaque)->load() ? 1 : 0;
+}
+
+} // namespace
+
 RtspSource::RtspSource() = default;
 
 RtspSource::~RtspSource() {
@@ -29,6 +39,11 @@ void RtspSource::set_transport(const std::string& transport) {
 }
 
 bool RtspSource::connect() {
+    abort_.store(false);
+    return open_stream();
+}
+
+bool RtspSource::open_stream() {
     if (url_.empty()) {
         LOG_ERROR("RTSP URL not set");
         return false;
@@ -43,6 +58,11 @@ bool RtspSource::connect() {
         return false;
     }
 
+    // stop() cuts a blocking open or read short instead of waiting out
+    // the network timeout
+    fmt_ctx_->interrupt_callback.callback = interrupt_requested;
+    fmt_ctx_->interrupt_callback.opaque = &abort_;
+
     // Set options
     AVDictionary* options = nullptr;
 
@@ -105,6 +125,8 @@ bool RtspSource::connect() {
     AVCodecParameters* codecpar = video_stream->codecpar;
 
     codec_ = detect_codec(codecpar->codec_id);
+    time_base_num_ = video_stream->time_base.num;
+    time_base_den_ = video_stream->time_base.den;
 
     int width = codecpar->width;
     int height = codecpar->height;
@@ -145,16 +167,16 @@ bool RtspSource::connect() {
 }
 
 bool RtspSource::start() {
-    if (!connected_.load()) {
-        LOG_ERROR("RTSP not connected");
-        return false;
-    }
-
     if (running_.load()) {
         LOG_WARN("RTSP already streaming");
         return true;
     }
 
+    // Not connected yet: the receive thread connects first
+    if (receive_thread_.joinable()) {
+        receive_thread_.join();
+    }
+    abort_.store(false);
     running_.store(true);
     receive_thread_ = std::thread(&RtspSource::receive_loop, this);
 
@@ -164,6 +186,7 @@ bool RtspSource::start() {
 
 void RtspSource::stop() {
     running_.store(false);
+    abort_.store(true);
 
     if (receive_thread_.joinable()) {
         receive_thread_.join();
@@ -185,17 +208,40 @@ void RtspSource::on_frame(FrameCallback cb) {
     frame_callback_ = std::move(cb);
 }
 
+void RtspSource::on_packet(PacketCallback cb) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    packet_callback_ = std::move(cb);
+}
+
 void RtspSource::on_error(ErrorCallback cb) {
     std::lock_guard<std::mutex> lock(callback_mutex_);
     error_callback_ = std::move(cb);
 }
 
+void RtspSource::on_end(EndCallback cb) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    end_callback_ = std::move(cb);
+}
+
 void RtspSource::on_info(InfoCallback cb) {
     std::lock_guard<std::mutex> lock(callback_mutex_);
     info_callback_ = std::move(cb);
 }
 
 void RtspSource::receive_loop() {
+    if (!connected_.load() && !open_stream()) {
+        if (running_.exchange(false)) {
+            std::lock_guard<std::mutex> lock(callback_mutex_);
+            if (error_callback_) {
+                error_callback_("Connection failed");
+            }
+            if (end_callback_) {
+                end_callback_();
+            }
+        }
+        return;
+    }
+
     AVPacket* packet = av_packet_alloc();
     if (!packet) {
         LOG_ERROR("Failed to allocate AVPacket");
@@ -206,6 +252,9 @@ void RtspSource::receive_loop() {
         int ret = av_read_frame(fmt_ctx_, packet);
 
         if (ret < 0) {
+            if (!running_.load()) {
+                break;  // Interrupted by stop()
+            }
             if (ret == AVERROR_EOF) {
                 LOG_INFO("RTSP stream ended");
             } else if (ret != AVERROR(EAGAIN)) {
@@ -222,6 +271,10 @@ void RtspSource::receive_loop() {
             // On error or EOF, wait a bit before retrying or exit
             if (ret == AVERROR_EOF) {
                 running_.store(false);
+                std::lock_guard<std::mutex> lock(callback_mutex_);
+                if (end_callback_) {
+                    end_callback_();
+                }
                 break;
             }
 
@@ -243,18 +296,34 @@ void RtspSource::receive_loop() {
                 LOG_DEBUG("RTSP: Got first keyframe, starting decode");
             }
 
-            // Deliver frame data to callback
+            // Deliver frame data to callbacks
             std::lock_guard<std::mutex> lock(callback_mutex_);
-            if (frame_callback_ && packet->data && packet->size > 0) {
-                // For first keyframe, prepend extradata if available
+            if ((frame_callback_ || packet_callback_) && packet->data && packet->size > 0) {
+                const uint8_t* data = packet->data;
+                size_t len = static_cast<size_t>(packet->size);
+
+                // For keyframes, prepend extradata if available
+                std::vector<uint8_t> frame_data;
                 if (is_keyframe && !extradata_.empty()) {
-                    std::vector<uint8_t> frame_data;
                     frame_data.reserve(extradata_.size() + packet->size);
                     frame_data.insert(frame_data.end(), extradata_.begin(), extradata_.end());
                     frame_data.insert(frame_data.end(), packet->data, packet->data + packet->size);
-                    frame_callback_(frame_data.data(), frame_data.size(), codec_);
-                } else {
-                    frame_callback_(packet->data, static_cast<size_t>(packet->size), codec_);
+                    data = frame_data.data();
+                    len = frame_data.size();
+                }
+
+                if (frame_callback_) {
+                    frame_callback_(data, len, codec_);
+                }
+
+                if (packet_callback_) {
+                    int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                    int64_t pts_us = AV_NOPTS_VALUE;
+                    if (pts != AV_NOPTS_VALUE) {
+                        pts_us = av_rescale_q(pts, AVRational{time_base_num_, time_base_den_},
+                                              AVRational{1, 1000000});
+                    }
+                    packet_callback_(data, len, codec_, is_keyframe, pts_us);
                 }
             }
         }
@@ -31,7 +31,10 @@ public:
     // Set transport protocol: "tcp" or "udp" (default: tcp)
     void set_transport(const std::string& transport);
 
-    // IVideoSource interface
+    // IVideoSource interface. start() without connect() connects on the
+    // receive thread instead of the caller's (on_info reports success,
+    // on_error and on_end failure); stop() interrupts a connect or read
+    // in progress.
     bool connect() override;
     bool start() override;
     void stop() override;
@@ -42,6 +45,19 @@ public:
     void on_error(ErrorCallback cb) override;
     void on_info(InfoCallback cb) override;
 
+    // Compressed packets for stream copy (no decode needed)
+    // Keyframes carry the SPS/PPS in front, like on_frame(); pts_us is the
+    // packet timestamp in microseconds (AV_NOPTS_VALUE if the stream has none)
+    using PacketCallback = std::function<void(const uint8_t* data, size_t len, VideoCodec codec,
+                                              bool keyframe, int64_t pts_us)>;
+    void on_packet(PacketCallback cb);
+
+    // The stream ended by itself (end of file, or the connection start()
+    // made failed); called on the receive thread once is_streaming() reads
+    // false, not after stop()
+    using EndCallback = std::function<void()>;
+    void on_end(EndCallback cb);
+
 private:
     std::string url_;
     std::string transport_ = "tcp";
@@ -55,15 +71,23 @@ private:
     std::vector<uint8_t> extradata_;
     std::atomic<bool> got_keyframe_{false};
 
+    // Video stream time base (packet pts -> microseconds)
+    int time_base_num_ = 1;
+    int time_base_den_ = 1000000;
+
     std::thread receive_thread_;
     std::atomic<bool> running_{false};
     std::atomic<bool> connected_{false};
+    std::atomic<bool> abort_{false};   // Set by stop(); polled by FFmpeg's interrupt callback
 
     FrameCallback frame_callback_;
+    PacketCallback packet_callback_;
     ErrorCallback error_callback_;
     InfoCallback info_callback_;
+    EndCallback end_callback_;
     std::mutex callback_mutex_;
 
+    bool open_stream();
     void receive_loop();
     void cleanup();
     VideoCodec detect_codec(int codec_id);
@@ -0,0 +1,20 @@
+#include "utils/backoff.h"
+
+namespace baichuan {
+
+Backoff::Backoff(std::chrono::milliseconds initial, std::chrono::milliseconds max)
+    : initial_(initial), max_(max), rng_(std::random_device{}()) {}
+
+std::chrono::milliseconds Backoff::next() {
+    // initial * 2^attempt, capped (the shift is bounded so it can't overflow)
+    int64_t delay = initial_.count() << (attempt_ < 20 ? attempt_ : 20);
+    if (delay > max_.count()) {
+        delay = max_.count();
+    }
+    attempt_++;
+
+    std::uniform_int_distribution<int64_t> jitter(delay / 2, delay);
+    return std::chrono::milliseconds(jitter(rng_));
+}
+
+} // namespace baichuan
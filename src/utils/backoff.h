@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+namespace baichuan {
+
+// Reconnect delays: exponential with jitter
+//
+// Each next() doubles the delay from `initial` up to `max`, then picks a
+// random point in its upper half, so the cameras of a site that dropped
+// together don't reconnect in lockstep, and the first retry after a blip
+// comes within a fraction of a second. reset() once a connection has
+// proven itself.
+class Backoff {
+public:
+    explicit Backoff(std::chrono::milliseconds initial = std::chrono::milliseconds(250),
+                     std::chrono::milliseconds max = std::chrono::seconds(30));
+
+    std::chrono::milliseconds next();
+    void reset() { attempt_ = 0; }
+
+    int attempts() const { return attempt_; }
+
+private:
+    std::chrono::milliseconds initial_;
+    std::chrono::milliseconds max_;
+    int attempt_ = 0;
+    std::minstd_rand rng_;
+};
+
+} // namespace baichuan
@@ -0,0 +1,203 @@
+#include "utils/buffer_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace baichuan {
+
+// FrameBuffer methods
+FrameBuffer::FrameBuffer(const FrameBuffer& other)
+    : block_(other.block_), data_(other.data_), size_(other.size_) {
+    if (block_) {
+        block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer& other) {
+    if (this != &other) {
+        if (other.block_) {
+            other.block_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        release();
+        block_ = other.block_;
+        data_ = other.data_;
+        size_ = other.size_;
+    }
+    return *this;
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept
+    : block_(other.block_), data_(other.data_), size_(other.size_) {
+    other.block_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        block_ = other.block_;
+        data_ = other.data_;
+        size_ = other.size_;
+        other.block_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+FrameBuffer FrameBuffer::allocate(size_t size) {
+    FrameBuffer buf;
+    if (size == 0) {
+        return buf;
+    }
+
+    buf.block_ = BufferPool::instance().acquire(size + PADDING);
+    buf.data_ = BufferPool::block_data(buf.block_);
+    buf.size_ = size;
+    memset(buf.data_ + size, 0, PADDING);
+    return buf;
+}
+
+FrameBuffer FrameBuffer::copy_of(const uint8_t* data, size_t size) {
+    FrameBuffer buf = allocate(size);
+    if (size > 0) {
+        memcpy(buf.data_, data, size);
+    }
+    return buf;
+}
+
+uint32_t FrameBuffer::use_count() const {
+    return block_ ? block_->refs.load(std::memory_order_relaxed) : 0;
+}
+
+void FrameBuffer::release() {
+    if (block_ && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        BufferPool::instance().recycle(block_);
+    }
+    block_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// BufferPool methods
+FrameBuffer::Block* BufferPool::new_block(size_t capacity, uint32_t size_class) {
+    void* mem = ::operator new(sizeof(FrameBuffer::Block) + capacity);
+    auto* block = new (mem) FrameBuffer::Block();
+    block->size_class = size_class;
+    block->capacity = capacity;
+    return block;
+}
+
+void BufferPool::delete_block(FrameBuffer::Block* block) {
+    block->~Block();
+    ::operator delete(block);
+}
+
+uint8_t* BufferPool::block_data(FrameBuffer::Block* block) {
+    return reinterpret_cast<uint8_t*>(block) + sizeof(FrameBuffer::Block);
+}
+
+FrameBuffer::Block* BufferPool::acquire(size_t size) {
+    // Round up to the size class
+    size_t shift = MIN_CLASS_SHIFT;
+    while (shift <= MAX_CLASS_SHIFT && (size_t(1) << shift) < size) {
+        shift++;
+    }
+
+    if (shift > MAX_CLASS_SHIFT) {
+        // Too large to pool
+        auto* block = new_block(size, UNPOOLED);
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.misses++;
+        stats_.in_use_bytes += size;
+        stats_.resident_bytes += size;
+        stats_.peak_resident_bytes = std::max(stats_.peak_resident_bytes, stats_.resident_bytes);
+        return block;
+    }
+
+    uint32_t size_class = static_cast<uint32_t>(shift - MIN_CLASS_SHIFT);
+    size_t capacity = size_t(1) << shift;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& free_list = free_lists_[size_class];
+        if (!free_list.empty()) {
+            FrameBuffer::Block* block = free_list.back();
+            free_list.pop_back();
+            cached_bytes_ -= capacity;
+            stats_.hits++;
+            stats_.in_use_bytes += capacity;
+            block->refs.store(1, std::memory_order_relaxed);
+            return block;
+        }
+        stats_.misses++;
+        stats_.in_use_bytes += capacity;
+        stats_.resident_bytes += capacity;
+        stats_.peak_resident_bytes = std::max(stats_.peak_resident_bytes, stats_.resident_bytes);
+    }
+
+    return new_block(capacity, size_class);
+}
+
+void BufferPool::recycle(FrameBuffer::Block* block) {
+    size_t capacity = block->capacity;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.in_use_bytes -= capacity;
+
+        if (block->size_class != UNPOOLED && cached_bytes_ + capacity <= max_cached_bytes_) {
+            free_lists_[block->size_class].push_back(block);
+            cached_bytes_ += capacity;
+            return;
+        }
+        stats_.resident_bytes -= capacity;
+    }
+
+    delete_block(block);
+}
+
+std::string BufferPool::Stats::to_json() const {
+    return "{\"hits\": " + std::to_string(hits) +
+           ", \"misses\": " + std::to_string(misses) +
+           ", \"in_use_bytes\": " + std::to_string(in_use_bytes) +
+           ", \"resident_bytes\": " + std::to_string(resident_bytes) +
+           ", \"peak_resident_bytes\": " + std::to_string(peak_resident_bytes) + "}";
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BufferPool::set_max_cached_bytes(size_t bytes) {
+    bool over;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_cached_bytes_ = bytes;
+        over = cached_bytes_ > bytes;
+    }
+    if (over) {
+        trim();
+    }
+}
+
+void BufferPool::trim() {
+    std::vector<FrameBuffer::Block*> blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& free_list : free_lists_) {
+            blocks.insert(blocks.end(), free_list.begin(), free_list.end());
+            free_list.clear();
+        }
+        stats_.resident_bytes -= cached_bytes_;
+        cached_bytes_ = 0;
+    }
+
+    for (auto* block : blocks) {
+        delete_block(block);
+    }
+}
+
+} // namespace baichuan
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace baichuan {
+
+class BufferPool;
+
+// Reference-counted handle to a pooled byte buffer
+//
+// Copying a FrameBuffer only bumps the reference count, so consumers
+// (decoder, recorder, display) can keep a frame payload without copying it.
+// When the last handle goes away the memory goes back to BufferPool for
+// reuse by a later frame of a similar size. The payload is always followed
+// by PADDING zeroed bytes so it can be handed to FFmpeg parsers as-is.
+class FrameBuffer {
+public:
+    static constexpr size_t PADDING = 64;
+
+    FrameBuffer() = default;
+    ~FrameBuffer() { release(); }
+
+    FrameBuffer(const FrameBuffer& other);
+    FrameBuffer& operator=(const FrameBuffer& other);
+    FrameBuffer(FrameBuffer&& other) noexcept;
+    FrameBuffer& operator=(FrameBuffer&& other) noexcept;
+
+    // Allocate an uninitialized buffer of `size` bytes from the pool
+    static FrameBuffer allocate(size_t size);
+
+    // Allocate and fill from existing data
+    static FrameBuffer copy_of(const uint8_t* data, size_t size);
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    uint8_t* begin() { return data_; }
+    uint8_t* end() { return data_ + size_; }
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_ + size_; }
+
+    uint8_t& operator[](size_t i) { return data_[i]; }
+    const uint8_t& operator[](size_t i) const { return data_[i]; }
+
+    // Number of handles sharing this buffer (0 for an empty handle)
+    uint32_t use_count() const;
+
+private:
+    friend class BufferPool;
+
+    // Header placed in front of the payload in the same allocation
+    struct Block {
+        std::atomic<uint32_t> refs{1};
+        uint32_t size_class = 0;
+        size_t capacity = 0;
+    };
+
+    Block* block_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+
+    void release();
+};
+
+// Size-class pool backing FrameBuffer
+//
+// Requests are rounded up to a power-of-two size class (4 KB .. 16 MB) and
+// served from a per-class free list. Released blocks are cached until the
+// pool holds max_cached_bytes; requests above the largest class are
+// allocated and freed directly.
+class BufferPool {
+public:
+    static BufferPool& instance() {
+        // Never destroyed: FrameBuffers may outlive other statics at exit
+        static BufferPool* pool = new BufferPool();
+        return *pool;
+    }
+
+    struct Stats {
+        uint64_t hits = 0;                  // Served from a free list
+        uint64_t misses = 0;                // Needed a fresh allocation
+        uint64_t in_use_bytes = 0;          // Held by live FrameBuffers
+        uint64_t resident_bytes = 0;        // In use + cached in free lists
+        uint64_t peak_resident_bytes = 0;
+
+        // {"hits": .., "misses": .., "in_use_bytes": .., ...} for the stats commands
+        std::string to_json() const;
+    };
+    Stats stats() const;
+
+    // Upper bound on memory kept in free lists
+    void set_max_cached_bytes(size_t bytes);
+
+    // Free all cached blocks
+    void trim();
+
+private:
+    friend class FrameBuffer;
+
+    BufferPool() = default;
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    static constexpr size_t MIN_CLASS_SHIFT = 12;   // 4 KB
+    static constexpr size_t MAX_CLASS_SHIFT = 24;   // 16 MB
+    static constexpr size_t NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+    static constexpr uint32_t UNPOOLED = UINT32_MAX;
+
+    FrameBuffer::Block* acquire(size_t size);
+    void recycle(FrameBuffer::Block* block);
+
+    static FrameBuffer::Block* new_block(size_t capacity, uint32_t size_class);
+    static void delete_block(FrameBuffer::Block* block);
+    static uint8_t* block_data(FrameBuffer::Block* block);
+
+    mutable std::mutex mutex_;
+    std::array<std::vector<FrameBuffer::Block*>, NUM_CLASSES> free_lists_;
+    size_t max_cached_bytes_ = 64 * 1024 * 1024;
+    size_t cached_bytes_ = 0;
+    Stats stats_;
+};
+
+} // namespace baichuan
@@ -0,0 +1,288 @@
+#include "utils/io_reactor.h"
+#include "utils/logger.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+namespace baichuan {
+
+namespace {
+
+constexpr uint32_t READ_EVENTS = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+constexpr uint32_t WRITE_EVENTS = EPOLLOUT | EPOLLET | EPOLLONESHOT;
+
+// The timerfd's epoll id (socket ids start at 1)
+constexpr uint64_t TIMER_FD_ID = 0;
+
+// Entry or timer whose handler the current thread is running (remove() and
+// cancel_timer() from inside the handler must not wait for itself)
+thread_local IoReactor* t_reactor = nullptr;
+thread_local uint64_t t_running_id = 0;
+thread_local uint64_t t_running_timer = 0;
+
+// Re-arm the one-shot timerfd registration after it fired
+void rearm_timer_fd(int epoll_fd, int timer_fd) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = TIMER_FD_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, timer_fd, &ev);
+}
+
+} // namespace
+
+IoReactor::IoReactor() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        LOG_ERROR("epoll_create1 failed: {}", strerror(errno));
+        return;
+    }
+
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd_ < 0) {
+        LOG_ERROR("timerfd_create failed: {}", strerror(errno));
+    } else {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.u64 = TIMER_FD_ID;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev) < 0) {
+            LOG_ERROR("epoll_ctl(ADD) failed for the timerfd: {}", strerror(errno));
+            close(timer_fd_);
+            timer_fd_ = -1;
+        }
+    }
+
+    // A few threads are plenty: handlers only read and parse
+    unsigned hw = std::thread::hardware_concurrency();
+    size_t count = std::clamp<size_t>(hw / 4, 1, 4);
+    for (size_t i = 0; i < count; i++) {
+        threads_.emplace_back(&IoReactor::run, this);
+    }
+    LOG_DEBUG("I/O reactor started with {} threads", count);
+}
+
+uint64_t IoReactor::add(int fd, ReadyCallback on_ready, Interest interest) {
+    if (epoll_fd_ < 0 || fd < 0) {
+        return 0;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->fd = fd;
+    entry->events = interest == Interest::Write ? WRITE_EVENTS : READ_EVENTS;
+    entry->on_ready = std::move(on_ready);
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(entries_mutex_);
+        id = next_id_++;
+        entries_[id] = entry;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = entry->events;
+    ev.data.u64 = id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERROR("epoll_ctl(ADD) failed for fd {}: {}", fd, strerror(errno));
+        std::lock_guard<std::mutex> lock(entries_mutex_);
+        entries_.erase(id);
+        return 0;
+    }
+    return id;
+}
+
+void IoReactor::remove(uint64_t id) {
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(entries_mutex_);
+        auto it = entries_.find(id);
+        if (it == entries_.end()) {
+            return;
+        }
+        entry = it->second;
+        entries_.erase(it);
+    }
+
+    entry->removed.store(true);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry->fd, nullptr);
+
+    // Wait for a running handler to finish
+    if (t_reactor == this && t_running_id == id) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(entry->running);
+}
+
+uint64_t IoReactor::add_timer(std::chrono::steady_clock::time_point when, TimerCallback on_due) {
+    if (timer_fd_ < 0) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    uint64_t id = next_timer_id_++;
+    bool earliest = timers_.empty() || when < timers_.begin()->first.first;
+    timers_.emplace(TimerKey(when, id), std::move(on_due));
+    timer_deadlines_[id] = when;
+    if (earliest) {
+        arm_timer_fd();
+    }
+    return id;
+}
+
+bool IoReactor::cancel_timer(uint64_t id) {
+    std::unique_lock<std::mutex> lock(timers_mutex_);
+    auto it = timer_deadlines_.find(id);
+    if (it != timer_deadlines_.end()) {
+        // The timerfd may still fire for it; run_timers() finds nothing due
+        timers_.erase(TimerKey(it->second, id));
+        timer_deadlines_.erase(it);
+        return true;
+    }
+
+    // Fired: wait for the callback to finish
+    if (t_reactor != this || t_running_timer != id) {
+        timer_done_cv_.wait(lock, [this, id] { return running_timers_.count(id) == 0; });
+    }
+    return false;
+}
+
+void IoReactor::arm_timer_fd() {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (!timers_.empty()) {
+        // steady_clock is CLOCK_MONOTONIC; an all-zero value would disarm
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            timers_.begin()->first.first.time_since_epoch()).count();
+        ns = std::max<int64_t>(ns, 1);
+        spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+        spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+    }
+    if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        LOG_ERROR("timerfd_settime failed: {}", strerror(errno));
+    }
+}
+
+IoReactor::Stats IoReactor::stats() const {
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(entries_mutex_);
+        stats.registered = entries_.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex_);
+        stats.timers = timers_.size();
+    }
+    stats.wakeups = wakeups_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void IoReactor::run() {
+    t_reactor = this;
+    struct epoll_event events[64];
+
+    while (true) {
+        int n = epoll_wait(epoll_fd_, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait failed: {}", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 == TIMER_FD_ID) {
+                run_timers();
+            } else {
+                handle(events[i].data.u64);
+            }
+        }
+    }
+}
+
+void IoReactor::handle(uint64_t id) {
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(entries_mutex_);
+        auto it = entries_.find(id);
+        if (it == entries_.end()) {
+            return;
+        }
+        entry = it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->running);
+    if (entry->removed.load()) {
+        return;
+    }
+
+    wakeups_.fetch_add(1, std::memory_order_relaxed);
+    t_running_id = id;
+    bool keep = entry->on_ready();
+    t_running_id = 0;
+
+    if (entry->removed.load()) {
+        // Removed while the handler ran; the fd may already be closed and
+        // reused, so leave epoll alone
+        return;
+    }
+    if (!keep) {
+        // Not re-armed, so no further events; forget it
+        {
+            std::lock_guard<std::mutex> entries_lock(entries_mutex_);
+            entries_.erase(id);
+        }
+        entry->removed.store(true);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry->fd, nullptr);
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = entry->events;
+    ev.data.u64 = id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, entry->fd, &ev) < 0 && errno != ENOENT) {
+        LOG_ERROR("epoll_ctl(MOD) failed for fd {}: {}", entry->fd, strerror(errno));
+    }
+}
+
+void IoReactor::run_timers() {
+    uint64_t expirations;
+    ssize_t ret = read(timer_fd_, &expirations, sizeof(expirations));
+    (void)ret;  // EAGAIN after a cancel moved the deadline; nothing is lost
+
+    std::vector<std::pair<uint64_t, TimerCallback>> due;
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        while (!timers_.empty() && timers_.begin()->first.first <= now) {
+            auto it = timers_.begin();
+            uint64_t id = it->first.second;
+            due.emplace_back(id, std::move(it->second));
+            timers_.erase(it);
+            timer_deadlines_.erase(id);
+            running_timers_.insert(id);
+        }
+        arm_timer_fd();
+    }
+
+    // Later deadlines can fire on another thread while these callbacks run
+    rearm_timer_fd(epoll_fd_, timer_fd_);
+
+    for (auto& timer : due) {
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
+        t_running_timer = timer.first;
+        timer.second();
+        t_running_timer = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(timers_mutex_);
+            running_timers_.erase(timer.first);
+        }
+        timer_done_cv_.notify_all();
+    }
+}
+
+} // namespace baichuan
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace baichuan {
+
+// Shared epoll event loop for camera sockets
+//
+// A fixed pool of I/O threads waits on one epoll set, so the number of
+// receive threads no longer grows with the number of cameras. Sockets are
+// registered edge-triggered and one-shot: a ready socket is handed to
+// exactly one I/O thread, whose handler must read until EAGAIN; the socket
+// is re-armed when the handler returns. Handlers therefore never run
+// concurrently for the same socket, but must not block - heavy work (video
+// decoding) belongs on another thread.
+//
+// Timers run on the same threads (one timerfd in the epoll set), so
+// deadlines - keepalives, timeouts, reconnect delays - cost nothing until
+// they are due, instead of a thread polling for them.
+class IoReactor {
+public:
+    static IoReactor& instance() {
+        // Never destroyed: sockets may still be registered when statics go
+        static IoReactor* reactor = new IoReactor();
+        return *reactor;
+    }
+
+    // Called when the socket is ready (or closed); return false to
+    // unregister it
+    using ReadyCallback = std::function<bool()>;
+
+    // What a socket waits for: data to read, or room to write (a
+    // non-blocking connect() completing)
+    enum class Interest { Read, Write };
+
+    // Register fd; returns an id for remove(), or 0 on failure
+    uint64_t add(int fd, ReadyCallback on_ready, Interest interest = Interest::Read);
+
+    // Unregister; once it returns the handler is not running and will not
+    // run again (unless called from that handler itself)
+    void remove(uint64_t id);
+
+    // Run on_due on an I/O thread once `when` has passed (same rules as
+    // socket handlers: must not block). Returns an id for cancel_timer(),
+    // or 0 on failure.
+    using TimerCallback = std::function<void()>;
+    uint64_t add_timer(std::chrono::steady_clock::time_point when, TimerCallback on_due);
+
+    // Cancel a timer; true if it had not fired yet. Once it returns the
+    // callback is not running (unless called from that callback itself).
+    bool cancel_timer(uint64_t id);
+
+    // Run fn on an I/O thread as soon as one is free (a timer that is
+    // already due); returns its timer id, or 0 on failure
+    uint64_t post(TimerCallback fn) {
+        return add_timer(std::chrono::steady_clock::now(), std::move(fn));
+    }
+
+    size_t thread_count() const { return threads_.size(); }
+
+    struct Stats {
+        uint64_t registered = 0;   // Sockets currently registered
+        uint64_t timers = 0;       // Timers waiting to fire
+        uint64_t wakeups = 0;      // Handler and timer invocations
+    };
+    Stats stats() const;
+
+private:
+    IoReactor();
+
+    struct Entry {
+        int fd = -1;
+        uint32_t events = 0;
+        ReadyCallback on_ready;
+        std::mutex running;   // Held while on_ready runs
+        std::atomic<bool> removed{false};
+    };
+
+    int epoll_fd_ = -1;
+    std::vector<std::thread> threads_;
+
+    mutable std::mutex entries_mutex_;
+    std::unordered_map<uint64_t, std::shared_ptr<Entry>> entries_;
+    uint64_t next_id_ = 1;
+
+    // Timers by deadline (ids break ties), and each pending timer's deadline
+    using TimerKey = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+    int timer_fd_ = -1;
+    mutable std::mutex timers_mutex_;
+    std::condition_variable timer_done_cv_;
+    std::map<TimerKey, TimerCallback> timers_;
+    std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> timer_deadlines_;
+    std::unordered_set<uint64_t> running_timers_;
+    uint64_t next_timer_id_ = 1;
+
+    std::atomic<uint64_t> wakeups_{0};
+
+    void run();
+    void handle(uint64_t id);
+    void run_timers();
+    void arm_timer_fd();   // Under timers_mutex_: program the earliest deadline
+};
+
+} // namespace baichuan
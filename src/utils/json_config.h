@@ -33,6 +33,9 @@ struct CameraConfig {
     // RTSP/MJPEG URL field
     std::string url;        // Full URL (rtsp:// or http://)
     std::string transport = "tcp";  // tcp or udp (RTSP only)
+
+    // Decoder profile: low-latency or throughput (empty = program default)
+    std::string decoder;
 };
 
 // Control socket configuration
@@ -41,11 +44,29 @@ struct ControlConfig {
     int tcp_port = 0;       // TCP port (optional, 0 = disabled)
 };
 
+// Segmented recording configuration (recorder only)
+struct RecordingConfig {
+    std::string directory = "recordings";  // One subdirectory per camera
+    std::string mode = "continuous";       // continuous (segments + events), events (events only) or motion (camera alarms)
+    int segment_seconds = 300;             // Segment length (cut at the next keyframe)
+    std::string format = "mp4";            // Container: mp4, fmp4 (fragmented mp4), mkv, ts
+
+    // Retention per camera, oldest files deleted first (0 = unlimited)
+    int retention_hours = 0;
+    int retention_mb = 0;
+
+    // Event clips: pre-roll ring of compressed GOPs plus the time after the event
+    int pre_roll_seconds = 15;
+    int pre_roll_mb = 32;                  // Ring bound per camera
+    int event_seconds = 30;
+};
+
 // Dashboard configuration
 struct DashboardConfig {
     std::vector<CameraConfig> cameras;
     int columns = 2;        // Grid columns
     ControlConfig control;
+    RecordingConfig recording;
 };
 
 // Simple JSON parser for dashboard config
@@ -121,6 +142,28 @@ private:
             }
         }
 
+        // Parse optional "recording" section
+        size_t rec_pos = json.find("\"recording\"");
+        if (rec_pos != std::string::npos) {
+            size_t rec_obj_start = json.find('{', rec_pos);
+            if (rec_obj_start != std::string::npos) {
+                size_t rec_obj_end = find_matching_brace(json, rec_obj_start);
+                if (rec_obj_end != std::string::npos) {
+                    std::string rec_str = json.substr(rec_obj_start, rec_obj_end - rec_obj_start + 1);
+                    RecordingConfig& rec = config.recording;
+                    rec.directory = parse_string(rec_str, "directory", rec.directory);
+                    rec.mode = parse_string(rec_str, "mode", rec.mode);
+                    rec.format = parse_string(rec_str, "format", rec.format);
+                    parse_optional_int(rec_str, "segment_seconds", rec.segment_seconds);
+                    parse_optional_int(rec_str, "retention_hours", rec.retention_hours);
+                    parse_optional_int(rec_str, "retention_mb", rec.retention_mb);
+                    parse_optional_int(rec_str, "pre_roll_seconds", rec.pre_roll_seconds);
+                    parse_optional_int(rec_str, "pre_roll_mb", rec.pre_roll_mb);
+                    parse_optional_int(rec_str, "event_seconds", rec.event_seconds);
+                }
+            }
+        }
+
         return config;
     }
 
@@ -129,6 +172,7 @@ public:
         CameraConfig cam;
 
         cam.name = parse_string(json, "name", "Camera");
+        cam.decoder = parse_string(json, "decoder", "");
 
         // Determine camera type
         std::string type_str = parse_string(json, "type", "baichuan");
@@ -211,6 +255,14 @@ public:
         return json.substr(start + 1, end - start - 1);
     }
 
+    // Overwrite value only if key is present
+    static void parse_optional_int(const std::string& json, const std::string& key, int& value) {
+        size_t pos = json.find("\"" + key + "\"");
+        if (pos != std::string::npos) {
+            value = parse_int(json, pos);
+        }
+    }
+
     static int parse_int(const std::string& json, size_t key_pos) {
         size_t colon = json.find(':', key_pos);
         if (colon == std::string::npos) return 0;
@@ -255,6 +307,48 @@ public:
         return find_matching_bracket(json, start);
     }
 
+    // Parse an int or an array of ints for a given key (empty if absent)
+    static std::vector<size_t> get_indices(const std::string& json, const std::string& key) {
+        std::vector<size_t> indices;
+        std::string search = "\"" + key + "\"";
+        size_t pos = json.find(search);
+        if (pos == std::string::npos) return indices;
+
+        size_t colon = json.find(':', pos);
+        if (colon == std::string::npos) return indices;
+
+        size_t val_start = colon + 1;
+        while (val_start < json.size() && json[val_start] == ' ') val_start++;
+        if (val_start >= json.size()) return indices;
+
+        if (json[val_start] == '[') {
+            size_t arr_end = find_matching_bracket(json, val_start);
+            if (arr_end == std::string::npos) return indices;
+            std::string arr_str = json.substr(val_start + 1, arr_end - val_start - 1);
+            std::string num;
+            for (char c : arr_str) {
+                if (c >= '0' && c <= '9') {
+                    num += c;
+                } else if (c == ',' || c == ' ') {
+                    if (!num.empty()) {
+                        indices.push_back(static_cast<size_t>(std::stoi(num)));
+                        num.clear();
+                    }
+                }
+            }
+            if (!num.empty()) {
+                indices.push_back(static_cast<size_t>(std::stoi(num)));
+            }
+        } else if (json[val_start] >= '0' && json[val_start] <= '9') {
+            std::string num;
+            for (size_t i = val_start; i < json.size() && json[i] >= '0' && json[i] <= '9'; i++) {
+                num += json[i];
+            }
+            indices.push_back(static_cast<size_t>(std::stoi(num)));
+        }
+        return indices;
+    }
+
     static int get_int(const std::string& json, const std::string& key) {
         std::string search = "\"" + key + "\"";
         size_t pos = json.find(search);
@@ -0,0 +1,73 @@
+#include "utils/latency.h"
+
+#include <chrono>
+
+namespace baichuan {
+
+namespace {
+
+// A keyframe's wall-clock time further than this below the estimate means
+// the camera's clock was set back or the camera restarted; start over
+constexpr int64_t MAX_CLOCK_JUMP_US = 2000000;
+
+} // namespace
+
+void CaptureClock::on_keyframe(uint32_t posix_time, uint32_t microseconds) {
+    // Lower bound for this frame's wall-clock time
+    int64_t bound = static_cast<int64_t>(posix_time) * 1000000;
+
+    // Keep the estimate unless the bound is tighter or the clocks jumped
+    int64_t estimate = to_wall_us(microseconds);
+    if (!valid_ || bound > estimate || bound < estimate - MAX_CLOCK_JUMP_US) {
+        estimate = bound;
+    }
+
+    anchor_media_us_ = microseconds;
+    anchor_wall_us_ = estimate;
+    valid_ = true;
+}
+
+int64_t CaptureClock::to_wall_us(uint32_t microseconds) const {
+    if (!valid_) {
+        return INT64_MIN;
+    }
+    // Signed 32-bit difference: correct across a media clock wrap
+    int32_t delta = static_cast<int32_t>(microseconds - anchor_media_us_);
+    return anchor_wall_us_ + delta;
+}
+
+int64_t wall_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void LatencyStats::record(int64_t latency_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0 || latency_us < min_us_) min_us_ = latency_us;
+    if (count_ == 0 || latency_us > max_us_) max_us_ = latency_us;
+    count_++;
+    total_us_ += latency_us;
+    last_us_ = latency_us;
+}
+
+void LatencyStats::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    count_ = 0;
+    total_us_ = 0;
+    last_us_ = 0;
+    min_us_ = 0;
+    max_us_ = 0;
+}
+
+LatencyStats::Summary LatencyStats::summary() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Summary summary;
+    summary.count = count_;
+    summary.last_us = last_us_;
+    summary.avg_us = count_ > 0 ? total_us_ / static_cast<int64_t>(count_) : 0;
+    summary.min_us = min_us_;
+    summary.max_us = max_us_;
+    return summary;
+}
+
+} // namespace baichuan
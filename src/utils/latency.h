@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+namespace baichuan {
+
+// Maps a Baichuan camera's media clock to wall-clock time
+//
+// Every frame carries a 32-bit microsecond timestamp from the camera's
+// free-running clock; I-frames also carry the camera's wall clock in whole
+// seconds (BcMediaIFrame::posix_time). Each I-frame gives a lower bound
+// for the offset between the two clocks (the truncated seconds lose up to
+// 1 s); the largest bound seen is kept, which converges on the true offset
+// as keyframes land at different points within a second. Times are taken
+// relative to the last keyframe, so the media clock wrapping (every ~71
+// minutes) doesn't matter.
+//
+// The result is only meaningful as glass-to-glass latency when the camera
+// and this host keep time from the same NTP source.
+class CaptureClock {
+public:
+    // Feed an I-frame's timestamps
+    void on_keyframe(uint32_t posix_time, uint32_t microseconds);
+
+    // Wall-clock capture time (microseconds since the epoch) of a frame,
+    // or INT64_MIN before the first keyframe with a wall-clock time
+    int64_t to_wall_us(uint32_t microseconds) const;
+
+    void reset() { valid_ = false; }
+
+private:
+    bool valid_ = false;
+    uint32_t anchor_media_us_ = 0;  // Media clock of the last keyframe
+    int64_t anchor_wall_us_ = 0;    // Its estimated wall-clock time
+};
+
+// Wall-clock time now, microseconds since the epoch
+int64_t wall_clock_us();
+
+// Running summary of a latency measurement (thread-safe)
+class LatencyStats {
+public:
+    void record(int64_t latency_us);
+    void reset();
+
+    struct Summary {
+        uint64_t count = 0;
+        int64_t last_us = 0;
+        int64_t avg_us = 0;
+        int64_t min_us = 0;
+        int64_t max_us = 0;
+    };
+    Summary summary() const;
+
+private:
+    mutable std::mutex mutex_;
+    uint64_t count_ = 0;
+    int64_t total_us_ = 0;
+    int64_t last_us_ = 0;
+    int64_t min_us_ = 0;
+    int64_t max_us_ = 0;
+};
+
+} // namespace baichuan
@@ -0,0 +1,110 @@
+#include "utils/metrics.h"
+#include "utils/buffer_pool.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace baichuan {
+
+RateMeter::Rates RateMeter::read(uint64_t frames, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return Rates{};
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = now - last_time_;
+    if (elapsed < window_ || frames < last_frames_ || bytes < last_bytes_) {
+        return rates_;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    rates_.fps = static_cast<double>(frames - last_frames_) / seconds;
+    rates_.bitrate = static_cast<double>(bytes - last_bytes_) * 8 / seconds;
+
+    last_time_ = now;
+    last_frames_ = frames;
+    last_bytes_ = bytes;
+    return rates_;
+}
+
+void RateMeter::start(uint64_t frames, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    last_time_ = std::chrono::steady_clock::now();
+    last_frames_ = frames;
+    last_bytes_ = bytes;
+    rates_ = Rates{};
+}
+
+void RateMeter::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    rates_ = Rates{};
+}
+
+void OpenMetricsWriter::family(const std::string& name, const std::string& type, const std::string& help) {
+    text_ += "# TYPE " + name + " " + type + "\n";
+    text_ += "# HELP " + name + " " + help + "\n";
+}
+
+void OpenMetricsWriter::sample(const std::string& name, const Labels& labels, double value) {
+    text_ += name;
+    write_labels(labels);
+
+    char number[32];
+    if (std::isfinite(value)) {
+        snprintf(number, sizeof(number), " %.6g\n", value);
+    } else {
+        snprintf(number, sizeof(number), " %s\n", std::isnan(value) ? "NaN" : (value > 0 ? "+Inf" : "-Inf"));
+    }
+    text_ += number;
+}
+
+void OpenMetricsWriter::sample(const std::string& name, const Labels& labels, uint64_t value) {
+    text_ += name;
+    write_labels(labels);
+    text_ += " " + std::to_string(value) + "\n";
+}
+
+void OpenMetricsWriter::write_labels(const Labels& labels) {
+    if (labels.empty()) {
+        return;
+    }
+
+    text_ += "{";
+    for (size_t i = 0; i < labels.size(); i++) {
+        if (i > 0) text_ += ",";
+        text_ += labels[i].first + "=\"";
+        // Label values escape backslash, quote and newline
+        for (char c : labels[i].second) {
+            if (c == '\\') text_ += "\\\\";
+            else if (c == '"') text_ += "\\\"";
+            else if (c == '\n') text_ += "\\n";
+            else text_ += c;
+        }
+        text_ += "\"";
+    }
+    text_ += "}";
+}
+
+void write_buffer_pool_metrics(OpenMetricsWriter& writer) {
+    BufferPool::Stats stats = BufferPool::instance().stats();
+
+    writer.family("baichuan_buffer_pool_hits", "counter", "Frame buffers served from the pool's free lists");
+    writer.sample("baichuan_buffer_pool_hits_total", {}, stats.hits);
+
+    writer.family("baichuan_buffer_pool_misses", "counter", "Frame buffers that needed a fresh allocation");
+    writer.sample("baichuan_buffer_pool_misses_total", {}, stats.misses);
+
+    writer.family("baichuan_buffer_pool_in_use_bytes", "gauge", "Bytes held by live frame buffers");
+    writer.sample("baichuan_buffer_pool_in_use_bytes", {}, stats.in_use_bytes);
+
+    writer.family("baichuan_buffer_pool_resident_bytes", "gauge", "Bytes in use plus cached in free lists");
+    writer.sample("baichuan_buffer_pool_resident_bytes", {}, stats.resident_bytes);
+
+    writer.family("baichuan_buffer_pool_peak_resident_bytes", "gauge", "Highest resident bytes since start");
+    writer.sample("baichuan_buffer_pool_peak_resident_bytes", {}, stats.peak_resident_bytes);
+}
+
+} // namespace baichuan
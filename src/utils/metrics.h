@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace baichuan {
+
+// Counters bumped on different threads get a cache line each, so a decode
+// thread and a receive thread never fight over one line
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Monotonic counter: relaxed increments from any thread, read by exporters
+class alignas(CACHE_LINE_SIZE) MetricCounter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+
+    MetricCounter& operator++(int) { add(); return *this; }
+    MetricCounter& operator+=(uint64_t n) { add(n); return *this; }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Last-written value
+class alignas(CACHE_LINE_SIZE) MetricGauge {
+public:
+    void set(double value) { value_.store(value, std::memory_order_relaxed); }
+    double load() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+// Frames and bits per second from running counters, worked out when read
+// rather than sampled on a timer: averaged over the time since the previous
+// read that took a sample (at least `window`; reads closer together return
+// the same rates), or since start(). Safe to call from any thread.
+class RateMeter {
+public:
+    explicit RateMeter(std::chrono::milliseconds window = std::chrono::milliseconds(1000))
+        : window_(window) {}
+
+    struct Rates {
+        double fps = 0.0;
+        double bitrate = 0.0;   // Bits per second
+    };
+    Rates read(uint64_t frames, uint64_t bytes);
+
+    // The stream started: rates are measured from these counter values
+    void start(uint64_t frames, uint64_t bytes);
+
+    // The stream stopped: reads return zero until the next start()
+    void stop();
+
+private:
+    std::chrono::milliseconds window_;
+    std::mutex mutex_;
+    bool running_ = false;
+    std::chrono::steady_clock::time_point last_time_;
+    uint64_t last_frames_ = 0;
+    uint64_t last_bytes_ = 0;
+    Rates rates_;
+};
+
+// OpenMetrics text exposition (application/openmetrics-text)
+//
+// Write each family's header, then its samples:
+//   writer.family("baichuan_frames_received", "counter", "Video frames received");
+//   writer.sample("baichuan_frames_received_total", {{"camera", "Front"}}, 1520);
+// str() ends the page with the mandatory "# EOF".
+class OpenMetricsWriter {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    static constexpr const char* CONTENT_TYPE = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+    void family(const std::string& name, const std::string& type, const std::string& help);
+    void sample(const std::string& name, const Labels& labels, double value);
+    void sample(const std::string& name, const Labels& labels, uint64_t value);
+
+    std::string str() const { return text_ + "# EOF\n"; }
+
+private:
+    std::string text_;
+
+    void write_labels(const Labels& labels);
+};
+
+// Process-wide frame buffer pool families (no labels): hits, misses and
+// in-use / resident / peak resident bytes
+void write_buffer_pool_metrics(OpenMetricsWriter& writer);
+
+} // namespace baichuan
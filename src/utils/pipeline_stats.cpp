@@ -0,0 +1,122 @@
+#include "utils/pipeline_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace baichuan {
+
+size_t LatencyHistogram::bucket_of(uint64_t ns) {
+    if (ns < SUB_COUNT) {
+        return static_cast<size_t>(ns);
+    }
+
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent > MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    size_t mantissa = static_cast<size_t>(ns >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+    return static_cast<size_t>(exponent - SUB_BITS + 1) * SUB_COUNT + mantissa;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+
+    int exponent = static_cast<int>(bucket / SUB_COUNT) + SUB_BITS - 1;
+    uint64_t mantissa = bucket % SUB_COUNT;
+    uint64_t lower = (SUB_COUNT + mantissa) << (exponent - SUB_BITS);
+    return lower + (uint64_t{1} << (exponent - SUB_BITS)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snapshot;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count)));
+    target = std::clamp<uint64_t>(target, 1, count);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            // A bucket's bound can overshoot the largest value recorded
+            return std::min(bucket_upper_bound(i), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+const char* pipeline_stage_name(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::Recv: return "recv";
+        case PipelineStage::Decrypt: return "decrypt";
+        case PipelineStage::Parse: return "parse";
+        case PipelineStage::DecodeQueue: return "decode_queue";
+        case PipelineStage::DecodeSend: return "decode_send";
+        case PipelineStage::DecodeReceive: return "decode_receive";
+        case PipelineStage::Convert: return "convert";
+        case PipelineStage::Publish: return "publish";
+        case PipelineStage::Paint: return "paint";
+        case PipelineStage::Count: break;
+    }
+    return "unknown";
+}
+
+std::string PipelineStats::to_json() const {
+    std::string json = "{";
+    bool first = true;
+    for (size_t i = 0; i < histograms_.size(); i++) {
+        auto snapshot = histograms_[i].snapshot();
+        if (snapshot.count == 0) {
+            continue;
+        }
+        if (!first) json += ", ";
+        first = false;
+
+        // Microseconds with one decimal: parsing and decryption are sub-us
+        char values[96];
+        snprintf(values, sizeof(values), "\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f",
+                 snapshot.percentile(0.50) / 1000.0, snapshot.percentile(0.99) / 1000.0,
+                 snapshot.max_ns / 1000.0);
+        json += "\"" + std::string(pipeline_stage_name(static_cast<PipelineStage>(i))) + "\": " +
+                "{\"count\": " + std::to_string(snapshot.count) + ", " + values + "}";
+    }
+    json += "}";
+    return json;
+}
+
+void PipelineStats::reset() {
+    for (auto& histogram : histograms_) {
+        histogram.reset();
+    }
+}
+
+} // namespace baichuan
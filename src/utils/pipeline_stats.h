@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace baichuan {
+
+// Log-linear latency histogram (HDR-style), lock-free
+//
+// Values are nanoseconds. Each power of two is split into 16 buckets, so a
+// percentile is within ~6% of the true value; values up to ~18 minutes are
+// tracked, larger ones land in the top bucket. record() is a few relaxed
+// atomic increments - cheap enough to leave on for every frame - and any
+// thread may record while another takes a snapshot.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT;
+
+    void record(uint64_t ns);
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t max_ns = 0;
+        std::array<uint64_t, BUCKETS> buckets{};
+
+        // Smallest value at or above the given fraction (0..1) of samples,
+        // reported as its bucket's upper bound; 0 when empty
+        uint64_t percentile(double fraction) const;
+    };
+    Snapshot snapshot() const;
+
+    void reset();
+
+    static size_t bucket_of(uint64_t ns);
+    static uint64_t bucket_upper_bound(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+// Steps between the camera's socket and the screen
+enum class PipelineStage {
+    Recv,           // Socket read into the receive buffer
+    Decrypt,        // Split and decrypt one BC message
+    Parse,          // BcMedia parsing of one message's payload
+    DecodeQueue,    // Waiting in the decode pool
+    DecodeSend,     // avcodec_send_packet
+    DecodeReceive,  // avcodec_receive_frame (per picture)
+    Convert,        // YUV -> BGRA and scaling (sws_scale)
+    Publish,        // Copy into the pane's mailbox (update_frame)
+    Paint,          // Cairo blit of the pane
+    Count
+};
+
+const char* pipeline_stage_name(PipelineStage stage);
+
+// One histogram per stage; each component records the stages it runs
+//
+// A camera's stats are filled by its stream, decoder and pane; the receive
+// stages belong to the connection, which several cameras may share.
+class PipelineStats {
+public:
+    void record(PipelineStage stage, std::chrono::steady_clock::duration elapsed) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        histograms_[static_cast<size_t>(stage)].record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    }
+
+    const LatencyHistogram& histogram(PipelineStage stage) const {
+        return histograms_[static_cast<size_t>(stage)];
+    }
+
+    // {"recv": {"count": N, "p50_us": .., "p99_us": .., "max_us": ..}, ...}
+    // for the stages with samples
+    std::string to_json() const;
+
+    void reset();
+
+private:
+    std::array<LatencyHistogram, static_cast<size_t>(PipelineStage::Count)> histograms_;
+};
+
+// Times a scope into a stage; does nothing when stats is null
+class StageTimer {
+public:
+    StageTimer(PipelineStats* stats, PipelineStage stage)
+        : stats_(stats), stage_(stage) {
+        if (stats_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~StageTimer() {
+        if (stats_) {
+            stats_->record(stage_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    PipelineStats* stats_;
+    PipelineStage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace baichuan
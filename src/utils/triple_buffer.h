@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace baichuan {
+
+// Lock-free single-producer / single-consumer "latest value" mailbox
+//
+// Three slots rotate between the writer (back), the reader (front) and a
+// shared middle slot. publish() swaps the back slot into the middle and
+// acquire() swaps the middle into the front, each with one atomic exchange,
+// so neither side ever waits for the other. The reader always sees the
+// newest published value; values published faster than they are read are
+// overwritten (and reported as dropped). Slots are reused, so a T holding
+// buffers keeps its allocations between frames.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer: slot to fill before the next publish()
+    T& write_buffer() { return slots_[back_]; }
+
+    // Writer: hand the back slot to the reader
+    // Returns true if the previously published value was never acquired
+    bool publish() {
+        uint8_t prev = middle_.exchange(static_cast<uint8_t>(back_ | DIRTY),
+                                        std::memory_order_acq_rel);
+        back_ = prev & INDEX_MASK;
+        return (prev & DIRTY) != 0;
+    }
+
+    // Reader: true if a value was published since the last acquire()
+    bool has_update() const {
+        return (middle_.load(std::memory_order_acquire) & DIRTY) != 0;
+    }
+
+    // Reader: take the newest published value into the front slot
+    // Returns false (front slot unchanged) if nothing new was published
+    bool acquire() {
+        if (!has_update()) {
+            return false;
+        }
+        uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & INDEX_MASK;
+        return true;
+    }
+
+    // Reader: most recently acquired value
+    T& read_buffer() { return slots_[front_]; }
+    const T& read_buffer() const { return slots_[front_]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t DIRTY = 0x4;
+
+    T slots_[3];
+
+    // Each index is touched by one side only; keep them off the shared line
+    alignas(64) uint8_t back_ = 0;
+    alignas(64) std::atomic<uint8_t> middle_{1};
+    alignas(64) uint8_t front_ = 2;
+};
+
+} // namespace baichuan
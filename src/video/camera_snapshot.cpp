@@ -0,0 +1,53 @@
+#include "video/camera_snapshot.h"
+
+#include <chrono>
+#include <cstdlib>
+
+namespace baichuan {
+
+std::shared_ptr<const Snapshot> take_camera_snapshot(CameraContext* ctx, SnapshotService& snapshots,
+                                                     const SnapshotOptions& options,
+                                                     const std::string& native_stream) {
+    if (native_stream.empty()) {
+        return snapshots.take(ctx->index, ctx->keyframes, options);
+    }
+
+    SnapResult result = fetch_camera_snapshot(ctx, native_stream);
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->ok = result.ok;
+    snapshot->error = result.error;
+    snapshot->jpeg = std::move(result.jpeg);
+    snapshot->keyframe_received = std::chrono::steady_clock::now();
+    return snapshot;
+}
+
+HttpResponse camera_snapshot_response(CameraContext* ctx, SnapshotService& snapshots,
+                                      const std::string& query) {
+    auto param = [&query](const std::string& name) {
+        std::string value = CommandServer::query_param(query, name);
+        return value.empty() ? -1 : std::atoi(value.c_str());
+    };
+
+    HttpResponse response;
+    response.content_type = "text/plain";
+    if (!ctx) {
+        response.status = "404 Not Found";
+        response.body = "no such camera\n";
+        return response;
+    }
+
+    std::string native = CommandServer::query_param(query, "native");
+    auto shot = take_camera_snapshot(ctx, snapshots,
+                                     SnapshotOptions::from(param("quality"), param("width"), param("height")),
+                                     native == "1" ? "main" : native);
+    if (!shot->ok) {
+        response.status = "503 Service Unavailable";
+        response.body = shot->error + "\n";
+        return response;
+    }
+    response.content_type = "image/jpeg";
+    response.body.assign(shot->jpeg.begin(), shot->jpeg.end());
+    return response;
+}
+
+} // namespace baichuan
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "video/snapshot.h"
+#include "worker/camera_worker.h"
+#include "control/command_server.h"
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace baichuan {
+
+// Snapshots of a front end's cameras, shared by the dashboard and the recorder
+
+// Snapshot of a camera: its cached keyframe decoded here, or with
+// native_stream ("main" / "sub") a JPEG the camera encodes (MSG_ID_SNAP)
+std::shared_ptr<const Snapshot> take_camera_snapshot(CameraContext* ctx, SnapshotService& snapshots,
+                                                     const SnapshotOptions& options,
+                                                     const std::string& native_stream);
+
+// GET /snapshot?camera=N[&quality=Q&width=W&height=H][&native=main|sub]
+// for ctx, the camera the query names (nullptr: none, 404)
+HttpResponse camera_snapshot_response(CameraContext* ctx, SnapshotService& snapshots,
+                                      const std::string& query);
+
+// The same, looking the camera up by index among a front end's cameras
+template <typename Camera>
+HttpResponse snapshot_response(const std::vector<std::unique_ptr<Camera>>& cameras,
+                               SnapshotService& snapshots, const std::string& query) {
+    std::string camera = CommandServer::query_param(query, "camera");
+    int index = camera.empty() ? -1 : std::atoi(camera.c_str());
+    CameraContext* found = nullptr;
+    for (auto& ctx : cameras) {
+        if (index >= 0 && ctx->index == static_cast<size_t>(index)) {
+            found = ctx.get();
+            break;
+        }
+    }
+    return camera_snapshot_response(found, snapshots, query);
+}
+
+} // namespace baichuan
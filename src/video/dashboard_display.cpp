@@ -117,6 +117,9 @@ bool DashboardDisplay::create(const std::string& title, const std::vector<Camera
     // Connect window close
     g_signal_connect(window_, "delete-event", G_CALLBACK(on_delete_event), this);
 
+    // One frame-clock callback redraws every pane with a new frame per vsync
+    gtk_widget_add_tick_callback(window_, on_tick, this, nullptr);
+
     // Show window
     gtk_widget_show_all(window_);
 
@@ -130,25 +133,54 @@ void DashboardDisplay::update_frame(size_t pane_index, const DecodedFrame& frame
     }
 
     auto& pane = panes_[pane_index];
-
-    {
-        std::lock_guard<std::mutex> lock(pane->mutex);
-        pane->frame_buffer = frame.rgb_data;
-        pane->frame_width = frame.width;
-        pane->frame_height = frame.height;
-        pane->has_video.store(true);
-        pane->frame_pending.store(true);
+    StageTimer timer(pane->pipeline_stats.load(std::memory_order_relaxed), PipelineStage::Publish);
+
+    // Copy into the mailbox's back slot in Cairo's layout; the slot keeps
+    // its allocation, so this only allocates when the frame grows
+    PaneFrame& slot = pane->mailbox.write_buffer();
+    int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, frame.width);
+    size_t bytes = static_cast<size_t>(stride) * frame.height;
+    if (slot.pixels.size() < bytes) {
+        slot.pixels.resize(bytes);
     }
 
-    // Schedule redraw
-    g_idle_add([](gpointer data) -> gboolean {
-        CameraPane* p = static_cast<CameraPane*>(data);
-        if (p->drawing_area && p->frame_pending.load()) {
-            gtk_widget_queue_draw(p->drawing_area);
-            p->frame_pending.store(false);
+    if (stride == frame.stride) {
+        memcpy(slot.pixels.data(), frame.data, bytes);
+    } else {
+        size_t row_bytes = static_cast<size_t>(frame.width) * 4;
+        for (int y = 0; y < frame.height; ++y) {
+            memcpy(slot.pixels.data() + static_cast<size_t>(y) * stride,
+                   frame.data + static_cast<size_t>(y) * frame.stride,
+                   row_bytes);
         }
-        return FALSE;
-    }, pane.get());
+    }
+    slot.width = frame.width;
+    slot.height = frame.height;
+    slot.stride = stride;
+
+    // Hand it over; the frame clock tick picks it up on the next vsync
+    pane->frames_published.fetch_add(1, std::memory_order_relaxed);
+    if (pane->mailbox.publish()) {
+        pane->frames_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    pane->has_video.store(true);
+}
+
+void DashboardDisplay::get_target_size(size_t pane_index, int& width, int& height) const {
+    width = 0;
+    height = 0;
+    if (pane_index >= panes_.size()) {
+        return;
+    }
+    width = panes_[pane_index]->target_width.load();
+    height = panes_[pane_index]->target_height.load();
+}
+
+bool DashboardDisplay::is_pane_visible(size_t pane_index) const {
+    if (pane_index >= panes_.size()) {
+        return false;
+    }
+    return window_visible_.load() && panes_[pane_index]->visible.load();
 }
 
 void DashboardDisplay::set_status(size_t pane_index, const std::string& status) {
@@ -175,6 +207,13 @@ void DashboardDisplay::set_status(size_t pane_index, const std::string& status)
     }
 }
 
+void DashboardDisplay::set_pipeline_stats(size_t pane_index, PipelineStats* stats) {
+    if (pane_index >= panes_.size()) {
+        return;
+    }
+    panes_[pane_index]->pipeline_stats.store(stats);
+}
+
 void DashboardDisplay::run() {
     if (!window_) {
         LOG_ERROR("Window not created");
@@ -191,12 +230,31 @@ void DashboardDisplay::quit() {
     gtk_main_quit();
 }
 
+gboolean DashboardDisplay::on_tick(GtkWidget* widget, GdkFrameClock* clock, gpointer user_data) {
+    (void)widget;
+    (void)clock;
+
+    auto* self = static_cast<DashboardDisplay*>(user_data);
+    for (auto& pane : self->panes_) {
+        if (pane->drawing_area && pane->mailbox.has_update()) {
+            gtk_widget_queue_draw(pane->drawing_area);
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 gboolean DashboardDisplay::on_draw(GtkWidget* widget, cairo_t* cr, gpointer user_data) {
     CameraPane* pane = static_cast<CameraPane*>(user_data);
 
     int area_width = gtk_widget_get_allocated_width(widget);
     int area_height = gtk_widget_get_allocated_height(widget);
 
+    // Publish the pane size so the worker can decode straight to it
+    int scale_factor = std::max(1, gtk_widget_get_scale_factor(widget));
+    pane->scale_factor.store(scale_factor);
+    pane->target_width.store(area_width * scale_factor);
+    pane->target_height.store(area_height * scale_factor);
+
     // Clear background
     cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
     cairo_paint(cr);
@@ -207,59 +265,73 @@ gboolean DashboardDisplay::on_draw(GtkWidget* widget, cairo_t* cr, gpointer user
 }
 
 void DashboardDisplay::draw_pane(CameraPane* pane, cairo_t* cr, int width, int height) {
-    std::lock_guard<std::mutex> lock(pane->mutex);
-
-    if (pane->has_video.load() && !pane->frame_buffer.empty() &&
-        pane->frame_width > 0 && pane->frame_height > 0) {
-
-        // Update surface if needed
-        if (pane->surface) {
-            int surf_width = cairo_image_surface_get_width(pane->surface);
-            int surf_height = cairo_image_surface_get_height(pane->surface);
-            if (surf_width != pane->frame_width || surf_height != pane->frame_height) {
-                cairo_surface_destroy(pane->surface);
-                pane->surface = nullptr;
-            }
-        }
-
-        if (!pane->surface) {
-            pane->surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
-                                                        pane->frame_width, pane->frame_height);
+    // Take the newest frame, if one arrived since the last draw
+    bool fresh = pane->mailbox.acquire();
+    if (fresh) {
+        pane->frames_displayed.fetch_add(1, std::memory_order_relaxed);
+    }
+    PaneFrame& frame = pane->mailbox.read_buffer();
+
+    if (pane->has_video.load() && frame.width > 0 && frame.height > 0) {
+        StageTimer timer(pane->pipeline_stats.load(std::memory_order_relaxed), PipelineStage::Paint);
+
+        // Wrap the slot's pixels (recreate if the slot was reallocated or resized)
+        if (frame.surface &&
+            (cairo_image_surface_get_data(frame.surface) != frame.pixels.data() ||
+             cairo_image_surface_get_width(frame.surface) != frame.width ||
+             cairo_image_surface_get_height(frame.surface) != frame.height ||
+             cairo_image_surface_get_stride(frame.surface) != frame.stride)) {
+            cairo_surface_destroy(frame.surface);
+            frame.surface = nullptr;
         }
 
-        // Copy BGRA data directly to surface (decoder outputs Cairo's native format)
-        unsigned char* surf_data = cairo_image_surface_get_data(pane->surface);
-        int stride = cairo_image_surface_get_stride(pane->surface);
-        int src_stride = pane->frame_width * 4;
-
-        cairo_surface_flush(pane->surface);
-
-        for (int y = 0; y < pane->frame_height; ++y) {
-            memcpy(surf_data + y * stride,
-                   pane->frame_buffer.data() + y * src_stride,
-                   src_stride);
+        if (!frame.surface) {
+            frame.surface = cairo_image_surface_create_for_data(frame.pixels.data(),
+                                                                CAIRO_FORMAT_RGB24,
+                                                                frame.width, frame.height,
+                                                                frame.stride);
+        } else if (fresh) {
+            cairo_surface_mark_dirty(frame.surface);
         }
 
-        cairo_surface_mark_dirty(pane->surface);
-
-        // Draw scaled
-        double scale_x = static_cast<double>(width) / pane->frame_width;
-        double scale_y = static_cast<double>(height) / pane->frame_height;
+        // Surface pixels map 1:1 to device pixels on HiDPI outputs
+        int scale_factor = pane->scale_factor.load();
+        cairo_surface_set_device_scale(frame.surface, scale_factor, scale_factor);
+        double frame_width = static_cast<double>(frame.width) / scale_factor;
+        double frame_height = static_cast<double>(frame.height) / scale_factor;
+
+        // The decoder normally outputs at pane size already; scale only
+        // while a resize is catching up or the source is smaller than the pane
+        // (within the 2px the decoder may trim to keep dimensions even)
+        double scale_x = width / frame_width;
+        double scale_y = height / frame_height;
         double scale = std::min(scale_x, scale_y);
+        bool fits = frame_width <= width && frame_height <= height &&
+                    (width - frame_width < 2.0 || height - frame_height < 2.0);
+        if (fits) {
+            scale = 1.0;
+        }
 
-        double x_offset = (width - pane->frame_width * scale) / 2.0;
-        double y_offset = (height - pane->frame_height * scale) / 2.0;
+        double x_offset = (width - frame_width * scale) / 2.0;
+        double y_offset = (height - frame_height * scale) / 2.0;
 
         cairo_save(cr);
-        cairo_translate(cr, x_offset, y_offset);
-        cairo_scale(cr, scale, scale);
-        cairo_set_source_surface(cr, pane->surface, 0, 0);
-        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+        if (fits) {
+            // Whole-pixel offset keeps the blit unfiltered
+            cairo_set_source_surface(cr, frame.surface,
+                                     static_cast<int>(x_offset), static_cast<int>(y_offset));
+        } else {
+            cairo_translate(cr, x_offset, y_offset);
+            cairo_scale(cr, scale, scale);
+            cairo_set_source_surface(cr, frame.surface, 0, 0);
+            cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+        }
         cairo_paint(cr);
         cairo_restore(cr);
 
     } else {
         // Show status message
+        std::lock_guard<std::mutex> lock(pane->mutex);
         if (!pane->status.empty()) {
             cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
             cairo_set_font_size(cr, 14.0);
@@ -285,6 +357,14 @@ struct ShowOnlyData {
 };
 
 void DashboardDisplay::show_only(const std::vector<size_t>& indices) {
+    for (size_t i = 0; i < panes_.size(); i++) {
+        bool should_show = false;
+        for (size_t idx : indices) {
+            if (idx == i) { should_show = true; break; }
+        }
+        panes_[i]->visible.store(should_show);
+    }
+
     auto* data = new ShowOnlyData{this, indices};
     g_idle_add([](gpointer user_data) -> gboolean {
         auto* d = static_cast<ShowOnlyData*>(user_data);
@@ -308,6 +388,10 @@ void DashboardDisplay::show_only(const std::vector<size_t>& indices) {
 }
 
 void DashboardDisplay::show_all_panes() {
+    for (auto& pane : panes_) {
+        pane->visible.store(true);
+    }
+
     g_idle_add([](gpointer user_data) -> gboolean {
         auto* self = static_cast<DashboardDisplay*>(user_data);
         for (auto& pane : self->panes_) {
@@ -329,6 +413,11 @@ size_t DashboardDisplay::add_pane(const CameraConfig& config, bool replace) {
     pane->status = "Connecting...";
 
     size_t new_index = panes_.size();
+    if (replace) {
+        for (auto& existing : panes_) {
+            existing->visible.store(false);
+        }
+    }
     panes_.push_back(std::move(pane));
 
     auto* data = new AddPaneData{this, panes_.back()->name, replace};
@@ -379,6 +468,7 @@ size_t DashboardDisplay::add_pane(const CameraConfig& config, bool replace) {
 }
 
 void DashboardDisplay::hide_window() {
+    window_visible_.store(false);
     g_idle_add([](gpointer user_data) -> gboolean {
         auto* self = static_cast<DashboardDisplay*>(user_data);
         if (self->window_) {
@@ -389,6 +479,7 @@ void DashboardDisplay::hide_window() {
 }
 
 void DashboardDisplay::show_window() {
+    window_visible_.store(true);
     g_idle_add([](gpointer user_data) -> gboolean {
         auto* self = static_cast<DashboardDisplay*>(user_data);
         if (self->window_) {
@@ -420,7 +511,9 @@ std::vector<DashboardDisplay::PaneInfo> DashboardDisplay::get_pane_info(const st
         auto& pane = panes_[i];
         bool visible = pane->frame_widget ? gtk_widget_get_visible(pane->frame_widget) : false;
         bool connected = (i < connected_flags.size()) ? connected_flags[i] : true;
-        result.push_back({pane->name, visible, connected});
+        result.push_back({pane->name, visible, connected,
+                          pane->frames_published.load(), pane->frames_displayed.load(),
+                          pane->frames_dropped.load()});
     }
     return result;
 }
@@ -2,6 +2,7 @@
 
 #include "video/decoder.h"
 #include "utils/json_config.h"
+#include "utils/triple_buffer.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -17,29 +18,59 @@ namespace baichuan {
 // Callback for quit event
 using QuitCallback = std::function<void()>;
 
+// One decoded frame in a pane's mailbox
+// Pixels are laid out with Cairo's stride so the GTK thread can wrap them
+// in a surface without copying; the surface belongs to the GTK thread and
+// is recreated when the slot's buffer or geometry changes.
+struct PaneFrame {
+    std::vector<uint8_t> pixels;  // BGRA, stride bytes per row
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    cairo_surface_t* surface = nullptr;
+
+    PaneFrame() = default;
+    PaneFrame(const PaneFrame&) = delete;
+    PaneFrame& operator=(const PaneFrame&) = delete;
+
+    ~PaneFrame() {
+        if (surface) {
+            cairo_surface_destroy(surface);
+        }
+    }
+};
+
 // Single camera pane within the dashboard
 struct CameraPane {
     std::string name;
     std::string status;
+    std::mutex mutex;  // Guards status
 
-    // Video frame data
-    std::vector<uint8_t> frame_buffer;
-    int frame_width = 0;
-    int frame_height = 0;
-    cairo_surface_t* surface = nullptr;
-    std::mutex mutex;
+    // Newest decoded frame: written by the camera worker, read by the GTK
+    // frame clock - no locks or idle callbacks per frame
+    TripleBuffer<PaneFrame> mailbox;
     std::atomic<bool> has_video{false};
-    std::atomic<bool> frame_pending{false};
+
+    // Frame counters (dropped = published but overwritten before display)
+    std::atomic<uint64_t> frames_published{0};
+    std::atomic<uint64_t> frames_displayed{0};
+    std::atomic<uint64_t> frames_dropped{0};
+
+    // Publish and paint times go to the camera's stats (null = off)
+    std::atomic<PipelineStats*> pipeline_stats{nullptr};
+
+    // Drawing area size in device pixels (allocation x scale factor), set on
+    // the GTK thread and read by the camera worker to size decoder output
+    std::atomic<int> target_width{0};
+    std::atomic<int> target_height{0};
+    std::atomic<int> scale_factor{1};
+
+    // Shown in the grid (tracked at request time, ahead of the GTK update)
+    std::atomic<bool> visible{true};
 
     // GTK widgets
     GtkWidget* frame_widget = nullptr;  // GtkFrame container
     GtkWidget* drawing_area = nullptr;
-
-    ~CameraPane() {
-        if (surface) {
-            cairo_surface_destroy(surface);
-        }
-    }
 };
 
 class DashboardDisplay {
@@ -56,9 +87,21 @@ public:
     // Update a specific camera pane with decoded frame
     void update_frame(size_t pane_index, const DecodedFrame& frame);
 
+    // Pixel size frames for this pane should be decoded at (0 x 0 until drawn)
+    // Safe to call from worker threads
+    void get_target_size(size_t pane_index, int& width, int& height) const;
+
+    // Whether the pane is on screen (pane shown and window not hidden)
+    // Safe to call from worker threads
+    bool is_pane_visible(size_t pane_index) const;
+
     // Set status message for a specific pane
     void set_status(size_t pane_index, const std::string& status);
 
+    // Record the pane's publish (update_frame) and paint times here; the
+    // stats must outlive the display
+    void set_pipeline_stats(size_t pane_index, PipelineStats* stats);
+
     // Run GTK main loop (blocking, call from main thread)
     void run();
 
@@ -98,6 +141,9 @@ public:
         std::string name;
         bool visible;
         bool connected;  // whether the camera worker is active
+        uint64_t frames_published;
+        uint64_t frames_displayed;
+        uint64_t frames_dropped;
     };
 
     // Get current pane info (names + visibility + connection state)
@@ -114,15 +160,15 @@ private:
     int columns_ = 2;
 
     std::atomic<bool> quit_requested_{false};
+    std::atomic<bool> window_visible_{true};
     QuitCallback quit_callback_;
 
     // GTK callbacks
     static gboolean on_draw(GtkWidget* widget, cairo_t* cr, gpointer user_data);
     static gboolean on_delete_event(GtkWidget* widget, GdkEvent* event, gpointer user_data);
     static void on_quit_clicked(GtkWidget* widget, gpointer user_data);
-    static gboolean on_idle_update(gpointer user_data);
+    static gboolean on_tick(GtkWidget* widget, GdkFrameClock* clock, gpointer user_data);
 
-    void update_pane_surface(CameraPane* pane);
     static void draw_pane(CameraPane* pane, cairo_t* cr, int width, int height);
 };
 
@@ -0,0 +1,168 @@
+#include "video/decode_gate.h"
+#include "utils/logger.h"
+
+namespace baichuan {
+
+const char* decode_policy_to_string(DecodePolicy policy) {
+    switch (policy) {
+        case DecodePolicy::Full: return "full";
+        case DecodePolicy::KeyframesOnly: return "keyframes";
+        case DecodePolicy::Suspended: return "off";
+    }
+    return "unknown";
+}
+
+bool parse_decode_policy(const std::string& str, DecodePolicy& policy) {
+    if (str == "full") {
+        policy = DecodePolicy::Full;
+    } else if (str == "keyframes") {
+        policy = DecodePolicy::KeyframesOnly;
+    } else if (str == "off") {
+        policy = DecodePolicy::Suspended;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool is_keyframe_bitstream(const uint8_t* data, size_t len, VideoCodec codec) {
+    // Walk Annex-B start codes until the first slice
+    for (size_t i = 0; i + 3 < len; i++) {
+        if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+            continue;
+        }
+
+        uint8_t header = data[i + 3];
+        if (codec == VideoCodec::H265) {
+            int type = (header >> 1) & 0x3F;
+            if ((type >= 16 && type <= 21) || (type >= 32 && type <= 34)) {
+                return true;  // IRAP slice or VPS/SPS/PPS
+            }
+            if (type < 32) {
+                return false;  // Other slice
+            }
+        } else {
+            int type = header & 0x1F;
+            if (type == 5 || type == 7) {
+                return true;  // IDR slice or SPS
+            }
+            if (type >= 1 && type <= 4) {
+                return false;  // Non-IDR slice
+            }
+        }
+        i += 2;
+    }
+    return false;
+}
+
+DecodeGate::DecodeGate(VideoDecoder& decoder)
+    : decoder_(decoder) {}
+
+bool DecodeGate::submit(const uint8_t* data, size_t len, bool keyframe, DecodePolicy policy,
+                        const DecodedFrameCallback& callback, int64_t pts) {
+    return submit(FrameBuffer::copy_of(data, len), keyframe, policy, callback, pts);
+}
+
+bool DecodeGate::submit(const FrameBuffer& data, bool keyframe, DecodePolicy policy,
+                        const DecodedFrameCallback& callback, int64_t pts) {
+    cache(data, keyframe);
+
+    // Nothing decodable before the first keyframe
+    if (gop_.empty()) {
+        stats_.frames_skipped++;
+        return false;
+    }
+
+    if (policy == DecodePolicy::Full) {
+        if (!synced_) {
+            if (keyframe) {
+                // Fresh GOP - no need to replay anything
+                decoder_.flush();
+                synced_ = true;
+            } else if (!gop_truncated_) {
+                synced_ = true;
+                return resume(callback, pts);
+            } else {
+                // Show the cached I-frame once, then wait for the next keyframe
+                if (still_shown_) {
+                    stats_.frames_skipped++;
+                    return false;
+                }
+                still_shown_ = true;
+                stats_.frames_replayed++;
+                decoder_.flush();
+                return decoder_.decode_still(gop_[0].data(), gop_[0].size(), callback);
+            }
+        }
+
+        stats_.frames_decoded++;
+        return decoder_.decode(data.data(), data.size(), callback, pts);
+    }
+
+    synced_ = false;
+
+    if (policy == DecodePolicy::KeyframesOnly && keyframe) {
+        auto now = std::chrono::steady_clock::now();
+        if (last_still_ == std::chrono::steady_clock::time_point{} ||
+            now - last_still_ >= keyframe_interval_) {
+            last_still_ = now;
+            stats_.frames_decoded++;
+            return decoder_.decode_still(data.data(), data.size(), callback, pts);
+        }
+    }
+
+    stats_.frames_skipped++;
+    return false;
+}
+
+void DecodeGate::reset() {
+    gop_.clear();
+    gop_bytes_ = 0;
+    gop_truncated_ = false;
+    synced_ = false;
+    still_shown_ = false;
+    last_still_ = {};
+}
+
+void DecodeGate::cache(const FrameBuffer& data, bool keyframe) {
+    if (keyframe) {
+        gop_.clear();
+        gop_bytes_ = 0;
+        gop_truncated_ = false;
+        still_shown_ = false;
+    } else if (gop_.empty() || gop_truncated_) {
+        return;
+    }
+
+    if (!keyframe && gop_bytes_ + data.size() > max_gop_bytes_) {
+        LOG_DEBUG("GOP cache over {} bytes, keeping only its I-frame", max_gop_bytes_);
+        gop_.resize(1);
+        gop_bytes_ = gop_[0].size();
+        gop_truncated_ = true;
+        return;
+    }
+
+    // Pooled buffers are shared, not copied
+    gop_.push_back(data);
+    gop_bytes_ += data.size();
+}
+
+bool DecodeGate::resume(const DecodedFrameCallback& callback, int64_t pts) {
+    // Rebuild the reference state from the GOP's I-frame; only the newest
+    // picture (the frame just submitted) is converted and output
+    decoder_.flush();
+
+    bool decoded = false;
+    for (size_t i = 0; i < gop_.size(); i++) {
+        bool last = (i + 1 == gop_.size());
+        decoded = decoder_.decode(gop_[i].data(), gop_[i].size(),
+                                  last ? callback : DecodedFrameCallback{},
+                                  last ? pts : INT64_MIN);
+        stats_.frames_replayed++;
+    }
+
+    LOG_DEBUG("Decode resumed: replayed {} cached frames", gop_.size());
+    return decoded;
+}
+
+} // namespace baichuan
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "video/decoder.h"
+#include "utils/buffer_pool.h"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace baichuan {
+
+// How much of a stream gets decoded
+enum class DecodePolicy {
+    Full,           // Every frame
+    KeyframesOnly,  // Standalone I-frames, at most one per keyframe interval
+    Suspended       // Nothing; the current GOP is cached for instant resume
+};
+
+const char* decode_policy_to_string(DecodePolicy policy);
+
+// Accepts "full", "keyframes" and "off"
+bool parse_decode_policy(const std::string& str, DecodePolicy& policy);
+
+// Check an Annex-B bitstream for an IDR/IRAP picture (or parameter sets)
+bool is_keyframe_bitstream(const uint8_t* data, size_t len, VideoCodec codec);
+
+// Decides which compressed frames reach a VideoDecoder
+//
+// Frames are always added to a cache of the current GOP (I-frame plus the
+// P-frames after it). While frames are being skipped the decoder's
+// reference state goes stale; when the policy returns to Full the cached
+// GOP is replayed without conversion and only the newest picture is output,
+// so a resumed pane shows the live image straight away rather than waiting
+// for the next keyframe. If the GOP outgrows max_gop_bytes only its I-frame
+// is kept and decoding resumes at the next keyframe instead.
+//
+// Not thread-safe: call from the thread that owns the decoder.
+class DecodeGate {
+public:
+    explicit DecodeGate(VideoDecoder& decoder);
+
+    // Minimum gap between pictures in KeyframesOnly mode (default 1000 ms)
+    void set_keyframe_interval(int ms) { keyframe_interval_ = std::chrono::milliseconds(ms); }
+
+    // Cap on cached GOP bytes (default 32 MB)
+    void set_max_gop_bytes(size_t bytes) { max_gop_bytes_ = bytes; }
+
+    // Feed one compressed frame; returns true if a picture was output
+    // pts is handed to the decoder with the frame (see VideoDecoder::decode())
+    bool submit(const FrameBuffer& data, bool keyframe, DecodePolicy policy,
+                const DecodedFrameCallback& callback, int64_t pts = INT64_MIN);
+
+    // Same, for sources that don't hand out pooled buffers (copies the frame)
+    bool submit(const uint8_t* data, size_t len, bool keyframe, DecodePolicy policy,
+                const DecodedFrameCallback& callback, int64_t pts = INT64_MIN);
+
+    // Forget the cached GOP (after a reconnect)
+    void reset();
+
+    struct Stats {
+        uint64_t frames_decoded = 0;   // Sent to the decoder live
+        uint64_t frames_skipped = 0;   // Dropped by policy
+        uint64_t frames_replayed = 0;  // Sent from the GOP cache on resume
+    };
+    Stats stats() const { return stats_; }
+
+private:
+    VideoDecoder& decoder_;
+
+    std::vector<FrameBuffer> gop_;
+    size_t gop_bytes_ = 0;
+    bool gop_truncated_ = false;  // Only the I-frame is cached
+
+    // Decoder holds valid references for the next P-frame
+    bool synced_ = false;
+
+    // Cached I-frame of a truncated GOP was already shown
+    bool still_shown_ = false;
+
+    std::chrono::milliseconds keyframe_interval_{1000};
+    std::chrono::steady_clock::time_point last_still_{};
+    size_t max_gop_bytes_ = 32 * 1024 * 1024;
+
+    Stats stats_;
+
+    void cache(const FrameBuffer& data, bool keyframe);
+    bool resume(const DecodedFrameCallback& callback, int64_t pts);
+};
+
+} // namespace baichuan
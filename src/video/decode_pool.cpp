@@ -0,0 +1,193 @@
+#include "video/decode_pool.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+
+namespace baichuan {
+
+DecodePool::DecodePool(size_t threads, size_t max_pending)
+    : max_pending_(max_pending > 0 ? max_pending : 1) {
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers_[i]->thread = std::thread(&DecodePool::run, this, i);
+    }
+    LOG_INFO("Decode pool started with {} threads", threads);
+}
+
+DecodePool::~DecodePool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_.store(true);
+    }
+    sleep_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+bool DecodePool::submit(size_t key, std::function<void()> task) {
+    Lane* lane = lane_for(key);
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        if (stopping_.load() || lane->stats.pending >= max_pending_) {
+            lane->stats.rejected++;
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        lane->tasks.push_back(Task{std::move(task), std::chrono::steady_clock::now()});
+        lane->stats.pending++;
+        if (!lane->scheduled) {
+            lane->scheduled = true;
+            wake = true;
+        }
+    }
+
+    if (wake) {
+        schedule(lane, lane->home);
+    }
+    return true;
+}
+
+void DecodePool::drain(size_t key) {
+    Lane* lane = lane_for(key);
+    std::unique_lock<std::mutex> lock(lane->mutex);
+    lane->idle_cv.wait(lock, [lane] { return lane->stats.pending == 0; });
+}
+
+DecodePool::LaneStats DecodePool::lane_stats(size_t key) {
+    Lane* lane = lane_for(key);
+    std::lock_guard<std::mutex> lock(lane->mutex);
+    return lane->stats;
+}
+
+DecodePool::Stats DecodePool::stats() const {
+    Stats stats;
+    stats.tasks_run = tasks_run_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.steals = steals_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+DecodePool::Lane* DecodePool::lane_for(size_t key) {
+    std::lock_guard<std::mutex> lock(lanes_mutex_);
+    std::unique_ptr<Lane>& lane = lanes_[key];
+    if (!lane) {
+        lane = std::make_unique<Lane>();
+        lane->home = key % workers_.size();
+    }
+    return lane.get();
+}
+
+void DecodePool::schedule(Lane* lane, size_t worker) {
+    {
+        std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+        workers_[worker]->runnable.push_back(lane);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ready_++;
+    }
+    sleep_cv_.notify_one();
+}
+
+DecodePool::Lane* DecodePool::take(size_t self) {
+    Lane* lane = nullptr;
+
+    // Own queue first (oldest lane), then steal the newest from the others
+    {
+        Worker& own = *workers_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.runnable.empty()) {
+            lane = own.runnable.front();
+            own.runnable.pop_front();
+        }
+    }
+    for (size_t i = 1; !lane && i < workers_.size(); i++) {
+        Worker& victim = *workers_[(self + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.runnable.empty()) {
+            lane = victim.runnable.back();
+            victim.runnable.pop_back();
+            steals_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (lane) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ready_--;
+    }
+    return lane;
+}
+
+void DecodePool::run(size_t self) {
+    while (true) {
+        Lane* lane = take(self);
+        if (!lane) {
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.wait(lock, [this] { return stopping_.load() || ready_ > 0; });
+            if (stopping_.load() && ready_ == 0) {
+                return;  // Stopping and drained
+            }
+            continue;
+        }
+
+        run_lane(lane);
+
+        // Still busy: back of our own queue, behind the other cameras
+        bool again;
+        {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            again = !lane->tasks.empty();
+            if (!again) {
+                lane->scheduled = false;
+            }
+        }
+        if (again) {
+            schedule(lane, self);
+        }
+    }
+}
+
+void DecodePool::run_lane(Lane* lane) {
+    for (size_t n = 0; n < BATCH; n++) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            if (lane->tasks.empty()) {
+                return;
+            }
+            task = std::move(lane->tasks.front());
+            lane->tasks.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        task.fn();
+        auto end = std::chrono::steady_clock::now();
+        task.fn = nullptr;  // Release captured packets outside the lock
+
+        uint64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(start - task.queued).count();
+        uint64_t busy_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            lane->stats.pending--;
+            lane->stats.tasks_run++;
+            lane->stats.wait_us_total += wait_us;
+            lane->stats.wait_us_max = std::max(lane->stats.wait_us_max, wait_us);
+            lane->stats.busy_us += busy_us;
+        }
+        lane->idle_cv.notify_all();
+        tasks_run_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace baichuan
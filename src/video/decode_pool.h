@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace baichuan {
+
+// Work-stealing decode scheduler shared by all cameras
+//
+// Sockets are read on the shared I/O reactor, whose threads must never
+// decode - one slow decoder would stall every camera's network reads.
+// Packets are handed here instead.
+//
+// Each camera (key) has a lane: an ordered queue that at most one thread
+// runs at a time, so its packets decode in order and its decoder is never
+// touched concurrently. A lane with work sits in one thread's run queue
+// (its home thread when it becomes runnable); idle threads steal lanes from
+// the back of other run queues, so a busy camera doesn't leave the rest of
+// the pool idle. A thread runs at most BATCH tasks of a lane before putting
+// it at the back of its queue, which bounds how long one camera can
+// monopolise a thread.
+//
+// Each lane's backlog is bounded: submit() refuses work past max_pending,
+// and the caller drops packets until the next keyframe.
+class DecodePool {
+public:
+    // threads = 0: one per hardware thread
+    explicit DecodePool(size_t threads = 0, size_t max_pending = 32);
+    ~DecodePool();
+
+    DecodePool(const DecodePool&) = delete;
+    DecodePool& operator=(const DecodePool&) = delete;
+
+    // Queue a task for a camera; false if its backlog is full
+    bool submit(size_t key, std::function<void()> task);
+
+    // Wait until every task queued for the camera has run
+    void drain(size_t key);
+
+    size_t thread_count() const { return workers_.size(); }
+
+    // Per-camera latency and fairness
+    struct LaneStats {
+        uint64_t tasks_run = 0;
+        uint64_t rejected = 0;      // Backlog full
+        size_t pending = 0;         // Queued or running
+        uint64_t wait_us_total = 0; // Queued -> started, summed
+        uint64_t wait_us_max = 0;
+        uint64_t busy_us = 0;       // Time spent running the camera's tasks
+    };
+    LaneStats lane_stats(size_t key);
+
+    struct Stats {
+        uint64_t tasks_run = 0;
+        uint64_t rejected = 0;
+        uint64_t steals = 0;        // Lanes taken from another thread's queue
+    };
+    Stats stats() const;
+
+private:
+    static constexpr size_t BATCH = 4;
+
+    struct Task {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    struct Lane {
+        std::mutex mutex;
+        std::condition_variable idle_cv;
+        std::deque<Task> tasks;
+        size_t home = 0;
+        bool scheduled = false;     // In a run queue or being run
+        LaneStats stats;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Lane*> runnable;
+        std::thread thread;
+    };
+
+    size_t max_pending_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // Lanes live as long as the pool
+    std::mutex lanes_mutex_;
+    std::unordered_map<size_t, std::unique_ptr<Lane>> lanes_;
+
+    // Idle threads sleep until a lane becomes runnable
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    size_t ready_ = 0;              // Lanes waiting in run queues
+    std::atomic<bool> stopping_{false};
+
+    std::atomic<uint64_t> tasks_run_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> steals_{0};
+
+    Lane* lane_for(size_t key);
+    void schedule(Lane* lane, size_t worker);
+    Lane* take(size_t self);
+    void run(size_t self);
+    void run_lane(Lane* lane);
+};
+
+} // namespace baichuan
@@ -1,6 +1,8 @@
 #include "video/decoder.h"
 #include "utils/logger.h"
 
+#include <algorithm>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/imgutils.h>
@@ -10,6 +12,25 @@ extern "C" {
 
 namespace baichuan {
 
+const char* decoder_profile_to_string(DecoderProfile profile) {
+    switch (profile) {
+        case DecoderProfile::LowLatency: return "low-latency";
+        case DecoderProfile::Throughput: return "throughput";
+    }
+    return "unknown";
+}
+
+bool parse_decoder_profile(const std::string& str, DecoderProfile& profile) {
+    if (str == "low-latency") {
+        profile = DecoderProfile::LowLatency;
+    } else if (str == "throughput") {
+        profile = DecoderProfile::Throughput;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 VideoDecoder::VideoDecoder() = default;
 
 VideoDecoder::~VideoDecoder() {
@@ -23,13 +44,20 @@ bool VideoDecoder::try_open_decoder(const AVCodec* decoder) {
     codec_ctx_ = avcodec_alloc_context3(decoder);
     if (!codec_ctx_) return false;
 
-    // Low latency flags
-    codec_ctx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
-    codec_ctx_->flags2 |= AV_CODEC_FLAG2_FAST;
-
-    // Multi-threaded decoding (frame-level only, slice threading can cause issues)
-    codec_ctx_->thread_count = 0;
-    codec_ctx_->thread_type = FF_THREAD_FRAME;
+    codec_ctx_->thread_count = thread_count_;
+    if (profile_ == DecoderProfile::LowLatency) {
+        // Every picture is output as soon as it is decoded: threads split
+        // slices of one frame (FFmpeg ignores frame threads with LOW_DELAY),
+        // non-spec-compliant speedups allowed, and the deblocking filter
+        // skipped on frames nothing else references
+        codec_ctx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        codec_ctx_->flags2 |= AV_CODEC_FLAG2_FAST;
+        codec_ctx_->thread_type = FF_THREAD_SLICE;
+        codec_ctx_->skip_loop_filter = AVDISCARD_NONREF;
+    } else {
+        // Threads work on consecutive frames; each adds a frame of delay
+        codec_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
 
     if (avcodec_open2(codec_ctx_, decoder, nullptr) < 0) {
         avcodec_free_context(&codec_ctx_);
@@ -57,7 +85,8 @@ bool VideoDecoder::init(VideoCodec codec) {
         LOG_ERROR("Failed to open {} decoder", codec_name);
         return false;
     }
-    LOG_INFO("Video decoder initialized: {} ({})", codec_name, decoder->name);
+    LOG_INFO("Video decoder initialized: {} ({}, {})", codec_name, decoder->name,
+             decoder_profile_to_string(profile_));
 
     // Allocate frame and packet
     frame_ = av_frame_alloc();
@@ -71,7 +100,6 @@ bool VideoDecoder::init(VideoCodec codec) {
     }
 
     initialized_ = true;
-    stats_ = Stats{};
     return true;
 }
 
@@ -107,62 +135,161 @@ void VideoDecoder::shutdown() {
         aligned_buf_size_ = 0;
         aligned_stride_ = 0;
     }
+    bgra_buf_.clear();
+    bgra_buf_.shrink_to_fit();
+    output_ = DecodedFrame{};
 
     initialized_ = false;
+    input_width_ = 0;
+    input_height_ = 0;
+    input_pix_fmt_ = -1;
     output_width_ = 0;
     output_height_ = 0;
-    input_pix_fmt_ = -1;
 }
 
-bool VideoDecoder::decode(const uint8_t* data, size_t len, DecodedFrameCallback callback) {
+void VideoDecoder::set_output_size(int max_width, int max_height) {
+    max_width_ = max_width > 0 ? max_width : 0;
+    max_height_ = max_height > 0 ? max_height : 0;
+}
+
+void VideoDecoder::fit_output_size(int width, int height, int& out_width, int& out_height) const {
+    out_width = width;
+    out_height = height;
+
+    if (max_width_ <= 0 || max_height_ <= 0 ||
+        (width <= max_width_ && height <= max_height_)) {
+        return;
+    }
+
+    // Scale to fit the bound, keeping the aspect ratio
+    if (static_cast<int64_t>(width) * max_height_ > static_cast<int64_t>(height) * max_width_) {
+        out_width = max_width_;
+        out_height = static_cast<int>(static_cast<int64_t>(height) * max_width_ / width);
+    } else {
+        out_height = max_height_;
+        out_width = static_cast<int>(static_cast<int64_t>(width) * max_height_ / height);
+    }
+
+    // Even dimensions keep the chroma subsampling in step
+    out_width = std::max(2, out_width & ~1);
+    out_height = std::max(2, out_height & ~1);
+}
+
+bool VideoDecoder::decode(const uint8_t* data, size_t len, DecodedFrameCallback callback,
+                          int64_t pts) {
+    if (!initialized_) {
+        LOG_ERROR("Decoder not initialized");
+        return false;
+    }
+
+    if (!send_packet(data, len, pts)) {
+        return false;
+    }
+    return receive_frames(callback);
+}
+
+bool VideoDecoder::decode_still(const uint8_t* data, size_t len, DecodedFrameCallback callback,
+                                int64_t pts) {
     if (!initialized_) {
         LOG_ERROR("Decoder not initialized");
         return false;
     }
 
+    if (!send_packet(data, len, pts)) {
+        return false;
+    }
+
+    // Enter draining mode so frame threads hand back the picture now
+    // instead of after the next thread_count packets
+    avcodec_send_packet(codec_ctx_, nullptr);
+    bool decoded = receive_frames(callback);
+
+    // Leave draining mode; reference frames are gone after this
+    avcodec_flush_buffers(codec_ctx_);
+    return decoded;
+}
+
+void VideoDecoder::flush() {
+    if (initialized_) {
+        avcodec_flush_buffers(codec_ctx_);
+    }
+}
+
+bool VideoDecoder::send_packet(const uint8_t* data, size_t len, int64_t pts) {
     // Set packet data
     packet_->data = const_cast<uint8_t*>(data);
     packet_->size = static_cast<int>(len);
+    packet_->pts = pts;
 
     // Send packet to decoder
-    int ret = avcodec_send_packet(codec_ctx_, packet_);
+    int ret;
+    {
+        StageTimer timer(pipeline_stats_, PipelineStage::DecodeSend);
+        ret = avcodec_send_packet(codec_ctx_, packet_);
+    }
     if (ret < 0) {
         LOG_ERROR("Error sending packet to decoder: {}", ret);
-        stats_.decode_errors++;
+        stats_->decode_errors++;
         return false;
     }
+    return true;
+}
 
+bool VideoDecoder::receive_frames(const DecodedFrameCallback& callback) {
     // Receive decoded frames
     bool decoded = false;
+    int ret = 0;
     while (ret >= 0) {
+        auto receive_start = pipeline_stats_ ? std::chrono::steady_clock::now()
+                                             : std::chrono::steady_clock::time_point{};
         ret = avcodec_receive_frame(codec_ctx_, frame_);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             break;
         }
+        if (pipeline_stats_ && ret >= 0) {
+            pipeline_stats_->record(PipelineStage::DecodeReceive,
+                                    std::chrono::steady_clock::now() - receive_start);
+        }
         if (ret < 0) {
             LOG_ERROR("Error receiving frame from decoder: {}", ret);
-            stats_.decode_errors++;
+            stats_->decode_errors++;
             break;
         }
 
-        // Setup scaler if needed (first frame, resolution change, or format change)
-        if (frame_->width != output_width_ || frame_->height != output_height_ ||
-            frame_->format != input_pix_fmt_) {
+        // Nobody to hand the picture to (e.g. catching up on skipped
+        // frames) - keep the reference state, skip the conversion
+        if (!callback) {
+            stats_->frames_decoded++;
+            decoded = true;
+            continue;
+        }
+
+        // Setup scaler if needed (first frame, resolution or format change,
+        // or a new output bound)
+        int out_width, out_height;
+        fit_output_size(frame_->width, frame_->height, out_width, out_height);
+        if (frame_->width != input_width_ || frame_->height != input_height_ ||
+            frame_->format != input_pix_fmt_ ||
+            out_width != output_width_ || out_height != output_height_) {
             if (!setup_scaler(frame_->width, frame_->height, frame_->format)) {
                 LOG_ERROR("Failed to setup scaler");
                 continue;
             }
         }
 
-        // Convert to RGB
-        DecodedFrame output;
-        if (convert_to_rgb(output)) {
-            output.pts = frame_->pts;
-            stats_.frames_decoded++;
+        // Convert to BGRA (into the reused output buffer)
+        bool converted;
+        {
+            StageTimer timer(pipeline_stats_, PipelineStage::Convert);
+            converted = convert_to_bgra(output_);
+        }
+        if (converted) {
+            output_.pts = frame_->pts;
+            stats_->frames_decoded++;
             decoded = true;
 
             if (callback) {
-                callback(output);
+                callback(output_);
             }
         }
     }
@@ -186,13 +313,26 @@ bool VideoDecoder::setup_scaler(int width, int height, int pix_fmt) {
         default: break;
     }
 
-    // Create scaler context: YUV -> RGB24 (BGRA not supported on all platforms)
-    // We convert RGB24 -> BGRA manually afterwards
+    int out_width, out_height;
+    fit_output_size(width, height, out_width, out_height);
+
+    // Create scaler context: YUV -> BGRA (and downscale) in one pass. If the
+    // build's swscale can't produce BGRA, fall back to RGB24 and swizzle afterwards
     sws_ctx_ = sws_getContext(
         width, height, src_fmt,
-        width, height, AV_PIX_FMT_RGB24,
+        out_width, out_height, AV_PIX_FMT_BGRA,
         SWS_BILINEAR, nullptr, nullptr, nullptr
     );
+    direct_bgra_ = sws_ctx_ != nullptr;
+
+    if (!sws_ctx_) {
+        LOG_WARN("BGRA scaler unavailable, falling back to RGB24 conversion");
+        sws_ctx_ = sws_getContext(
+            width, height, src_fmt,
+            out_width, out_height, AV_PIX_FMT_RGB24,
+            SWS_BILINEAR, nullptr, nullptr, nullptr
+        );
+    }
 
     if (!sws_ctx_) {
         LOG_ERROR("Failed to create scaler context");
@@ -200,9 +340,10 @@ bool VideoDecoder::setup_scaler(int width, int height, int pix_fmt) {
     }
 
     // Allocate aligned buffer for sws_scale output (NEON/SSE require 32-byte alignment)
-    // Use stride aligned to 32 bytes for SIMD safety (RGB24 = 3 bytes per pixel)
-    aligned_stride_ = (width * 3 + 31) & ~31;
-    int buf_size = aligned_stride_ * height;
+    // Use stride aligned to 32 bytes for SIMD safety
+    int bytes_per_pixel = direct_bgra_ ? 4 : 3;
+    aligned_stride_ = (out_width * bytes_per_pixel + 31) & ~31;
+    int buf_size = aligned_stride_ * out_height;
 
     if (buf_size != aligned_buf_size_) {
         if (aligned_buf_) av_free(aligned_buf_);
@@ -215,20 +356,29 @@ bool VideoDecoder::setup_scaler(int width, int height, int pix_fmt) {
         aligned_buf_size_ = buf_size;
     }
 
-    output_width_ = width;
-    output_height_ = height;
+    if (!direct_bgra_) {
+        bgra_buf_.resize(static_cast<size_t>(out_width) * out_height * 4);
+    } else {
+        bgra_buf_.clear();
+        bgra_buf_.shrink_to_fit();
+    }
+
+    input_width_ = width;
+    input_height_ = height;
     input_pix_fmt_ = pix_fmt;
+    output_width_ = out_width;
+    output_height_ = out_height;
 
-    LOG_DEBUG("Scaler setup: {}x{} fmt={} (stride {})", width, height, pix_fmt, aligned_stride_);
+    LOG_DEBUG("Scaler setup: {}x{} fmt={} -> {}x{} (stride {})",
+        width, height, pix_fmt, out_width, out_height, aligned_stride_);
     return true;
 }
 
-bool VideoDecoder::convert_to_rgb(DecodedFrame& output) {
+bool VideoDecoder::convert_to_bgra(DecodedFrame& output) {
     if (!sws_ctx_ || !aligned_buf_) {
         return false;
     }
 
-    int width = frame_->width;
     int height = frame_->height;
 
     // sws_scale into the aligned buffer (safe for NEON/SSE)
@@ -242,17 +392,30 @@ bool VideoDecoder::convert_to_rgb(DecodedFrame& output) {
         dst_data, dst_linesize
     );
 
-    if (result != height) {
-        LOG_ERROR("sws_scale returned {}, expected {} (fmt={} {}x{} stride={})",
-            result, height, frame_->format, width, height, aligned_stride_);
+    // sws_scale returns the number of output rows written
+    if (result != output_height_) {
+        LOG_ERROR("sws_scale returned {}, expected {} (fmt={} {}x{} -> {}x{} stride={})",
+            result, output_height_, frame_->format, frame_->width, height,
+            output_width_, output_height_, aligned_stride_);
         return false;
     }
 
-    // Convert RGB24 (aligned buffer) -> BGRA (output) for Cairo
-    output.rgb_data.resize(width * height * 4);
+    int width = output_width_;
+    height = output_height_;
+    output.width = width;
+    output.height = height;
+
+    if (direct_bgra_) {
+        // Scaler output is already BGRA - hand out the aligned buffer as-is
+        output.data = aligned_buf_;
+        output.stride = aligned_stride_;
+        return true;
+    }
+
+    // Fallback: RGB24 (aligned buffer) -> BGRA for Cairo
     for (int y = 0; y < height; y++) {
         const uint8_t* src = aligned_buf_ + y * aligned_stride_;
-        uint8_t* dst = output.rgb_data.data() + y * width * 4;
+        uint8_t* dst = bgra_buf_.data() + static_cast<size_t>(y) * width * 4;
         for (int x = 0; x < width; x++) {
             dst[0] = src[2];  // B
             dst[1] = src[1];  // G
@@ -263,9 +426,8 @@ bool VideoDecoder::convert_to_rgb(DecodedFrame& output) {
         }
     }
 
-    output.width = width;
-    output.height = height;
-
+    output.data = bgra_buf_.data();
+    output.stride = width * 4;
     return true;
 }
 
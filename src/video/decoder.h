@@ -1,9 +1,13 @@
 #pragma once
 
 #include "protocol/bc_media.h"
+#include "utils/pipeline_stats.h"
+#include "utils/metrics.h"
 #include <memory>
 #include <functional>
 #include <cstdint>
+#include <vector>
+#include <string>
 
 // Forward declarations for FFmpeg types
 struct AVCodec;
@@ -14,22 +18,48 @@ struct SwsContext;
 
 namespace baichuan {
 
-// Decoded frame with RGB data
+// Decoded frame in BGRA byte order (Cairo's native CAIRO_FORMAT_RGB24 layout)
+// The pixels belong to the producer (decoder/MJPEG source) and are reused for
+// the next frame - they are only valid during the frame callback. Rows are
+// `stride` bytes apart, which may be more than width * 4.
 struct DecodedFrame {
     int width = 0;
     int height = 0;
-    std::vector<uint8_t> rgb_data;  // RGB24 format
-    int64_t pts = 0;  // Presentation timestamp
+    int stride = 0;                 // Bytes per row
+    const uint8_t* data = nullptr;  // BGRA pixels
+    int64_t pts = INT64_MIN;        // Passed to decode() with the packet (INT64_MIN = none)
 };
 
 // Callback for decoded frames
 using DecodedFrameCallback = std::function<void(const DecodedFrame&)>;
 
+// How the FFmpeg decoder trades latency against throughput
+enum class DecoderProfile {
+    LowLatency,   // Slice threads, low-delay output, no loop filter on non-reference frames
+    Throughput    // Frame threads: more frames/s per core, one frame of delay per thread
+};
+
+const char* decoder_profile_to_string(DecoderProfile profile);
+
+// Accepts "low-latency" and "throughput"
+bool parse_decoder_profile(const std::string& str, DecoderProfile& profile);
+
 class VideoDecoder {
 public:
     VideoDecoder();
     ~VideoDecoder();
 
+    // FFmpeg frame threads for the next init() (0 = one per core). When
+    // many decoders share a DecodePool, 1 avoids oversubscribing the CPU.
+    void set_thread_count(int threads) { thread_count_ = threads; }
+
+    // Decoder profile for the next init() (default LowLatency)
+    void set_profile(DecoderProfile profile) { profile_ = profile; }
+    DecoderProfile profile() const { return profile_; }
+
+    // Record send/receive/convert times here (null = off)
+    void set_pipeline_stats(PipelineStats* stats) { pipeline_stats_ = stats; }
+
     // Initialize decoder for specific codec
     bool init(VideoCodec codec);
 
@@ -43,8 +73,11 @@ public:
     VideoCodec codec() const { return codec_; }
 
     // Decode a video frame (IFrame or PFrame)
-    // Returns true if frame was decoded successfully
-    bool decode(const uint8_t* data, size_t len, DecodedFrameCallback callback);
+    // Returns true if frame was decoded successfully. pts comes back in the
+    // DecodedFrame made from this packet, which with frame threads is
+    // output during a later call.
+    bool decode(const uint8_t* data, size_t len, DecodedFrameCallback callback,
+                int64_t pts = INT64_MIN);
 
     // Convenience overloads
     bool decode(const std::vector<uint8_t>& data, DecodedFrameCallback callback) {
@@ -59,16 +92,39 @@ public:
         return decode(frame.data.data(), frame.data.size(), std::move(callback));
     }
 
-    // Get decoder statistics
+    // Decode a standalone keyframe and output it straight away
+    // Drains the frame-threading delay and flushes afterwards, so the next
+    // frame sent to the decoder must be a keyframe as well
+    bool decode_still(const uint8_t* data, size_t len, DecodedFrameCallback callback,
+                      int64_t pts = INT64_MIN);
+
+    // Drop all reference frames and queued output (e.g. before resyncing
+    // on a keyframe after frames were skipped)
+    void flush();
+
+    // Bound the output size (e.g. to the pane the frames are drawn in)
+    // Frames are scaled down to fit within max_width x max_height, keeping
+    // the aspect ratio; they are never scaled up. 0 x 0 means native size.
+    // The scaler is rebuilt on the next frame when the bound changes.
+    void set_output_size(int max_width, int max_height);
+
+    // Decoder statistics (atomic: readable from any thread)
     struct Stats {
-        uint64_t frames_decoded = 0;
-        uint64_t decode_errors = 0;
+        MetricCounter frames_decoded;
+        MetricCounter decode_errors;
     };
-    Stats stats() const { return stats_; }
+    const Stats& stats() const { return *stats_; }
+
+    // Count into an external block instead (e.g. one that outlives the
+    // decoder, for totals across reconnects)
+    void set_stats(Stats* stats) { stats_ = stats ? stats : &own_stats_; }
 
 private:
     bool initialized_ = false;
     VideoCodec codec_ = VideoCodec::H264;
+    int thread_count_ = 0;
+    DecoderProfile profile_ = DecoderProfile::LowLatency;
+    PipelineStats* pipeline_stats_ = nullptr;
 
     AVCodecContext* codec_ctx_ = nullptr;
     AVFrame* frame_ = nullptr;
@@ -76,20 +132,39 @@ private:
     AVPacket* packet_ = nullptr;
     SwsContext* sws_ctx_ = nullptr;
 
+    // Source frame geometry the scaler was built for
+    int input_width_ = 0;
+    int input_height_ = 0;
+    int input_pix_fmt_ = -1;
+
+    // Requested bound (0 = native) and the resulting scaler output size
+    int max_width_ = 0;
+    int max_height_ = 0;
     int output_width_ = 0;
     int output_height_ = 0;
-    int input_pix_fmt_ = -1;
 
     // Aligned buffer for sws_scale output (NEON requires 32-byte alignment)
+    // Reused across frames; reallocated only when the frame size changes
     uint8_t* aligned_buf_ = nullptr;
     int aligned_buf_size_ = 0;
     int aligned_stride_ = 0;
 
-    Stats stats_;
+    // Scaler writes BGRA directly; false when falling back to RGB24 + swizzle
+    bool direct_bgra_ = true;
+    std::vector<uint8_t> bgra_buf_;  // Fallback output only
+
+    // Output frame handed to callbacks (points into the buffers above)
+    DecodedFrame output_;
+
+    Stats own_stats_;
+    Stats* stats_ = &own_stats_;
 
     bool try_open_decoder(const AVCodec* decoder);
+    bool send_packet(const uint8_t* data, size_t len, int64_t pts);
+    bool receive_frames(const DecodedFrameCallback& callback);
     bool setup_scaler(int width, int height, int pix_fmt);
-    bool convert_to_rgb(DecodedFrame& output);
+    void fit_output_size(int width, int height, int& out_width, int& out_height) const;
+    bool convert_to_bgra(DecodedFrame& output);
 };
 
 } // namespace baichuan
@@ -92,9 +92,10 @@ void VideoDisplay::update_frame(const DecodedFrame& frame) {
     // Copy frame data to buffer
     {
         std::lock_guard<std::mutex> lock(frame_mutex_);
-        frame_buffer_ = frame.rgb_data;
+        frame_buffer_.assign(frame.data, frame.data + static_cast<size_t>(frame.stride) * frame.height);
         frame_width_ = frame.width;
         frame_height_ = frame.height;
+        frame_stride_ = frame.stride;
         frame_pending_.store(true);
         has_video_.store(true);
     }
@@ -293,14 +294,19 @@ void VideoDisplay::update_surface() {
     // Copy BGRA data directly to surface (decoder outputs Cairo's native format)
     unsigned char* surf_data = cairo_image_surface_get_data(surface_);
     int stride = cairo_image_surface_get_stride(surface_);
-    int src_stride = frame_width_ * 4;
+    int src_stride = frame_stride_;
+    int row_bytes = frame_width_ * 4;
 
     cairo_surface_flush(surface_);
 
-    for (int y = 0; y < frame_height_; ++y) {
-        memcpy(surf_data + y * stride,
-               frame_buffer_.data() + y * src_stride,
-               src_stride);
+    if (stride == src_stride) {
+        memcpy(surf_data, frame_buffer_.data(), static_cast<size_t>(stride) * frame_height_);
+    } else {
+        for (int y = 0; y < frame_height_; ++y) {
+            memcpy(surf_data + y * stride,
+                   frame_buffer_.data() + y * src_stride,
+                   row_bytes);
+        }
     }
 
     cairo_surface_mark_dirty(surface_);
@@ -59,11 +59,12 @@ private:
     int height_ = 0;
     int frame_width_ = 0;
     int frame_height_ = 0;
+    int frame_stride_ = 0;
 
     std::atomic<bool> quit_requested_{false};
     CloseCallback close_callback_;
 
-    // Frame buffer protected by mutex
+    // Frame buffer protected by mutex (BGRA, frame_stride_ bytes per row)
     std::vector<uint8_t> frame_buffer_;
     std::mutex frame_mutex_;
     std::atomic<bool> frame_pending_{false};
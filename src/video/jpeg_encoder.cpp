@@ -0,0 +1,182 @@
+#include "video/jpeg_encoder.h"
+#include "utils/logger.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+namespace baichuan {
+
+JpegEncoder::~JpegEncoder() {
+    close();
+}
+
+bool JpegEncoder::open(int width, int height, int quality) {
+    close();
+
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        LOG_ERROR("MJPEG encoder not found");
+        return false;
+    }
+
+    ctx_ = avcodec_alloc_context3(codec);
+    if (!ctx_) {
+        LOG_ERROR("Failed to allocate JPEG codec context");
+        return false;
+    }
+
+    ctx_->width = width;
+    ctx_->height = height;
+    ctx_->pix_fmt = AV_PIX_FMT_YUVJ420P;  // JPEG uses YUVJ format
+    ctx_->time_base = {1, 1};
+
+    // Set quality (1-31, lower is better for FFmpeg)
+    // Convert our 0-100 quality to FFmpeg's qmin/qmax
+    int q = 31 - (quality * 30 / 100);
+    if (q < 1) q = 1;
+    if (q > 31) q = 31;
+    ctx_->qmin = q;
+    ctx_->qmax = q;
+
+    if (avcodec_open2(ctx_, codec, nullptr) < 0) {
+        LOG_ERROR("Failed to open JPEG encoder");
+        close();
+        return false;
+    }
+
+    yuv_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (!yuv_ || !packet_) {
+        LOG_ERROR("Failed to allocate frame/packet for JPEG");
+        close();
+        return false;
+    }
+
+    yuv_->format = AV_PIX_FMT_YUVJ420P;
+    yuv_->width = width;
+    yuv_->height = height;
+    if (av_frame_get_buffer(yuv_, 0) < 0) {
+        LOG_ERROR("Failed to allocate JPEG frame buffer");
+        close();
+        return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    quality_ = quality;
+    return true;
+}
+
+void JpegEncoder::close() {
+    if (sws_) {
+        sws_freeContext(sws_);
+        sws_ = nullptr;
+    }
+    if (packet_) av_packet_free(&packet_);
+    if (yuv_) av_frame_free(&yuv_);
+    if (ctx_) avcodec_free_context(&ctx_);
+    width_ = 0;
+    height_ = 0;
+    quality_ = -1;
+}
+
+bool JpegEncoder::encode(const DecodedFrame& frame, int quality, std::vector<uint8_t>& out) {
+    if (!frame.data || frame.width <= 0 || frame.height <= 0) {
+        LOG_ERROR("Invalid frame data for JPEG encode");
+        return false;
+    }
+
+    if (!ctx_ || frame.width != width_ || frame.height != height_ || quality != quality_) {
+        if (!open(frame.width, frame.height, quality)) {
+            return false;
+        }
+    }
+
+    // BGRA to YUV (the scaler is kept while the size stays the same)
+    sws_ = sws_getCachedContext(sws_,
+                                frame.width, frame.height, AV_PIX_FMT_BGRA,
+                                frame.width, frame.height, AV_PIX_FMT_YUVJ420P,
+                                SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws_) {
+        LOG_ERROR("Failed to create scaler for JPEG");
+        return false;
+    }
+    if (av_frame_make_writable(yuv_) < 0) {
+        LOG_ERROR("JPEG frame buffer not writable");
+        return false;
+    }
+
+    const uint8_t* src_data[4] = {frame.data, nullptr, nullptr, nullptr};
+    int src_linesize[4] = {frame.stride, 0, 0, 0};
+    sws_scale(sws_, src_data, src_linesize, 0, frame.height, yuv_->data, yuv_->linesize);
+
+    int ret = avcodec_send_frame(ctx_, yuv_);
+    if (ret < 0) {
+        LOG_ERROR("Failed to send frame to JPEG encoder: {}", ret);
+        return false;
+    }
+    ret = avcodec_receive_packet(ctx_, packet_);
+    if (ret < 0) {
+        LOG_ERROR("Failed to encode JPEG: {}", ret);
+        return false;
+    }
+
+    out.assign(packet_->data, packet_->data + packet_->size);
+    av_packet_unref(packet_);
+    return true;
+}
+
+JpegEncoderPool& JpegEncoderPool::instance() {
+    static JpegEncoderPool pool;
+    return pool;
+}
+
+bool JpegEncoderPool::encode(const DecodedFrame& frame, int quality, std::vector<uint8_t>& out) {
+    std::unique_ptr<JpegEncoder> encoder = acquire(frame.width, frame.height);
+    bool ok = encoder->encode(frame, quality, out);
+    if (ok) {
+        release(std::move(encoder));
+    }
+    return ok;
+}
+
+JpegEncoderPool::Stats JpegEncoderPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::unique_ptr<JpegEncoder> JpegEncoderPool::acquire(int width, int height) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.encodes++;
+
+    // Same size first (no setup), else any idle one (reopened for the size)
+    for (size_t i = 0; i < idle_.size(); i++) {
+        if (idle_[i]->width() == width && idle_[i]->height() == height) {
+            std::unique_ptr<JpegEncoder> encoder = std::move(idle_[i]);
+            idle_.erase(idle_.begin() + static_cast<std::ptrdiff_t>(i));
+            return encoder;
+        }
+    }
+    if (!idle_.empty()) {
+        std::unique_ptr<JpegEncoder> encoder = std::move(idle_.back());
+        idle_.pop_back();
+        return encoder;
+    }
+
+    stats_.created++;
+    return std::make_unique<JpegEncoder>();
+}
+
+void JpegEncoderPool::release(std::unique_ptr<JpegEncoder> encoder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < MAX_IDLE) {
+        idle_.push_back(std::move(encoder));
+        return;
+    }
+    // Pool full: freed when `encoder` goes out of scope
+}
+
+} // namespace baichuan
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "video/decoder.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Forward declarations for FFmpeg types
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace baichuan {
+
+// BGRA frame -> JPEG with FFmpeg's MJPEG encoder
+// The codec context, scaler and buffers are kept between calls and only
+// rebuilt when the frame size or quality changes. Not thread-safe; use
+// JpegEncoderPool to share encoders.
+class JpegEncoder {
+public:
+    JpegEncoder() = default;
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    // quality: 0-100
+    bool encode(const DecodedFrame& frame, int quality, std::vector<uint8_t>& out);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    AVCodecContext* ctx_ = nullptr;
+    SwsContext* sws_ = nullptr;
+    AVFrame* yuv_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    int width_ = 0;
+    int height_ = 0;
+    int quality_ = -1;
+
+    bool open(int width, int height, int quality);
+    void close();
+};
+
+// Encoders shared by every caller (snapshots, ImageWriter)
+// Each encode borrows an idle encoder - preferring one already set up for
+// the frame size - so concurrent calls run in parallel and repeated
+// snapshots of a camera skip the encoder setup.
+class JpegEncoderPool {
+public:
+    static JpegEncoderPool& instance();
+
+    bool encode(const DecodedFrame& frame, int quality, std::vector<uint8_t>& out);
+
+    struct Stats {
+        uint64_t encodes = 0;
+        uint64_t created = 0;   // Encoders built (pool misses)
+    };
+    Stats stats() const;
+
+private:
+    static constexpr size_t MAX_IDLE = 4;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<JpegEncoder>> idle_;
+    Stats stats_;
+
+    std::unique_ptr<JpegEncoder> acquire(int width, int height);
+    void release(std::unique_ptr<JpegEncoder> encoder);
+};
+
+} // namespace baichuan
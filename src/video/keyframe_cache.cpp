@@ -0,0 +1,43 @@
+#include "video/keyframe_cache.h"
+
+namespace baichuan {
+
+void KeyframeCache::store(const FrameBuffer& data, VideoCodec codec, int64_t capture_time_us) {
+    Keyframe keyframe;
+    keyframe.data = data;
+    keyframe.codec = codec;
+    keyframe.capture_time_us = capture_time_us;
+    put(std::move(keyframe));
+}
+
+void KeyframeCache::store_jpeg(const FrameBuffer& data) {
+    Keyframe keyframe;
+    keyframe.data = data;
+    keyframe.jpeg = true;
+    put(std::move(keyframe));
+}
+
+std::optional<KeyframeCache::Keyframe> KeyframeCache::latest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latest_;
+}
+
+void KeyframeCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_.reset();
+}
+
+void KeyframeCache::put(Keyframe keyframe) {
+    keyframe.received = std::chrono::steady_clock::now();
+
+    // The previous payload is released outside the lock
+    std::optional<Keyframe> previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keyframe.sequence = ++sequence_;
+        previous = std::move(latest_);
+        latest_ = std::move(keyframe);
+    }
+}
+
+} // namespace baichuan
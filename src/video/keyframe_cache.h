@@ -0,0 +1,44 @@
+#pragma once
+
+#include "protocol/bc_media.h"
+#include "utils/buffer_pool.h"
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <optional>
+
+namespace baichuan {
+
+// Latest keyframe of one camera, kept for snapshots
+//
+// Storing shares the pooled payload (no copy), so keeping every camera's
+// last I-frame costs one buffer each. Written on the receive thread once
+// per GOP, read by snapshot requests on any thread.
+class KeyframeCache {
+public:
+    struct Keyframe {
+        FrameBuffer data;               // Annex-B access unit with SPS/PPS, or a JPEG
+        VideoCodec codec = VideoCodec::H264;
+        bool jpeg = false;              // MJPEG camera: data is a complete JPEG
+        int64_t capture_time_us = INT64_MIN;  // Wall clock, when known (utils/latency.h)
+        std::chrono::steady_clock::time_point received;
+        uint64_t sequence = 0;          // Changes with every store
+    };
+
+    void store(const FrameBuffer& data, VideoCodec codec, int64_t capture_time_us = INT64_MIN);
+    void store_jpeg(const FrameBuffer& data);
+
+    // Nothing until the camera's first keyframe
+    std::optional<Keyframe> latest() const;
+
+    void clear();
+
+private:
+    mutable std::mutex mutex_;
+    std::optional<Keyframe> latest_;
+    uint64_t sequence_ = 0;
+
+    void put(Keyframe keyframe);
+};
+
+} // namespace baichuan
@@ -0,0 +1,193 @@
+#include "video/snapshot.h"
+#include "video/jpeg_encoder.h"
+#include "utils/logger.h"
+
+#include <cstdio>
+
+namespace baichuan {
+
+namespace {
+
+std::string base64_encode(const std::vector<uint8_t>& input) {
+    static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    result.reserve((input.size() + 2) / 3 * 4);
+
+    size_t i = 0;
+    for (; i + 3 <= input.size(); i += 3) {
+        uint32_t v = (input[i] << 16) | (input[i + 1] << 8) | input[i + 2];
+        result.push_back(chars[(v >> 18) & 0x3F]);
+        result.push_back(chars[(v >> 12) & 0x3F]);
+        result.push_back(chars[(v >> 6) & 0x3F]);
+        result.push_back(chars[v & 0x3F]);
+    }
+    if (i < input.size()) {
+        uint32_t v = input[i] << 16;
+        if (i + 1 < input.size()) v |= input[i + 1] << 8;
+        result.push_back(chars[(v >> 18) & 0x3F]);
+        result.push_back(chars[(v >> 12) & 0x3F]);
+        result.push_back(i + 1 < input.size() ? chars[(v >> 6) & 0x3F] : '=');
+        result.push_back('=');
+    }
+    return result;
+}
+
+std::shared_ptr<const Snapshot> failed(const std::string& error) {
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->error = error;
+    return snapshot;
+}
+
+} // namespace
+
+std::string Snapshot::to_json(const std::string& path) const {
+    if (!ok) {
+        return "{\"error\": \"" + error + "\"}";
+    }
+
+    auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - keyframe_received).count();
+    std::string result = "{\"ok\": true, \"width\": " + std::to_string(width) +
+                         ", \"height\": " + std::to_string(height) +
+                         ", \"bytes\": " + std::to_string(jpeg.size()) +
+                         ", \"age_ms\": " + std::to_string(age);
+
+    if (!path.empty()) {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) {
+            return "{\"error\": \"cannot write " + path + "\"}";
+        }
+        fwrite(jpeg.data(), 1, jpeg.size(), f);
+        fclose(f);
+        return result + ", \"path\": \"" + path + "\"}";
+    }
+    return result + ", \"jpeg\": \"" + base64_encode(jpeg) + "\"}";
+}
+
+std::shared_ptr<const Snapshot> SnapshotService::take(size_t key, const KeyframeCache& cache,
+                                                      const SnapshotOptions& options) {
+    std::optional<KeyframeCache::Keyframe> keyframe = cache.latest();
+    if (!keyframe) {
+        return failed("no keyframe received yet");
+    }
+
+    CameraState* state = state_for(key);
+    std::promise<std::shared_ptr<const Snapshot>> promise;
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+
+        // Same keyframe as last time: nothing new to show
+        if (state->last && state->last->keyframe_sequence == keyframe->sequence &&
+            state->last_options == options) {
+            return state->last;
+        }
+
+        // Someone is already making this one: wait for theirs
+        if (state->pending.valid() && state->pending_sequence == keyframe->sequence &&
+            state->pending_options == options) {
+            auto pending = state->pending;
+            lock.unlock();
+            return pending.get();
+        }
+
+        state->pending = promise.get_future().share();
+        state->pending_sequence = keyframe->sequence;
+        state->pending_options = options;
+    }
+
+    std::shared_ptr<const Snapshot> result = render(*keyframe, options);
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (result->ok && (!state->last || state->last->keyframe_sequence <= result->keyframe_sequence)) {
+            state->last = result;
+            state->last_options = options;
+        }
+        if (state->pending_sequence == keyframe->sequence && state->pending_options == options) {
+            state->pending = {};
+        }
+    }
+    promise.set_value(result);
+    return result;
+}
+
+SnapshotService::CameraState* SnapshotService::state_for(size_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<CameraState>& state = cameras_[key];
+    if (!state) {
+        state = std::make_unique<CameraState>();
+    }
+    return state.get();
+}
+
+std::shared_ptr<const Snapshot> SnapshotService::render(const KeyframeCache::Keyframe& keyframe,
+                                                        const SnapshotOptions& options) {
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->keyframe_sequence = keyframe.sequence;
+    snapshot->capture_time_us = keyframe.capture_time_us;
+    snapshot->keyframe_received = keyframe.received;
+
+    // MJPEG: the camera's own JPEG
+    if (keyframe.jpeg) {
+        snapshot->jpeg.assign(keyframe.data.begin(), keyframe.data.end());
+        snapshot->ok = true;
+        return snapshot;
+    }
+
+    std::unique_ptr<VideoDecoder> decoder = acquire_decoder(keyframe.codec);
+    if (!decoder) {
+        return failed("decoder unavailable");
+    }
+    decoder->set_output_size(options.max_width, options.max_height);
+
+    // The picture is only valid inside the callback: encode it there
+    bool encoded = false;
+    bool decoded = decoder->decode_still(keyframe.data.data(), keyframe.data.size(),
+                                         [&](const DecodedFrame& frame) {
+        if (encoded) return;
+        encoded = JpegEncoderPool::instance().encode(frame, options.quality, snapshot->jpeg);
+        snapshot->width = frame.width;
+        snapshot->height = frame.height;
+    });
+
+    if (!decoded) {
+        // A decoder that failed may be in a bad state; don't reuse it
+        return failed("failed to decode keyframe");
+    }
+    release_decoder(keyframe.codec, std::move(decoder));
+
+    if (!encoded) {
+        return failed("failed to encode JPEG");
+    }
+    snapshot->ok = true;
+    return snapshot;
+}
+
+std::unique_ptr<VideoDecoder> SnapshotService::acquire_decoder(VideoCodec codec) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& idle = idle_decoders_[codec];
+        if (!idle.empty()) {
+            std::unique_ptr<VideoDecoder> decoder = std::move(idle.back());
+            idle.pop_back();
+            return decoder;
+        }
+    }
+
+    auto decoder = std::make_unique<VideoDecoder>();
+    if (!decoder->init(codec)) {
+        LOG_ERROR("Snapshot: failed to initialize decoder");
+        return nullptr;
+    }
+    return decoder;
+}
+
+void SnapshotService::release_decoder(VideoCodec codec, std::unique_ptr<VideoDecoder> decoder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& idle = idle_decoders_[codec];
+    if (idle.size() < MAX_IDLE_DECODERS) {
+        idle.push_back(std::move(decoder));
+    }
+}
+
+} // namespace baichuan
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "video/keyframe_cache.h"
+#include "video/decoder.h"
+#include <cstdint>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace baichuan {
+
+struct SnapshotOptions {
+    int quality = 90;       // JPEG quality 0-100
+    int max_width = 0;      // Fit within this size, keeping the aspect ratio (0 = native)
+    int max_height = 0;
+
+    // From request values; negative (absent) keeps the default
+    static SnapshotOptions from(int quality, int max_width, int max_height) {
+        SnapshotOptions options;
+        if (quality >= 0) options.quality = quality > 100 ? 100 : quality;
+        if (max_width > 0) options.max_width = max_width;
+        if (max_height > 0) options.max_height = max_height;
+        return options;
+    }
+
+    bool operator==(const SnapshotOptions& other) const {
+        return quality == other.quality && max_width == other.max_width &&
+               max_height == other.max_height;
+    }
+};
+
+struct Snapshot {
+    bool ok = false;
+    std::string error;
+    std::vector<uint8_t> jpeg;
+    int width = 0;          // 0 when passed through from an MJPEG camera
+    int height = 0;
+    uint64_t keyframe_sequence = 0;
+    int64_t capture_time_us = INT64_MIN;
+    std::chrono::steady_clock::time_point keyframe_received;
+
+    // {"ok": true, "width": .., "height": .., "bytes": .., "age_ms": ..,
+    //  "jpeg": "<base64>"}, or with a path, the file is written and
+    // "path" replaces "jpeg"
+    std::string to_json(const std::string& path = "") const;
+};
+
+// JPEG snapshots of running cameras from their cached keyframes
+//
+// take() decodes the camera's latest keyframe on the calling thread and
+// encodes it through the shared JpegEncoderPool - no connection, login or
+// wait for an I-frame. Decoders are pooled per codec. Requests for the
+// same camera are coalesced: callers arriving while a snapshot is being
+// made wait for it, and the result is reused until a new keyframe arrives.
+// MJPEG cameras' JPEGs are returned as received.
+class SnapshotService {
+public:
+    SnapshotService() = default;
+
+    SnapshotService(const SnapshotService&) = delete;
+    SnapshotService& operator=(const SnapshotService&) = delete;
+
+    std::shared_ptr<const Snapshot> take(size_t key, const KeyframeCache& cache,
+                                         const SnapshotOptions& options = {});
+
+private:
+    static constexpr size_t MAX_IDLE_DECODERS = 2;  // Per codec
+
+    struct CameraState {
+        std::mutex mutex;
+        std::shared_ptr<const Snapshot> last;
+        SnapshotOptions last_options;
+        std::shared_future<std::shared_ptr<const Snapshot>> pending;
+        uint64_t pending_sequence = 0;
+        SnapshotOptions pending_options;
+    };
+
+    std::mutex mutex_;
+    std::map<size_t, std::unique_ptr<CameraState>> cameras_;
+    std::map<VideoCodec, std::vector<std::unique_ptr<VideoDecoder>>> idle_decoders_;
+
+    CameraState* state_for(size_t key);
+    std::shared_ptr<const Snapshot> render(const KeyframeCache::Keyframe& keyframe,
+                                           const SnapshotOptions& options);
+    std::unique_ptr<VideoDecoder> acquire_decoder(VideoCodec codec);
+    void release_decoder(VideoCodec codec, std::unique_ptr<VideoDecoder> decoder);
+};
+
+} // namespace baichuan
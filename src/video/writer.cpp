@@ -1,136 +1,95 @@
 #include "video/writer.h"
+#include "video/jpeg_encoder.h"
 #include "utils/logger.h"
 
+#include <cstring>
+#include <vector>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
 #include <libavutil/opt.h>
 #include <libswscale/swscale.h>
 }
 
 namespace baichuan {
 
-// ImageWriter implementation
+namespace {
 
-bool ImageWriter::save_jpeg(const DecodedFrame& frame, const std::string& filename, int quality) {
-    if (frame.rgb_data.empty() || frame.width <= 0 || frame.height <= 0) {
-        LOG_ERROR("Invalid frame data for JPEG save");
-        return false;
-    }
+// Stream time base for passthrough packets (source timestamps are in us)
+constexpr AVRational PASSTHROUGH_TIME_BASE = {1, 1000000};
 
-    // Find MJPEG encoder
-    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
-    if (!codec) {
-        LOG_ERROR("MJPEG encoder not found");
-        return false;
-    }
+// Jumps beyond this are treated as a clock discontinuity
+constexpr int64_t MAX_TIMESTAMP_STEP_US = 5 * 1000000;
 
-    // Allocate codec context
-    AVCodecContext* ctx = avcodec_alloc_context3(codec);
-    if (!ctx) {
-        LOG_ERROR("Failed to allocate JPEG codec context");
-        return false;
-    }
+// Collect the parameter set NAL units (H264 SPS/PPS, H265 VPS/SPS/PPS) of an
+// Annex-B access unit, start codes included, for use as stream extradata
+std::vector<uint8_t> extract_parameter_sets(const uint8_t* data, size_t len, VideoCodec codec) {
+    std::vector<uint8_t> out;
 
-    // Configure encoder
-    ctx->width = frame.width;
-    ctx->height = frame.height;
-    ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;  // JPEG uses YUVJ format
-    ctx->time_base = {1, 1};
-
-    // Set quality (1-31, lower is better for FFmpeg)
-    // Convert our 0-100 quality to FFmpeg's qmin/qmax
-    int q = 31 - (quality * 30 / 100);
-    if (q < 1) q = 1;
-    if (q > 31) q = 31;
-    ctx->qmin = q;
-    ctx->qmax = q;
+    // Find each start code, then copy [start code, next start code) if the
+    // NAL is a parameter set
+    auto next_start = [&](size_t from) -> size_t {
+        for (size_t j = from; j + 3 <= len; j++) {
+            if (data[j] == 0 && data[j + 1] == 0 && data[j + 2] == 1) {
+                return j;
+            }
+        }
+        return len;
+    };
+
+    size_t i = next_start(0);
+    while (i < len) {
+        size_t nal = i + 3;
+        size_t end = next_start(nal);
+
+        // Trim the leading zero of a 4-byte start code that follows
+        size_t nal_end = end;
+        if (end < len && nal_end > nal && data[nal_end - 1] == 0) {
+            nal_end--;
+        }
 
-    // Open encoder
-    if (avcodec_open2(ctx, codec, nullptr) < 0) {
-        LOG_ERROR("Failed to open JPEG encoder");
-        avcodec_free_context(&ctx);
-        return false;
+        if (nal < len) {
+            bool param_set;
+            if (codec == VideoCodec::H265) {
+                int type = (data[nal] >> 1) & 0x3F;
+                param_set = type >= 32 && type <= 34;
+            } else {
+                int type = data[nal] & 0x1F;
+                param_set = type == 7 || type == 8;
+            }
+            if (param_set) {
+                static const uint8_t start_code[4] = {0, 0, 0, 1};
+                out.insert(out.end(), start_code, start_code + 4);
+                out.insert(out.end(), data + nal, data + nal_end);
+            }
+        }
+        i = end;
     }
+    return out;
+}
 
-    // Create scaler for RGB24 to YUVJ420P
-    SwsContext* sws = sws_getContext(
-        frame.width, frame.height, AV_PIX_FMT_RGB24,
-        frame.width, frame.height, AV_PIX_FMT_YUVJ420P,
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-    );
+} // namespace
 
-    if (!sws) {
-        LOG_ERROR("Failed to create scaler for JPEG");
-        avcodec_free_context(&ctx);
-        return false;
-    }
+// ImageWriter implementation
 
-    // Allocate frame and packet
-    AVFrame* av_frame = av_frame_alloc();
-    AVPacket* packet = av_packet_alloc();
-
-    if (!av_frame || !packet) {
-        LOG_ERROR("Failed to allocate frame/packet for JPEG");
-        if (av_frame) av_frame_free(&av_frame);
-        if (packet) av_packet_free(&packet);
-        sws_freeContext(sws);
-        avcodec_free_context(&ctx);
+bool ImageWriter::save_jpeg(const DecodedFrame& frame, const std::string& filename, int quality) {
+    std::vector<uint8_t> jpeg;
+    if (!JpegEncoderPool::instance().encode(frame, quality, jpeg)) {
         return false;
     }
 
-    // Setup frame
-    av_frame->format = AV_PIX_FMT_YUVJ420P;
-    av_frame->width = frame.width;
-    av_frame->height = frame.height;
-
-    if (av_frame_get_buffer(av_frame, 0) < 0) {
-        LOG_ERROR("Failed to allocate JPEG frame buffer");
-        av_frame_free(&av_frame);
-        av_packet_free(&packet);
-        sws_freeContext(sws);
-        avcodec_free_context(&ctx);
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (!f) {
+        LOG_ERROR("Failed to open file for writing: {}", filename);
         return false;
     }
-
-    // Convert RGB to YUV
-    const uint8_t* src_data[4] = {frame.rgb_data.data(), nullptr, nullptr, nullptr};
-    int src_linesize[4] = {frame.width * 3, 0, 0, 0};
-
-    sws_scale(sws, src_data, src_linesize, 0, frame.height,
-              av_frame->data, av_frame->linesize);
-
-    // Encode frame
-    bool success = false;
-    int ret = avcodec_send_frame(ctx, av_frame);
-    if (ret >= 0) {
-        ret = avcodec_receive_packet(ctx, packet);
-        if (ret >= 0) {
-            // Write to file
-            FILE* f = fopen(filename.c_str(), "wb");
-            if (f) {
-                fwrite(packet->data, 1, packet->size, f);
-                fclose(f);
-                success = true;
-                LOG_INFO("Saved JPEG: {} ({}x{})", filename, frame.width, frame.height);
-            } else {
-                LOG_ERROR("Failed to open file for writing: {}", filename);
-            }
-        } else {
-            LOG_ERROR("Failed to encode JPEG: {}", ret);
-        }
-    } else {
-        LOG_ERROR("Failed to send frame to JPEG encoder: {}", ret);
-    }
-
-    // Cleanup
-    av_packet_free(&packet);
-    av_frame_free(&av_frame);
-    sws_freeContext(sws);
-    avcodec_free_context(&ctx);
-
-    return success;
+    fwrite(jpeg.data(), 1, jpeg.size(), f);
+    fclose(f);
+    LOG_INFO("Saved JPEG: {} ({}x{})", filename, frame.width, frame.height);
+    return true;
 }
 
 // VideoWriter implementation
@@ -253,9 +212,9 @@ bool VideoWriter::open(const std::string& filename, int width, int height, int f
         return false;
     }
 
-    // Create scaler for RGB24 to YUV420P
+    // Create scaler for BGRA to YUV420P
     sws_ctx_ = sws_getContext(
-        width, height, AV_PIX_FMT_RGB24,
+        width, height, AV_PIX_FMT_BGRA,
         width, height, AV_PIX_FMT_YUV420P,
         SWS_BILINEAR, nullptr, nullptr, nullptr
     );
@@ -294,13 +253,186 @@ bool VideoWriter::open(const std::string& filename, int width, int height, int f
     return true;
 }
 
+bool VideoWriter::open_passthrough(const std::string& filename, VideoCodec codec) {
+    if (is_open_) {
+        close();
+    }
+
+    filename_ = filename;
+    codec_ = codec;
+    passthrough_ = true;
+    header_written_ = false;
+    ts_offset_ = 0;
+    last_pts_ = -1;
+    last_duration_ = 40000;
+    frames_written_ = 0;
+    is_open_ = true;
+
+    LOG_INFO("Recording (stream copy) to: {} - waiting for keyframe", filename);
+    return true;
+}
+
+bool VideoWriter::start_passthrough(const uint8_t* data, size_t len) {
+    // Allocate format context
+    int ret = avformat_alloc_output_context2(&fmt_ctx_, nullptr, nullptr, filename_.c_str());
+    if (ret < 0 || !fmt_ctx_) {
+        LOG_ERROR("Failed to create output context for: {}", filename_);
+        return false;
+    }
+
+    stream_ = avformat_new_stream(fmt_ctx_, nullptr);
+    if (!stream_) {
+        LOG_ERROR("Failed to create video stream");
+        return false;
+    }
+
+    AVCodecID codec_id = (codec_ == VideoCodec::H265) ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264;
+    AVCodecParameters* par = stream_->codecpar;
+    par->codec_type = AVMEDIA_TYPE_VIDEO;
+    par->codec_id = codec_id;
+
+    // Dimensions from the keyframe's SPS
+    AVCodecParserContext* parser = av_parser_init(codec_id);
+    AVCodecContext* parse_ctx = avcodec_alloc_context3(nullptr);
+    if (parser && parse_ctx) {
+        parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+        uint8_t* out = nullptr;
+        int out_size = 0;
+        av_parser_parse2(parser, parse_ctx, &out, &out_size, data, static_cast<int>(len),
+                         AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        width_ = parser->width;
+        height_ = parser->height;
+    }
+    if (parser) av_parser_close(parser);
+    if (parse_ctx) avcodec_free_context(&parse_ctx);
+
+    par->width = width_;
+    par->height = height_;
+
+    // Parameter sets as Annex-B extradata (the muxer converts to avcC/hvcC)
+    std::vector<uint8_t> extradata = extract_parameter_sets(data, len, codec_);
+    if (extradata.empty()) {
+        LOG_WARN("Keyframe carries no parameter sets; file may not play");
+    } else {
+        par->extradata = static_cast<uint8_t*>(av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (!par->extradata) {
+            LOG_ERROR("Failed to allocate extradata");
+            return false;
+        }
+        memcpy(par->extradata, extradata.data(), extradata.size());
+        par->extradata_size = static_cast<int>(extradata.size());
+    }
+
+    stream_->time_base = PASSTHROUGH_TIME_BASE;
+
+    // Open output file
+    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&fmt_ctx_->pb, filename_.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            LOG_ERROR("Failed to open output file: {}", filename_);
+            return false;
+        }
+    }
+
+    // Write header (the muxer may change stream_->time_base)
+    AVDictionary* options = nullptr;
+    if (fragmented_) {
+        av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+    ret = avformat_write_header(fmt_ctx_, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        LOG_ERROR("Failed to write header: {}", ret);
+        return false;
+    }
+
+    packet_ = av_packet_alloc();
+    if (!packet_) {
+        LOG_ERROR("Failed to allocate packet");
+        return false;
+    }
+
+    header_written_ = true;
+    LOG_INFO("Opened video file: {} ({}x{}, stream copy {})",
+             filename_, width_, height_, codec_ == VideoCodec::H265 ? "H265" : "H264");
+    return true;
+}
+
+int64_t VideoWriter::next_passthrough_pts(int64_t timestamp_us) {
+    if (last_pts_ < 0) {
+        // First packet defines time zero
+        ts_offset_ = timestamp_us == AV_NOPTS_VALUE ? 0 : timestamp_us;
+        return 0;
+    }
+
+    int64_t pts = (timestamp_us == AV_NOPTS_VALUE) ? AV_NOPTS_VALUE : timestamp_us - ts_offset_;
+    int64_t step = (pts == AV_NOPTS_VALUE) ? -1 : pts - last_pts_;
+
+    if (step <= 0 || step > MAX_TIMESTAMP_STEP_US) {
+        // Discontinuity: continue one frame on and rebase the source clock
+        pts = last_pts_ + last_duration_;
+        if (timestamp_us != AV_NOPTS_VALUE) {
+            ts_offset_ = timestamp_us - pts;
+        }
+    } else {
+        last_duration_ = step;
+    }
+    return pts;
+}
+
+bool VideoWriter::write_packet(const uint8_t* data, size_t len, bool keyframe, int64_t timestamp_us) {
+    if (!is_open_ || !passthrough_) {
+        LOG_ERROR("Video writer not open for stream copy");
+        return false;
+    }
+
+    if (!header_written_) {
+        // The file starts at a keyframe so it is decodable from the first packet
+        if (!keyframe) {
+            return false;
+        }
+        if (!start_passthrough(data, len)) {
+            close();
+            return false;
+        }
+    }
+
+    int64_t pts = next_passthrough_pts(timestamp_us);
+    last_pts_ = pts;
+
+    // Reference the caller's buffer; av_write_frame doesn't keep it
+    packet_->data = const_cast<uint8_t*>(data);
+    packet_->size = static_cast<int>(len);
+    packet_->stream_index = stream_->index;
+    packet_->flags = keyframe ? AV_PKT_FLAG_KEY : 0;
+    packet_->pts = pts;
+    packet_->dts = pts;  // Camera streams carry no B-frames
+    packet_->duration = 0;
+    av_packet_rescale_ts(packet_, PASSTHROUGH_TIME_BASE, stream_->time_base);
+
+    int ret = av_write_frame(fmt_ctx_, packet_);
+    packet_->data = nullptr;
+    packet_->size = 0;
+    if (ret < 0) {
+        LOG_ERROR("Error writing packet: {}", ret);
+        return false;
+    }
+
+    frames_written_++;
+    return true;
+}
+
 void VideoWriter::close() {
     if (is_open_ && fmt_ctx_) {
         // Flush encoder
-        encode_frame(nullptr);
+        if (codec_ctx_) {
+            encode_frame(nullptr);
+        }
 
         // Write trailer
-        av_write_trailer(fmt_ctx_);
+        if (!passthrough_ || header_written_) {
+            av_write_trailer(fmt_ctx_);
+        }
     }
 
     if (sws_ctx_) {
@@ -336,11 +468,13 @@ void VideoWriter::close() {
     }
 
     is_open_ = false;
+    passthrough_ = false;
+    header_written_ = false;
     stream_ = nullptr;
 }
 
 bool VideoWriter::write_frame(const DecodedFrame& frame) {
-    if (!is_open_) {
+    if (!is_open_ || passthrough_) {
         LOG_ERROR("Video writer not open");
         return false;
     }
@@ -358,9 +492,9 @@ bool VideoWriter::write_frame(const DecodedFrame& frame) {
         return false;
     }
 
-    // Convert RGB to YUV
-    const uint8_t* src_data[4] = {frame.rgb_data.data(), nullptr, nullptr, nullptr};
-    int src_linesize[4] = {frame.width * 3, 0, 0, 0};
+    // Convert BGRA to YUV
+    const uint8_t* src_data[4] = {frame.data, nullptr, nullptr, nullptr};
+    int src_linesize[4] = {frame.stride, 0, 0, 0};
 
     sws_scale(sws_ctx_, src_data, src_linesize, 0, frame.height,
               frame_->data, frame_->linesize);
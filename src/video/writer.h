@@ -17,12 +17,17 @@ namespace baichuan {
 // Save a single frame as JPEG image
 class ImageWriter {
 public:
-    // Save decoded RGB frame as JPEG
+    // Save decoded BGRA frame as JPEG
     // Returns true on success
     static bool save_jpeg(const DecodedFrame& frame, const std::string& filename, int quality = 90);
 };
 
 // Write video frames to file (MPEG4 container with H264)
+//
+// Two modes:
+// - open() + write_frame(): encode decoded BGRA frames (transcode)
+// - open_passthrough() + write_packet(): mux the camera's compressed
+//   H264/H265 access units as-is (stream copy, no decoder or encoder)
 class VideoWriter {
 public:
     VideoWriter();
@@ -32,15 +37,34 @@ public:
     // Supported formats: .mp4, .mpg, .avi (based on extension)
     bool open(const std::string& filename, int width, int height, int fps = 25);
 
+    // Open for stream copy (.mp4, .mkv, ...)
+    // The file is created on the first keyframe written; packets before it
+    // are dropped. Codec parameters (SPS/PPS, dimensions) come from that keyframe.
+    bool open_passthrough(const std::string& filename, VideoCodec codec);
+
+    // Write MP4 as fragments (one per keyframe) instead of a trailing index
+    // The file stays playable while it is written and after a crash.
+    // Applies to the next open_passthrough(); ignored by other containers.
+    void set_fragmented(bool fragmented) { fragmented_ = fragmented; }
+
     // Close and finalize the video file
     void close();
 
     // Check if writer is open
     bool is_open() const { return is_open_; }
 
-    // Write a decoded RGB frame
+    // Write a decoded BGRA frame
     bool write_frame(const DecodedFrame& frame);
 
+    // Write one compressed Annex-B access unit (passthrough mode)
+    // timestamp_us is the source's microsecond clock; it is rebased to start
+    // at 0, and backward or implausibly large jumps (clock wrap, camera
+    // restart) continue from the previous timestamp instead
+    bool write_packet(const uint8_t* data, size_t len, bool keyframe, int64_t timestamp_us);
+
+    // Check if writer is in passthrough mode
+    bool is_passthrough() const { return passthrough_; }
+
     // Get number of frames written
     uint64_t frames_written() const { return frames_written_; }
 
@@ -60,7 +84,18 @@ private:
     int64_t pts_ = 0;
     uint64_t frames_written_ = 0;
 
+    // Passthrough state
+    bool passthrough_ = false;
+    bool header_written_ = false;
+    bool fragmented_ = false;
+    VideoCodec codec_ = VideoCodec::H264;
+    int64_t ts_offset_ = 0;      // Source timestamp -> file pts (us)
+    int64_t last_pts_ = -1;      // Last pts written (us)
+    int64_t last_duration_ = 40000;
+
     bool encode_frame(AVFrame* frame);
+    bool start_passthrough(const uint8_t* data, size_t len);
+    int64_t next_passthrough_pts(int64_t timestamp_us);
 };
 
 } // namespace baichuan
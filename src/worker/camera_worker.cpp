@@ -0,0 +1,866 @@
+#include "worker/camera_worker.h"
+#include "utils/io_reactor.h"
+#include "utils/logger.h"
+#include "utils/latency.h"
+#include "utils/backoff.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <optional>
+
+namespace baichuan {
+
+namespace {
+
+void set_status(CameraContext* ctx, const std::string& status) {
+    if (ctx->handlers.on_status) {
+        ctx->handlers.on_status(status);
+    }
+}
+
+void notify_stopped(CameraContext* ctx) {
+    if (ctx->handlers.on_stopped) {
+        ctx->handlers.on_stopped();
+    }
+}
+
+// A cycle counts as stable once it has streamed this long
+constexpr auto STABLE_CYCLE = std::chrono::seconds(10);
+
+constexpr int CONNECT_TIMEOUT_MS = 10000;
+// Failover connects are cut short: the old connection may still be usable
+constexpr int FAILOVER_CONNECT_TIMEOUT_MS = 3000;
+
+uint64_t frames_received(CameraContext* ctx) {
+    return ctx->metrics.received.frames_received.load() + ctx->metrics.mjpeg.frames_received.load();
+}
+
+uint64_t bytes_received(CameraContext* ctx) {
+    return ctx->metrics.received.bytes_received.load() + ctx->metrics.mjpeg.bytes_received.load();
+}
+
+// The fps / bitrate meter runs while a stream does (read on demand)
+void start_rates(CameraContext* ctx) {
+    ctx->metrics.rates.start(frames_received(ctx), bytes_received(ctx));
+}
+
+StreamConfig stream_config_for(const CameraConfig& config) {
+    StreamConfig stream_config;
+    stream_config.channel_id = config.channel;
+
+    if (config.stream == "sub") {
+        stream_config.handle = STREAM_HANDLE_SUB;
+        stream_config.stream_type = "subStream";
+    } else if (config.stream == "extern") {
+        stream_config.handle = STREAM_HANDLE_EXTERN;
+        stream_config.stream_type = "externStream";
+    } else {
+        stream_config.handle = STREAM_HANDLE_MAIN;
+        stream_config.stream_type = "mainStream";
+    }
+    return stream_config;
+}
+
+} // namespace
+
+// One camera's lifecycle as a state machine on the I/O reactor
+//
+// Sources, sessions and timers report events by recording them and posting
+// a step; steps run one at a time (an event during a step makes it go
+// round again) and never wait on the network, so any number of cameras
+// share the reactor's threads. Every callback carries the cycle it belongs
+// to and is dropped once that cycle has ended, so a late reply from a torn
+// down connection can't move the camera on.
+class CameraActor : public std::enable_shared_from_this<CameraActor> {
+public:
+    explicit CameraActor(CameraContext* ctx) : ctx_(ctx) {}
+
+    // Run a step soon (re-checks the flags, polls handlers)
+    void post();
+
+    void request_stop();
+    void wait_stopped();
+
+private:
+    enum class Phase {
+        Idle,        // Not started yet
+        Paused,
+        Connecting,  // Baichuan: connect and login; RTSP / MJPEG: until the first frame
+        Starting,    // Baichuan: waiting for the stream start reply
+        Streaming,
+        Backoff,     // Waiting for backoff_timer_
+        Stopped
+    };
+
+    struct OpenResult {
+        bool ok = false;
+        std::string error;
+    };
+
+    // What happened since the last step
+    struct Events {
+        std::optional<OpenResult> opened;     // open_async() of the first connection
+        std::optional<OpenResult> failover;   // open_async() of a replacement
+        std::optional<bool> started;          // Stream start reply / RTSP info / first JPEG
+        bool ended = false;                   // RTSP or MJPEG stream ended
+        bool backoff_due = false;
+    };
+
+    CameraContext* ctx_;
+
+    std::mutex mutex_;
+    std::condition_variable stopped_cv_;
+    bool queued_ = false;           // A step is posted; guarded by mutex_
+    bool in_step_ = false;          // Guarded by mutex_
+    bool again_ = false;            // Event during the step; guarded by mutex_
+    bool stop_requested_ = false;   // Guarded by mutex_
+    bool stopped_ = false;          // Guarded by mutex_
+    uint64_t cycle_ = 0;            // Bumped as a cycle ends; guarded by mutex_
+    Events events_;                 // Of cycle_; guarded by mutex_
+
+    // Only touched by steps
+    Phase phase_ = Phase::Idle;
+    Backoff backoff_;
+    uint64_t backoff_timer_ = 0;
+    std::chrono::steady_clock::time_point cycle_start_{};
+    uint64_t frames_before_ = 0;
+    std::shared_ptr<BaichuanSession> opening_;    // Session being opened for this camera
+    std::shared_ptr<BaichuanSession> failover_;   // Replacement being opened while streaming
+    bool failover_tried_ = false;
+    int motion_listener_ = -1;
+    int health_listener_ = -1;
+
+    // Record an event of `cycle` and run a step for it
+    template <typename Apply>
+    static void report(const std::weak_ptr<CameraActor>& weak, uint64_t cycle, Apply apply);
+    uint64_t current_cycle();
+
+    void run();
+    void step();
+    void shutdown();
+
+    void begin_cycle();
+    void end_cycle();
+    void fail_cycle();
+    void enter_paused();
+    void enter_backoff();
+
+    // Baichuan
+    bool start_baichuan();
+    void advance_baichuan(Events& events);
+    bool start_stream();
+    void on_stream_started();
+    void check_health();
+    void stop_stream(bool switching);
+
+    // RTSP and MJPEG
+    bool start_rtsp();
+    bool start_mjpeg();
+    void advance_source(Events& events);
+    void stop_source();
+};
+
+template <typename Apply>
+void CameraActor::report(const std::weak_ptr<CameraActor>& weak, uint64_t cycle, Apply apply) {
+    std::shared_ptr<CameraActor> self = weak.lock();
+    if (!self) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        if (cycle != self->cycle_) {
+            return;
+        }
+        apply(self->events_);
+    }
+    self->post();
+}
+
+uint64_t CameraActor::current_cycle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cycle_;
+}
+
+void CameraActor::post() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (in_step_) {
+        again_ = true;
+        return;
+    }
+    if (queued_ || stopped_) {
+        return;
+    }
+    queued_ = true;
+    IoReactor::instance().post([weak = weak_from_this()]() {
+        if (std::shared_ptr<CameraActor> self = weak.lock()) {
+            self->run();
+        }
+    });
+}
+
+void CameraActor::request_stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = true;
+    }
+    post();
+}
+
+void CameraActor::wait_stopped() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_cv_.wait(lock, [this] { return stopped_ && !in_step_; });
+}
+
+void CameraActor::run() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_ = false;
+        if (stopped_) {
+            return;
+        }
+        in_step_ = true;
+        again_ = false;
+    }
+    while (true) {
+        step();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!again_ || stopped_) {
+            in_step_ = false;
+            if (stopped_) {
+                stopped_cv_.notify_all();
+            }
+            return;
+        }
+        again_ = false;
+    }
+}
+
+void CameraActor::step() {
+    bool quit;
+    Events events;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit = stop_requested_;
+        events = std::move(events_);
+        events_ = Events{};
+    }
+    bool paused = ctx_->paused.load();
+
+    if (quit) {
+        shutdown();
+        return;
+    }
+
+    switch (phase_) {
+        case Phase::Stopped:
+            return;
+        case Phase::Idle:
+            break;
+        case Phase::Paused:
+            if (paused) return;
+            break;
+        case Phase::Backoff:
+            if (paused) {
+                IoReactor::instance().cancel_timer(backoff_timer_);
+                backoff_timer_ = 0;
+                enter_paused();
+                return;
+            }
+            // Cut short by nothing but pause or stop
+            if (!events.backoff_due) return;
+            backoff_timer_ = 0;
+            break;
+        default:
+            // A cycle is running
+            if (paused) {
+                end_cycle();
+                enter_paused();
+            } else if (ctx_->config.type == CameraType::Baichuan) {
+                advance_baichuan(events);
+            } else {
+                advance_source(events);
+            }
+            return;
+    }
+
+    if (paused) {
+        enter_paused();
+        return;
+    }
+    begin_cycle();
+}
+
+void CameraActor::shutdown() {
+    if (phase_ == Phase::Backoff) {
+        IoReactor::instance().cancel_timer(backoff_timer_);
+        backoff_timer_ = 0;
+    } else if (phase_ != Phase::Idle && phase_ != Phase::Paused && phase_ != Phase::Stopped) {
+        end_cycle();
+    }
+    phase_ = Phase::Stopped;
+    ctx_->state.store(CameraState::Stopped);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+}
+
+void CameraActor::begin_cycle() {
+    phase_ = Phase::Connecting;
+    ctx_->state.store(CameraState::Connecting);
+    cycle_start_ = std::chrono::steady_clock::now();
+    frames_before_ = frames_received(ctx_);
+
+    bool ok;
+    if (ctx_->config.type == CameraType::Rtsp) {
+        ok = start_rtsp();
+    } else if (ctx_->config.type == CameraType::Mjpeg) {
+        ok = start_mjpeg();
+    } else {
+        ok = start_baichuan();
+    }
+    if (!ok) {
+        fail_cycle();
+    }
+}
+
+void CameraActor::end_cycle() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cycle_++;
+        events_ = Events{};
+    }
+
+    // Logins still running lose this camera's interest (and are aborted
+    // once no other camera waits on them)
+    if (opening_) {
+        opening_->cancel_open();
+        opening_.reset();
+    }
+    if (failover_) {
+        failover_->cancel_open();
+        failover_.reset();
+    }
+
+    if (ctx_->config.type == CameraType::Baichuan) {
+        stop_stream(false);
+    } else {
+        stop_source();
+    }
+}
+
+void CameraActor::fail_cycle() {
+    end_cycle();
+    enter_backoff();
+}
+
+void CameraActor::enter_paused() {
+    phase_ = Phase::Paused;
+    ctx_->state.store(CameraState::Paused);
+    set_status(ctx_, "Disconnected");
+}
+
+void CameraActor::enter_backoff() {
+    // A cycle that streamed for a while was a success: the next failure
+    // starts the backoff over rather than continuing it
+    if (std::chrono::steady_clock::now() - cycle_start_ >= STABLE_CYCLE &&
+        frames_received(ctx_) > frames_before_) {
+        backoff_.reset();
+    }
+
+    // Stream dropped — reconnect after a jittered, growing delay
+    // (cut short by pause or stop)
+    ctx_->metrics.reconnects++;
+    phase_ = Phase::Backoff;
+    ctx_->state.store(CameraState::Backoff);
+    set_status(ctx_, "Reconnecting...");
+
+    uint64_t cycle = current_cycle();
+    backoff_timer_ = IoReactor::instance().add_timer(
+        std::chrono::steady_clock::now() + backoff_.next(),
+        [weak = weak_from_this(), cycle]() {
+            report(weak, cycle, [](Events& events) { events.backoff_due = true; });
+        });
+}
+
+// Connect and log in, or join the connection another camera entry with the
+// same host and credentials already has
+bool CameraActor::start_baichuan() {
+    LOG_INFO("Camera {} ({}) starting...", ctx_->index, ctx_->config.host);
+    set_status(ctx_, "Connecting...");
+
+    opening_ = BaichuanSession::acquire(ctx_->config);
+    opening_->open_async(CONNECT_TIMEOUT_MS,
+                         [weak = weak_from_this(), cycle = current_cycle()](bool ok, const std::string& error) {
+        report(weak, cycle, [&](Events& events) { events.opened = OpenResult{ok, error}; });
+    });
+    return true;
+}
+
+void CameraActor::advance_baichuan(Events& events) {
+    if (phase_ == Phase::Connecting) {
+        if (!events.opened) return;
+        std::shared_ptr<BaichuanSession> session = std::move(opening_);
+        if (!events.opened->ok) {
+            LOG_ERROR("Camera {}: {}", ctx_->index, events.opened->error);
+            set_status(ctx_, events.opened->error);
+            fail_cycle();
+            return;
+        }
+        ctx_->session = std::move(session);
+        if (!start_stream()) {
+            fail_cycle();
+        }
+        return;
+    }
+
+    if (phase_ == Phase::Starting) {
+        if (!events.started) return;
+        if (!*events.started) {
+            LOG_ERROR("Camera {}: Failed to start stream", ctx_->index);
+            set_status(ctx_, "Stream failed");
+            fail_cycle();
+            return;
+        }
+        on_stream_started();
+        return;
+    }
+
+    // Streaming: a replacement logged in, or the connection's health changed
+    if (events.failover) {
+        std::shared_ptr<BaichuanSession> replacement = std::move(failover_);
+        if (events.failover->ok) {
+            // Video resumes as soon as the stream starts on the new one
+            stop_stream(true);
+            LOG_INFO("Camera {}: Switching to the new connection", ctx_->index);
+            ctx_->metrics.reconnects++;
+            ctx_->session = std::move(replacement);
+            if (!start_stream()) {
+                fail_cycle();
+            }
+            return;
+        }
+        LOG_ERROR("Camera {}: {}", ctx_->index, events.failover->error);
+    }
+    check_health();
+}
+
+bool CameraActor::start_stream() {
+    CameraContext* ctx = ctx_;
+    phase_ = Phase::Connecting;
+    ctx->state.store(CameraState::Connecting);
+    set_status(ctx, "Starting stream...");
+
+    // Create video stream
+    MessageDemux& demux = ctx->session->demux();
+    ctx->stream = std::make_unique<VideoStream>(demux);
+    ctx->stream->set_pipeline_stats(&ctx->pipeline);
+    ctx->stream->set_stats(&ctx->metrics.received);
+
+    // Handle stream info
+    ctx->stream->on_stream_info([ctx](const BcMediaInfo& info) {
+        LOG_INFO("Camera {}: Stream {}x{} @ {} fps",
+                 ctx->index, info.video_width, info.video_height, info.fps);
+    });
+
+    // Handle video frames (pooled payloads are shared, not copied); the
+    // capture clock follows the I-frames' wall-clock stamps
+    ctx->stream->on_frame([ctx, clock = CaptureClock()](const BcMediaFrame& frame) mutable {
+        if (!ctx->running.load() || !ctx->handlers.on_packet) return;
+
+        VideoPacket packet;
+        if (const BcMediaIFrame* iframe = std::get_if<BcMediaIFrame>(&frame)) {
+            if (iframe->posix_time) {
+                clock.on_keyframe(*iframe->posix_time, iframe->microseconds);
+            }
+            packet.data = iframe->data;
+            packet.codec = iframe->codec;
+            packet.keyframe = true;
+            packet.timestamp_us = iframe->microseconds;
+            packet.capture_time_us = clock.to_wall_us(iframe->microseconds);
+            ctx->keyframes.store(packet.data, packet.codec, packet.capture_time_us);
+        } else if (const BcMediaPFrame* pframe = std::get_if<BcMediaPFrame>(&frame)) {
+            packet.data = pframe->data;
+            packet.codec = pframe->codec;
+            packet.timestamp_us = pframe->microseconds;
+            packet.capture_time_us = clock.to_wall_us(pframe->microseconds);
+        } else {
+            return;
+        }
+        ctx->handlers.on_packet(packet);
+    });
+
+    // Handle errors
+    ctx->stream->on_error([ctx](const std::string& error) {
+        LOG_ERROR("Camera {}: Stream error: {}", ctx->index, error);
+        set_status(ctx, "Error: " + error);
+    });
+
+    // Motion alarms are pushed outside any stream's msg_num; the monitor
+    // listens to the session's unrouted messages and keeps its own channel
+    if (ctx->handlers.on_motion) {
+        ctx->motion = std::make_unique<MotionMonitor>(ctx->session->connection(), ctx->config.channel);
+        ctx->motion->on_event([ctx](const MotionEvent& event) {
+            ctx->handlers.on_motion(event);
+        });
+        MotionMonitor* motion = ctx->motion.get();
+        motion_listener_ = demux.add_listener([motion](const BcMessageView& msg) {
+            motion->handle_message(msg);
+        });
+    }
+
+    // Start stream; the reply comes back as an event
+    ctx->running.store(true);
+    bool sent = ctx->stream->start_async(stream_config_for(ctx->config),
+                                         [weak = weak_from_this(), cycle = current_cycle()](bool ok) {
+        report(weak, cycle, [ok](Events& events) { events.started = ok; });
+    });
+    if (!sent) {
+        LOG_ERROR("Camera {}: Failed to start stream", ctx->index);
+        set_status(ctx, "Stream failed");
+        return false;
+    }
+    phase_ = Phase::Starting;
+    return true;
+}
+
+void CameraActor::on_stream_started() {
+    if (ctx_->motion) {
+        ctx_->motion->subscribe();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ctx_->live_session_mutex);
+        ctx_->live_session = ctx_->session;
+    }
+
+    // The session pings a quiet camera on its own timer and reports health
+    // changes; nothing else needs watching while it streams
+    phase_ = Phase::Streaming;
+    ctx_->state.store(CameraState::Streaming);
+    start_rates(ctx_);
+    health_listener_ = ctx_->session->add_health_listener(
+        [weak = weak_from_this(), cycle = current_cycle()](BaichuanSession::Health) {
+            report(weak, cycle, [](Events&) {});
+        });
+    failover_tried_ = false;
+    check_health();
+}
+
+// A quiet or lost connection gets a new one logged in before it is torn
+// down, once per episode; the stream keeps running meanwhile
+void CameraActor::check_health() {
+    BaichuanSession::Health health = ctx_->session->health();
+    if (health == BaichuanSession::Health::Alive) {
+        failover_tried_ = false;
+        return;
+    }
+
+    if (!failover_tried_) {
+        failover_tried_ = true;
+        LOG_WARN("Camera {}: connection {}, opening a new one", ctx_->index,
+                 health == BaichuanSession::Health::Dead ? "lost" : "quiet");
+        failover_ = BaichuanSession::acquire(ctx_->config);
+        failover_->open_async(FAILOVER_CONNECT_TIMEOUT_MS,
+                              [weak = weak_from_this(), cycle = current_cycle()](bool ok, const std::string& error) {
+            report(weak, cycle, [&](Events& events) { events.failover = OpenResult{ok, error}; });
+        });
+        return;
+    }
+
+    if (health == BaichuanSession::Health::Dead && !failover_) {
+        fail_cycle();
+    }
+}
+
+// Tear down the stream (the connection closes with the last camera using it)
+void CameraActor::stop_stream(bool switching) {
+    CameraContext* ctx = ctx_;
+    bool streamed = phase_ == Phase::Streaming;
+
+    if (health_listener_ >= 0) {
+        ctx->session->remove_health_listener(health_listener_);
+        health_listener_ = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(ctx->live_session_mutex);
+        ctx->live_session.reset();
+    }
+    ctx->metrics.rates.stop();
+    ctx->running.store(false);
+
+    if (ctx->stream) {
+        // VIDEO_STOP only on a connection that stays in use: when failing
+        // over or on a quiet link the send could stall the reactor for the
+        // send timeout (5 s)
+        ctx->stream->stop(!switching && ctx->session->is_responsive());
+        ctx->stream.reset();
+    }
+    if (motion_listener_ >= 0) {
+        ctx->session->demux().remove_listener(motion_listener_);
+        motion_listener_ = -1;
+    }
+    if (ctx->motion && ctx->motion->motion_active()) {
+        MotionEvent event;
+        event.channel_id = ctx->config.channel;
+        event.status = "disconnected";
+        ctx->handlers.on_motion(event);
+    }
+    ctx->motion.reset();
+    ctx->session.reset();
+
+    if (streamed) {
+        notify_stopped(ctx);
+        LOG_INFO("Camera {}: Stopped", ctx->index);
+    }
+}
+
+// RTSP: the source connects on its receive thread (FFmpeg reads block);
+// on_info marks the start of streaming
+bool CameraActor::start_rtsp() {
+    CameraContext* ctx = ctx_;
+    LOG_INFO("Camera {} (RTSP: {}) starting...", ctx->index, ctx->config.name);
+    set_status(ctx, "Connecting RTSP...");
+
+    // Create RTSP source
+    ctx->rtsp_source = std::make_unique<RtspSource>();
+    ctx->rtsp_source->set_url(ctx->config.url);
+    ctx->rtsp_source->set_transport(ctx->config.transport);
+
+    std::weak_ptr<CameraActor> weak = weak_from_this();
+    uint64_t cycle = current_cycle();
+
+    // Handle stream info
+    ctx->rtsp_source->on_info([ctx, weak, cycle](int width, int height, int fps) {
+        LOG_INFO("Camera {} (RTSP): Stream {}x{} @ {} fps", ctx->index, width, height, fps);
+        report(weak, cycle, [](Events& events) { events.started = true; });
+    });
+
+    // Handle video packets
+    ctx->rtsp_source->on_packet([ctx](const uint8_t* data, size_t len, VideoCodec codec,
+                                      bool keyframe, int64_t pts_us) {
+        if (!ctx->running.load() || !ctx->handlers.on_packet) return;
+
+        CameraMetrics& metrics = ctx->metrics;
+        metrics.received.frames_received++;
+        metrics.received.bytes_received += len;
+        if (keyframe) {
+            metrics.received.i_frames++;
+        } else {
+            metrics.received.p_frames++;
+        }
+
+        VideoPacket packet;
+        packet.data = FrameBuffer::copy_of(data, len);
+        packet.codec = codec;
+        packet.keyframe = keyframe;
+        packet.timestamp_us = pts_us;
+        if (keyframe) {
+            ctx->keyframes.store(packet.data, codec);
+        }
+        ctx->handlers.on_packet(packet);
+    });
+
+    // Handle errors
+    ctx->rtsp_source->on_error([ctx](const std::string& error) {
+        LOG_ERROR("Camera {} (RTSP): Error: {}", ctx->index, error);
+        set_status(ctx, "Error: " + error);
+    });
+    ctx->rtsp_source->on_end([weak, cycle]() {
+        report(weak, cycle, [](Events& events) { events.ended = true; });
+    });
+
+    // Start streaming
+    ctx->running.store(true);
+    if (!ctx->rtsp_source->start()) {
+        LOG_ERROR("Camera {}: Failed to start RTSP stream", ctx->index);
+        set_status(ctx, "Stream failed");
+        return false;
+    }
+    return true;
+}
+
+// MJPEG: the source connects and reads on the reactor; the first JPEG marks
+// the start of streaming
+bool CameraActor::start_mjpeg() {
+    CameraContext* ctx = ctx_;
+    LOG_INFO("Camera {} (MJPEG: {}) starting...", ctx->index, ctx->config.name);
+    set_status(ctx, "Connecting MJPEG...");
+
+    // Create MJPEG source
+    ctx->mjpeg_source = std::make_unique<MjpegSource>();
+    ctx->mjpeg_source->set_url(ctx->config.url);
+    ctx->mjpeg_source->set_stats(&ctx->metrics.mjpeg);
+    if (ctx->handlers.mjpeg_decode_executor) {
+        ctx->mjpeg_source->set_decode_executor(ctx->handlers.mjpeg_decode_executor);
+    }
+
+    std::weak_ptr<CameraActor> weak = weak_from_this();
+    uint64_t cycle = current_cycle();
+
+    // Handle stream info
+    ctx->mjpeg_source->on_info([ctx](int width, int height, int fps) {
+        (void)fps;
+        LOG_INFO("Camera {} (MJPEG): Stream {}x{}", ctx->index, width, height);
+    });
+
+    // Handle decoded frames directly (MJPEG decodes internally)
+    ctx->mjpeg_source->on_frame([ctx](const DecodedFrame& decoded) {
+        if (!ctx->running.load() || !ctx->handlers.on_mjpeg_frame) return;
+        ctx->handlers.on_mjpeg_frame(decoded);
+    });
+
+    // Keep a recent JPEG for snapshots (copying every frame would cost more
+    // than snapshots need)
+    ctx->mjpeg_source->on_jpeg([ctx, weak, cycle, started = false,
+                                last = std::chrono::steady_clock::time_point{}](
+                                   const uint8_t* data, size_t len) mutable {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last >= std::chrono::milliseconds(500)) {
+            ctx->keyframes.store_jpeg(FrameBuffer::copy_of(data, len));
+            last = now;
+        }
+        if (!started) {
+            started = true;
+            report(weak, cycle, [](Events& events) { events.started = true; });
+        }
+    });
+
+    // Handle errors
+    ctx->mjpeg_source->on_error([ctx](const std::string& error) {
+        LOG_ERROR("Camera {} (MJPEG): Error: {}", ctx->index, error);
+        set_status(ctx, "Error: " + error);
+    });
+    ctx->mjpeg_source->on_end([weak, cycle]() {
+        report(weak, cycle, [](Events& events) { events.ended = true; });
+    });
+
+    // Start streaming
+    if (ctx->handlers.on_mjpeg_poll) {
+        ctx->handlers.on_mjpeg_poll(*ctx->mjpeg_source);
+    }
+    ctx->running.store(true);
+    if (!ctx->mjpeg_source->start_async()) {
+        LOG_ERROR("Camera {}: MJPEG connection failed", ctx->index);
+        set_status(ctx, "MJPEG failed");
+        return false;
+    }
+    return true;
+}
+
+void CameraActor::advance_source(Events& events) {
+    // MJPEG decodes inside the source, so decode settings are pushed to it
+    // on each step (wake() runs one)
+    if (ctx_->mjpeg_source && ctx_->handlers.on_mjpeg_poll) {
+        ctx_->handlers.on_mjpeg_poll(*ctx_->mjpeg_source);
+    }
+
+    if (events.started && phase_ == Phase::Connecting) {
+        set_status(ctx_, "Starting stream...");
+        phase_ = Phase::Streaming;
+        ctx_->state.store(CameraState::Streaming);
+        start_rates(ctx_);
+    }
+
+    if (events.ended) {
+        if (phase_ == Phase::Connecting) {
+            bool rtsp = ctx_->config.type == CameraType::Rtsp;
+            LOG_ERROR("Camera {}: {} connection failed", ctx_->index, rtsp ? "RTSP" : "MJPEG");
+            set_status(ctx_, rtsp ? "RTSP failed" : "MJPEG failed");
+        }
+        fail_cycle();
+    }
+}
+
+void CameraActor::stop_source() {
+    CameraContext* ctx = ctx_;
+    bool streamed = phase_ == Phase::Streaming;
+
+    ctx->metrics.rates.stop();
+    ctx->running.store(false);
+    if (ctx->rtsp_source) {
+        ctx->rtsp_source->stop();
+        ctx->rtsp_source.reset();
+    }
+    if (ctx->mjpeg_source) {
+        ctx->mjpeg_source->stop();
+        ctx->mjpeg_source.reset();
+    }
+
+    if (streamed) {
+        notify_stopped(ctx);
+        LOG_INFO("Camera {} ({}): Stopped", ctx->index,
+                 ctx->config.type == CameraType::Rtsp ? "RTSP" : "MJPEG");
+    }
+}
+
+const char* camera_state_to_string(CameraState state) {
+    switch (state) {
+        case CameraState::Connecting: return "connecting";
+        case CameraState::Streaming: return "streaming";
+        case CameraState::Paused: return "paused";
+        case CameraState::Backoff: return "backoff";
+        case CameraState::Stopped: return "stopped";
+    }
+    return "unknown";
+}
+
+RateMeter::Rates CameraContext::rates() {
+    return metrics.rates.read(frames_received(this), bytes_received(this));
+}
+
+void CameraContext::start() {
+    if (actor_) {
+        return;
+    }
+    actor_ = std::make_shared<CameraActor>(this);
+    actor_->post();
+}
+
+void CameraContext::set_paused(bool value) {
+    paused.store(value);
+    wake();
+}
+
+void CameraContext::stop() {
+    if (!actor_) {
+        return;
+    }
+    actor_->request_stop();
+    actor_->wait_stopped();
+}
+
+void CameraContext::wake() {
+    if (actor_) {
+        actor_->post();
+    }
+}
+
+MaxEncryption string_to_encryption(const std::string& enc) {
+    if (enc == "none") return MaxEncryption::None;
+    if (enc == "bc") return MaxEncryption::BCEncrypt;
+    return MaxEncryption::Aes;
+}
+
+SnapResult fetch_camera_snapshot(CameraContext* ctx, const std::string& stream_type) {
+    std::shared_ptr<BaichuanSession> session;
+    {
+        std::lock_guard<std::mutex> lock(ctx->live_session_mutex);
+        session = ctx->live_session;
+    }
+
+    if (!session) {
+        SnapResult result;
+        result.error = ctx->config.type == CameraType::Baichuan
+            ? "camera not streaming" : "camera snapshots need a Baichuan camera";
+        return result;
+    }
+
+    SnapConfig config;
+    config.channel_id = ctx->config.channel;
+    config.stream_type = stream_type;
+    SnapClient snap(session->demux());
+    return snap.fetch(config);
+}
+
+} // namespace baichuan
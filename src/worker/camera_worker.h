@@ -0,0 +1,144 @@
+#pragma once
+
+#include "worker/session.h"
+#include "client/auth.h"
+#include "client/stream.h"
+#include "client/motion.h"
+#include "client/snap.h"
+#include "rtsp/rtsp_source.h"
+#include "mjpeg/mjpeg_source.h"
+#include "video/keyframe_cache.h"
+#include "utils/buffer_pool.h"
+#include "utils/json_config.h"
+#include "utils/pipeline_stats.h"
+#include "utils/metrics.h"
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+namespace baichuan {
+
+// One compressed video access unit (Annex-B), from a Baichuan or RTSP source
+// Keyframes carry their SPS/PPS (VPS) in front.
+struct VideoPacket {
+    FrameBuffer data;
+    VideoCodec codec = VideoCodec::H264;
+    bool keyframe = false;
+    int64_t timestamp_us = INT64_MIN;  // Source clock (INT64_MIN = AV_NOPTS_VALUE, unknown)
+    int64_t capture_time_us = INT64_MIN;  // Wall-clock capture time, Baichuan only (utils/latency.h)
+};
+
+// What happens to a camera's output
+// Every handler is optional. They run on a shared I/O thread (RTSP packets:
+// the source's receive thread; MJPEG frames: the decode executor, if set),
+// so they must not block.
+struct CameraHandlers {
+    // Human-readable connection state ("Connecting...", "Login failed", ...)
+    std::function<void(const std::string& status)> on_status;
+
+    // Compressed video (Baichuan and RTSP cameras)
+    std::function<void(const VideoPacket& packet)> on_packet;
+
+    // Decoded pictures (MJPEG cameras decode inside the source)
+    std::function<void(const DecodedFrame& frame)> on_mjpeg_frame;
+
+    // Where MJPEG cameras decode (see MjpegSource::set_decode_executor);
+    // unset, on the I/O thread that read the JPEG
+    MjpegSource::DecodeExecutor mjpeg_decode_executor;
+
+    // Called when an MJPEG stream starts and on every wake() while it runs,
+    // to push decode settings
+    std::function<void(MjpegSource& source)> on_mjpeg_poll;
+
+    // Camera motion alarms (Baichuan cameras; subscribed only if set)
+    // A motion end is reported when the connection drops mid-motion.
+    std::function<void(const MotionEvent& event)> on_motion;
+
+    // A connection cycle ended; the next packet starts a new stream
+    std::function<void()> on_stopped;
+};
+
+// Per-camera counters for monitoring
+// They belong to the context rather than a connection, so they keep
+// counting across reconnects; every field is atomic.
+struct CameraMetrics {
+    VideoStream::Stats received;   // Compressed frames (Baichuan and RTSP)
+    MjpegSource::Stats mjpeg;      // MJPEG cameras
+    MetricCounter reconnects;      // Connection cycles that ended and were retried
+    RateMeter rates;               // fps / bitrate while streaming, see CameraContext::rates()
+};
+
+// Where a camera is in its lifecycle
+enum class CameraState {
+    Connecting,   // Connecting and logging in, or starting the stream
+    Streaming,
+    Paused,       // Disconnected until resumed
+    Backoff,      // Waiting to reconnect after a dropped stream
+    Stopped       // Not started, or stopped
+};
+
+const char* camera_state_to_string(CameraState state);
+
+class CameraActor;
+
+// Per-camera context
+// Front ends (dashboard, recorder) fill in config and handlers, then call
+// start(). The lifecycle - connect, log in, stream, reconnect - has no
+// thread of its own: it advances in steps on the shared I/O reactor, each
+// run by an event (a reply, a health change, a timer, set_paused()), so
+// the process's thread count does not grow with the number of cameras.
+struct CameraContext {
+    size_t index = 0;
+    CameraConfig config;
+    CameraHandlers handlers;
+    // Baichuan-specific (the session may be shared with other cameras)
+    std::shared_ptr<BaichuanSession> session;
+    std::unique_ptr<VideoStream> stream;
+    std::unique_ptr<MotionMonitor> motion;
+    // The session while streaming, for other threads (camera snapshots)
+    std::mutex live_session_mutex;
+    std::shared_ptr<BaichuanSession> live_session;
+    // RTSP-specific
+    std::unique_ptr<RtspSource> rtsp_source;
+    // MJPEG-specific
+    std::unique_ptr<MjpegSource> mjpeg_source;
+    // Shared
+    std::atomic<bool> running{false};  // A stream is running (handlers drop frames otherwise)
+    std::atomic<bool> paused{false};   // When true, the camera disconnects and waits (set via set_paused())
+    std::atomic<CameraState> state{CameraState::Stopped};
+    // Per-stage timings; the stream records parsing, the owner the rest
+    PipelineStats pipeline;
+    CameraMetrics metrics;
+    // Latest keyframe (MJPEG: a recent JPEG), kept across reconnects for snapshots
+    KeyframeCache keyframes;
+
+    // Frames and bits per second, worked out now from the counters
+    // (averaged since the previous read, at least a second ago)
+    RateMeter::Rates rates();
+
+    // Connect and stream until stop(), reconnecting after failures
+    void start();
+    void set_paused(bool value);
+    // Disconnect for good; returns once state is Stopped and no handler
+    // runs any more. Required before destruction; not from an I/O thread.
+    void stop();
+    // Re-check the flags and poll handlers now
+    void wake();
+
+    virtual ~CameraContext() = default;
+
+private:
+    std::shared_ptr<CameraActor> actor_;
+};
+
+MaxEncryption string_to_encryption(const std::string& enc);
+
+// JPEG encoded by the camera (MSG_ID_SNAP), fetched over the camera's live
+// session alongside its stream; blocks up to the snapshot timeout.
+// Baichuan cameras only, and only while streaming.
+SnapResult fetch_camera_snapshot(CameraContext* ctx, const std::string& stream_type = "main");
+
+} // namespace baichuan
@@ -0,0 +1,424 @@
+#include "worker/session.h"
+#include "worker/camera_worker.h"
+#include "utils/io_reactor.h"
+#include "utils/logger.h"
+
+#include <map>
+
+namespace baichuan {
+
+namespace {
+
+std::mutex g_sessions_mutex;
+std::map<std::string, std::weak_ptr<BaichuanSession>> g_sessions;
+
+// Receive-side stats by session key; never dropped (own lock: sessions are
+// constructed under g_sessions_mutex)
+std::mutex g_stats_mutex;
+struct StatsEntry {
+    std::string name;
+    std::shared_ptr<PipelineStats> stats;
+};
+std::map<std::string, StatsEntry> g_connection_stats;
+
+// What the last login per session key learned, for the next one
+std::mutex g_login_cache_mutex;
+std::map<std::string, LoginCache> g_login_cache;
+
+// Health listeners being notified on this thread (removal from inside a
+// listener must not wait for itself)
+thread_local const BaichuanSession* t_notifying = nullptr;
+
+std::string session_key(const CameraConfig& config) {
+    return config.host + ":" + std::to_string(config.port) + "/" + config.username + "/" +
+           config.password + "/" + config.encryption;
+}
+
+} // namespace
+
+std::shared_ptr<BaichuanSession> BaichuanSession::acquire(const CameraConfig& config) {
+    std::lock_guard<std::mutex> lock(g_sessions_mutex);
+
+    // Forget sessions whose last user has gone
+    for (auto it = g_sessions.begin(); it != g_sessions.end();) {
+        it = it->second.expired() ? g_sessions.erase(it) : std::next(it);
+    }
+
+    std::weak_ptr<BaichuanSession>& entry = g_sessions[session_key(config)];
+    std::shared_ptr<BaichuanSession> session = entry.lock();
+
+    // A failed, dropped or quiet session stays with its current users (who
+    // move over as they notice); so does one whose login every waiter gave
+    // up on. Start afresh
+    bool reusable = session && ((session->state_.load() == State::New && session->add_waiter()) ||
+                                session->is_responsive());
+    if (!reusable) {
+        session = std::make_shared<BaichuanSession>(config);
+        session->add_waiter();
+        entry = session;
+    } else {
+        LOG_INFO("Sharing connection to {}:{} (channel {}, {} stream)",
+                 config.host, config.port, config.channel, config.stream);
+    }
+    return session;
+}
+
+std::vector<BaichuanSession::ConnectionStats> BaichuanSession::connection_stats() {
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    std::vector<ConnectionStats> result;
+    for (const auto& entry : g_connection_stats) {
+        result.push_back({entry.second.name, entry.second.stats});
+    }
+    return result;
+}
+
+BaichuanSession::BaichuanSession(const CameraConfig& config)
+    : config_(config), demux_(connection_) {
+    {
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        StatsEntry& entry = g_connection_stats[session_key(config)];
+        if (!entry.stats) {
+            entry.name = config.host + ":" + std::to_string(config.port);
+            entry.stats = std::make_shared<PipelineStats>();
+        }
+        pipeline_stats_ = entry.stats;
+    }
+    connection_.set_pipeline_stats(pipeline_stats_.get());
+
+    // Report a lost connection at once rather than at the next deadline
+    demux_.on_closed([this]() {
+        set_health(Health::Dead);
+    });
+}
+
+BaichuanSession::~BaichuanSession() {
+    uint64_t timer;
+    {
+        std::lock_guard<std::mutex> lock(keepalive_mutex_);
+        keepalive_stopped_ = true;
+        timer = keepalive_timer_;
+    }
+    if (timer != 0) {
+        IoReactor::instance().cancel_timer(timer);
+    }
+
+    uint64_t watch;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        watch = connect_watch_;
+        timer = connect_timer_;
+    }
+    if (watch != 0) {
+        IoReactor::instance().remove(watch);
+    }
+    if (timer != 0) {
+        IoReactor::instance().cancel_timer(timer);
+    }
+
+    demux_.stop();
+    connection_.disconnect();
+}
+
+void BaichuanSession::open_async(int connect_timeout_ms, OpenCallback done) {
+    std::unique_lock<std::mutex> lock(open_mutex_);
+
+    State state = state_.load();
+    if (state != State::New) {
+        std::string error = error_;
+        lock.unlock();
+        done(state == State::Open, error);
+        return;
+    }
+
+    // Stays New while connecting, so cameras acquiring now share the result
+    open_callbacks_.push_back(std::move(done));
+    if (opening_) {
+        return;
+    }
+    opening_ = true;
+
+    if (cancelled() || !connection_.begin_connect(config_.host, config_.port)) {
+        LOG_ERROR("Failed to connect to {}:{}", config_.host, config_.port);
+        lock.unlock();
+        finish_open(false, cancelled() ? "Cancelled" : "Connection failed");
+        return;
+    }
+
+    // Whichever of the two fires first claims the handshake; both look the
+    // ids up under open_mutex_, so they are set before either runs
+    std::weak_ptr<BaichuanSession> weak = weak_from_this();
+    connect_watch_ = IoReactor::instance().add(connection_.socket_fd(), [weak]() {
+        if (std::shared_ptr<BaichuanSession> session = weak.lock()) {
+            session->on_connected();
+        }
+        return false;
+    }, IoReactor::Interest::Write);
+    connect_timer_ = IoReactor::instance().add_timer(
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(connect_timeout_ms), [weak]() {
+            if (std::shared_ptr<BaichuanSession> session = weak.lock()) {
+                session->on_connect_timeout();
+            }
+        });
+    if (connect_watch_ == 0) {
+        lock.unlock();
+        if (!connect_claimed_.exchange(true)) {
+            finish_open(false, "Connection failed");
+        }
+    }
+}
+
+void BaichuanSession::on_connected() {
+    uint64_t watch;
+    uint64_t timer;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        watch = connect_watch_;
+        timer = connect_timer_;
+    }
+    if (connect_claimed_.exchange(true)) {
+        return;  // Timed out first
+    }
+    IoReactor::instance().cancel_timer(timer);
+
+    // Unregistered before the demux registers the same socket
+    IoReactor::instance().remove(watch);
+
+    if (!connection_.finish_connect()) {
+        LOG_ERROR("Failed to connect to {}:{}", config_.host, config_.port);
+        finish_open(false, cancelled() ? "Cancelled" : "Connection failed");
+        return;
+    }
+
+    // The demux reads the connection from here on, login replies included
+    if (cancelled() || !demux_.start()) {
+        connection_.cancel();
+        finish_open(false, cancelled() ? "Cancelled" : "Connection failed");
+        return;
+    }
+
+    std::optional<LoginCache> cache;
+    {
+        std::lock_guard<std::mutex> cache_lock(g_login_cache_mutex);
+        auto it = g_login_cache.find(session_key(config_));
+        if (it != g_login_cache.end()) cache = it->second;
+    }
+
+    std::weak_ptr<BaichuanSession> weak = weak_from_this();
+    Authenticator::login_async(demux_, config_.username, config_.password,
+                               string_to_encryption(config_.encryption), cache ? &*cache : nullptr,
+                               [weak](const LoginResult& result) {
+        if (std::shared_ptr<BaichuanSession> session = weak.lock()) {
+            session->on_login(result);
+            release_later(std::move(session));
+        }
+    });
+}
+
+void BaichuanSession::on_connect_timeout() {
+    if (connect_claimed_.exchange(true)) {
+        return;
+    }
+    LOG_ERROR("Connect to {}:{} timed out", config_.host, config_.port);
+
+    uint64_t watch;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        watch = connect_watch_;
+    }
+    IoReactor::instance().remove(watch);
+    finish_open(false, cancelled() ? "Cancelled" : "Connection failed");
+}
+
+void BaichuanSession::on_login(const LoginResult& result) {
+    std::string key = session_key(config_);
+    if (!result.success) {
+        // The camera's settings may have changed; negotiate afresh next time
+        {
+            std::lock_guard<std::mutex> cache_lock(g_login_cache_mutex);
+            g_login_cache.erase(key);
+        }
+        LOG_ERROR("Login to {} failed: {}", config_.host, result.error_message);
+        finish_open(false, cancelled() ? "Cancelled" : "Login failed");
+        return;
+    }
+
+    LOG_INFO("Login to {} successful", config_.host);
+    {
+        std::lock_guard<std::mutex> cache_lock(g_login_cache_mutex);
+        LoginCache& entry = g_login_cache[key];
+        entry.encryption_type = result.encryption_type;
+        entry.device_info = result.device_info;
+    }
+    finish_open(true, "");
+}
+
+void BaichuanSession::finish_open(bool ok, const std::string& error) {
+    std::string reported = error;
+    {
+        // A cancel_open() either lands before this or finds the session open
+        std::lock_guard<std::mutex> cancel_lock(cancel_mutex_);
+        if (ok && cancelled_) {
+            ok = false;
+            reported = "Cancelled";
+        }
+        if (ok) {
+            state_.store(State::Open);
+            schedule_keepalive(demux_.last_received() + PING_AFTER);
+        } else {
+            // Stop reading; the socket is closed with the session, never
+            // from inside one of its own callbacks
+            connection_.cancel();
+            state_.store(State::Failed);
+        }
+    }
+
+    std::vector<OpenCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        error_ = reported;
+        callbacks.swap(open_callbacks_);
+    }
+    for (const auto& callback : callbacks) {
+        callback(ok, reported);
+    }
+}
+
+void BaichuanSession::release_later(std::shared_ptr<BaichuanSession> session) {
+    // The posted callback holds the reference; it is dropped on a timer,
+    // outside any dispatch
+    IoReactor::instance().post([session]() mutable { session.reset(); });
+}
+
+bool BaichuanSession::add_waiter() {
+    std::lock_guard<std::mutex> lock(cancel_mutex_);
+    if (cancelled_) {
+        return false;
+    }
+    waiters_++;
+    return true;
+}
+
+void BaichuanSession::cancel_open() {
+    std::lock_guard<std::mutex> lock(cancel_mutex_);
+    if (state_.load() != State::New || cancelled_) {
+        return;
+    }
+    // Other cameras (NVR channels, the main and sub stream) still want it
+    if (--waiters_ > 0) {
+        return;
+    }
+    cancelled_ = true;
+    connection_.cancel();
+}
+
+bool BaichuanSession::cancelled() {
+    std::lock_guard<std::mutex> lock(cancel_mutex_);
+    return cancelled_;
+}
+
+bool BaichuanSession::is_alive() const {
+    return state_.load() == State::Open && demux_.is_running();
+}
+
+bool BaichuanSession::is_responsive() const {
+    return is_alive() && quiet_for() < QUIET_AFTER;
+}
+
+std::chrono::steady_clock::duration BaichuanSession::quiet_for() const {
+    return std::chrono::steady_clock::now() - demux_.last_received();
+}
+
+int BaichuanSession::add_health_listener(HealthCallback cb) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    int id = next_listener_id_++;
+    health_listeners_[id] = std::move(cb);
+    return id;
+}
+
+void BaichuanSession::remove_health_listener(int id) {
+    {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        health_listeners_.erase(id);
+    }
+    if (t_notifying != this) {
+        std::lock_guard<std::mutex> lock(notify_mutex_);
+    }
+}
+
+void BaichuanSession::schedule_keepalive(std::chrono::steady_clock::time_point when) {
+    std::weak_ptr<BaichuanSession> weak = weak_from_this();
+    std::lock_guard<std::mutex> lock(keepalive_mutex_);
+    if (keepalive_stopped_) {
+        return;
+    }
+    keepalive_timer_ = IoReactor::instance().add_timer(when, [weak]() {
+        if (std::shared_ptr<BaichuanSession> session = weak.lock()) {
+            session->on_keepalive();
+        }
+    });
+}
+
+void BaichuanSession::on_keepalive() {
+    auto now = std::chrono::steady_clock::now();
+    auto last = demux_.last_received();
+    auto quiet = now - last;
+
+    if (!is_alive()) {
+        set_health(Health::Dead);
+        return;
+    }
+    if (quiet >= DEAD_AFTER) {
+        // Leave it to the users to drop; nothing is coming back on it
+        LOG_WARN("No data from {}:{} for {} s, giving up on the connection", config_.host,
+                 config_.port, std::chrono::duration_cast<std::chrono::seconds>(quiet).count());
+        {
+            std::lock_guard<std::mutex> lock(open_mutex_);
+            error_ = "Connection timed out";
+        }
+        state_.store(State::Failed);
+        set_health(Health::Dead);
+        return;
+    }
+
+    // Data arrived since the deadline was set: wait for the next one.
+    // Otherwise ping (again every PING_AFTER) and come back at the next
+    // ping or threshold, whichever is first
+    auto next = last + PING_AFTER;
+    if (quiet >= PING_AFTER) {
+        if (now - last_ping_ >= PING_AFTER) {
+            LOG_DEBUG("Pinging {}:{}", config_.host, config_.port);
+            connection_.send_message(BcMessage::create_header_only(MSG_ID_PING,
+                                                                   connection_.next_msg_num()));
+            last_ping_ = now;
+        }
+        auto threshold = last + (quiet < QUIET_AFTER ? QUIET_AFTER : DEAD_AFTER);
+        next = std::min(last_ping_ + PING_AFTER, threshold);
+    }
+    schedule_keepalive(next);
+
+    set_health(quiet >= QUIET_AFTER ? Health::Quiet : Health::Alive);
+}
+
+void BaichuanSession::set_health(Health health) {
+    std::lock_guard<std::mutex> notify_lock(notify_mutex_);
+    Health previous = health_.load();
+    if (previous == health || previous == Health::Dead) {
+        return;
+    }
+    health_.store(health);
+
+    std::vector<HealthCallback> listeners;
+    {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        for (const auto& entry : health_listeners_) {
+            listeners.push_back(entry.second);
+        }
+    }
+    t_notifying = this;
+    for (const auto& listener : listeners) {
+        listener(health);
+    }
+    t_notifying = nullptr;
+}
+
+} // namespace baichuan
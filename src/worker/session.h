@@ -0,0 +1,154 @@
+#pragma once
+
+#include "client/connection.h"
+#include "client/auth.h"
+#include "client/demux.h"
+#include "utils/json_config.h"
+#include "utils/pipeline_stats.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace baichuan {
+
+// One logged-in Baichuan connection shared by every camera entry with the
+// same host, port and credentials - the channels of an NVR, or the main and
+// sub stream of one camera. Each entry runs its own VideoStream on the
+// session's MessageDemux, so N streams cost one socket and one login. The
+// connection closes when the last user releases it.
+//
+// Opening never blocks a thread: the TCP handshake is a non-blocking
+// connect() watched by the I/O reactor, and each login step is a request on
+// the demux whose reply sends the next.
+//
+// An open session keeps itself alive: one reactor timer per connection,
+// set to the next deadline after the last message received, pings a quiet
+// camera and reports a connection that has stopped answering to the health
+// listeners, so cameras can log in on a new one before dropping it. Nothing
+// wakes while data flows between deadlines. What a login learned
+// (negotiated encryption, device info) is kept per host and handed to the
+// next login.
+class BaichuanSession : public std::enable_shared_from_this<BaichuanSession> {
+public:
+    // The live session for the camera's host and credentials, or a new one
+    // (also when the live one has gone quiet)
+    static std::shared_ptr<BaichuanSession> acquire(const CameraConfig& config);
+
+    explicit BaichuanSession(const CameraConfig& config);
+    ~BaichuanSession();
+
+    BaichuanSession(const BaichuanSession&) = delete;
+    BaichuanSession& operator=(const BaichuanSession&) = delete;
+
+    // Connect and log in. done(ok, error) runs once the session is open or
+    // has failed - on an I/O thread, or at once if that is already decided;
+    // later callers share the first one's attempt. On failure `error` holds
+    // a status text. done must not block (demux callback rules).
+    using OpenCallback = std::function<void(bool ok, const std::string& error)>;
+    void open_async(int connect_timeout_ms, OpenCallback done);
+
+    // Drop the caller's interest in an open_async() in progress (the caller
+    // got the session from acquire() and gives up on it, e.g. its camera was
+    // paused). Every acquire() of a session still opening counts as one
+    // waiter; once the last one gives up the login is aborted and the open
+    // fails promptly ("Cancelled"). No effect once the session is open.
+    void cancel_open();
+
+    // Logged in and the connection is still up
+    bool is_alive() const;
+
+    // Alive and heard from within QUIET_AFTER: a send on it won't stall
+    // (used to skip courtesy messages such as VIDEO_STOP on a failing link)
+    bool is_responsive() const;
+
+    enum class Health {
+        Alive,
+        Quiet,   // Nothing received for QUIET_AFTER, pings included
+        Dead     // Closed, or nothing received for DEAD_AFTER (final)
+    };
+
+    // The connection's state as of its last keepalive deadline. While
+    // nothing arrives the session sends MSG_ID_PING every PING_AFTER.
+    Health health() const { return health_.load(); }
+
+    // Called on an I/O thread whenever health() changes (must not block).
+    // Once remove_health_listener() returns the listener is not running and
+    // will not be called again (a listener may remove itself).
+    using HealthCallback = std::function<void(Health)>;
+    int add_health_listener(HealthCallback cb);
+    void remove_health_listener(int id);
+
+    // A streaming camera sends many messages a second, so half a second of
+    // silence is already unusual; the ping's reply has until QUIET_AFTER
+    static constexpr std::chrono::milliseconds PING_AFTER{500};
+    static constexpr std::chrono::milliseconds QUIET_AFTER{1500};
+    static constexpr std::chrono::milliseconds DEAD_AFTER{8000};
+
+    Connection& connection() { return connection_; }
+    MessageDemux& demux() { return demux_; }
+
+    // Socket read and decrypt times, one set per host and credentials; kept
+    // across reconnects (and after the last camera goes) so they accumulate
+    struct ConnectionStats {
+        std::string name;   // host:port
+        std::shared_ptr<PipelineStats> stats;
+    };
+    static std::vector<ConnectionStats> connection_stats();
+
+private:
+    enum class State { New, Open, Failed };
+
+    CameraConfig config_;
+    std::shared_ptr<PipelineStats> pipeline_stats_;
+    Connection connection_;
+    MessageDemux demux_;
+
+    // The open attempt: callbacks waiting for it, and the connect watch and
+    // timeout racing to finish the handshake (whoever claims it goes on)
+    std::mutex open_mutex_;
+    bool opening_ = false;                      // Guarded by open_mutex_
+    std::vector<OpenCallback> open_callbacks_;  // Guarded by open_mutex_
+    uint64_t connect_watch_ = 0;                // Guarded by open_mutex_
+    uint64_t connect_timer_ = 0;                // Guarded by open_mutex_
+    std::atomic<bool> connect_claimed_{false};
+    std::mutex cancel_mutex_;         // Orders cancel_open() against the switch to Open
+    int waiters_ = 0;                 // Users of the opening session; guarded by cancel_mutex_
+    bool cancelled_ = false;          // Guarded by cancel_mutex_
+    std::atomic<State> state_{State::New};
+    std::string error_;               // Guarded by open_mutex_
+
+    // Keepalive timer; last_ping_ is only touched by its callback
+    std::mutex keepalive_mutex_;
+    uint64_t keepalive_timer_ = 0;    // Guarded by keepalive_mutex_
+    bool keepalive_stopped_ = false;  // Guarded by keepalive_mutex_
+    std::chrono::steady_clock::time_point last_ping_{};
+
+    std::atomic<Health> health_{Health::Alive};
+    std::mutex listeners_mutex_;
+    std::map<int, HealthCallback> health_listeners_;
+    int next_listener_id_ = 0;
+    std::mutex notify_mutex_;         // Held while listeners run; orders health changes
+
+    void on_connected();
+    void on_connect_timeout();
+    void on_login(const LoginResult& result);
+    void finish_open(bool ok, const std::string& error);
+    // Drop a reference from inside the demux's own callbacks: the last one
+    // must not destroy the session (and its demux) there
+    static void release_later(std::shared_ptr<BaichuanSession> session);
+
+    std::chrono::steady_clock::duration quiet_for() const;
+    void schedule_keepalive(std::chrono::steady_clock::time_point when);
+    void on_keepalive();
+    void set_health(Health health);
+    bool cancelled();
+    // Count one more user of the opening session; false once it was cancelled
+    bool add_waiter();
+};
+
+} // namespace baichuan
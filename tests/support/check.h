@@ -0,0 +1,20 @@
+#pragma once
+
+// Assertions for the test programs: a failed check prints where it failed
+// (plus an optional printf-style note) and exits non-zero for ctest
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cond) CHECK_MSG(cond, "%s", "")
+
+#define CHECK_MSG(cond, ...)                                                        \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__,   \
+                         #cond);                                                    \
+            std::fprintf(stderr, __VA_ARGS__);                                      \
+            std::fprintf(stderr, "\n");                                             \
+            std::exit(1);                                                           \
+        }                                                                           \
+    } while (0)
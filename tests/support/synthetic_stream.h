@@ -0,0 +1,199 @@
+#pragma once
+
+// Synthetic camera streams for the tests and benchmarks
+//
+// Builds BcMedia frames and the BC video messages carrying them byte for
+// byte the way a camera sends them after login (unencrypted), so the
+// parsers and the receive path can be exercised without a camera or a
+// recorded capture.
+
+#include "protocol/bc_header.h"
+#include "protocol/bc_media.h"
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace baichuan {
+namespace test {
+
+// One BcMedia frame as the generator wrote it
+struct MediaFrame {
+    BcMediaType type = BcMediaType::PFrame;
+    VideoCodec codec = VideoCodec::H264;
+    uint32_t microseconds = 0;
+    std::optional<uint32_t> posix_time;     // IFrame additional header
+    uint32_t extra_header = 0;              // Additional header bytes (I/P frames)
+    BcMediaInfo info;                       // Info frames
+    std::vector<uint8_t> payload;           // Video / audio bytes
+};
+
+inline void append_u16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+inline void append_u32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+inline void append_padding(std::vector<uint8_t>& out, size_t payload_size) {
+    size_t remainder = payload_size % BCMEDIA_PAD_SIZE;
+    if (remainder != 0) {
+        out.insert(out.end(), BCMEDIA_PAD_SIZE - remainder, 0);
+    }
+}
+
+// Append the frame's stream bytes (magic, headers, payload, padding)
+inline void encode_frame(const MediaFrame& frame, std::vector<uint8_t>& out) {
+    switch (frame.type) {
+        case BcMediaType::Info: {
+            const BcMediaInfo& info = frame.info;
+            append_u32(out, MAGIC_BCMEDIA_INFO_V1);
+            append_u32(out, 32);
+            append_u32(out, info.video_width);
+            append_u32(out, info.video_height);
+            out.push_back(0);
+            out.push_back(info.fps);
+            for (uint8_t v : {info.start_year, info.start_month, info.start_day, info.start_hour,
+                              info.start_min, info.start_seconds, info.end_year, info.end_month,
+                              info.end_day, info.end_hour, info.end_min, info.end_seconds}) {
+                out.push_back(v);
+            }
+            out.insert(out.end(), 6, 0);    // Unknown; 32 bytes after the magic
+            return;
+        }
+        case BcMediaType::IFrame:
+        case BcMediaType::PFrame: {
+            bool iframe = frame.type == BcMediaType::IFrame;
+            append_u32(out, iframe ? MAGIC_BCMEDIA_IFRAME : MAGIC_BCMEDIA_PFRAME);
+            const char* video_type = frame.codec == VideoCodec::H265 ? "H265" : "H264";
+            out.insert(out.end(), video_type, video_type + 4);
+            append_u32(out, static_cast<uint32_t>(frame.payload.size()));
+            append_u32(out, frame.extra_header);
+            append_u32(out, frame.microseconds);
+            append_u32(out, 0);
+            if (frame.extra_header > 0) {
+                // IFrame: POSIX time first; the rest is ignored by the parsers
+                append_u32(out, frame.posix_time.value_or(0));
+                out.insert(out.end(), frame.extra_header - 4, 0);
+            }
+            out.insert(out.end(), frame.payload.begin(), frame.payload.end());
+            append_padding(out, frame.payload.size());
+            return;
+        }
+        case BcMediaType::Aac:
+            append_u32(out, MAGIC_BCMEDIA_AAC);
+            append_u16(out, static_cast<uint16_t>(frame.payload.size()));
+            append_u16(out, static_cast<uint16_t>(frame.payload.size()));
+            out.insert(out.end(), frame.payload.begin(), frame.payload.end());
+            append_padding(out, frame.payload.size());
+            return;
+        case BcMediaType::Adpcm:
+            append_u32(out, MAGIC_BCMEDIA_ADPCM);
+            append_u16(out, static_cast<uint16_t>(frame.payload.size() + 4));
+            append_u16(out, static_cast<uint16_t>(frame.payload.size() + 4));
+            append_u16(out, 0x0100);    // more_magic
+            append_u16(out, static_cast<uint16_t>(frame.payload.size() / 2));
+            out.insert(out.end(), frame.payload.begin(), frame.payload.end());
+            return;
+    }
+}
+
+inline std::vector<uint8_t> random_bytes(std::mt19937& rng, size_t len) {
+    std::vector<uint8_t> bytes(len);
+    for (uint8_t& b : bytes) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+// An Info frame, then GOPs of one I-frame and P-frames with some audio in
+// between. Payload sizes vary from 0 to max_payload (I-frames) or a tenth
+// of it (P-frames), covering every padding length.
+inline std::vector<MediaFrame> generate_media(std::mt19937& rng, size_t frame_count,
+                                              size_t max_payload = 64 * 1024) {
+    std::vector<MediaFrame> frames;
+
+    MediaFrame info;
+    info.type = BcMediaType::Info;
+    info.info.video_width = 1920;
+    info.info.video_height = 1080;
+    info.info.fps = 25;
+    info.info.start_year = 126;
+    info.info.start_month = 1;
+    info.info.start_day = 2;
+    frames.push_back(info);
+
+    VideoCodec codec = rng() % 2 ? VideoCodec::H265 : VideoCodec::H264;
+    uint32_t microseconds = 0;
+    for (size_t i = 1; i < frame_count; i++) {
+        MediaFrame frame;
+        uint32_t pick = rng() % 16;
+        if (pick == 0) {
+            frame.type = BcMediaType::Aac;
+            frame.payload = random_bytes(rng, rng() % 400);
+        } else if (pick == 1) {
+            frame.type = BcMediaType::Adpcm;
+            frame.payload = random_bytes(rng, 2 * (rng() % 200));
+        } else if (i % 25 == 1) {
+            frame.type = BcMediaType::IFrame;
+            frame.codec = codec;
+            frame.microseconds = microseconds;
+            uint32_t extra = rng() % 3;    // None, POSIX time, POSIX time + 4 unknown bytes
+            if (extra > 0) {
+                frame.extra_header = 4 * extra;
+                frame.posix_time = 1767225600 + static_cast<uint32_t>(i);
+            }
+            frame.payload = random_bytes(rng, rng() % (max_payload + 1));
+        } else {
+            frame.type = BcMediaType::PFrame;
+            frame.codec = codec;
+            frame.microseconds = microseconds;
+            frame.extra_header = rng() % 4 == 0 ? 4 : 0;
+            frame.payload = random_bytes(rng, rng() % (max_payload / 10 + 1));
+        }
+        if (frame.type == BcMediaType::IFrame || frame.type == BcMediaType::PFrame) {
+            microseconds += 40000;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+inline std::vector<uint8_t> encode_media(const std::vector<MediaFrame>& frames) {
+    std::vector<uint8_t> out;
+    for (const MediaFrame& frame : frames) {
+        encode_frame(frame, out);
+    }
+    return out;
+}
+
+constexpr const char* VIDEO_EXTENSION_XML =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+    "<Extension version=\"1.1\">\n"
+    "<binaryData>1</binaryData>\n"
+    "</Extension>\n";
+
+// Split a media byte stream into MSG_ID_VIDEO messages of up to
+// max_payload bytes (each with the binaryData extension) and serialize them
+inline std::vector<uint8_t> wrap_in_messages(const std::vector<uint8_t>& media, uint16_t msg_num,
+                                             size_t max_payload = 40 * 1024) {
+    std::vector<uint8_t> out;
+    for (size_t pos = 0; pos < media.size(); pos += max_payload) {
+        size_t len = std::min(max_payload, media.size() - pos);
+        std::vector<uint8_t> payload(media.begin() + static_cast<std::ptrdiff_t>(pos),
+                                     media.begin() + static_cast<std::ptrdiff_t>(pos + len));
+        BcMessage msg = BcMessage::create_with_extension(MSG_ID_VIDEO, msg_num, VIDEO_EXTENSION_XML,
+                                                         payload);
+        std::vector<uint8_t> bytes = msg.serialize();
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+    return out;
+}
+
+} // namespace test
+} // namespace baichuan
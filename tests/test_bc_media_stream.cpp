@@ -0,0 +1,182 @@
+// BcMediaStreamParser against arbitrary chunking
+//
+// A generated media stream (every frame type, payload sizes covering all
+// padding lengths, optional additional headers) is fed whole, in random
+// chunks, one byte at a time and with garbage between the frames. Every
+// way must produce exactly the generated frames, which must also match a
+// BcMediaParser::parse walk over the same bytes.
+
+#include "protocol/bc_media.h"
+#include "support/check.h"
+#include "support/synthetic_stream.h"
+#include "utils/logger.h"
+#include <cstring>
+
+using namespace baichuan;
+using test::MediaFrame;
+
+namespace {
+
+struct Parsed {
+    BcMediaFrame frame;
+    size_t frame_size;
+};
+
+// Payload bytes of any frame type
+std::pair<const uint8_t*, size_t> payload_of(const BcMediaFrame& frame) {
+    if (const FrameBuffer* video = BcMediaParser::get_video_data(frame)) {
+        return {video->data(), video->size()};
+    }
+    if (const auto* aac = std::get_if<BcMediaAac>(&frame)) {
+        return {aac->data.data(), aac->data.size()};
+    }
+    if (const auto* adpcm = std::get_if<BcMediaAdpcm>(&frame)) {
+        return {adpcm->data.data(), adpcm->data.size()};
+    }
+    return {nullptr, 0};
+}
+
+bool same_info(const BcMediaInfo& a, const BcMediaInfo& b) {
+    return a.video_width == b.video_width && a.video_height == b.video_height && a.fps == b.fps &&
+           a.start_year == b.start_year && a.start_month == b.start_month &&
+           a.start_day == b.start_day && a.start_hour == b.start_hour &&
+           a.start_min == b.start_min && a.start_seconds == b.start_seconds &&
+           a.end_year == b.end_year && a.end_month == b.end_month && a.end_day == b.end_day &&
+           a.end_hour == b.end_hour && a.end_min == b.end_min && a.end_seconds == b.end_seconds;
+}
+
+bool same_frame(const BcMediaFrame& parsed, const MediaFrame& expected) {
+    if (BcMediaParser::get_type(parsed) != expected.type) {
+        return false;
+    }
+    if (const auto* info = std::get_if<BcMediaInfo>(&parsed)) {
+        return same_info(*info, expected.info);
+    }
+    if (const auto* iframe = std::get_if<BcMediaIFrame>(&parsed)) {
+        if (iframe->codec != expected.codec || iframe->microseconds != expected.microseconds ||
+            iframe->posix_time != expected.posix_time) {
+            return false;
+        }
+    }
+    if (const auto* pframe = std::get_if<BcMediaPFrame>(&parsed)) {
+        if (pframe->codec != expected.codec || pframe->microseconds != expected.microseconds) {
+            return false;
+        }
+    }
+    auto [data, size] = payload_of(parsed);
+    return size == expected.payload.size() &&
+           (size == 0 || memcmp(data, expected.payload.data(), size) == 0);
+}
+
+void check_frames(const std::vector<Parsed>& parsed, const std::vector<MediaFrame>& expected,
+                  const char* how) {
+    CHECK_MSG(parsed.size() == expected.size(), "%s: %zu frames, expected %zu", how, parsed.size(),
+              expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        std::vector<uint8_t> encoded;
+        test::encode_frame(expected[i], encoded);
+        CHECK_MSG(same_frame(parsed[i].frame, expected[i]), "%s: frame %zu (%s) differs", how, i,
+                  BcMediaParser::type_name(expected[i].type));
+        CHECK_MSG(parsed[i].frame_size == encoded.size(), "%s: frame %zu size %zu, expected %zu",
+                  how, i, parsed[i].frame_size, encoded.size());
+    }
+}
+
+// Feed the stream in chunks whose sizes come from next_size
+template <typename NextSize>
+std::vector<Parsed> feed_chunks(const std::vector<uint8_t>& stream, NextSize next_size,
+                                uint64_t* skipped = nullptr) {
+    std::vector<Parsed> parsed;
+    BcMediaStreamParser parser([&](const BcMediaFrame& frame, size_t frame_size) {
+        parsed.push_back({frame, frame_size});
+    });
+    for (size_t pos = 0; pos < stream.size();) {
+        size_t len = std::min(next_size(), stream.size() - pos);
+        parser.feed(stream.data() + pos, len);
+        pos += len;
+    }
+    CHECK_MSG(parser.pending_bytes() == 0, "%zu bytes left pending", parser.pending_bytes());
+    if (skipped) {
+        *skipped = parser.skipped_bytes();
+    }
+    return parsed;
+}
+
+// Walk the whole buffer with BcMediaParser::parse, skipping bytes it rejects
+std::vector<Parsed> parse_walk(const std::vector<uint8_t>& stream) {
+    std::vector<Parsed> parsed;
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        auto result = BcMediaParser::parse(stream.data() + pos, stream.size() - pos);
+        if (result) {
+            parsed.push_back({std::move(result->first), result->second});
+            pos += result->second;
+        } else {
+            pos++;
+        }
+    }
+    return parsed;
+}
+
+// Garbage bytes are below '0' (0x30), so they never form part of a magic
+std::vector<uint8_t> encode_with_garbage(std::mt19937& rng, const std::vector<MediaFrame>& frames,
+                                         size_t& garbage_total) {
+    std::vector<uint8_t> out;
+    garbage_total = 0;
+    for (const MediaFrame& frame : frames) {
+        if (rng() % 3 == 0) {
+            size_t count = 1 + rng() % 40;
+            for (size_t i = 0; i < count; i++) {
+                out.push_back(static_cast<uint8_t>(rng() % 0x30));
+            }
+            garbage_total += count;
+        }
+        test::encode_frame(frame, out);
+    }
+    return out;
+}
+
+void run_seed(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<MediaFrame> frames = test::generate_media(rng, 200, 8 * 1024);
+    std::vector<uint8_t> stream = test::encode_media(frames);
+
+    check_frames(feed_chunks(stream, [&] { return stream.size(); }), frames, "whole buffer");
+    check_frames(parse_walk(stream), frames, "parse walk");
+    check_frames(feed_chunks(stream, [] { return size_t(1); }), frames, "1-byte feeds");
+
+    for (int round = 0; round < 20; round++) {
+        // Mostly small chunks (splitting headers and magics), some large ones
+        size_t max_chunk = round % 2 ? 64 : 16 * 1024;
+        check_frames(feed_chunks(stream, [&] { return 1 + rng() % max_chunk; }), frames,
+                     "random chunks");
+    }
+
+    size_t garbage_total = 0;
+    std::vector<uint8_t> dirty = encode_with_garbage(rng, frames, garbage_total);
+    uint64_t skipped = 0;
+    check_frames(feed_chunks(dirty, [&] { return dirty.size(); }, &skipped), frames,
+                 "whole buffer with garbage");
+    CHECK_MSG(skipped == garbage_total, "skipped %llu bytes, inserted %zu",
+              static_cast<unsigned long long>(skipped), garbage_total);
+    check_frames(parse_walk(dirty), frames, "parse walk with garbage");
+    check_frames(feed_chunks(dirty, [] { return size_t(1); }), frames, "1-byte feeds with garbage");
+    for (int round = 0; round < 10; round++) {
+        check_frames(feed_chunks(dirty, [&] { return 1 + rng() % 300; }, &skipped), frames,
+                     "random chunks with garbage");
+        CHECK(skipped == garbage_total);
+    }
+}
+
+} // namespace
+
+int main() {
+    // Resyncing over the garbage logs a warning each time
+    Logger::instance().set_level(LogLevel::Error);
+
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        run_seed(seed);
+    }
+    std::printf("BcMediaStreamParser: 20 streams ok\n");
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Connection::cancel from another thread
+//
+// A local listener accepts and never answers, like a camera that stalls
+// mid-login. A receive blocked on it with a 10 s timeout must return as
+// soon as cancel() is called, and the cancelled connection must refuse a
+// later connect().
+
+#include "client/connection.h"
+#include "support/check.h"
+#include "utils/logger.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+using namespace baichuan;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Listening socket on 127.0.0.1 (port 0: any free port)
+int listen_local(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(fd >= 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+    CHECK(listen(fd, 4) == 0);
+    socklen_t len = sizeof(addr);
+    CHECK(getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void test_cancel_receive() {
+    uint16_t port = 0;
+    int listener = listen_local(port);
+
+    Connection conn;
+    CHECK(conn.connect("127.0.0.1", port, 2000));
+    int camera_fd = accept(listener, nullptr, nullptr);
+    CHECK(camera_fd >= 0);
+
+    std::thread canceller([&conn] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        conn.cancel();
+    });
+    auto start = Clock::now();
+    auto msg = conn.receive_message(10000);
+    double waited = seconds_since(start);
+    canceller.join();
+
+    CHECK(!msg);
+    CHECK_MSG(waited < 2.0, "receive returned %.2f s after the start, not on cancel()", waited);
+
+    // Stays cancelled
+    start = Clock::now();
+    CHECK(!conn.connect("127.0.0.1", port, 2000));
+    CHECK(seconds_since(start) < 0.5);
+
+    close(camera_fd);
+    close(listener);
+}
+
+} // namespace
+
+int main() {
+    Logger::instance().set_level(LogLevel::Error);
+
+    test_cancel_receive();
+    std::printf("Connection: ok\n");
+    return 0;
+}
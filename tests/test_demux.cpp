@@ -0,0 +1,256 @@
+// MessageDemux routing and callback removal
+//
+// A Connection attached to one end of a socketpair stands in for a camera
+// session. Checks that replies, routes and listeners get their messages,
+// that a route removing itself from its own callback does not deadlock,
+// and - while messages for the route keep arriving - that once
+// remove_route() returns its callback never runs again. Asynchronous
+// requests get their reply, or nothing on timeout, close or cancel.
+
+#include "client/demux.h"
+#include "support/check.h"
+#include "utils/logger.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+
+using namespace baichuan;
+
+namespace {
+
+constexpr uint16_t REQUEST_NUM = 100;
+constexpr uint16_t ROUTED_NUM = 200;
+constexpr uint16_t UNROUTED_NUM = 300;
+constexpr uint16_t ASYNC_NUM = 400;
+
+bool write_all(int fd, const std::vector<uint8_t>& bytes) {
+    size_t offset = 0;
+    while (offset < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + offset, bytes.size() - offset);
+        if (n <= 0) return false;
+        offset += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::vector<uint8_t> message(uint16_t msg_num) {
+    return BcMessage::create_header_only(MSG_ID_VIDEO, msg_num).serialize();
+}
+
+template <typename Pred>
+bool wait_until(Pred pred) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Owns a socketpair: the Connection gets one end, the test writes the other
+struct Pair {
+    int camera_fd = -1;
+    Connection conn;
+
+    Pair() {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        camera_fd = fds[0];
+        conn.attach(fds[1], "socketpair");
+    }
+
+    ~Pair() { close(camera_fd); }
+};
+
+void test_routing() {
+    Pair pair;
+    MessageDemux demux(pair.conn);
+    CHECK(demux.start());
+
+    // The "camera" answers the request with the same msg_num
+    std::thread camera([&] {
+        uint8_t header[HEADER_SIZE_24];
+        size_t got = 0;
+        while (got < sizeof(header)) {
+            ssize_t n = ::read(pair.camera_fd, header + got, sizeof(header) - got);
+            if (n <= 0) return;
+            got += static_cast<size_t>(n);
+        }
+        BcHeader parsed;
+        BcHeader::deserialize(header, sizeof(header), parsed);
+        write_all(pair.camera_fd, message(parsed.msg_num));
+    });
+    auto reply = demux.request(BcMessage::create_header_only(MSG_ID_VIDEO, REQUEST_NUM), 5000);
+    camera.join();
+    CHECK(reply && reply->header.msg_num == REQUEST_NUM);
+
+    std::atomic<int> routed{0};
+    std::atomic<int> unrouted{0};
+    demux.add_route(ROUTED_NUM, [&](const BcMessageView&) { routed++; });
+    int listener = demux.add_listener([&](const BcMessageView& msg) {
+        CHECK(msg.header.msg_num == UNROUTED_NUM);
+        unrouted++;
+    });
+    for (int i = 0; i < 10; i++) {
+        CHECK(write_all(pair.camera_fd, message(ROUTED_NUM)));
+        CHECK(write_all(pair.camera_fd, message(UNROUTED_NUM)));
+    }
+    CHECK(wait_until([&] { return routed == 10 && unrouted == 10; }));
+
+    MessageDemux::Stats stats = demux.stats();
+    CHECK(stats.replies == 1 && stats.routed == 10 && stats.unrouted == 10);
+
+    demux.remove_listener(listener);
+    demux.remove_route(ROUTED_NUM);
+    demux.stop();
+}
+
+void test_self_removal() {
+    Pair pair;
+    MessageDemux demux(pair.conn);
+    CHECK(demux.start());
+
+    std::atomic<int> calls{0};
+    std::atomic<int> after{0};
+    demux.add_route(ROUTED_NUM, [&](const BcMessageView&) {
+        calls++;
+        demux.remove_route(ROUTED_NUM);
+    });
+    demux.add_listener([&](const BcMessageView&) { after++; });
+
+    // Both in one read: the second goes to the listener once the route is gone
+    std::vector<uint8_t> two = message(ROUTED_NUM);
+    std::vector<uint8_t> second = message(ROUTED_NUM);
+    two.insert(two.end(), second.begin(), second.end());
+    CHECK(write_all(pair.camera_fd, two));
+    CHECK(wait_until([&] { return calls == 1 && after == 1; }));
+    demux.stop();
+}
+
+void test_removal_race() {
+    Pair pair;
+    MessageDemux demux(pair.conn);
+    CHECK(demux.start());
+
+    std::atomic<bool> flooding{true};
+    std::thread camera([&] {
+        std::vector<uint8_t> batch;
+        for (int i = 0; i < 64; i++) {
+            std::vector<uint8_t> one = message(ROUTED_NUM);
+            batch.insert(batch.end(), one.begin(), one.end());
+        }
+        while (flooding.load() && write_all(pair.camera_fd, batch)) {
+        }
+    });
+
+    // Each route tags its calls with its generation; a call from a
+    // generation whose remove_route() has returned is a use after removal
+    std::atomic<int> removed_generation{0};
+    std::atomic<int> late_calls{0};
+    std::atomic<uint64_t> calls{0};
+    for (int generation = 1; generation <= 2000; generation++) {
+        demux.add_route(ROUTED_NUM, [&, generation](const BcMessageView&) {
+            calls++;
+            if (removed_generation.load() >= generation) {
+                late_calls++;
+            }
+        });
+        uint64_t seen = calls.load();
+        wait_until([&] { return calls.load() > seen; });
+        demux.remove_route(ROUTED_NUM);
+        removed_generation.store(generation);
+    }
+
+    flooding.store(false);
+    demux.stop();
+    shutdown(pair.camera_fd, SHUT_RDWR);
+    camera.join();
+
+    CHECK_MSG(late_calls == 0, "%d callbacks ran after remove_route() returned", late_calls.load());
+    std::printf("removal race: %llu routed calls, none after removal\n",
+                static_cast<unsigned long long>(calls.load()));
+}
+
+} // namespace
+
+// Reads one request header off the camera end; its msg_num, or -1
+int read_request(int fd) {
+    uint8_t header[HEADER_SIZE_24];
+    size_t got = 0;
+    while (got < sizeof(header)) {
+        ssize_t n = ::read(fd, header + got, sizeof(header) - got);
+        if (n <= 0) return -1;
+        got += static_cast<size_t>(n);
+    }
+    BcHeader parsed;
+    BcHeader::deserialize(header, sizeof(header), parsed);
+    return parsed.msg_num;
+}
+
+void test_request_async() {
+    Pair pair;
+    MessageDemux demux(pair.conn);
+    CHECK(demux.start());
+
+    // Answered: the callback gets the reply
+    std::atomic<int> calls{0};
+    std::optional<BcMessage> reply;
+    CHECK(demux.request_async(BcMessage::create_header_only(MSG_ID_VIDEO, ASYNC_NUM), 5000,
+                              [&](std::optional<BcMessage> msg) {
+        reply = std::move(msg);
+        calls++;
+    }));
+    CHECK(read_request(pair.camera_fd) == ASYNC_NUM);
+    CHECK(write_all(pair.camera_fd, message(ASYNC_NUM)));
+    CHECK(wait_until([&] { return calls == 1; }));
+    CHECK(reply && reply->header.msg_num == ASYNC_NUM);
+
+    // Unanswered: nothing once the timeout passes
+    std::atomic<int> timeouts{0};
+    CHECK(demux.request_async(BcMessage::create_header_only(MSG_ID_VIDEO, ASYNC_NUM + 1), 50,
+                              [&](std::optional<BcMessage> msg) {
+        CHECK(!msg);
+        timeouts++;
+    }));
+    CHECK(read_request(pair.camera_fd) == ASYNC_NUM + 1);
+    CHECK(wait_until([&] { return timeouts == 1; }));
+
+    // Cancelled: the callback never runs, not even for a late reply
+    std::atomic<int> cancelled_calls{0};
+    CHECK(demux.request_async(BcMessage::create_header_only(MSG_ID_VIDEO, ASYNC_NUM + 2), 5000,
+                              [&](std::optional<BcMessage>) { cancelled_calls++; }));
+    CHECK(demux.cancel_request(ASYNC_NUM + 2));
+    CHECK(!demux.cancel_request(ASYNC_NUM + 2));
+    CHECK(read_request(pair.camera_fd) == ASYNC_NUM + 2);
+    CHECK(write_all(pair.camera_fd, message(ASYNC_NUM + 2)));
+
+    // Connection lost: waiting requests fail at once, not at their timeout
+    std::atomic<int> failed{0};
+    auto sent = std::chrono::steady_clock::now();
+    CHECK(demux.request_async(BcMessage::create_header_only(MSG_ID_VIDEO, ASYNC_NUM + 3), 5000,
+                              [&](std::optional<BcMessage> msg) {
+        CHECK(!msg);
+        failed++;
+    }));
+    CHECK(read_request(pair.camera_fd) == ASYNC_NUM + 3);
+    shutdown(pair.camera_fd, SHUT_RDWR);
+    CHECK(wait_until([&] { return failed == 1; }));
+    CHECK(std::chrono::steady_clock::now() - sent < std::chrono::seconds(2));
+
+    CHECK(calls == 1 && timeouts == 1 && cancelled_calls == 0 && failed == 1);
+    demux.stop();
+}
+
+int main() {
+    Logger::instance().set_level(LogLevel::Error);
+
+    test_routing();
+    test_self_removal();
+    test_removal_race();
+    test_request_async();
+    std::printf("MessageDemux: ok\n");
+    return 0;
+}
@@ -0,0 +1,197 @@
+// ExtensionXml scanner against libxml2
+//
+// The scanner may reject anything (parse() then falls back to libxml2),
+// but whatever it accepts must come out exactly as parse_dom() reads it.
+// Checked on the forms the cameras send and on a few hundred thousand
+// random mutations of them (byte edits biased towards XML syntax, spliced
+// fragments, truncation), plus generated extensions whose children and
+// values are drawn at random so most of them stay on the scanner path.
+// The camera forms must also take the scanner path.
+
+#include "protocol/bc_xml.h"
+#include "support/check.h"
+#include <libxml/parser.h>
+#include <algorithm>
+#include <random>
+#include <string>
+
+using namespace baichuan;
+
+namespace {
+
+const char* const CAMERA_FORMS[] = {
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<Extension version=\"1.1\">\n<binaryData>1</binaryData>\n</Extension>\n",
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<Extension version=\"1.1\">\n<channelId>0</channelId>\n</Extension>\n",
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<Extension version=\"1.1\">\n<binaryData>1</binaryData>\n<encryptLen>1024</encryptLen>\n</Extension>\n",
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<Extension version=\"1.1\">\n<userName>admin</userName>\n<token>abc123</token>\n<channelId>2</channelId>\n</Extension>\n",
+    "<?xml version=\"1.0\"?><Extension version=\"1.1\"><binaryData>1</binaryData></Extension>",
+    "<Extension version=\"1.1\"><channelId>255</channelId><binaryData>0</binaryData></Extension>",
+    "<Extension><checkPos>0</checkPos><binaryData>1</binaryData></Extension>",
+};
+
+// Pieces that tend to push either parser onto an edge
+const char* const FRAGMENTS[] = {
+    "<", ">", "</", "/>", "=", "\"", "'", " ", "\t", "\r\n", "&amp;", "&lt;", "&#65;", "&#x41;",
+    "<![CDATA[7]]>", "<!-- c -->", "<?pi x?>", "]]>", "<binaryData>", "</binaryData>",
+    "<channelId>", "</channelId>", "<encryptLen>", "</encryptLen>", "<token>", "</token>",
+    "<userName>", "</userName>", "<x/>", "<a:b>", "version=\"2\"", " version='1.1'",
+    "4294967295", "4294967296", "99999999999", "-1", "+1", "0x10", " 12 ", "\xC3\xA9", "\xFF",
+    "<?xml version=\"1.0\"?>", "encoding=\"ISO-8859-1\"", "<Extension>", "</Extension>",
+    "<body>", "</body>", "\n", "\x00",
+};
+
+const char ALPHABET[] = "<>/=\"' \t\r\n&;#!?-[]0123456789abcdefxyzEBCDATAx\x7f\x80\xC3";
+
+const char* const CHILDREN[] = {
+    "binaryData", "channelId", "encryptLen", "userName", "token", "checkPos", "x", "binarydata",
+};
+
+// Values for generated children: numbers at and past the scanner's limits,
+// padding and the characters it must refuse
+const char* const VALUES[] = {
+    "0", "1", "7", "255", "256", "1024", "000000001", "123456789", "1234567890", "4294967295",
+    "4294967296", " 5", "5 ", "\t5\n", " ", "", "-1", "+1", "1 2", "abc", "admin", "a b\tc",
+    "x\ny", "&amp;", "&#49;", "<![CDATA[1]]>", "1<!--c-->", "\xC3\xA9", "a]]>b", "\r", "\x01",
+};
+
+const char* const PROLOGS[] = {
+    "", "<?xml version=\"1.0\"?>", "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n",
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>", "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>",
+    "<?xml version='1.0'?>", " <?xml version=\"1.0\"?>", "\n",
+};
+
+const char* const OPENERS[] = {
+    "<Extension>", "<Extension version=\"1.1\">", "<Extension version=\"2\">",
+    "<Extension version='1.1'>", "<Extension version=\"1.1\" >", "<Extension  version=\"\">",
+    "<Extension version=\"1.1\" version=\"1.2\">", "<Extension other=\"1\">", "<extension>",
+};
+
+const char* const CLOSERS[] = {
+    "</Extension>", "</Extension>\n", "</Extension >", "</Extension>\n\n  ", "</Extension>x",
+    "</Extension><x/>", "", "</extension>",
+};
+
+template <typename T, size_t N>
+const T& pick(std::mt19937& rng, const T (&items)[N]) {
+    return items[rng() % N];
+}
+
+std::string generate(std::mt19937& rng) {
+    std::string text = pick(rng, PROLOGS);
+    text += pick(rng, OPENERS);
+    int children = static_cast<int>(rng() % 6);
+    for (int i = 0; i < children; i++) {
+        const char* name = pick(rng, CHILDREN);
+        text += rng() % 4 == 0 ? "\n" : "";
+        text += std::string("<") + name + ">" + pick(rng, VALUES) + "</" + name + ">";
+    }
+    text += pick(rng, CLOSERS);
+    return text;
+}
+
+bool same(const ExtensionXml& a, const ExtensionXml& b) {
+    return a.version == b.version && a.binary_data == b.binary_data &&
+           a.user_name == b.user_name && a.token == b.token && a.channel_id == b.channel_id &&
+           a.encrypt_len == b.encrypt_len;
+}
+
+std::string describe(const std::optional<uint32_t>& v) {
+    return v ? std::to_string(*v) : "-";
+}
+
+std::string describe(const ExtensionXml& x) {
+    return "version=" + x.version + " binaryData=" + describe(x.binary_data) +
+           " channelId=" + (x.channel_id ? std::to_string(*x.channel_id) : "-") +
+           " encryptLen=" + describe(x.encrypt_len) + " userName=" + x.user_name.value_or("-") +
+           " token=" + x.token.value_or("-");
+}
+
+// Returns true if the scanner took the input
+bool check_input(const std::string& input) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(input.data());
+    ExtensionXml scanned;
+    if (!ExtensionXml::scan(data, input.size(), scanned)) {
+        return false;
+    }
+    std::optional<ExtensionXml> dom = ExtensionXml::parse_dom(data, input.size());
+    CHECK_MSG(dom, "scanner accepted what libxml2 rejects: [%s]", input.c_str());
+    CHECK_MSG(same(scanned, *dom), "scanner [%s] vs libxml2 [%s] for [%s]", describe(scanned).c_str(),
+              describe(*dom).c_str(), input.c_str());
+    return true;
+}
+
+std::string mutate(std::mt19937& rng, std::string text) {
+    int edits = 1 + static_cast<int>(rng() % 4);
+    for (int e = 0; e < edits; e++) {
+        size_t pos = text.empty() ? 0 : rng() % (text.size() + 1);
+        switch (rng() % 6) {
+            case 0:    // Insert a character
+                text.insert(pos, 1, ALPHABET[rng() % (sizeof(ALPHABET) - 1)]);
+                break;
+            case 1:    // Replace a character
+                if (pos < text.size()) text[pos] = ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+                break;
+            case 2:    // Delete a run
+                if (pos < text.size()) text.erase(pos, 1 + rng() % 4);
+                break;
+            case 3: {  // Splice in a fragment
+                const char* fragment = FRAGMENTS[rng() % (sizeof(FRAGMENTS) / sizeof(FRAGMENTS[0]))];
+                size_t len = fragment[0] == '\0' ? 1 : std::char_traits<char>::length(fragment);
+                text.insert(pos, fragment, len);
+                break;
+            }
+            case 4:    // Truncate
+                text.resize(pos);
+                break;
+            case 5: {  // Duplicate a slice elsewhere
+                if (text.empty()) break;
+                size_t from = rng() % text.size();
+                size_t len = 1 + rng() % std::min<size_t>(40, text.size() - from);
+                text.insert(pos, text.substr(from, len));
+                break;
+            }
+        }
+    }
+    return text;
+}
+
+} // namespace
+
+int main() {
+    xmlInitParser();
+
+    for (const char* form : CAMERA_FORMS) {
+        CHECK_MSG(check_input(form), "camera form not taken by the scanner: [%s]", form);
+    }
+
+    std::mt19937 rng(2024);
+    size_t accepted = 0;
+    constexpr size_t ROUNDS = 300000;
+    for (size_t i = 0; i < ROUNDS; i++) {
+        std::string input = CAMERA_FORMS[rng() % (sizeof(CAMERA_FORMS) / sizeof(CAMERA_FORMS[0]))];
+        // Mutations of mutations reach further from the camera forms
+        int generations = 1 + static_cast<int>(rng() % 3);
+        for (int g = 0; g < generations; g++) {
+            input = mutate(rng, input);
+        }
+        if (check_input(input)) {
+            accepted++;
+        }
+    }
+
+    size_t generated_accepted = 0;
+    for (size_t i = 0; i < ROUNDS; i++) {
+        std::string input = generate(rng);
+        if (rng() % 4 == 0) {
+            input = mutate(rng, input);
+        }
+        if (check_input(input)) {
+            generated_accepted++;
+        }
+    }
+
+    std::printf("ExtensionXml: %zu mutated inputs (%zu taken by the scanner), %zu generated (%zu "
+                "taken), all matching libxml2\n",
+                ROUNDS, accepted, ROUNDS, generated_accepted);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// IoReactor timers
+//
+// Timers fire in deadline order and not before their deadline; a timer
+// added with an earlier deadline than every pending one re-arms the wait;
+// cancelled timers never fire; cancel_timer() on a running callback waits
+// for it to finish, and a callback may cancel itself.
+
+#include "utils/io_reactor.h"
+#include "support/check.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace baichuan;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+template <typename Pred>
+bool wait_until(Pred pred) {
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (!pred()) {
+        if (Clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void test_order() {
+    IoReactor& reactor = IoReactor::instance();
+    std::mutex mutex;
+    std::vector<int> fired;
+    std::vector<bool> early;
+
+    // Added latest first, so each one moves the earliest deadline forward
+    auto start = Clock::now();
+    for (int i = 4; i >= 0; i--) {
+        auto when = start + std::chrono::milliseconds(20 + 20 * i);
+        CHECK(reactor.add_timer(when, [&, i, when] {
+            std::lock_guard<std::mutex> lock(mutex);
+            fired.push_back(i);
+            early.push_back(Clock::now() < when);
+        }) != 0);
+    }
+
+    CHECK(wait_until([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fired.size() == 5;
+    }));
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < 5; i++) {
+        CHECK_MSG(fired[i] == i, "timer %d fired in position %d", fired[i], i);
+        CHECK_MSG(!early[i], "timer %d fired before its deadline", fired[i]);
+    }
+}
+
+void test_cancel() {
+    IoReactor& reactor = IoReactor::instance();
+    std::atomic<int> fired{0};
+
+    uint64_t cancelled = reactor.add_timer(Clock::now() + std::chrono::milliseconds(30), [&] {
+        fired += 100;
+    });
+    uint64_t kept = reactor.add_timer(Clock::now() + std::chrono::milliseconds(60), [&] {
+        fired += 1;
+    });
+    CHECK(reactor.cancel_timer(cancelled));
+    CHECK(!reactor.cancel_timer(cancelled));
+
+    CHECK(wait_until([&] { return fired.load() != 0; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_MSG(fired.load() == 1, "fired = %d", fired.load());
+    CHECK(!reactor.cancel_timer(kept));
+}
+
+void test_cancel_waits() {
+    IoReactor& reactor = IoReactor::instance();
+    std::atomic<bool> running{false};
+    std::atomic<bool> finished{false};
+
+    uint64_t id = reactor.add_timer(Clock::now(), [&] {
+        running.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        finished.store(true);
+    });
+    CHECK(wait_until([&] { return running.load(); }));
+    CHECK(!reactor.cancel_timer(id));
+    CHECK_MSG(finished.load(), "cancel_timer() returned while the callback ran");
+}
+
+void test_cancel_self() {
+    IoReactor& reactor = IoReactor::instance();
+    std::atomic<uint64_t> id{0};
+    std::atomic<bool> done{false};
+
+    std::atomic<bool> added{false};
+    id = reactor.add_timer(Clock::now() + std::chrono::milliseconds(10), [&] {
+        while (!added.load()) std::this_thread::yield();
+        CHECK(!reactor.cancel_timer(id.load()));
+        done.store(true);
+    });
+    added.store(true);
+    CHECK(wait_until([&] { return done.load(); }));
+}
+
+} // namespace
+
+int main() {
+    test_order();
+    test_cancel();
+    test_cancel_waits();
+    test_cancel_self();
+
+    auto stats = IoReactor::instance().stats();
+    CHECK_MSG(stats.timers == 0, "%llu timers still pending", static_cast<unsigned long long>(stats.timers));
+    std::printf("IoReactor: timer order, cancel and cancel-while-running OK\n");
+    return 0;
+}